@@ -0,0 +1,4 @@
+#include <benchmark/benchmark.h>
+
+// Defined here rather than linked from benchmark_main: libutils carries the utils examples, each with its own main().
+BENCHMARK_MAIN();
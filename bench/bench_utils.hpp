@@ -0,0 +1,40 @@
+#pragma once
+
+#include <chrono>
+#include <thread>
+
+#include <benchmark/benchmark.h>
+
+#include "utils/logger.hpp"
+
+
+namespace kse::bench {
+	/// One logger for every benchmark: each one starts a flusher thread and opens a file.
+	inline auto bench_logger() -> utils::logger& {
+		static utils::logger logger{ "kse_bench.log" };
+		return logger;
+	}
+
+	/**
+	 * The logger and the engine's output queues never block a writer: a full one wraps over unread entries. Benchmarks
+	 * call this every iteration; with the timer paused it lets the logger catch up and empties the queues before either fills.
+	 */
+	template<typename... Q>
+	inline auto settle(benchmark::State& state, utils::logger& logger, Q&... queues) -> void {
+		if (logger.pending() < utils::LOG_QUEUE_SIZE / 2 && ((queues.size() < queues.capacity() / 2) && ...)) [[likely]] {
+			return;
+		}
+
+		state.PauseTiming();
+		using namespace std::literals::chrono_literals;
+		while (logger.pending()) {
+			std::this_thread::sleep_for(1ms);
+		}
+		([&queues]() {
+			while (queues.size()) {
+				queues.next_read_index();
+			}
+		}(), ...);
+		state.ResumeTiming();
+	}
+}
@@ -0,0 +1,83 @@
+#include <atomic>
+#include <thread>
+
+#include <benchmark/benchmark.h>
+
+#include "models/client_request.hpp"
+
+#include "utils/lock_free_queue.hpp"
+#include "utils/utils.hpp"
+
+using namespace kse;
+
+
+namespace {
+	/**
+	 * Round trip of a client request through two queues: the benchmark thread writes to ping and waits for the echo
+	 * thread to copy it back through pong. Both threads share core 0 or sit on cores 0 and 1. Sharing a core, the
+	 * waiting side yields to the other one; otherwise both spin.
+	 */
+	template<bool same_core>
+	void BM_LockFreeQueuePingPong(benchmark::State& state) {
+		if (!same_core && std::thread::hardware_concurrency() < 2) {
+			state.SkipWithError("needs two cores");
+			return;
+		}
+		if (!utils::pin_thread(0)) {
+			state.SkipWithError("cannot pin to core 0");
+			return;
+		}
+
+		utils::lock_free_queue<models::client_request_internal> ping{ 1024 };
+		utils::lock_free_queue<models::client_request_internal> pong{ 1024 };
+		std::atomic<bool> running = true;
+
+		auto echo = utils::create_thread(same_core ? 0 : 1, [&]() {
+			while (running.load(std::memory_order_relaxed)) {
+				if (const auto* request = ping.get_next_read_element()) {
+					*pong.get_next_write_element() = *request;
+					pong.next_write_index();
+					ping.next_read_index();
+				}
+				else if (same_core) {
+					std::this_thread::yield();
+				}
+			}
+		});
+
+		models::client_request_internal request;
+		request.type_ = models::client_request_type::NEW;
+		for (auto _ : state) {
+			++request.order_id_;
+			*ping.get_next_write_element() = request;
+			ping.next_write_index();
+
+			const models::client_request_internal* echoed = nullptr;
+			while (!(echoed = pong.get_next_read_element())) {
+				if (same_core) {
+					std::this_thread::yield();
+				}
+			}
+			benchmark::DoNotOptimize(echoed->order_id_);
+			pong.next_read_index();
+		}
+
+		running = false;
+	}
+
+	/// Write then read on one thread: the cost of the queue operations themselves.
+	void BM_LockFreeQueueWriteRead(benchmark::State& state) {
+		utils::lock_free_queue<models::client_request_internal> queue{ 1024 };
+		models::client_request_internal request;
+		for (auto _ : state) {
+			*queue.get_next_write_element() = request;
+			queue.next_write_index();
+			benchmark::DoNotOptimize(queue.get_next_read_element());
+			queue.next_read_index();
+		}
+	}
+}
+
+BENCHMARK(BM_LockFreeQueueWriteRead);
+BENCHMARK(BM_LockFreeQueuePingPong<true>)->Name("BM_LockFreeQueuePingPong/same_core")->UseRealTime();
+BENCHMARK(BM_LockFreeQueuePingPong<false>)->Name("BM_LockFreeQueuePingPong/cross_core")->UseRealTime();
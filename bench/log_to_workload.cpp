@@ -0,0 +1,32 @@
+#include "workload.hpp"
+
+#include <iostream>
+
+
+/// Converts the request lines of a matching engine log, such as perf_analysis/kse_matching_engine.log, into a workload file for kse_replay_bench.
+int main(int argc, char** argv) {
+	if (argc != 3) {
+		std::cerr << "Usage: " << argv[0] << " <matching engine log> <workload file>\n";
+		return EXIT_FAILURE;
+	}
+
+	std::ifstream log{ argv[1] };
+	if (!log) {
+		std::cerr << "Could not open " << argv[1] << "\n";
+		return EXIT_FAILURE;
+	}
+
+	size_t skipped = 0;
+	const auto requests = kse::bench::read_request_log(log, &skipped);
+	if (!kse::bench::write_workload(argv[2], requests)) {
+		std::cerr << "Could not write " << argv[2] << "\n";
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "Wrote " << requests.size() << " requests to " << argv[2];
+	if (skipped) {
+		std::cout << ", skipped " << skipped << " request lines that did not parse";
+	}
+	std::cout << "\n";
+	return EXIT_SUCCESS;
+}
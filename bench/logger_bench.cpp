@@ -0,0 +1,53 @@
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include "models/client_request.hpp"
+
+#include "bench_utils.hpp"
+
+using namespace kse;
+
+
+namespace {
+	/// Every character of the format is its own queue entry, so the cost grows with the format's length.
+	void BM_LoggerLogFormat(benchmark::State& state) {
+		auto& logger = bench::bench_logger();
+		for (auto _ : state) {
+			logger.log("RDTSC Exchange_MEOrderBook_add\n");
+			bench::settle(state, logger);
+		}
+	}
+
+	/// The line the matching engine writes for every request, with the time string and the request's text prepared once.
+	void BM_LoggerLogEngineLine(benchmark::State& state) {
+		auto& logger = bench::bench_logger();
+		std::string time_str;
+		utils::get_curren_time_str(&time_str);
+		models::client_request_internal request;
+		request.type_ = models::client_request_type::NEW;
+		const auto request_str = request.to_string();
+
+		for (auto _ : state) {
+			logger.log("%:% %() % Processing %\n", __FILE__, __LINE__, __func__, time_str, request_str);
+			bench::settle(state, logger);
+		}
+	}
+
+	/// The same line formatting the time and the request on the logging thread, as the engine does.
+	void BM_LoggerLogEngineLineFormatted(benchmark::State& state) {
+		auto& logger = bench::bench_logger();
+		std::string time_str;
+		models::client_request_internal request;
+		request.type_ = models::client_request_type::NEW;
+
+		for (auto _ : state) {
+			logger.log("%:% %() % Processing %\n", __FILE__, __LINE__, __func__, utils::get_curren_time_str(&time_str), request.to_string());
+			bench::settle(state, logger);
+		}
+	}
+}
+
+BENCHMARK(BM_LoggerLogFormat);
+BENCHMARK(BM_LoggerLogEngineLine);
+BENCHMARK(BM_LoggerLogEngineLineFormatted);
@@ -0,0 +1,58 @@
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "models/constants.hpp"
+#include "models/order.hpp"
+
+#include "utils/memory_pool.hpp"
+
+using namespace kse;
+
+
+namespace {
+	/// Alloc and free of one order, the pattern of an order that rests briefly: the pool hands back the same block every time.
+	void BM_MemoryPoolAllocFree(benchmark::State& state) {
+		utils::memory_pool<models::order> pool{ models::MAX_NUM_ORDERS };
+		for (auto _ : state) {
+			auto* order = pool.alloc();
+			benchmark::DoNotOptimize(order);
+			pool.free(order);
+		}
+	}
+
+	/**
+	 * Allocates range(0) orders, then frees them in allocation order (a book draining from the front of its queues)
+	 * or shuffled (cancels scattered over the book), which leaves the free list out of address order for the next round.
+	 */
+	template<bool shuffled>
+	void BM_MemoryPoolBulk(benchmark::State& state) {
+		const auto count = static_cast<size_t>(state.range(0));
+		utils::memory_pool<models::order> pool{ models::MAX_NUM_ORDERS };
+		std::vector<models::order*> orders(count);
+		std::vector<size_t> free_order(count);
+		for (size_t i = 0; i < count; ++i) {
+			free_order[i] = i;
+		}
+		if (shuffled) {
+			std::shuffle(free_order.begin(), free_order.end(), std::mt19937_64{ 42 });
+		}
+
+		for (auto _ : state) {
+			for (auto& order : orders) {
+				order = pool.alloc();
+			}
+			benchmark::ClobberMemory();
+			for (const auto i : free_order) {
+				pool.free(orders[i]);
+			}
+		}
+		state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * count));
+	}
+}
+
+BENCHMARK(BM_MemoryPoolAllocFree);
+BENCHMARK(BM_MemoryPoolBulk<false>)->Name("BM_MemoryPoolBulk/fifo")->RangeMultiplier(8)->Range(8, models::MAX_NUM_ORDERS);
+BENCHMARK(BM_MemoryPoolBulk<true>)->Name("BM_MemoryPoolBulk/shuffled")->RangeMultiplier(8)->Range(8, models::MAX_NUM_ORDERS);
@@ -0,0 +1,95 @@
+#include <chrono>
+#include <memory>
+
+#include <benchmark/benchmark.h>
+
+#include "engine/order_book.hpp"
+
+#include "bench_utils.hpp"
+
+using namespace kse;
+
+
+namespace {
+	constexpr models::price_t MID_PRICE = 1000;
+	constexpr models::quantity_t LEVEL_QTY = 10;
+	constexpr models::client_id_t MAKER = 1;
+	constexpr models::client_id_t TAKER = 2;
+
+	/**
+	 * A book `depth` levels deep on each side around MID_PRICE, with one maker order per level: the bid at
+	 * MID_PRICE - 1 - i has client order id 1 + i, the ask at MID_PRICE + 1 + i has depth + 1 + i.
+	 */
+	struct book_fixture {
+		explicit book_fixture(size_t depth) : depth_{ depth } {
+			add_bids();
+			for (size_t i = 0; i < depth_; ++i) {
+				book_->add(MAKER, depth_ + 1 + i, models::side_t::SELL, MID_PRICE + 1 + static_cast<models::price_t>(i), LEVEL_QTY);
+			}
+		}
+
+		auto add_bids() -> void {
+			for (size_t i = 0; i < depth_; ++i) {
+				book_->add(MAKER, 1 + i, models::side_t::BUY, MID_PRICE - 1 - static_cast<models::price_t>(i), LEVEL_QTY);
+			}
+		}
+
+		auto settle(benchmark::State& state) -> void {
+			bench::settle(state, bench::bench_logger(), responses_, updates_);
+		}
+
+		size_t depth_ = 0;
+		models::client_response_queue responses_{ models::MAX_CLIENT_UPDATES };
+		models::market_update_queue updates_{ models::MAX_MARKET_UPDATES };
+		engine::message_handler message_handler_{ &responses_, &updates_, &bench::bench_logger() };
+		std::unique_ptr<engine::order_book> book_ = std::make_unique<engine::order_book>(0, &bench::bench_logger(), &message_handler_);
+	};
+
+	/// A passive order joins the back of the level halfway down the bids and is canceled again.
+	void BM_OrderBookAddCancel(benchmark::State& state) {
+		book_fixture fixture{ static_cast<size_t>(state.range(0)) };
+		const auto order_id = 2 * fixture.depth_ + 1;
+		const auto price = MID_PRICE - 1 - static_cast<models::price_t>(fixture.depth_ / 2);
+
+		for (auto _ : state) {
+			fixture.book_->add(MAKER, order_id, models::side_t::BUY, price, LEVEL_QTY);
+			fixture.book_->cancel(MAKER, order_id);
+			fixture.settle(state);
+		}
+	}
+
+	/// A bid halfway down moves into the spread, opening a new best level, and back to its own level.
+	void BM_OrderBookModify(benchmark::State& state) {
+		book_fixture fixture{ static_cast<size_t>(state.range(0)) };
+		const auto order_id = 1 + fixture.depth_ / 2;
+		const auto price = MID_PRICE - 1 - static_cast<models::price_t>(fixture.depth_ / 2);
+
+		bool in_spread = false;
+		for (auto _ : state) {
+			fixture.book_->modify(MAKER, order_id, in_spread ? price : MID_PRICE, LEVEL_QTY);
+			in_spread = !in_spread;
+			fixture.settle(state);
+		}
+	}
+
+	/// A sell takes out every bid level in one order. The bids are put back outside the measurement.
+	void BM_OrderBookSweep(benchmark::State& state) {
+		book_fixture fixture{ static_cast<size_t>(state.range(0)) };
+		const auto qty = static_cast<models::quantity_t>(fixture.depth_) * LEVEL_QTY;
+		const auto price = MID_PRICE - static_cast<models::price_t>(fixture.depth_);
+
+		for (auto _ : state) {
+			const auto start = std::chrono::steady_clock::now();
+			fixture.book_->add(TAKER, 1, models::side_t::SELL, price, qty);
+			state.SetIterationTime(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+			fixture.add_bids();
+			fixture.settle(state);
+		}
+		state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * fixture.depth_));
+	}
+}
+
+BENCHMARK(BM_OrderBookAddCancel)->Arg(1)->Arg(8)->Arg(32)->Arg(100);
+BENCHMARK(BM_OrderBookModify)->Arg(1)->Arg(8)->Arg(32)->Arg(100);
+BENCHMARK(BM_OrderBookSweep)->Arg(1)->Arg(8)->Arg(32)->Arg(100)->UseManualTime();
@@ -0,0 +1,122 @@
+#include "workload.hpp"
+
+#include <algorithm>
+#include <array>
+#include <iomanip>
+#include <iostream>
+#include <set>
+
+#include "engine/matching_engine.hpp"
+
+
+namespace {
+	/// Latency at percentile p of sorted samples, nearest rank.
+	auto percentile(const std::vector<kse::utils::nananoseconds_t>& sorted, double p) -> kse::utils::nananoseconds_t {
+		const auto rank = static_cast<size_t>(p / 100.0 * static_cast<double>(sorted.size() - 1) + 0.5);
+		return sorted[rank];
+	}
+
+	auto report(const std::string& name, std::vector<kse::utils::nananoseconds_t>& latencies) -> void {
+		if (latencies.empty()) {
+			return;
+		}
+		std::sort(latencies.begin(), latencies.end());
+		std::cout << std::left << std::setw(14) << name << std::right << std::setw(10) << latencies.size();
+		for (const auto p : { 50.0, 90.0, 99.0, 99.9 }) {
+			std::cout << std::setw(10) << percentile(latencies, p);
+		}
+		std::cout << std::setw(10) << latencies.back() << "\n";
+	}
+}
+
+/**
+ * Drives a matching engine with a workload file from kse_log_to_workload, timing every request, and reports the
+ * throughput and the latency percentiles of each request type. The engine is called directly on this thread; its
+ * outputs are drained between requests, outside the measurements. Every pass ends with a mass cancel of each client, so
+ * the next one starts from empty books.
+ */
+int main(int argc, char** argv) {
+	using namespace kse;
+
+	if (argc < 2 || argc > 3) {
+		std::cerr << "Usage: " << argv[0] << " <workload file> [passes]\n";
+		return EXIT_FAILURE;
+	}
+
+	const auto requests = bench::read_workload(argv[1]);
+	if (requests.empty()) {
+		std::cerr << "Could not read a workload from " << argv[1] << "\n";
+		return EXIT_FAILURE;
+	}
+	const size_t passes = argc == 3 ? std::stoul(argv[2]) : 100;
+
+	std::set<models::client_id_t> clients;
+	for (const auto& request : requests) {
+		clients.insert(request.client_id_);
+	}
+
+	models::client_request_queue client_requests{ models::MAX_CLIENT_UPDATES };
+	models::client_response_queue client_responses{ models::MAX_CLIENT_UPDATES };
+	models::market_update_queue market_updates{ models::MAX_MARKET_UPDATES };
+	engine::matching_engine matching_engine{ &client_requests, &client_responses, &market_updates };
+
+	const auto drain = [&]() {
+		while (client_responses.size()) {
+			client_responses.next_read_index();
+		}
+		while (market_updates.size()) {
+			market_updates.next_read_index();
+		}
+	};
+
+	std::array<std::vector<utils::nananoseconds_t>, std::numeric_limits<uint8_t>::max() + 1> latencies;
+	std::vector<utils::nananoseconds_t> all;
+	all.reserve(requests.size() * passes);
+	utils::nananoseconds_t busy = 0;
+
+	for (size_t pass = 0; pass < passes; ++pass) {
+		for (size_t i = 0; i < requests.size(); ++i) {
+			const auto& request = requests[i];
+			const auto length = models::batch_length(request);
+			if (length > 1 && i + length > requests.size()) [[unlikely]] {
+				break; //a batch cut short by the end of the log
+			}
+
+			const auto start = utils::get_monotonic_timestamp();
+			if (length > 1) [[unlikely]] {
+				matching_engine.process_batch(request, [&](models::client_request_internal& entry) {
+					entry = requests[++i];
+					return true;
+				});
+			}
+			else {
+				matching_engine.process_client_request(request);
+			}
+			const auto elapsed = utils::get_monotonic_timestamp() - start;
+
+			latencies[static_cast<uint8_t>(request.type_)].push_back(elapsed);
+			all.push_back(elapsed);
+			busy += elapsed;
+			drain();
+		}
+
+		for (const auto client_id : clients) {
+			models::client_request_internal mass_cancel;
+			mass_cancel.type_ = models::client_request_type::MASS_CANCEL;
+			mass_cancel.client_id_ = client_id;
+			matching_engine.process_mass_cancel(mass_cancel);
+			drain();
+		}
+	}
+
+	std::cout << requests.size() << " requests x " << passes << " passes, " << all.size() << " timed\n";
+	std::cout << std::fixed << std::setprecision(0) << "Throughput: " << static_cast<double>(all.size()) * utils::NANOS_PER_SECS / static_cast<double>(busy)
+		<< " requests/s\n\n";
+	std::cout << std::left << std::setw(14) << "request" << std::right << std::setw(10) << "count" << std::setw(10) << "p50" << std::setw(10) << "p90"
+		<< std::setw(10) << "p99" << std::setw(10) << "p99.9" << std::setw(10) << "max" << "  (ns)\n";
+	for (size_t type = 0; type < latencies.size(); ++type) {
+		report(models::client_request_type_to_string(static_cast<models::client_request_type>(type)), latencies[type]);
+	}
+	report("all", all);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <array>
+
+#include <benchmark/benchmark.h>
+
+#include "market_data/market_data_encoder.hpp"
+#include "order_server/serializer.hpp"
+
+using namespace kse;
+
+
+namespace {
+	auto make_request() -> models::client_request_external {
+		models::client_request_external request;
+		request.sequence_number_ = 42;
+		request.request_.type_ = models::client_request_type::NEW;
+		request.request_.client_id_ = 3;
+		request.request_.instrument_id_ = 1;
+		request.request_.order_id_ = 1001;
+		request.request_.side_ = models::side_t::BUY;
+		request.request_.price_ = 100;
+		request.request_.qty_ = 25;
+		return request;
+	}
+
+	auto make_market_update() -> models::client_market_update {
+		models::client_market_update update;
+		update.sequence_number_ = 42;
+		update.update_ = { models::market_update_type::ADD, 1001, 1, models::side_t::SELL, 101, 25, 7 };
+		return update;
+	}
+
+	void BM_SerializeClientRequest(benchmark::State& state) {
+		const auto request = make_request();
+		alignas(64) std::array<char, models::client_request_codec::size> buffer{};
+		for (auto _ : state) {
+			server::serialize_client_request(request, buffer.data());
+			benchmark::DoNotOptimize(buffer.data());
+			benchmark::ClobberMemory();
+		}
+		state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * buffer.size()));
+	}
+
+	void BM_DeserializeClientResponse(benchmark::State& state) {
+		models::client_response_external response;
+		response.sequence_number_ = 42;
+		response.response_ = { models::client_response_type::FILLED, 3, 1, 1001, 17, models::side_t::BUY, 100, 10, 15 };
+		alignas(64) std::array<char, models::client_response_codec::size> buffer{};
+		server::serialize_client_response(response, buffer.data());
+
+		for (auto _ : state) {
+			benchmark::DoNotOptimize(server::deserialize_client_response(buffer.data()));
+		}
+		state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * buffer.size()));
+	}
+
+	/// Protocol v1 is fixed size; v2 writes the price as a delta from the instrument's reference price.
+	template<models::protocol_version version>
+	void BM_SerializeClientMarketUpdate(benchmark::State& state) {
+		const auto update = make_market_update();
+		models::reference_price_table reference_prices{};
+		reference_prices.fill(100);
+		alignas(64) std::array<char, std::max(models::client_market_update_codec::size, models::V2_MAX_FRAME_SIZE)> buffer{};
+
+		size_t bytes = 0;
+		for (auto _ : state) {
+			bytes += market_data::serialize_client_market_update(update, version, reference_prices, buffer.data());
+			benchmark::DoNotOptimize(buffer.data());
+			benchmark::ClobberMemory();
+		}
+		state.SetBytesProcessed(static_cast<int64_t>(bytes));
+	}
+}
+
+BENCHMARK(BM_SerializeClientRequest);
+BENCHMARK(BM_DeserializeClientResponse);
+BENCHMARK(BM_SerializeClientMarketUpdate<models::protocol_version::V1>)->Name("BM_SerializeClientMarketUpdate/v1");
+BENCHMARK(BM_SerializeClientMarketUpdate<models::protocol_version::V2>)->Name("BM_SerializeClientMarketUpdate/v2");
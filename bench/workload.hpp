@@ -0,0 +1,182 @@
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "models/client_request.hpp"
+
+#include "utils/utils.hpp"
+
+
+namespace kse::bench {
+	constexpr uint64_t WORKLOAD_MAGIC = 0x4B5345574B4C4431; //"KSEWKLD1", bumped whenever the layout changes
+	constexpr std::string_view REQUEST_LOG_MARKER = "Processing client_request_internal [";
+
+	/**
+	 * Workload file layout: this header, then num_requests_ client_request_internal back to back, in the order the
+	 * matching engine processed them. Batch entries follow their header as they do on the engine queue.
+	 */
+	struct workload_file_header {
+		uint64_t magic_ = WORKLOAD_MAGIC;
+		uint64_t num_requests_ = 0;
+		uint32_t request_size_ = sizeof(models::client_request_internal);
+		uint64_t checksum_ = 0; //FNV-1a of the requests
+	};
+
+	namespace detail {
+		/// Integer field; "INVALID" is the type's sentinel, as the *_to_string helpers print it.
+		template<typename T>
+		auto parse_value(std::string_view text, T& value) noexcept -> bool {
+			if (text == "INVALID") {
+				value = std::numeric_limits<T>::max();
+				return true;
+			}
+			const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+			return error == std::errc{} && end == text.data() + text.size();
+		}
+
+		/// Enum field, matched against every value's to_string.
+		template<typename E, typename F>
+		auto parse_enum(std::string_view text, F&& to_string, E& value) -> bool {
+			for (uint32_t i = 0; i <= std::numeric_limits<uint8_t>::max(); ++i) {
+				if (to_string(static_cast<E>(i)) == text) {
+					value = static_cast<E>(i);
+					return true;
+				}
+			}
+			return false;
+		}
+	}
+
+	/**
+	 * Parses a matching engine log line "... Processing client_request_internal [type:NEW client:0 ...]" into request.
+	 * Fields missing from older logs keep their defaults. Returns false for any other line or an unknown value.
+	 */
+	inline auto parse_request_line(std::string_view line, models::client_request_internal& request) -> bool {
+		const auto begin = line.find(REQUEST_LOG_MARKER);
+		if (begin == std::string_view::npos) {
+			return false;
+		}
+		auto fields = line.substr(begin + REQUEST_LOG_MARKER.size());
+		const auto end = fields.find(']');
+		if (end == std::string_view::npos) {
+			return false;
+		}
+		fields = fields.substr(0, end);
+
+		request = {};
+		bool seen_type = false; //the first "type:" is the request's, the second the order's
+		while (!fields.empty()) {
+			const auto space = fields.find(' ');
+			const auto field = fields.substr(0, space);
+			fields = space == std::string_view::npos ? std::string_view{} : fields.substr(space + 1);
+
+			const auto colon = field.find(':');
+			if (colon == std::string_view::npos) {
+				return false;
+			}
+			const auto key = field.substr(0, colon);
+			const auto value = field.substr(colon + 1);
+
+			bool parsed = false;
+			if (key == "type" && !seen_type) {
+				parsed = detail::parse_enum(value, models::client_request_type_to_string, request.type_);
+				seen_type = true;
+			}
+			else if (key == "type") {
+				parsed = detail::parse_enum(value, models::order_type_to_string, request.order_type_);
+			}
+			else if (key == "client") {
+				parsed = detail::parse_value(value, request.client_id_);
+			}
+			else if (key == "instrument") {
+				parsed = detail::parse_value(value, request.instrument_id_);
+			}
+			else if (key == "oid") {
+				parsed = detail::parse_value(value, request.order_id_);
+			}
+			else if (key == "side") {
+				parsed = detail::parse_enum(value, models::side_to_string, request.side_);
+			}
+			else if (key == "qty") {
+				parsed = detail::parse_value(value, request.qty_);
+			}
+			else if (key == "price") {
+				parsed = detail::parse_value(value, request.price_);
+			}
+			else if (key == "tif") {
+				parsed = detail::parse_enum(value, models::time_in_force_to_string, request.time_in_force_);
+			}
+			else if (key == "stop") {
+				parsed = detail::parse_value(value, request.stop_price_);
+			}
+			else if (key == "display") {
+				parsed = detail::parse_value(value, request.display_qty_);
+			}
+			else if (key == "stp") {
+				parsed = detail::parse_enum(value, models::stp_mode_to_string, request.stp_mode_);
+			}
+			else if (key == "expire") {
+				parsed = detail::parse_value(value, request.expire_time_);
+			}
+			if (!parsed) {
+				return false;
+			}
+		}
+		return request.type_ != models::client_request_type::INVALID;
+	}
+
+	/// Every request line of a matching engine log, in order. Lines that do not parse are counted in skipped.
+	inline auto read_request_log(std::istream& log, size_t* skipped = nullptr) -> std::vector<models::client_request_internal> {
+		std::vector<models::client_request_internal> requests;
+		std::string line;
+		models::client_request_internal request;
+		while (std::getline(log, line)) {
+			if (parse_request_line(line, request)) {
+				requests.push_back(request);
+			}
+			else if (skipped && line.find(REQUEST_LOG_MARKER) != std::string::npos) {
+				++*skipped;
+			}
+		}
+		return requests;
+	}
+
+	inline auto write_workload(const std::string& path, const std::vector<models::client_request_internal>& requests) -> bool {
+		workload_file_header header;
+		header.num_requests_ = requests.size();
+		header.checksum_ = utils::fnv1a(requests.data(), requests.size() * sizeof(models::client_request_internal));
+
+		std::ofstream file{ path, std::ios::binary | std::ios::trunc };
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(requests.data()), static_cast<std::streamsize>(requests.size() * sizeof(models::client_request_internal)));
+		return static_cast<bool>(file);
+	}
+
+	/// The requests of a workload file, or nothing if it is missing, truncated or does not match its checksum.
+	inline auto read_workload(const std::string& path) -> std::vector<models::client_request_internal> {
+		std::ifstream file{ path, std::ios::binary | std::ios::ate };
+		const auto file_size = static_cast<uint64_t>(file.tellg());
+		file.seekg(0);
+		workload_file_header header;
+		if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic_ != WORKLOAD_MAGIC ||
+			header.request_size_ != sizeof(models::client_request_internal) ||
+			file_size != sizeof(header) + header.num_requests_ * sizeof(models::client_request_internal)) {
+			return {};
+		}
+
+		std::vector<models::client_request_internal> requests(header.num_requests_);
+		if (!file.read(reinterpret_cast<char*>(requests.data()), static_cast<std::streamsize>(requests.size() * sizeof(models::client_request_internal))) ||
+			utils::fnv1a(requests.data(), requests.size() * sizeof(models::client_request_internal)) != header.checksum_) {
+			return {};
+		}
+		return requests;
+	}
+}
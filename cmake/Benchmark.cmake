@@ -0,0 +1,13 @@
+find_package(benchmark QUIET)
+
+if(NOT benchmark_FOUND)
+	include(FetchContent)
+	FetchContent_Declare(
+	  googlebenchmark
+	  GIT_REPOSITORY https://github.com/google/benchmark.git
+	  GIT_TAG v1.8.3
+	)
+	set(BENCHMARK_ENABLE_TESTING OFF CACHE BOOL "" FORCE)
+	set(BENCHMARK_ENABLE_INSTALL OFF CACHE BOOL "" FORCE)
+	FetchContent_MakeAvailable(googlebenchmark)
+endif()
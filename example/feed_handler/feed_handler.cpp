@@ -157,42 +157,68 @@ auto kse::example::market_data::feed_handler::read_data(multicast_connection_t*
 {
 	const auto is_snapshot = conn == snapshot_feed_.get();
 
-	if (conn->offset >= sizeof(models::client_market_update)) {
-		size_t i = 0;
-
-		for (; i + sizeof(models::client_market_update) <= conn->offset; i += sizeof(models::client_market_update)) {
-			auto update = deserialize_market_update(conn->buffer.data() + i);
-
-			logger_.log("%:% %() % Received % socket len:% %\n", __FILE__, __LINE__, __func__,
-				utils::get_curren_time_str(&time_str_),
-				(is_snapshot ? "snapshot" : "incremental"), sizeof(models::client_market_update), update.to_string());
-			
-			auto already_in_recovery = in_recovery_;
-			in_recovery_ = already_in_recovery || (update.sequence_number_ != next_expected_seq_);
-
-			if (in_recovery_) [[unlikely]] {
-				if (!already_in_recovery) [[unlikely]] {
-					logger_.log("%:% %() % Packet drops on % socket. SeqNum expected:% received:%\n", __FILE__, __LINE__, __func__,
-						utils::get_curren_time_str(&time_str_), (is_snapshot ? "snapshot" : "incremental"), next_expected_seq_, update.sequence_number_);
-					snapshot_queued_msgs_.clear();
-					incremental_queued_msgs_.clear();
-					uv_udp_recv_start(snapshot_feed_->handle_, alloc_buffer, on_read);
-				}
-				queue_message(is_snapshot, update);
+	size_t i = 0;
+	if (protocol_version_ == models::protocol_version::V2) {
+		while (i + sizeof(models::v2_header) <= conn->offset) {
+			const auto* frame = conn->buffer.data() + i;
+			const auto header = models::peek_v2_header(frame);
+
+			if (header.length_ < sizeof(models::v2_header)) [[unlikely]] {
+				logger_.log("%:% %() % Malformed v2 frame on % socket, dropping % bytes\n", __FILE__, __LINE__, __func__,
+					utils::get_curren_time_str(&time_str_), (is_snapshot ? "snapshot" : "incremental"), conn->offset - i);
+				i = conn->offset;
+				break;
 			}
-			else if (!is_snapshot) {
-				logger_.log("%:% %() % %\n", __FILE__, __LINE__, __func__,
-					utils::get_curren_time_str(&time_str_), update.to_string());
 
-				++next_expected_seq_;
+			if (i + header.length_ > conn->offset) {
+				break;
+			}
 
-				auto* next_write = incoming_updates_->get_next_write_element();
-				*next_write = std::move(update.update_);
-				incoming_updates_->next_write_index();
+			if (header.type_ == models::v2_message_type::MARKET_UPDATE && header.length_ == models::v2_market_update_codec::size) [[likely]] {
+				auto update = decode_market_update_v2(frame, is_snapshot ? 0 : next_expected_seq_, reference_prices_);
+				process_update(is_snapshot, update);
 			}
+
+			i += header.length_;
+		}
+	}
+	else {
+		for (; i + sizeof(models::client_market_update) <= conn->offset; i += sizeof(models::client_market_update)) {
+			auto update = deserialize_market_update(conn->buffer.data() + i);
+			process_update(is_snapshot, update);
 		}
+	}
+
+	conn->shift_inbound_buffer(i);
+}
 
-		conn->shift_inbound_buffer(i);
+auto kse::example::market_data::feed_handler::process_update(bool is_snapshot, models::client_market_update& update) -> void
+{
+	logger_.log("%:% %() % Received % socket len:% %\n", __FILE__, __LINE__, __func__,
+		utils::get_curren_time_str(&time_str_),
+		(is_snapshot ? "snapshot" : "incremental"), sizeof(models::client_market_update), update.to_string());
+	
+	auto already_in_recovery = in_recovery_;
+	in_recovery_ = already_in_recovery || (update.sequence_number_ != next_expected_seq_);
+
+	if (in_recovery_) [[unlikely]] {
+		if (!already_in_recovery) [[unlikely]] {
+			logger_.log("%:% %() % Packet drops on % socket. SeqNum expected:% received:%\n", __FILE__, __LINE__, __func__,
+				utils::get_curren_time_str(&time_str_), (is_snapshot ? "snapshot" : "incremental"), next_expected_seq_, update.sequence_number_);
+			snapshot_queued_msgs_.clear();
+			incremental_queued_msgs_.clear();
+			uv_udp_recv_start(snapshot_feed_->handle_, alloc_buffer, on_read);
+		}
+		queue_message(is_snapshot, update);
 	}
+	else if (!is_snapshot) {
+		logger_.log("%:% %() % %\n", __FILE__, __LINE__, __func__,
+			utils::get_curren_time_str(&time_str_), update.to_string());
+
+		++next_expected_seq_;
 
+		auto* next_write = incoming_updates_->get_next_write_element();
+		*next_write = std::move(update.update_);
+		incoming_updates_->next_write_index();
+	}
 }
@@ -13,6 +13,7 @@
 #include "utils/utils.hpp"
 #include "utils/logger.hpp"
 #include "models/market_update.hpp"
+#include "models/wire_v2.hpp"
 
 namespace kse::example::market_data {
 	constexpr size_t BUFFER_SIZE = 64 * 1024 * 1024;
@@ -50,8 +51,9 @@ namespace kse::example::market_data {
 	class feed_handler
 	{
 	public:
-		static feed_handler& get_instance(models::market_update_queue* incoming_updates = nullptr, std::string_view snapshot_ip = "", int snapshot_port = 0, std::string_view incremental_ip = "", int incremental_port = 0) {
-			static feed_handler instance{ incoming_updates, snapshot_ip, snapshot_port, incremental_ip, incremental_port };
+		static feed_handler& get_instance(models::market_update_queue* incoming_updates = nullptr, std::string_view snapshot_ip = "", int snapshot_port = 0, std::string_view incremental_ip = "", int incremental_port = 0,
+			models::protocol_version version = models::protocol_version::V1, const models::reference_price_table& reference_prices = {}) {
+			static feed_handler instance{ incoming_updates, snapshot_ip, snapshot_port, incremental_ip, incremental_port, version, reference_prices };
 			return instance;
 		}
 
@@ -86,11 +88,15 @@ namespace kse::example::market_data {
 		auto sync_snapshot_with_incremental() -> void;
 		auto queue_message(bool is_snapshot, const models::client_market_update upd) -> void;
 		auto read_data(multicast_connection_t* conn) -> void;
+		auto process_update(bool is_snapshot, models::client_market_update& update) -> void;
 		auto get_logger() -> utils::logger& { return logger_; }
 	private:
 		uint64_t next_expected_seq_ = 1;
 		models::market_update_queue* incoming_updates_ = nullptr;
 
+		models::protocol_version protocol_version_ = models::protocol_version::V1;
+		models::reference_price_table reference_prices_{};
+
 		std::string time_str_;
 		utils::logger logger_;
 
@@ -108,7 +114,8 @@ namespace kse::example::market_data {
 		queued_market_updates snapshot_queued_msgs_;
 		queued_market_updates incremental_queued_msgs_;
 
-		feed_handler(models::market_update_queue* incoming_updates, std::string_view snapshot_ip, int snapshot_port, std::string_view incremental_ip, int incremental_port) : incoming_updates_{ incoming_updates }, logger_{"feed_handler" + std::to_string((uintptr_t)incoming_updates) + ".log"}, snapshot_multicast_ip_{snapshot_ip}, snapshot_multicast_port_{snapshot_port}, incremental_multicast_ip_{incremental_ip}, incremental_multicast_port_{incremental_port} {
+		feed_handler(models::market_update_queue* incoming_updates, std::string_view snapshot_ip, int snapshot_port, std::string_view incremental_ip, int incremental_port,
+			models::protocol_version version, const models::reference_price_table& reference_prices) : incoming_updates_{ incoming_updates }, protocol_version_{ version }, reference_prices_{ reference_prices }, logger_{"feed_handler" + std::to_string((uintptr_t)incoming_updates) + ".log"}, snapshot_multicast_ip_{snapshot_ip}, snapshot_multicast_port_{snapshot_port}, incremental_multicast_ip_{incremental_ip}, incremental_multicast_port_{incremental_port} {
 			snapshot_feed_ = std::make_unique<multicast_connection_t>();
 			incremental_feed_ = std::make_unique<multicast_connection_t>();
 		}
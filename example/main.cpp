@@ -8,7 +8,7 @@
 #include <memory>
 #include <random>
 
-int main(int, char** argv) {
+int main(int argc, char** argv) {
 	const auto algo_type = kse::example::trading_utils::string_to_algo_type("RANDOM");
 
 	const int sleep_time = 1000;
@@ -35,7 +35,10 @@ int main(int, char** argv) {
 	auto& feed_handler = kse::example::market_data::feed_handler::get_instance(&updates, "233.252.14.1", 54322, "233.252.14.3", 54323);
 	feed_handler.start();
 
-	auto& order_gateway = kse::example::gateway::order_gateway::get_instance(&requests, &responses, "127.0.0.1", 54321);
+	// Pass "shm" as the third argument to enter orders through shared memory instead of TCP when running on the exchange's host.
+	const auto shm_segment_name = argc > 3 && std::string_view{ argv[3] } == "shm" ? kse::server::DEFAULT_SHM_SEGMENT_NAME : std::string_view{};
+
+	auto& order_gateway = kse::example::gateway::order_gateway::get_instance(&requests, &responses, "127.0.0.1", 54321, kse::models::LATEST_PROTOCOL_VERSION, shm_segment_name);
 	order_gateway.start();
 
 	logger->log("%:% %() % Starting Trade Engine...\n", __FILE__, __LINE__, __func__, kse::utils::get_curren_time_str(&time_str));
@@ -13,6 +13,8 @@ auto kse::example::gateway::on_connect(uv_connect_t* req, int status) -> void {
 	self.get_logger().log("%:% %() % connection established\n", __FILE__, __LINE__, __func__, utils::get_curren_time_str(&self.get_time_str()));
 
 	uv_read_start(req->handle, alloc_buffer, on_read);
+
+	self.send_logon();
 }
 
 auto kse::example::gateway::alloc_buffer(uv_handle_t* handle, size_t suggested_size [[maybe_unused]], uv_buf_t* buf) -> void
@@ -50,44 +52,171 @@ auto kse::example::gateway::on_read(uv_stream_t* stream, ssize_t nread, const uv
 
 auto kse::example::gateway::order_gateway::read_data() -> void
 {
-	if (connection_->next_rcv_valid_index_ >= sizeof(models::client_response_external)) {
-		size_t i = 0;
-		for (; i + sizeof(models::client_response_external) <= connection_->next_rcv_valid_index_; i += sizeof(models::client_response_external)) {
-			auto response = deserialize_client_response(connection_->inbound_data_.data() + i);
-
-			logger_.log("%:% %() % Received %\n", __FILE__, __LINE__, __func__, utils::get_curren_time_str(&time_str_), response.to_string());
+	size_t i = 0;
+	while (i < connection_->next_rcv_valid_index_) {
+		const auto* frame = connection_->inbound_data_.data() + i;
+		const auto available = connection_->next_rcv_valid_index_ - i;
 
-			if (client_id_ != models::INVALID_CLIENT_ID && client_id_ != response.response_.client_id_) [[unlikely]] {
-				logger_.log("%:% %() % Invalid clientid received for this ClientResponse\n", __FILE__, __LINE__, __func__,
-					utils::get_curren_time_str(&time_str_));
-				continue;
+		if (protocol_version_ == models::protocol_version::V1 && !negotiating_) [[likely]] {
+			if (available < sizeof(models::client_response_external)) {
+				break;
 			}
 
+			auto response = deserialize_client_response(frame);
+			process_response(response);
+			i += sizeof(models::client_response_external);
+			continue;
+		}
 
-			if (response.sequence_number_ != next_exp_seq_num_) [[unlikely]] { 
-				logger_.log("%:% %() % Incorrect sequence number. SeqNum expected:% received:%\n", __FILE__, __LINE__, __func__,
-					utils::get_curren_time_str(&time_str_), next_exp_seq_num_, response.sequence_number_);
-				continue;
-			}
-			else if (response.sequence_number_ == 1) {
-				client_id_ = response.response_.client_id_;
-			}
-			else {
-				auto next_write = incoming_responses_->get_next_write_element();
-				*next_write = std::move(response.response_);
-				incoming_responses_->next_write_index();
-			}
+		if (available < sizeof(models::v2_header)) {
+			break;
+		}
+
+		const auto header = models::peek_v2_header(frame);
+		if (header.length_ < sizeof(models::v2_header)) [[unlikely]] {
+			logger_.log("%:% %() % Malformed v2 frame, dropping % buffered bytes\n", __FILE__, __LINE__, __func__,
+				utils::get_curren_time_str(&time_str_), available);
+			i = connection_->next_rcv_valid_index_;
+			break;
+		}
+
+		if (available < header.length_) {
+			break;
+		}
+
+		process_v2_frame(frame);
+		i += header.length_;
+	}
+
+	connection_->shift_inbound_buffer(i);
+}
 
-			++next_exp_seq_num_;
+auto kse::example::gateway::order_gateway::process_v2_frame(const char* frame) -> void
+{
+	const auto header = models::peek_v2_header(frame);
+
+	switch (header.type_) {
+	case models::v2_message_type::REFERENCE_PRICE: {
+		const auto reference_price = models::v2_reference_price_codec::decode(frame);
+		if (reference_price.instrument_id_ < reference_prices_.size()) {
+			reference_prices_[reference_price.instrument_id_] = reference_price.price_;
 		}
-		connection_->shift_inbound_buffer(i);
+	} break;
+	case models::v2_message_type::HELLO_ACK: {
+		protocol_version_ = models::v2_hello_ack_codec::decode(frame).version_;
+		negotiating_ = false;
+		logger_.log("%:% %() % Negotiated protocol v%\n", __FILE__, __LINE__, __func__,
+			utils::get_curren_time_str(&time_str_), static_cast<unsigned>(protocol_version_));
+	} break;
+	case models::v2_message_type::RESPONSE: {
+		auto response = models::decode_v2_response(frame, client_id_, next_exp_seq_num_, reference_prices_);
+		process_response(response);
+	} break;
+	default: {
+		logger_.log("%:% %() % Skipping unknown v2 message type:% len:%\n", __FILE__, __LINE__, __func__,
+			utils::get_curren_time_str(&time_str_), static_cast<unsigned>(header.type_), static_cast<unsigned>(header.length_));
+	} break;
 	}
 }
 
+auto kse::example::gateway::order_gateway::process_response(models::client_response_external& response) -> void
+{
+	logger_.log("%:% %() % Received %\n", __FILE__, __LINE__, __func__, utils::get_curren_time_str(&time_str_), response.to_string());
+
+	switch (response.response_.type_) {
+	case models::client_response_type::LOGGED_ON: {
+		client_id_ = response.response_.client_id_;
+		next_outgoing_seq_num_ = response.response_.client_order_id_;
+		next_exp_seq_num_ = response.sequence_number_ + 1;
+		logger_.log("%:% %() % Logged on as ClientId:% next seq out:% in:%\n", __FILE__, __LINE__, __func__,
+			utils::get_curren_time_str(&time_str_), client_id_, next_outgoing_seq_num_, next_exp_seq_num_);
+		if (preferred_version_ != models::protocol_version::V1 && !shm_client_) {
+			send_hello();
+		}
+		return;
+	}
+	case models::client_response_type::LOGON_REJECTED: {
+		logger_.log("%:% %() % Logon rejected\n", __FILE__, __LINE__, __func__, utils::get_curren_time_str(&time_str_));
+		return;
+	}
+	default:
+		break;
+	}
+
+	if (client_id_ == models::INVALID_CLIENT_ID || client_id_ != response.response_.client_id_) [[unlikely]] {
+		logger_.log("%:% %() % Invalid clientid received for this ClientResponse\n", __FILE__, __LINE__, __func__,
+			utils::get_curren_time_str(&time_str_));
+		return;
+	}
+
+	if (response.sequence_number_ != next_exp_seq_num_) [[unlikely]] { 
+		logger_.log("%:% %() % Incorrect sequence number. SeqNum expected:% received:%\n", __FILE__, __LINE__, __func__,
+			utils::get_curren_time_str(&time_str_), next_exp_seq_num_, response.sequence_number_);
+		// Ask once per gap; everything after it is dropped until the resend arrives in order.
+		if (response.sequence_number_ > next_exp_seq_num_ && resend_requested_from_ != next_exp_seq_num_) {
+			send_resend_request(next_exp_seq_num_);
+		}
+		return;
+	}
+
+	if (response.response_.type_ == models::client_response_type::GAP_FILL) [[unlikely]] {
+		logger_.log("%:% %() % Responses % to % are no longer available\n", __FILE__, __LINE__, __func__,
+			utils::get_curren_time_str(&time_str_), next_exp_seq_num_, response.response_.client_order_id_ - 1);
+		next_exp_seq_num_ = response.response_.client_order_id_;
+		return;
+	}
+
+	auto next_write = incoming_responses_->get_next_write_element();
+	*next_write = std::move(response.response_);
+	incoming_responses_->next_write_index();
+
+	++next_exp_seq_num_;
+}
+
+auto kse::example::gateway::order_gateway::send_logon() -> void
+{
+	logger_.log("%:% %() % Logging on as ClientId:%\n", __FILE__, __LINE__, __func__,
+		utils::get_curren_time_str(&time_str_), models::client_id_to_string(client_id_));
+
+	// On a resumed session order_id_ carries the last response sequence number processed, so the server resends the rest.
+	const auto last_seen = client_id_ == models::INVALID_CLIENT_ID ? models::INVALID_ORDER_ID : next_exp_seq_num_ - 1;
+	models::client_request_internal logon{ models::client_request_type::LOGON, client_id_, models::INVALID_INSTRUMENT_ID,
+		last_seen, models::side_t::INVALID, models::INVALID_PRICE, models::INVALID_QUANTITY };
+	append_request(logon, 0);
+
+	write_outbound_buffer();
+}
+
+auto kse::example::gateway::order_gateway::send_resend_request(uint64_t from_sequence_number) -> void
+{
+	logger_.log("%:% %() % Requesting resend from seq:%\n", __FILE__, __LINE__, __func__,
+		utils::get_curren_time_str(&time_str_), from_sequence_number);
+
+	models::client_request_internal resend{ models::client_request_type::RESEND, client_id_, models::INVALID_INSTRUMENT_ID,
+		from_sequence_number, models::side_t::INVALID, models::INVALID_PRICE, models::INVALID_QUANTITY };
+	append_request(resend, 0);
+	resend_requested_from_ = from_sequence_number;
+
+	write_outbound_buffer();
+}
+
+auto kse::example::gateway::order_gateway::send_hello() -> void
+{
+	logger_.log("%:% %() % Requesting protocol v%\n", __FILE__, __LINE__, __func__,
+		utils::get_curren_time_str(&time_str_), static_cast<unsigned>(preferred_version_));
+
+	models::v2_hello_codec::encode({ { models::v2_message_type::HELLO, models::v2_hello_codec::size }, models::V2_HELLO_MAGIC, preferred_version_ },
+		connection_->outbound_data_.data() + connection_->next_send_valid_index_);
+	connection_->next_send_valid_index_ += models::v2_hello_codec::size;
+	negotiating_ = true;
+
+	write_outbound_buffer();
+}
+
 auto kse::example::gateway::on_idle(uv_idle_t* req [[maybe_unused]] ) -> void
 {
 	auto& self = order_gateway::get_instance();
-	if (self.get_client_id() == models::INVALID_CLIENT_ID) [[unlikely]] {
+	if (self.get_client_id() == models::INVALID_CLIENT_ID || self.is_negotiating()) [[unlikely]] {
 		return;
 	}
 	self.send_request();
@@ -95,7 +224,7 @@ auto kse::example::gateway::on_idle(uv_idle_t* req [[maybe_unused]] ) -> void
 
 auto kse::example::gateway::order_gateway::send_request() -> void
 {
-	auto can_continue_write = true;
+	auto can_continue_write = !shm_client_ || shm_client_->requests().get_next_write_element();
 	for (auto* request = outgoing_requests_->get_next_read_element();
 		outgoing_requests_->size() && request && can_continue_write;
 		request = outgoing_requests_->get_next_read_element()) {
@@ -103,11 +232,68 @@ auto kse::example::gateway::order_gateway::send_request() -> void
 		logger_.log("%:% %() % Processing seq:% %\n", __FILE__, __LINE__, __func__,
 			utils::get_curren_time_str(&time_str_), next_outgoing_seq_num_, request->to_string());
 
-		can_continue_write = connection_->append_to_outbound_buffer(*request, next_outgoing_seq_num_);	
+		can_continue_write = append_request(*request, next_outgoing_seq_num_);
 		outgoing_requests_->next_read_index();
 		++next_outgoing_seq_num_;
 	}
 
+	write_outbound_buffer();
+}
+
+auto kse::example::gateway::order_gateway::append_request(models::client_request_internal& request, uint64_t sequence_number) -> bool
+{
+	if (!shm_client_) {
+		return connection_->append_to_outbound_buffer(request, sequence_number, protocol_version_, reference_prices_);
+	}
+
+	// Shared memory takes the request as is; the server reads the host-order struct straight from the ring.
+	auto& requests = shm_client_->requests();
+	auto* slot = requests.get_next_write_element();
+	if (!slot) [[unlikely]] {
+		logger_.log("%:% %() % Request ring full, dropping %\n", __FILE__, __LINE__, __func__, utils::get_curren_time_str(&time_str_), request.to_string());
+		return false;
+	}
+
+	*slot = { sequence_number, request };
+	requests.next_write_index();
+	return requests.get_next_write_element() != nullptr;
+}
+
+auto kse::example::gateway::order_gateway::run_shm() -> void
+{
+	while (!(shm_client_ = server::shm_client::connect(shm_segment_name_))) {
+		logger_.log("%:% %() % Waiting for shared memory order entry on %\n", __FILE__, __LINE__, __func__,
+			utils::get_curren_time_str(&time_str_), shm_segment_name_);
+		using namespace std::literals::chrono_literals;
+		std::this_thread::sleep_for(1s);
+	}
+
+	logger_.log("%:% %() % Attached to shared memory order entry on %\n", __FILE__, __LINE__, __func__,
+		utils::get_curren_time_str(&time_str_), shm_segment_name_);
+
+	send_logon();
+
+	auto& responses = shm_client_->responses();
+	while (true) {
+		for (auto* response = responses.get_next_read_element(); response; response = responses.get_next_read_element()) {
+			TIME_MEASURE(T2_OrderGateway_SHM_read, logger_, time_str_);
+			auto next_response = *response;
+			responses.next_read_index();
+			process_response(next_response);
+		}
+
+		if (client_id_ != models::INVALID_CLIENT_ID) [[likely]] {
+			send_request();
+		}
+	}
+}
+
+auto kse::example::gateway::order_gateway::write_outbound_buffer() -> void
+{
+	if (shm_client_) {
+		return;
+	}
+
 	if (connection_->next_send_valid_index_ != 0) {
 		auto* writer = static_cast<uv_write_t*>(std::malloc(sizeof(uv_write_t)));
 		uv_buf_t buf = uv_buf_init(connection_->outbound_data_.data(), static_cast<unsigned int>(connection_->next_send_valid_index_));
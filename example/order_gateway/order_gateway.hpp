@@ -3,12 +3,14 @@
 #include "uv.h"
 #include "models/client_request.hpp"
 #include "models/client_response.hpp"
+#include "order_server/shm_transport.hpp"
 #include "utils/utils.hpp"
 #include "utils/logger.hpp"
 #include <array>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <memory>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -40,9 +42,18 @@ namespace kse::example::gateway {
 			}
 		}
 
-		auto append_to_outbound_buffer(models::client_request_internal& request, uint64_t sequence_number) -> bool {
-			serialize_client_request({sequence_number, std::move(request)}, outbound_data_.data() + next_send_valid_index_);
-			next_send_valid_index_ += sizeof(models::client_request_external);
+		auto append_to_outbound_buffer(models::client_request_internal& request, uint64_t sequence_number,
+			models::protocol_version version, const models::reference_price_table& reference_prices) -> bool {
+			const models::client_request_external external_request{ sequence_number, std::move(request) };
+			auto* buffer = outbound_data_.data() + next_send_valid_index_;
+
+			if (version == models::protocol_version::V2) {
+				next_send_valid_index_ += models::encode_v2_request(external_request, reference_prices, buffer);
+			}
+			else {
+				serialize_client_request(external_request, buffer);
+				next_send_valid_index_ += sizeof(models::client_request_external);
+			}
 			return outbound_data_.size() - next_send_valid_index_ >= sizeof(models::client_request_external);
 		}
 
@@ -65,9 +76,11 @@ namespace kse::example::gateway {
 			models::client_request_queue* outgoing_requests = nullptr,
 			models::client_response_queue* incoming_responses = nullptr,
 			std::string_view ip = "",
-			int port = 0)
+			int port = 0,
+			models::protocol_version preferred_version = models::protocol_version::V1,
+			std::string_view shm_segment_name = "")
 		{
-			static order_gateway instance(outgoing_requests, incoming_responses, ip, port);
+			static order_gateway instance(outgoing_requests, incoming_responses, ip, port, preferred_version, shm_segment_name);
 			return instance;
 		}
 
@@ -80,6 +93,7 @@ namespace kse::example::gateway {
 		auto get_logger() -> utils::logger& { return logger_; }
 		auto get_time_str() -> std::string& { return time_str_; }
 		auto get_client_id() const -> models::client_id_t { return client_id_; }
+		auto is_negotiating() const -> bool { return negotiating_; }
 
 		auto start() -> void {
 			auto order_gateway_thread = utils::create_thread(-1, [this]() { run(); });
@@ -90,6 +104,11 @@ namespace kse::example::gateway {
 		auto run() -> void {
 			logger_.log("%:% %() %\n", __FILE__, __LINE__, __func__, utils::get_curren_time_str(&time_str_));
 
+			if (!shm_segment_name_.empty()) {
+				run_shm();
+				return;
+			}
+
 			loop_ = uv_default_loop();
 			uv_tcp_init(loop_, connection_->handle_);
 
@@ -110,12 +129,25 @@ namespace kse::example::gateway {
 
 		auto read_data() -> void;
 		auto send_request() -> void;
+		auto send_logon() -> void;
 	private:
+		auto run_shm() -> void;
+		auto append_request(models::client_request_internal& request, uint64_t sequence_number) -> bool;
+		auto process_response(models::client_response_external& response) -> void;
+		auto process_v2_frame(const char* frame) -> void;
+		auto send_hello() -> void;
+		auto send_resend_request(uint64_t from_sequence_number) -> void;
+		auto write_outbound_buffer() -> void;
 
 		std::string ip_;
 		int port_;
 		models::client_id_t client_id_ = models::INVALID_CLIENT_ID;
 
+		models::protocol_version preferred_version_ = models::protocol_version::V1;
+		models::protocol_version protocol_version_ = models::protocol_version::V1;
+		bool negotiating_ = false;
+		models::reference_price_table reference_prices_{};
+
 		models::client_response_queue* incoming_responses_ = nullptr;
 		models::client_request_queue* outgoing_requests_ = nullptr;
 
@@ -124,6 +156,10 @@ namespace kse::example::gateway {
 
 		uint64_t next_outgoing_seq_num_ = 1;
 		uint64_t next_exp_seq_num_ = 1;
+		uint64_t resend_requested_from_ = 0;
+
+		std::string shm_segment_name_;
+		std::unique_ptr<server::shm_client> shm_client_; //replaces the TCP connection for a co-located gateway
 
 		std::unique_ptr<tcp_connection_t> connection_;
 		uv_loop_t* loop_{ nullptr };
@@ -132,9 +168,11 @@ namespace kse::example::gateway {
 			models::client_request_queue* outgoing_requests,
 			models::client_response_queue* incoming_responses,
 			std::string_view ip,
-			int port)
-			:ip_{ ip }, port_{ port }, incoming_responses_{ incoming_responses }, outgoing_requests_{ outgoing_requests }, 
-			logger_{ "order_gateway" + std::to_string((uintptr_t)outgoing_requests) + ".log" }, connection_{ std::make_unique<tcp_connection_t>() }, idle_{ (uv_idle_t*)std::malloc(sizeof(uv_idle_t)) } {
+			int port,
+			models::protocol_version preferred_version,
+			std::string_view shm_segment_name)
+			:ip_{ ip }, port_{ port }, preferred_version_{ preferred_version }, incoming_responses_{ incoming_responses }, outgoing_requests_{ outgoing_requests }, 
+			logger_{ "order_gateway" + std::to_string((uintptr_t)outgoing_requests) + ".log" }, shm_segment_name_{ shm_segment_name }, connection_{ std::make_unique<tcp_connection_t>() }, idle_{ (uv_idle_t*)std::malloc(sizeof(uv_idle_t)) } {
 		}
 
 		~order_gateway()
@@ -51,6 +51,12 @@ namespace kse::example::trading {
                     if (!order->qty_)
                         order->order_state_ = om_order_state::DEAD;
                 }break;
+                case models::client_response_type::RISK_REJECTED: {
+                    if (order->order_state_ == om_order_state::PENDING_NEW)
+                        order->order_state_ = om_order_state::DEAD;
+                    else if (order->order_state_ == om_order_state::PENDING_CANCEL)
+                        order->order_state_ = om_order_state::LIVE;
+                }break;
                 default: break;
             }
         }
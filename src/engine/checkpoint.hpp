@@ -0,0 +1,64 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "models/basic_types.hpp"
+#include "models/constants.hpp"
+
+
+namespace kse::engine {
+	constexpr uint64_t CHECKPOINT_MAGIC = 0x4B5345434B505431; //"KSECKPT1", bumped whenever the layout changes
+
+	/**
+	 * Checkpoint file layout. Nothing in it is a pointer: every section is found by its offset from the start of the file
+	 * and every order by its ids, so the file restores into books at any address. Sections are read and written with
+	 * memcpy and need no alignment.
+	 *
+	 * [checkpoint_file_header][book section of instrument 0][book section of instrument 1]...
+	 *
+	 * A book section is a book_checkpoint_header followed by its resting orders (bids best first, then asks, each level in
+	 * time order), its buy stops, its sell stops and then every client's order list in list order.
+	 */
+	struct checkpoint_file_header {
+		uint64_t magic_ = CHECKPOINT_MAGIC;
+		uint64_t sequence_number_ = 0; //last journal record applied to the books
+		uint64_t state_hash_ = 0; //matching_engine::state_hash() when the checkpoint was taken
+		uint64_t payload_checksum_ = 0; //FNV-1a of everything after this header
+		uint64_t size_ = 0; //of the whole file
+		std::array<uint64_t, models::MAX_NUM_INSTRUMENTS> book_offsets_{};
+	};
+
+	struct book_checkpoint_header {
+		models::instrument_id_t instrument_id_ = models::INVALID_INSTRUMENT_ID;
+		models::trading_phase_t phase_ = models::trading_phase_t::CONTINUOUS;
+		models::price_t last_trade_price_ = models::INVALID_PRICE;
+		models::order_id_t next_market_order_id_ = 1;
+		models::price_t indicative_price_ = models::INVALID_PRICE; //last published indicative equilibrium
+		models::quantity_t indicative_volume_ = 0;
+		models::side_t indicative_surplus_side_ = models::side_t::INVALID;
+		models::quantity_t indicative_surplus_qty_ = 0;
+		uint32_t num_orders_ = 0;
+		uint32_t num_buy_stops_ = 0;
+		uint32_t num_sell_stops_ = 0;
+	};
+
+	struct checkpoint_order {
+		models::client_id_t client_id_ = models::INVALID_CLIENT_ID;
+		models::order_id_t client_order_id_ = models::INVALID_ORDER_ID;
+		models::order_id_t market_order_id_ = models::INVALID_ORDER_ID;
+		models::side_t side_ = models::side_t::INVALID;
+		models::price_t price_ = models::INVALID_PRICE;
+		models::quantity_t qty_ = 0;
+		models::quantity_t hidden_qty_ = 0;
+		models::quantity_t display_qty_ = models::INVALID_QUANTITY;
+		models::priority_t priority_ = models::INVALID_PRIORITY;
+		uint64_t expiry_tick_ = 0; //0 for orders that never expire
+	};
+
+	/// One entry of a client's order list; the lists are written one client after another.
+	struct checkpoint_client_order {
+		models::client_id_t client_id_ = models::INVALID_CLIENT_ID;
+		models::order_id_t client_order_id_ = models::INVALID_ORDER_ID;
+	};
+}
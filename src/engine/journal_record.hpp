@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "models/client_request.hpp"
+
+#include "utils/utils.hpp"
+
+
+namespace kse::engine {
+#pragma pack(push, 1)
+	/// One sequenced request as the matching engine read it off its queue.
+	struct journal_record {
+		uint64_t sequence_number_ = 0;
+		utils::nananoseconds_t timestamp_ = 0;
+		models::client_request_internal request_;
+		uint64_t checksum_ = 0; //FNV-1a of everything above; a zero-filled or torn record never matches
+
+		auto compute_checksum() const noexcept -> uint64_t {
+			return utils::fnv1a(this, offsetof(journal_record, checksum_));
+		}
+	};
+#pragma pack(pop)
+}
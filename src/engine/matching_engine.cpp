@@ -2,12 +2,18 @@
 
 #include <algorithm>
 #include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
 
-kse::engine::matching_engine::matching_engine(models::client_request_queue* client_requests, models::client_response_queue* client_responses, models::market_update_queue* market_updates):
+kse::engine::matching_engine::matching_engine(models::client_request_queue* client_requests, models::client_response_queue* client_responses, models::market_update_queue* market_updates,
+	const matching_config& config, request_journal* journal):
 	incoming_requests_{ client_requests }, outgoing_responses_{ client_responses }, outgoing_market_updates_{ market_updates }, logger_{ "kse_matching_engine.log" }, message_handler_{ outgoing_responses_, outgoing_market_updates_, &logger_ }
 {
+	session_close_ = config.session_close_;
+	journal_ = journal;
 	for (models::instrument_id_t i = 0; i < instrument_order_books_.size(); i++) {
-		instrument_order_books_.at(i) = std::make_unique<kse::engine::order_book>(i, &logger_, &message_handler_);
+		instrument_order_books_.at(i) = std::make_unique<kse::engine::order_book>(i, &logger_, &message_handler_, config.instrument_params_.at(i), &expiry_wheel_);
 	}
 }
 
@@ -39,3 +45,139 @@ auto kse::engine::matching_engine::stop() -> void
 	running_ = false;
 }
 
+
+auto kse::engine::matching_engine::write_checkpoint(const std::string& path, uint64_t sequence_number) noexcept -> bool
+{
+	START_MEASURE(Exchange_MatchingEngine_writeCheckpoint);
+	checkpoint_file_header header{ CHECKPOINT_MAGIC, sequence_number, state_hash() };
+	size_t size = sizeof(header);
+	for (size_t i = 0; i < instrument_order_books_.size(); ++i) {
+		header.book_offsets_[i] = size;
+		size += instrument_order_books_[i]->checkpoint_size();
+	}
+	header.size_ = size;
+
+	const auto temp_path = path + ".tmp";
+	auto file = utils::mapped_file::create(temp_path, size);
+	if (!file) {
+		logger_.log("%:% %() % Failed to create checkpoint file %\n", __FILE__, __LINE__, __func__, utils::get_curren_time_str(&time_str_), temp_path);
+		return false;
+	}
+
+	for (size_t i = 0; i < instrument_order_books_.size(); ++i) {
+		instrument_order_books_[i]->write_checkpoint(file->data() + header.book_offsets_[i]);
+	}
+	header.payload_checksum_ = utils::fnv1a(file->data() + sizeof(header), size - sizeof(header));
+	std::memcpy(file->data(), &header, sizeof(header));
+
+	const auto synced = file->sync(0, size);
+	file.reset();
+	std::error_code error;
+	if (synced) {
+		std::filesystem::rename(temp_path, path, error);
+	}
+	if (!synced || error) {
+		logger_.log("%:% %() % Failed to write checkpoint file %\n", __FILE__, __LINE__, __func__, utils::get_curren_time_str(&time_str_), path);
+		return false;
+	}
+	END_MEASURE(Exchange_MatchingEngine_writeCheckpoint, logger_, time_str_);
+
+	logger_.log("%:% %() % Checkpoint of sequence % written to % (% bytes, state hash %)\n", __FILE__, __LINE__, __func__, utils::get_curren_time_str(&time_str_),
+		sequence_number, path, size, header.state_hash_);
+	return true;
+}
+
+auto kse::engine::matching_engine::restore_checkpoint(const std::string& path) noexcept -> uint64_t
+{
+	START_MEASURE(Exchange_MatchingEngine_restoreCheckpoint);
+	auto file = utils::mapped_file::open(path, false);
+	if (!file || file->size() < sizeof(checkpoint_file_header)) {
+		return 0;
+	}
+
+	checkpoint_file_header header;
+	std::memcpy(&header, file->data(), sizeof(header));
+	if (header.magic_ != CHECKPOINT_MAGIC || header.size_ != file->size() ||
+		header.payload_checksum_ != utils::fnv1a(file->data() + sizeof(header), file->size() - sizeof(header))) {
+		logger_.log("%:% %() % Ignoring invalid checkpoint file %\n", __FILE__, __LINE__, __func__, utils::get_curren_time_str(&time_str_), path);
+		return 0;
+	}
+
+	for (size_t i = 0; i < instrument_order_books_.size(); ++i) {
+		const auto offset = header.book_offsets_[i];
+		const auto end = i + 1 < instrument_order_books_.size() ? header.book_offsets_[i + 1] : header.size_;
+		if (offset < sizeof(header) || end < offset || end > header.size_ ||
+			!instrument_order_books_[i]->restore_checkpoint(file->data() + offset, static_cast<size_t>(end - offset))) {
+			utils::FATAL("Checkpoint " + path + " does not fit order book " + std::to_string(i));
+		}
+	}
+	utils::ASSERT(state_hash() == header.state_hash_, "Checkpoint " + path + " restored to a different state hash");
+	END_MEASURE(Exchange_MatchingEngine_restoreCheckpoint, logger_, time_str_);
+
+	if (journal_) {
+		journal_->set_last_checkpoint(header.sequence_number_);
+	}
+	logger_.log("%:% %() % Restored checkpoint of sequence % from %, state hash %\n", __FILE__, __LINE__, __func__, utils::get_curren_time_str(&time_str_),
+		header.sequence_number_, path, header.state_hash_);
+	return header.sequence_number_;
+}
+
+auto kse::engine::matching_engine::checkpoint() noexcept -> void
+{
+	const auto sequence_number = journal_->next_sequence_number() - 1;
+	journal_->flush();
+	write_checkpoint(journal_->checkpoint_path(), sequence_number);
+	journal_->set_last_checkpoint(sequence_number);
+}
+
+auto kse::engine::matching_engine::follow(standby_replica& replica, utils::nananoseconds_t failover_timeout) noexcept -> uint64_t
+{
+	logger_.log("%:% %() % Following the primary from sequence %\n", __FILE__, __LINE__, __func__, utils::get_curren_time_str(&time_str_),
+		replica.applied_sequence_number());
+	message_handler_.set_suppressed(true);
+
+	// Batches are replicated record by record, so the entries of a batch are waited for while the primary is alive.
+	const auto next_entry = [this, &replica, failover_timeout](models::client_request_internal& entry) {
+		while (true) {
+			if (const auto* record = replica.next()) {
+				entry = record->request_;
+				request_time_ = record->timestamp_;
+				return true;
+			}
+			if (!replica.primary_alive(failover_timeout)) [[unlikely]] {
+				return false;
+			}
+		}
+	};
+
+	auto last_report = utils::get_monotonic_timestamp();
+	while (true) {
+		const auto* record = replica.next();
+		if (!record) {
+			if (!replica.primary_alive(failover_timeout)) {
+				break;
+			}
+			const auto now = utils::get_monotonic_timestamp();
+			if (now - last_report >= utils::NANOS_PER_SECS) {
+				logger_.log("%:% %() % Standby at sequence % lag %\n", __FILE__, __LINE__, __func__, utils::get_curren_time_str(&time_str_),
+					replica.applied_sequence_number(), replica.lag());
+				last_report = now;
+			}
+			continue;
+		}
+
+		const auto request = record->request_;
+		request_time_ = record->timestamp_;
+		if (models::batch_length(request) > 1) [[unlikely]] {
+			process_batch(request, next_entry);
+		}
+		else {
+			process_client_request(request);
+		}
+	}
+
+	message_handler_.set_suppressed(false);
+	logger_.log("%:% %() % Primary heartbeat lost at sequence %, state hash %\n", __FILE__, __LINE__, __func__, utils::get_curren_time_str(&time_str_),
+		replica.applied_sequence_number(), state_hash());
+	return replica.applied_sequence_number();
+}
@@ -11,12 +11,21 @@
 
 #include "order_book.hpp"
 #include "message_handler.hpp"
+#include "request_journal.hpp"
 
 
 namespace kse::engine {
+	struct replay_result {
+		uint64_t requests_ = 0; //journal records applied
+		uint64_t last_sequence_number_ = 0;
+		utils::nananoseconds_t elapsed_ = 0;
+		uint64_t state_hash_ = 0;
+	};
+
 	class matching_engine {
 	public:
-		matching_engine(models::client_request_queue* client_requests, models::client_response_queue* client_responses, models::market_update_queue* market_updates);
+		matching_engine(models::client_request_queue* client_requests, models::client_response_queue* client_responses, models::market_update_queue* market_updates,
+			const matching_config& config = {}, request_journal* journal = nullptr);
 		~matching_engine();
 
 		matching_engine(const matching_engine&) = delete;
@@ -29,13 +38,22 @@ namespace kse::engine {
 		auto stop() -> void;
 
 		auto process_client_request(const models::client_request_internal& client_request) noexcept -> void {
+			if (client_request.type_ == models::client_request_type::MASS_CANCEL) [[unlikely]] {
+				START_MEASURE(Exchange_MEOrderBook_massCancel);
+				process_mass_cancel(client_request);
+				END_MEASURE(Exchange_MEOrderBook_massCancel, logger_, time_str_);
+				return;
+			}
+
 			auto* order_book = instrument_order_books_.at(client_request.instrument_id_).get();
 
 
 			switch (client_request.type_) {
 				case models::client_request_type::NEW: {
 					START_MEASURE(Exchange_MEOrderBook_add);
-					order_book->add(client_request.client_id_, client_request.order_id_, client_request.side_, client_request.price_, client_request.qty_);
+					order_book->add(client_request.client_id_, client_request.order_id_, client_request.side_, client_request.price_, client_request.qty_,
+						client_request.order_type_, client_request.time_in_force_, client_request.stop_price_,
+						client_request.display_qty_, client_request.stp_mode_, get_expire_time(client_request));
 					END_MEASURE(Exchange_MEOrderBook_add, logger_, time_str_);
 				} break;
 				case models::client_request_type::CANCEL: {
@@ -45,13 +63,138 @@ namespace kse::engine {
 				} break;
 				case models::client_request_type::MODIFY: {
 					START_MEASURE(Exchange_MEOrderBook_modify);
-					order_book->modify(client_request.client_id_, client_request.order_id_, client_request.price_, client_request.qty_);
+					order_book->modify(client_request.client_id_, client_request.order_id_, client_request.price_, client_request.qty_, client_request.stp_mode_);
 					END_MEASURE(Exchange_MEOrderBook_modify, logger_, time_str_);
 				}break;
+				case models::client_request_type::START_AUCTION: {
+					order_book->start_auction();
+				} break;
+				case models::client_request_type::UNCROSS: {
+					START_MEASURE(Exchange_MEOrderBook_uncross);
+					order_book->uncross();
+					END_MEASURE(Exchange_MEOrderBook_uncross, logger_, time_str_);
+				} break;
+				case models::client_request_type::EXPIRE: {
+					order_book->expire(client_request.client_id_, client_request.order_id_);
+				} break;
 				default: {
 					utils::FATAL("Received invalid client-request-type:" + models::client_request_type_to_string(client_request.type_));
 				} 
 			}
+
+			if (order_book->in_auction()) [[unlikely]] {
+				order_book->publish_indicative();
+			}
+		}
+
+		/// Cancels the client's orders in one instrument or all of them, then confirms with a MASS_CANCELED carrying the count.
+		auto process_mass_cancel(const models::client_request_internal& client_request) noexcept -> void {
+			models::quantity_t canceled = 0;
+			if (client_request.instrument_id_ == models::INVALID_INSTRUMENT_ID) {
+				for (auto& order_book : instrument_order_books_) {
+					canceled += order_book->mass_cancel(client_request.client_id_, client_request.side_);
+					if (order_book->in_auction()) [[unlikely]] {
+						order_book->publish_indicative();
+					}
+				}
+			}
+			else {
+				auto* order_book = instrument_order_books_.at(client_request.instrument_id_).get();
+				canceled = order_book->mass_cancel(client_request.client_id_, client_request.side_);
+				if (order_book->in_auction()) [[unlikely]] {
+					order_book->publish_indicative();
+				}
+			}
+
+			send_client_response({ models::client_response_type::MASS_CANCELED, client_request.client_id_, client_request.instrument_id_, client_request.order_id_,
+				models::INVALID_ORDER_ID, client_request.side_, models::INVALID_PRICE, canceled, models::INVALID_QUANTITY });
+		}
+
+		/**
+		 * Applies the entries behind a batch header back to back, each after a BATCH_ENTRY marker, then sends a BATCH_ACK
+		 * counting the entries applied and rejected; a new order canceled before it could rest counts as rejected.
+		 * The order server folds the acknowledgement that follows each marker into the BATCH_ACK.
+		 * next_entry(entry) fills in the next entry, from the queue or from the journal; a journal cut short inside a batch ends it early.
+		 */
+		template<typename F>
+		auto process_batch(const models::client_request_internal& header, F&& next_entry) noexcept -> void {
+			const auto num_entries = models::batch_length(header) - 1;
+			models::quantity_t applied = 0;
+			models::quantity_t rejected = 0;
+
+			models::client_request_internal entry;
+			for (size_t i = 0; i < num_entries && next_entry(entry); ++i) {
+				const auto request = models::batch_entry_as_request(header.type_, entry);
+				send_client_response({ models::client_response_type::BATCH_ENTRY, request.client_id_, request.instrument_id_, request.order_id_ });
+
+				auto* order_book = instrument_order_books_.at(request.instrument_id_).get();
+				if (header.type_ == models::client_request_type::MASS_QUOTE && request.type_ == models::client_request_type::NEW) {
+					START_MEASURE(Exchange_MEOrderBook_quote);
+					order_book->quote(request.client_id_, request.order_id_, request.side_, request.price_, request.qty_, request.stp_mode_);
+					END_MEASURE(Exchange_MEOrderBook_quote, logger_, time_str_);
+					if (order_book->in_auction()) [[unlikely]] {
+						order_book->publish_indicative();
+					}
+				}
+				else {
+					process_client_request(request);
+				}
+
+				const auto& outcome = order_book->get_client_response();
+				const bool canceled = request.type_ == models::client_request_type::NEW && outcome.type_ == models::client_response_type::CANCELED &&
+					outcome.client_id_ == request.client_id_ && outcome.client_order_id_ == request.order_id_;
+				if (outcome.type_ == models::client_response_type::CANCEL_REJECTED || outcome.type_ == models::client_response_type::MODIFY_REJECTED || canceled) [[unlikely]] {
+					++rejected;
+				}
+				else {
+					++applied;
+				}
+			}
+
+			send_client_response({ models::client_response_type::BATCH_ACK, header.client_id_, models::INVALID_INSTRUMENT_ID, header.order_id_,
+				models::INVALID_ORDER_ID, models::side_t::INVALID, models::INVALID_PRICE, applied, rejected });
+		}
+
+		/// Absolute expiry of a DAY, GTD or GTT order in nanoseconds since the epoch, 0 for orders that never expire. DAY counts from the request's journal timestamp.
+		auto get_expire_time(const models::client_request_internal& client_request) const noexcept -> uint64_t {
+			constexpr uint64_t NANOS_PER_DAY = 24 * 60 * 60 * static_cast<uint64_t>(utils::NANOS_PER_SECS);
+
+			switch (client_request.time_in_force_) {
+			case models::time_in_force_t::DAY: {
+				const auto now = static_cast<uint64_t>(request_time_);
+				const auto close = now / NANOS_PER_DAY * NANOS_PER_DAY + session_close_;
+				return close > now ? close : close + NANOS_PER_DAY;
+			}
+			case models::time_in_force_t::GTD:
+				return client_request.expire_time_ * NANOS_PER_DAY + session_close_;
+			case models::time_in_force_t::GTT:
+				return client_request.expire_time_;
+			default:
+				return 0;
+			}
+		}
+
+		/**
+		 * Cancels at most MAX_EXPIRIES_PER_POLL orders whose expiry has passed. The rest stay due in the wheel, so a wave
+		 * of DAY orders at the session close is worked off between incoming requests instead of ahead of them.
+		 * Every expiry is journaled as an EXPIRE request, since a replay has no clock to fire it from.
+		 */
+		auto expire_orders() noexcept -> void {
+			START_MEASURE(Exchange_MatchingEngine_expireOrders);
+			const auto now = utils::get_current_timestamp();
+			const auto expired = expiry_wheel_.poll(static_cast<uint64_t>(now / EXPIRY_TICK), MAX_EXPIRIES_PER_POLL, [this, now](models::order* order) {
+				if (journal_) {
+					journal_->append({ models::client_request_type::EXPIRE, order->client_id_, order->instrument_id_, order->client_order_id_ }, now);
+				}
+				auto* order_book = instrument_order_books_.at(order->instrument_id_).get();
+				order_book->expire(order);
+				if (order_book->in_auction()) [[unlikely]] {
+					order_book->publish_indicative();
+				}
+			});
+			if (expired) {
+				END_MEASURE(Exchange_MatchingEngine_expireOrders, logger_, time_str_);
+			}
 		}
 
 		auto send_client_response(const models::client_response_internal& client_response) noexcept -> void {
@@ -67,19 +210,142 @@ namespace kse::engine {
 			while (running_) {
 				const auto* client_request = incoming_requests_->get_next_read_element();
 				if (client_request) [[likely]] {
+					// Batches are published whole, but the header can become visible before its last entries.
+					const auto length = models::batch_length(*client_request);
+					if (length > 1 && incoming_requests_->size() < length) [[unlikely]] {
+						continue;
+					}
+
 					TIME_MEASURE(T3_MatchingEngine_LFQueue_read, logger_, time_str_);
 					logger_.log("%:% %() % Processing %\n", __FILE__, __LINE__, __func__, utils::get_curren_time_str(&time_str_),
 						client_request->to_string());
+					request_time_ = utils::get_current_timestamp();
+					if (journal_) {
+						START_MEASURE(Exchange_RequestJournal_append);
+						journal_->append(*client_request, request_time_);
+						END_MEASURE(Exchange_RequestJournal_append, logger_, time_str_);
+					}
 					START_MEASURE(Exchange_MatchingEngine_processClientRequest);
-					process_client_request(*client_request);
+					if (length > 1) [[unlikely]] {
+						const auto header = *client_request;
+						incoming_requests_->next_read_index();
+						process_batch(header, [this](models::client_request_internal& entry) {
+							entry = *incoming_requests_->get_next_read_element();
+							incoming_requests_->next_read_index();
+							if (journal_) {
+								journal_->append(entry, request_time_);
+							}
+							return true;
+						});
+					}
+					else {
+						process_client_request(*client_request);
+						incoming_requests_->next_read_index();
+					}
 					END_MEASURE(Exchange_MatchingEngine_processClientRequest, logger_, time_str_);
-					incoming_requests_->next_read_index();
+
+					if (journal_ && journal_->checkpoint_due()) [[unlikely]] {
+						checkpoint();
+					}
+				}
+
+				// Idle moments commit the journal, so a quiet market is not left waiting for a full commit batch.
+				if (!client_request && journal_) {
+					journal_->commit();
+				}
+
+				// The clock is only read between requests while no order can expire.
+				if (!client_request || expiry_wheel_.size()) {
+					expire_orders();
 				}
 			}
 		}
 
+		/**
+		 * Rebuilds the order books from a journal at full speed: every record is applied the way run() applied it, with
+		 * DAY expiries computed from the journaled timestamps and expiries taken from the EXPIRE records instead of the clock.
+		 * Outputs are dropped unless suppress_outputs is false. Call it before start().
+		 */
+		auto replay(journal_reader& reader, bool suppress_outputs = true) noexcept -> replay_result {
+			logger_.log("%:% %() % Replaying the journal\n", __FILE__, __LINE__, __func__, utils::get_curren_time_str(&time_str_));
+			message_handler_.set_suppressed(suppress_outputs);
+
+			replay_result result;
+			const auto start = utils::get_monotonic_timestamp();
+			const auto next_entry = [this, &reader, &result](models::client_request_internal& entry) {
+				const auto* record = reader.next();
+				if (!record) [[unlikely]] {
+					return false;
+				}
+				entry = record->request_;
+				request_time_ = record->timestamp_;
+				result.last_sequence_number_ = record->sequence_number_;
+				++result.requests_;
+				return true;
+			};
+
+			models::client_request_internal request;
+			while (next_entry(request)) {
+				if (models::batch_length(request) > 1) [[unlikely]] {
+					process_batch(request, next_entry);
+				}
+				else {
+					process_client_request(request);
+				}
+			}
+
+			result.elapsed_ = utils::get_monotonic_timestamp() - start;
+			result.state_hash_ = state_hash();
+			message_handler_.set_suppressed(false);
+
+			logger_.log("%:% %() % Replayed % requests up to sequence % in %ns, state hash %\n", __FILE__, __LINE__, __func__, utils::get_curren_time_str(&time_str_),
+				result.requests_, result.last_sequence_number_, result.elapsed_, result.state_hash_);
+			return result;
+		}
+
+		/**
+		 * Runs the engine as a hot standby: applies the primary's records from the replica with outputs suppressed until the
+		 * primary's heartbeat is older than failover_timeout and its process is gone, logging the lag every second while idle. Returns the last sequence
+		 * number applied; the caller then replays what the primary journaled but never replicated, attaches the journal and starts the engine.
+		 */
+		auto follow(standby_replica& replica, utils::nananoseconds_t failover_timeout = DEFAULT_FAILOVER_TIMEOUT) noexcept -> uint64_t;
+
+		/// Journal of a promoted standby, or of an engine that replayed before opening one. Call it before start().
+		auto set_journal(request_journal* journal) noexcept -> void { journal_ = journal; }
+
+		/**
+		 * Writes every order book to a checkpoint file covering the journal up to sequence_number. The file is written
+		 * under a temporary name, synced and renamed over `path`, so a crash never leaves a torn checkpoint behind.
+		 * Call it between requests. Returns false on failure.
+		 */
+		auto write_checkpoint(const std::string& path, uint64_t sequence_number) noexcept -> bool;
+
+		/**
+		 * Rebuilds the empty order books from a checkpoint file and returns the sequence number it covers; replaying the
+		 * journal from the next one brings the engine up to date. Returns 0 if there is no valid checkpoint. Call it before replay().
+		 */
+		auto restore_checkpoint(const std::string& path) noexcept -> uint64_t;
+
+		/// Hash of every order book. A replay of the same journal ends on the same hash as the run that wrote it.
+		auto state_hash() const noexcept -> uint64_t {
+			auto hash = utils::FNV1A_OFFSET_BASIS;
+			for (const auto& order_book : instrument_order_books_) {
+				hash = order_book->state_hash(hash);
+			}
+			return hash;
+		}
+
 	private:
+		static constexpr size_t MAX_EXPIRIES_PER_POLL = 64;
+
+		/// Periodic checkpoint between two requests. The journal is flushed first, so the checkpoint never covers records a power loss could take back.
+		auto checkpoint() noexcept -> void;
+
 		order_book_map instrument_order_books_;
+		expiry_wheel expiry_wheel_{ static_cast<uint64_t>(utils::get_current_timestamp() / EXPIRY_TICK) };
+		uint64_t session_close_ = 0;
+		request_journal* journal_ = nullptr; //optional write-ahead journal of every request read off the queue
+		utils::nananoseconds_t request_time_ = 0; //journal timestamp of the request being applied
 
 		models::client_request_queue* incoming_requests_ = nullptr;
 		models::client_response_queue* outgoing_responses_ = nullptr;
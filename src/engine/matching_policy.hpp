@@ -0,0 +1,120 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string>
+
+#include "models/basic_types.hpp"
+#include "models/constants.hpp"
+#include "models/order.hpp"
+
+
+namespace kse::engine {
+	/// How an incoming order's quantity is split among the resting orders of one price level.
+	enum class matching_policy_t : uint8_t {
+		FIFO = 0, //price-time priority
+		PRO_RATA = 1, //in proportion to each order's displayed quantity, rounding leftovers in time order
+		PRO_RATA_TOP_ORDER = 2, //the oldest order at the level is filled first, the rest pro-rata
+		LMM = 3 //the lead market maker's orders get their share first, the rest in time order
+	};
+
+	inline auto matching_policy_to_string(matching_policy_t policy) -> std::string {
+		switch (policy) {
+		case matching_policy_t::FIFO:
+			return "FIFO";
+		case matching_policy_t::PRO_RATA:
+			return "PRO_RATA";
+		case matching_policy_t::PRO_RATA_TOP_ORDER:
+			return "PRO_RATA_TOP_ORDER";
+		case matching_policy_t::LMM:
+			return "LMM";
+		}
+
+		return "UNKNOWN";
+	}
+
+	/// Matching setup of one instrument: its allocation policy and the price bands its trades are kept within.
+	struct matching_params {
+		matching_policy_t policy_ = matching_policy_t::FIFO;
+		models::client_id_t lmm_client_id_ = models::INVALID_CLIENT_ID; //LMM only
+		uint8_t lmm_allocation_pct_ = 0; //LMM only: share of the quantity taken at each level reserved for the lead market maker, at most 100
+
+		models::price_t reference_price_ = models::INVALID_PRICE; //centre of the static band
+		uint32_t static_band_bps_ = 0; //max distance of a trade from the reference price in basis points, 0 for no static band
+		uint32_t dynamic_band_bps_ = 0; //max distance of a trade from the last trade in basis points, 0 for no dynamic band
+		models::trading_phase_t breach_phase_ = models::trading_phase_t::AUCTION; //where a breach puts the instrument: AUCTION or HALTED
+	};
+
+	/// Matching policy of every instrument and the session schedule, fixed when the matching engine starts.
+	struct matching_config {
+		std::array<matching_params, models::MAX_NUM_INSTRUMENTS> instrument_params_{};
+		uint64_t session_close_ = 0; //nanoseconds after midnight UTC at which DAY and GTD orders expire
+	};
+
+	/**
+	 * Allocation policies. The order book's matching loop is a template over them, so each instrument runs a loop
+	 * specialised for its policy. FIFO keeps the order-by-order loop; the others fill a whole price level at a time
+	 * from allocate(), which splits `qty` (at most the sum of `qtys`) into `fills`, all three indexed in time order.
+	 */
+	struct fifo_allocation {};
+
+	struct pro_rata_allocation {
+		static auto allocate(std::span<models::order* const>, std::span<const models::quantity_t> qtys, models::quantity_t qty, std::span<models::quantity_t> fills,
+			const matching_params&) noexcept -> void {
+			split(qtys, qty, fills);
+		}
+
+		/// Floors each order's share of `qty` in one pass over the contiguous quantities, then hands out the rounding remainder in time order.
+		static auto split(std::span<const models::quantity_t> qtys, models::quantity_t qty, std::span<models::quantity_t> fills) noexcept -> void {
+			uint64_t total = 0;
+			for (const auto order_qty : qtys) {
+				total += order_qty;
+			}
+
+			models::quantity_t allocated = 0;
+			for (size_t i = 0; i < qtys.size(); ++i) {
+				fills[i] = total ? static_cast<models::quantity_t>(static_cast<uint64_t>(qty) * qtys[i] / total) : 0;
+				allocated += fills[i];
+			}
+
+			for (size_t i = 0; i < qtys.size() && allocated < qty; ++i) {
+				const auto extra = std::min(qty - allocated, qtys[i] - fills[i]);
+				fills[i] += extra;
+				allocated += extra;
+			}
+		}
+	};
+
+	struct pro_rata_top_order_allocation {
+		static auto allocate(std::span<models::order* const>, std::span<const models::quantity_t> qtys, models::quantity_t qty, std::span<models::quantity_t> fills,
+			const matching_params&) noexcept -> void {
+			fills[0] = std::min(qty, qtys[0]);
+			pro_rata_allocation::split(qtys.subspan(1), qty - fills[0], fills.subspan(1));
+		}
+	};
+
+	struct lmm_allocation {
+		static auto allocate(std::span<models::order* const> orders, std::span<const models::quantity_t> qtys, models::quantity_t qty, std::span<models::quantity_t> fills,
+			const matching_params& params) noexcept -> void {
+			// A share over 100% would hand out more than the incoming quantity.
+			auto lmm_share = static_cast<models::quantity_t>(static_cast<uint64_t>(qty) * std::min<uint8_t>(params.lmm_allocation_pct_, 100) / 100);
+			auto left = qty;
+			for (size_t i = 0; i < qtys.size(); ++i) {
+				fills[i] = 0;
+				if (orders[i]->client_id_ == params.lmm_client_id_ && lmm_share) {
+					fills[i] = std::min(lmm_share, qtys[i]);
+					lmm_share -= fills[i];
+					left -= fills[i];
+				}
+			}
+
+			for (size_t i = 0; i < qtys.size() && left; ++i) {
+				const auto extra = std::min(left, qtys[i] - fills[i]);
+				fills[i] += extra;
+				left -= extra;
+			}
+		}
+	};
+}
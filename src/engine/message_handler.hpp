@@ -25,7 +25,13 @@ namespace kse::engine {
 		message_handler& operator=(const message_handler&) = delete;
 		message_handler& operator=(message_handler&&) = delete;
 
+		/// While suppressed, responses and market updates are dropped unlogged, so a replay rebuilds the books at full speed.
+		auto set_suppressed(bool suppressed) noexcept -> void { suppressed_ = suppressed; }
+
 		auto send_client_response(const models::client_response_internal& client_response) noexcept -> void {
+			if (suppressed_) [[unlikely]] {
+				return;
+			}
 			logger_->log("%:% %() % Sending %\n", __FILE__, __LINE__, __func__,
 				utils::get_curren_time_str(&time_str_), client_response.to_string());
 			auto* next_write = outgoing_responses_->get_next_write_element();
@@ -35,6 +41,9 @@ namespace kse::engine {
 		}
 
 		auto send_market_update(const models::market_update& market_update) noexcept -> void {
+			if (suppressed_) [[unlikely]] {
+				return;
+			}
 			logger_->log("%:% %() % Sending %\n", __FILE__, __LINE__, __func__,
 				utils::get_curren_time_str(&time_str_), market_update.to_string());
 			auto* next_write = outgoing_market_updates_->get_next_write_element();
@@ -48,5 +57,6 @@ namespace kse::engine {
 		models::market_update_queue* outgoing_market_updates_ = nullptr;
 		utils::logger* logger_ = nullptr;
 		std::string time_str_;
+		bool suppressed_ = false;
 	};
 }
\ No newline at end of file
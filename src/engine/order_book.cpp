@@ -1,13 +1,32 @@
 #include "order_book.hpp"
 
 #include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <limits>
+#include <numeric>
+#include <type_traits>
 
 #include "fmt/format.h"
 
 namespace kse::engine {
-	order_book::order_book(models::instrument_id_t instrument_id, utils::logger* logger, message_handler* message_handler)
-		: instrument_id_{ instrument_id }, message_handler_{ message_handler }, price_level_pool_{ models::MAX_PRICE_LEVELS }, order_pool_{ models::MAX_NUM_ORDERS },logger_{ logger } {
-		client_orders_.fill({ models::MAX_NUM_ORDERS, nullptr });
+	order_book::order_book(models::instrument_id_t instrument_id, utils::logger* logger, message_handler* message_handler, const matching_params& matching,
+		expiry_wheel* expiries)
+		: instrument_id_{ instrument_id }, message_handler_{ message_handler }, price_level_pool_{ models::MAX_PRICE_LEVELS }, order_pool_{ models::MAX_NUM_ORDERS }, matching_{ matching },
+		expiries_{ expiries }, logger_{ logger } {
+		has_price_bands_ = matching_.static_band_bps_ || matching_.dynamic_band_bps_;
+		client_orders_.resize(models::MAX_NUM_CLIENTS, models::order_map(models::MAX_NUM_ORDERS, nullptr));
+		client_order_lists_.resize(models::MAX_NUM_CLIENTS, nullptr);
+		buy_stops_.reserve(models::MAX_NUM_ORDERS);
+		sell_stops_.reserve(models::MAX_NUM_ORDERS);
+		auction_prices_.reserve(2 * models::MAX_PRICE_LEVELS);
+		auction_bid_volumes_.reserve(2 * models::MAX_PRICE_LEVELS);
+		auction_ask_volumes_.reserve(2 * models::MAX_PRICE_LEVELS);
+		if (matching_.policy_ != matching_policy_t::FIFO) {
+			allocation_orders_.reserve(models::MAX_NUM_ORDERS);
+			allocation_qtys_.reserve(models::MAX_NUM_ORDERS);
+			allocation_fills_.reserve(models::MAX_NUM_ORDERS);
+		}
 	}
 
 	order_book::~order_book() {
@@ -22,22 +41,32 @@ namespace kse::engine {
 
 	auto order_book::match(models::client_id_t client_id, models::side_t side, models::order_id_t client_order_id, models::order_id_t market_order_id, models::quantity_t leaves_qty, models::order& order_to_match_with) noexcept -> models::quantity_t
 	{
-		const auto matched_qty = std::min(leaves_qty, order_to_match_with.qty_);
+		return fill(client_id, side, client_order_id, market_order_id, leaves_qty, std::min(leaves_qty, order_to_match_with.qty_), order_to_match_with);
+	}
+
+	auto order_book::fill(models::client_id_t client_id, models::side_t side, models::order_id_t client_order_id, models::order_id_t market_order_id, models::quantity_t leaves_qty,
+		models::quantity_t matched_qty, models::order& order_to_match_with) noexcept -> models::quantity_t
+	{
 		const auto order_to_match_with_old_qty = order_to_match_with.qty_;
 		const auto leaves_qty_after_match = leaves_qty - matched_qty;
 
 		order_to_match_with.qty_ -= matched_qty;
+		get_price_level(order_to_match_with.side_, order_to_match_with.price_)->qty_ -= matched_qty;
+		last_trade_price_ = order_to_match_with.price_;
 
 		client_response_ = { models::client_response_type::FILLED, client_id, instrument_id_, client_order_id, market_order_id, side, order_to_match_with.price_, matched_qty, leaves_qty_after_match };
 		message_handler_->send_client_response(client_response_);
 
-		client_response_ = { models::client_response_type::FILLED, order_to_match_with.client_id_, order_to_match_with.instrument_id_, order_to_match_with.client_order_id_, order_to_match_with.market_order_id_, order_to_match_with.side_, order_to_match_with.price_, matched_qty, order_to_match_with.qty_ };
+		client_response_ = { models::client_response_type::FILLED, order_to_match_with.client_id_, order_to_match_with.instrument_id_, order_to_match_with.client_order_id_, order_to_match_with.market_order_id_, order_to_match_with.side_, order_to_match_with.price_, matched_qty, order_to_match_with.qty_ + order_to_match_with.hidden_qty_ };
 		message_handler_->send_client_response(client_response_);
 
 		market_update_ = { models::market_update_type::TRADE, models::INVALID_ORDER_ID, instrument_id_, side, order_to_match_with.price_, matched_qty, models::INVALID_PRIORITY };
 		message_handler_->send_market_update(market_update_);
 
-		if (order_to_match_with.qty_ == 0)
+		if (order_to_match_with.qty_ == 0 && order_to_match_with.hidden_qty_) [[unlikely]] {
+			replenish(order_to_match_with);
+		}
+		else if (order_to_match_with.qty_ == 0)
 		{
 			market_update_ = { models::market_update_type::CANCEL, order_to_match_with.market_order_id_, instrument_id_, order_to_match_with.side_, order_to_match_with.price_, order_to_match_with_old_qty, order_to_match_with.priority_ };
 			message_handler_->send_market_update(market_update_);
@@ -53,11 +82,72 @@ namespace kse::engine {
 		return leaves_qty_after_match;
 	}
 
-	auto order_book::check_for_match(models::client_id_t client_id, models::order_id_t client_order_id, models::order_id_t new_market_order_id, models::side_t side, models::price_t price, models::quantity_t qty) noexcept -> models::quantity_t
+	auto order_book::replenish(models::order& order) noexcept -> void
+	{
+		// The new peak goes to the back of the level, keeping its pool slot and its market order id. Allocation policies and
+		// self-trade prevention reach orders anywhere in the level, so the order is unlinked from wherever it sits.
+		auto* orders_at_price_level = get_price_level(order.side_, order.price_);
+
+		market_update_ = { models::market_update_type::CANCEL, order.market_order_id_, instrument_id_, order.side_, order.price_, 0, order.priority_ };
+		message_handler_->send_market_update(market_update_);
+
+		order.qty_ = std::min(order.display_qty_, order.hidden_qty_);
+		order.hidden_qty_ -= order.qty_;
+		order.priority_ = get_order_priority_at_price_level(order.side_, order.price_);
+
+		auto*& first_order = orders_at_price_level->first_order_;
+		if (first_order == &order) {
+			// The level is a circular list, so advancing its head moves the order to the back.
+			first_order = order.next_order_;
+		}
+		else if (first_order->prev_order_ != &order) {
+			order.prev_order_->next_order_ = order.next_order_;
+			order.next_order_->prev_order_ = order.prev_order_;
+
+			order.prev_order_ = first_order->prev_order_;
+			order.next_order_ = first_order;
+			first_order->prev_order_->next_order_ = &order;
+			first_order->prev_order_ = &order;
+		}
+
+		market_update_ = { models::market_update_type::ADD, order.market_order_id_, instrument_id_, order.side_, order.price_, order.qty_, order.priority_ };
+		message_handler_->send_market_update(market_update_);
+	}
+
+	auto order_book::match_incoming(models::client_id_t client_id, models::order_id_t client_order_id, models::order_id_t new_market_order_id, models::side_t side, models::price_t price, models::quantity_t qty,
+		models::stp_mode_t stp_mode) noexcept -> models::quantity_t
+	{
+		switch (matching_.policy_) {
+		case matching_policy_t::PRO_RATA:
+			return check_for_match<pro_rata_allocation>(client_id, client_order_id, new_market_order_id, side, price, qty, stp_mode);
+		case matching_policy_t::PRO_RATA_TOP_ORDER:
+			return check_for_match<pro_rata_top_order_allocation>(client_id, client_order_id, new_market_order_id, side, price, qty, stp_mode);
+		case matching_policy_t::LMM:
+			return check_for_match<lmm_allocation>(client_id, client_order_id, new_market_order_id, side, price, qty, stp_mode);
+		default:
+			return check_for_match<fifo_allocation>(client_id, client_order_id, new_market_order_id, side, price, qty, stp_mode);
+		}
+	}
+
+	template<typename Policy>
+	auto order_book::check_for_match(models::client_id_t client_id, models::order_id_t client_order_id, models::order_id_t new_market_order_id, models::side_t side, models::price_t price, models::quantity_t qty,
+		models::stp_mode_t stp_mode) noexcept -> models::quantity_t
 	{
 		auto leaves_qty = qty;
 
-		if (side == models::side_t::BUY) {
+		if constexpr (!std::is_same_v<Policy, fifo_allocation>) {
+			while (leaves_qty) {
+				auto* price_level = side == models::side_t::BUY ? ask_ : bid_;
+				if (!price_level || (side == models::side_t::BUY ? price_level->price_ > price : price_level->price_ < price)) {
+					break;
+				}
+
+				START_MEASURE(Exchange_MEOrderBook_allocateLevel);
+				leaves_qty = allocate_level<Policy>(client_id, client_order_id, new_market_order_id, side, price, leaves_qty, stp_mode, *price_level);
+				END_MEASURE(Exchange_MEOrderBook_allocateLevel, (*logger_), time_str_);
+			}
+		}
+		else if (side == models::side_t::BUY) {
 			while (leaves_qty && ask_) {
 				auto* ask_order = ask_->first_order_;
 
@@ -65,6 +155,11 @@ namespace kse::engine {
 					break;
 				}
 
+				if (ask_order->client_id_ == client_id && stp_mode != models::stp_mode_t::NONE) [[unlikely]] {
+					leaves_qty = prevent_self_trade(stp_mode, client_id, client_order_id, new_market_order_id, side, price, leaves_qty, *ask_order);
+					continue;
+				}
+
 				START_MEASURE(Exchange_MEOrderBook_match);
 				leaves_qty = match(client_id, side, client_order_id, new_market_order_id, leaves_qty, *ask_order);
 				END_MEASURE(Exchange_MEOrderBook_match, (*logger_), time_str_);
@@ -78,6 +173,11 @@ namespace kse::engine {
 					break;
 				}
 
+				if (bid_order->client_id_ == client_id && stp_mode != models::stp_mode_t::NONE) [[unlikely]] {
+					leaves_qty = prevent_self_trade(stp_mode, client_id, client_order_id, new_market_order_id, side, price, leaves_qty, *bid_order);
+					continue;
+				}
+
 				START_MEASURE(Exchange_MEOrderBook_match);
 				leaves_qty = match(client_id, side, client_order_id, new_market_order_id, leaves_qty, *bid_order);
 				END_MEASURE(Exchange_MEOrderBook_match, (*logger_), time_str_);
@@ -88,29 +188,288 @@ namespace kse::engine {
 		return leaves_qty;
 	}
 
-	void order_book::add(models::client_id_t client_id, models::order_id_t client_order_id, models::side_t side, models::price_t price, models::quantity_t quantity) noexcept {
+	template<typename Policy>
+	auto order_book::allocate_level(models::client_id_t client_id, models::order_id_t client_order_id, models::order_id_t market_order_id, models::side_t side, models::price_t price,
+		models::quantity_t leaves_qty, models::stp_mode_t stp_mode, models::price_level& price_level) noexcept -> models::quantity_t
+	{
+		allocation_orders_.clear();
+		allocation_qtys_.clear();
+
+		uint64_t displayed_qty = 0;
+		auto* order = price_level.first_order_;
+		do {
+			// The client's own orders are dealt with before the level is split, so they never get an allocation.
+			if (order->client_id_ == client_id && stp_mode != models::stp_mode_t::NONE) [[unlikely]] {
+				return prevent_self_trade(stp_mode, client_id, client_order_id, market_order_id, side, price, leaves_qty, *order);
+			}
+			allocation_orders_.push_back(order);
+			allocation_qtys_.push_back(order->qty_);
+			displayed_qty += order->qty_;
+			order = order->next_order_;
+		} while (order != price_level.first_order_);
+
+		// Only displayed quantity is allocated; icebergs refilled by the fills are split again on the next pass over the level.
+		allocation_fills_.resize(allocation_orders_.size());
+		Policy::allocate(allocation_orders_, allocation_qtys_, static_cast<models::quantity_t>(std::min<uint64_t>(leaves_qty, displayed_qty)), allocation_fills_, matching_);
+
+		// Filled orders may leave the level or move to its back, so the fills go through the snapshot taken above.
+		for (size_t i = 0; i < allocation_orders_.size(); ++i) {
+			if (allocation_fills_[i]) {
+				leaves_qty = fill(client_id, side, client_order_id, market_order_id, leaves_qty, allocation_fills_[i], *allocation_orders_[i]);
+			}
+		}
+
+		return leaves_qty;
+	}
+
+	auto order_book::prevent_self_trade(models::stp_mode_t stp_mode, models::client_id_t client_id, models::order_id_t client_order_id, models::order_id_t market_order_id, models::side_t side,
+		models::price_t price, models::quantity_t leaves_qty, models::order& resting_order) noexcept -> models::quantity_t
+	{
+		const auto cancel_incoming = [&](models::quantity_t canceled_qty) {
+			client_response_ = { models::client_response_type::CANCELED, client_id, instrument_id_, client_order_id, market_order_id, side, price, models::INVALID_QUANTITY, canceled_qty };
+			message_handler_->send_client_response(client_response_);
+		};
+
+		switch (stp_mode) {
+		case models::stp_mode_t::CANCEL_NEWEST:
+			cancel_incoming(leaves_qty);
+			return 0;
+		case models::stp_mode_t::CANCEL_OLDEST:
+			cancel_order(&resting_order);
+			return leaves_qty;
+		case models::stp_mode_t::CANCEL_BOTH:
+			cancel_order(&resting_order);
+			cancel_incoming(leaves_qty);
+			return 0;
+		default:
+			break;
+		}
+
+		// Decrement: both orders lose the smaller quantity and nothing trades. The resting order is only ever reduced by its displayed part.
+		const auto decrement = std::min(leaves_qty, resting_order.qty_);
+		if (decrement == resting_order.qty_ && !resting_order.hidden_qty_) {
+			cancel_order(&resting_order);
+		}
+		else {
+			resting_order.qty_ -= decrement;
+			get_price_level(resting_order.side_, resting_order.price_)->qty_ -= decrement;
+
+			client_response_ = { models::client_response_type::DECREMENTED, resting_order.client_id_, instrument_id_, resting_order.client_order_id_, resting_order.market_order_id_,
+				resting_order.side_, resting_order.price_, decrement, resting_order.qty_ + resting_order.hidden_qty_ };
+			message_handler_->send_client_response(client_response_);
+
+			if (!resting_order.qty_) {
+				replenish(resting_order);
+			}
+			else {
+				market_update_ = { models::market_update_type::MODIFY, resting_order.market_order_id_, instrument_id_, resting_order.side_, resting_order.price_, resting_order.qty_, resting_order.priority_ };
+				message_handler_->send_market_update(market_update_);
+			}
+		}
+
+		leaves_qty -= decrement;
+		if (!leaves_qty) {
+			cancel_incoming(decrement);
+			return 0;
+		}
+
+		client_response_ = { models::client_response_type::DECREMENTED, client_id, instrument_id_, client_order_id, market_order_id, side, price, decrement, leaves_qty };
+		message_handler_->send_client_response(client_response_);
+		return leaves_qty;
+	}
+
+	void order_book::add(models::client_id_t client_id, models::order_id_t client_order_id, models::side_t side, models::price_t price, models::quantity_t quantity,
+		models::order_type_t order_type, models::time_in_force_t time_in_force, models::price_t stop_price, models::quantity_t display_qty, models::stp_mode_t stp_mode,
+		uint64_t expire_time) noexcept {
+		if (client_id >= client_orders_.size()) [[unlikely]] {
+			client_orders_.resize(client_id + 1, models::order_map(models::MAX_NUM_ORDERS, nullptr));
+			client_order_lists_.resize(client_id + 1, nullptr);
+		}
+
 		const auto market_order_id = get_new_market_order_id();
 
 		client_response_ = {models::client_response_type::ACCEPTED, client_id, instrument_id_, client_order_id, market_order_id, side, price, 0, quantity};
 
 		message_handler_->send_client_response(client_response_);
 
-		START_MEASURE(Exchange_MEOrderBook_checkForMatch);
-		const auto leaves_qty = check_for_match(client_id, client_order_id, market_order_id, side, price, quantity);
-		END_MEASURE(Exchange_MEOrderBook_checkForMatch, (*logger_), time_str_);
+		if (order_type == models::order_type_t::STOP || order_type == models::order_type_t::STOP_LIMIT) [[unlikely]] {
+			add_stop({ client_id, client_order_id, market_order_id, side, stop_price, price, quantity,
+				order_type == models::order_type_t::STOP ? models::order_type_t::MARKET : models::order_type_t::LIMIT, time_in_force, display_qty, stp_mode, expire_time });
+		}
+		else {
+			execute(client_id, client_order_id, market_order_id, side, price, quantity, order_type, time_in_force, display_qty, stp_mode, expire_time);
+		}
+
+		if (is_triggered(buy_stops_) || is_triggered(sell_stops_)) [[unlikely]] {
+			trigger_stops();
+		}
+	}
 
-		if (leaves_qty > 0) [[likely]] {
-			const auto priority = get_order_priority_at_price_level(side, price);
+	auto order_book::execute(models::client_id_t client_id, models::order_id_t client_order_id, models::order_id_t market_order_id, models::side_t side, models::price_t price,
+		models::quantity_t quantity, models::order_type_t order_type, models::time_in_force_t time_in_force, models::quantity_t display_qty, models::stp_mode_t stp_mode,
+		uint64_t expire_time) noexcept -> void
+	{
+		const auto limit_price = order_type == models::order_type_t::MARKET ?
+			(side == models::side_t::BUY ? std::numeric_limits<models::price_t>::max() : std::numeric_limits<models::price_t>::min()) : price;
+
+		// Nothing matches during a call phase or a halt: limit orders rest for the uncross, immediate orders are canceled whole.
+		auto leaves_qty = quantity;
+		if (phase_ == models::trading_phase_t::CONTINUOUS) [[likely]] {
+			// The order is matched no further than the price band, so one priced through it never walks the book past it.
+			auto match_price = limit_price;
+			if (has_price_bands_) [[unlikely]] {
+				const auto band_limit = get_band_limit(side);
+				match_price = side == models::side_t::BUY ? std::min(limit_price, band_limit) : std::max(limit_price, band_limit);
+			}
 
-			auto order = order_pool_.alloc(instrument_id_, client_id, client_order_id, market_order_id, side, price, leaves_qty, priority, nullptr, nullptr);
+			if (time_in_force != models::time_in_force_t::FOK || available_qty(client_id, side, match_price, quantity, stp_mode) >= quantity) [[likely]] {
+				START_MEASURE(Exchange_MEOrderBook_checkForMatch);
+				leaves_qty = match_incoming(client_id, client_order_id, market_order_id, side, match_price, quantity, stp_mode);
+				END_MEASURE(Exchange_MEOrderBook_checkForMatch, (*logger_), time_str_);
+			}
 
-			START_MEASURE(Exchange_MEOrderBook_addOrder);
-			add_order(order);
-			END_MEASURE(Exchange_MEOrderBook_addOrder, (*logger_), time_str_);
+			if (match_price != limit_price && leaves_qty) [[unlikely]] {
+				const auto* opposite = side == models::side_t::BUY ? ask_ : bid_;
+				if (opposite && (side == models::side_t::BUY ? opposite->price_ <= limit_price : opposite->price_ >= limit_price)) {
+					trip_circuit_breaker(side, opposite->price_);
+				}
+			}
+		}
 
-			market_update_ = { models::market_update_type::ADD, market_order_id, instrument_id_, side, price, leaves_qty, priority };
-			message_handler_->send_market_update(market_update_);
+		if (!leaves_qty) {
+			return;
+		}
+
+		// Market and immediate orders never rest, so neither the order pool nor the client's order list is touched.
+		if (order_type == models::order_type_t::MARKET || time_in_force == models::time_in_force_t::IOC || time_in_force == models::time_in_force_t::FOK) [[unlikely]] {
+			client_response_ = { models::client_response_type::CANCELED, client_id, instrument_id_, client_order_id, market_order_id, side, price, models::INVALID_QUANTITY, leaves_qty };
+			message_handler_->send_client_response(client_response_);
+			return;
+		}
+
+		const auto priority = get_order_priority_at_price_level(side, price);
+
+		const auto displayed_qty = display_qty ? std::min(leaves_qty, display_qty) : leaves_qty;
+		auto order = order_pool_.alloc(instrument_id_, client_id, client_order_id, market_order_id, side, price, displayed_qty, priority, nullptr, nullptr);
+		order->display_qty_ = display_qty;
+		order->hidden_qty_ = leaves_qty - displayed_qty;
+
+		START_MEASURE(Exchange_MEOrderBook_addOrder);
+		add_order(order);
+		END_MEASURE(Exchange_MEOrderBook_addOrder, (*logger_), time_str_);
+
+		if (expire_time && expiries_) [[unlikely]] {
+			expiries_->schedule(order, (expire_time + EXPIRY_TICK - 1) / EXPIRY_TICK);
+		}
+
+		market_update_ = { models::market_update_type::ADD, market_order_id, instrument_id_, side, price, displayed_qty, priority };
+		message_handler_->send_market_update(market_update_);
+	}
+
+	auto order_book::add_stop(const models::stop_order& stop) noexcept -> void
+	{
+		// Inserted in front of the stops with the same stop price, so those that arrived earlier stay closer to the back.
+		auto& stops = stop.side_ == models::side_t::BUY ? buy_stops_ : sell_stops_;
+		const auto position = std::lower_bound(stops.begin(), stops.end(), stop.stop_price_, [side = stop.side_](const models::stop_order& entry, models::price_t stop_price) {
+			return side == models::side_t::BUY ? entry.stop_price_ > stop_price : entry.stop_price_ < stop_price;
+		});
+		stops.insert(position, stop);
+	}
+
+	auto order_book::trigger_stops() noexcept -> void
+	{
+		// A triggered stop may trade and reach further stops, so the index is checked again after each one. Buys go before sells.
+		while (true) {
+			auto* stops = is_triggered(buy_stops_) ? &buy_stops_ : is_triggered(sell_stops_) ? &sell_stops_ : nullptr;
+			if (!stops) {
+				break;
+			}
+
+			const auto stop = stops->back();
+			stops->pop_back();
+
+			client_response_ = { models::client_response_type::TRIGGERED, stop.client_id_, instrument_id_, stop.client_order_id_, stop.market_order_id_, stop.side_, stop.stop_price_, 0, stop.qty_ };
+			message_handler_->send_client_response(client_response_);
+
+			execute(stop.client_id_, stop.client_order_id_, stop.market_order_id_, stop.side_, stop.price_, stop.qty_, stop.order_type_, stop.time_in_force_, stop.display_qty_, stop.stp_mode_, stop.expire_time_);
+		}
+	}
+
+	auto order_book::cancel_stop(models::client_id_t client_id, models::order_id_t client_order_id) noexcept -> bool
+	{
+		for (auto* stops : { &buy_stops_, &sell_stops_ }) {
+			const auto stop = std::ranges::find_if(*stops, [&](const models::stop_order& entry) {
+				return entry.client_id_ == client_id && entry.client_order_id_ == client_order_id;
+			});
+			if (stop != stops->end()) {
+				client_response_ = { models::client_response_type::CANCELED, client_id, instrument_id_, client_order_id, stop->market_order_id_, stop->side_, stop->price_, models::INVALID_QUANTITY, stop->qty_ };
+				stops->erase(stop);
+				message_handler_->send_client_response(client_response_);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	auto order_book::cancel_stops(models::client_id_t client_id, models::side_t side) noexcept -> models::quantity_t
+	{
+		models::quantity_t canceled = 0;
+		for (auto* stops : { &buy_stops_, &sell_stops_ }) {
+			std::erase_if(*stops, [&](const models::stop_order& stop) {
+				if (stop.client_id_ != client_id || (side != models::side_t::INVALID && stop.side_ != side)) {
+					return false;
+				}
+				client_response_ = { models::client_response_type::CANCELED, client_id, instrument_id_, stop.client_order_id_, stop.market_order_id_, stop.side_, stop.price_, models::INVALID_QUANTITY, stop.qty_ };
+				message_handler_->send_client_response(client_response_);
+				++canceled;
+				return true;
+			});
 		}
+		return canceled;
+	}
+
+	auto order_book::available_qty(models::client_id_t client_id, models::side_t side, models::price_t price, models::quantity_t needed, models::stp_mode_t stp_mode) const noexcept -> models::quantity_t
+	{
+		// Walks the opposite side's levels from the best price, stopping as soon as enough is found.
+		const auto* best = side == models::side_t::BUY ? ask_ : bid_;
+		uint64_t available = 0;
+		for (const auto* level = best; level && available < needed; level = level->next_entry_ == best ? nullptr : level->next_entry_) {
+			if (side == models::side_t::BUY ? level->price_ > price : level->price_ < price) {
+				break;
+			}
+			if (stp_mode == models::stp_mode_t::NONE) [[likely]] {
+				available += level->qty_;
+				continue;
+			}
+
+			uint64_t others = 0;
+			uint64_t displayed_before_own = 0;
+			bool has_own = false;
+			const auto* order = level->first_order_;
+			do {
+				if (order->client_id_ == client_id) {
+					has_own = true;
+				}
+				else {
+					others += order->qty_ + order->hidden_qty_;
+					displayed_before_own += has_own ? 0 : order->qty_;
+				}
+				order = order->next_order_;
+			} while (order != level->first_order_);
+
+			if (!has_own || stp_mode == models::stp_mode_t::CANCEL_OLDEST) {
+				available += others;
+				continue;
+			}
+
+			// FIFO trades the peaks in front of the client's order first; an iceberg refilled on the way goes behind it.
+			// The other policies deal with the client's order before splitting the level.
+			if (matching_.policy_ == matching_policy_t::FIFO) {
+				available += displayed_before_own;
+			}
+			break;
+		}
+		return static_cast<models::quantity_t>(std::min<uint64_t>(available, needed));
 	}
 
 	auto order_book::cancel(models::client_id_t client_id, models::order_id_t client_order_id) noexcept -> void
@@ -123,22 +482,53 @@ namespace kse::engine {
 			is_cancelable = order != nullptr;
 		}
 
+		if (!is_cancelable && cancel_stop(client_id, client_order_id)) [[unlikely]] {
+			return;
+		}
+
 		if(!is_cancelable) [[unlikely]] {
 			client_response_ = { models::client_response_type::CANCEL_REJECTED, client_id, instrument_id_, client_order_id, models::INVALID_ORDER_ID, models::side_t::INVALID, models::INVALID_PRICE, models::INVALID_QUANTITY, models::INVALID_QUANTITY};
 			message_handler_->send_client_response(client_response_);
 		}
 		else {
-			client_response_ = { models::client_response_type::CANCELED, client_id, instrument_id_, client_order_id, order->market_order_id_, order->side_, order->price_, models::INVALID_QUANTITY, order->qty_ };
-			market_update_ = { models::market_update_type::CANCEL, order->market_order_id_, instrument_id_, order->side_, order->price_, 0, order->priority_ };
-			START_MEASURE(Exchange_MEOrderBook_removeOrder);
-			remove_order(order);
-			END_MEASURE(Exchange_MEOrderBook_removeOrder, (*logger_), time_str_);
-			message_handler_->send_client_response(client_response_);
-			message_handler_->send_market_update(market_update_);
+			cancel_order(order);
 		}
 	}
 
-	auto order_book::modify(models::client_id_t client_id, models::order_id_t client_order_id, models::price_t new_price, models::quantity_t new_quantity) noexcept -> void
+	auto order_book::cancel_order(models::order* order) noexcept -> void
+	{
+		client_response_ = { models::client_response_type::CANCELED, order->client_id_, instrument_id_, order->client_order_id_, order->market_order_id_, order->side_, order->price_, models::INVALID_QUANTITY, order->qty_ + order->hidden_qty_ };
+		market_update_ = { models::market_update_type::CANCEL, order->market_order_id_, instrument_id_, order->side_, order->price_, 0, order->priority_ };
+		START_MEASURE(Exchange_MEOrderBook_removeOrder);
+		remove_order(order);
+		END_MEASURE(Exchange_MEOrderBook_removeOrder, (*logger_), time_str_);
+		message_handler_->send_client_response(client_response_);
+		message_handler_->send_market_update(market_update_);
+	}
+
+	auto order_book::mass_cancel(models::client_id_t client_id, models::side_t side) noexcept -> models::quantity_t
+	{
+		auto canceled = cancel_stops(client_id, side);
+		if (client_id >= client_order_lists_.size() || !client_order_lists_[client_id]) {
+			return canceled;
+		}
+
+		// One lap around the list. Removing an order only unlinks that order, so its successor is read first.
+		auto* order = client_order_lists_[client_id];
+		const auto* last = order->prev_client_order_;
+		for (auto done = false; !done;) {
+			auto* next = order->next_client_order_;
+			done = order == last;
+			if (side == models::side_t::INVALID || order->side_ == side) {
+				cancel_order(order);
+				++canceled;
+			}
+			order = next;
+		}
+		return canceled;
+	}
+
+	auto order_book::modify(models::client_id_t client_id, models::order_id_t client_order_id, models::price_t new_price, models::quantity_t new_quantity, models::stp_mode_t stp_mode) noexcept -> void
 	{
 		auto is_modifiable = client_id < client_orders_.size();
 		models::order* order = nullptr;
@@ -153,11 +543,16 @@ namespace kse::engine {
 			client_response_ = { models::client_response_type::MODIFY_REJECTED, client_id, instrument_id_, client_order_id, models::INVALID_ORDER_ID, models::side_t::INVALID, models::INVALID_PRICE, models::INVALID_QUANTITY, models::INVALID_QUANTITY };
 			message_handler_->send_client_response(client_response_);
 		}
-		else if(order->price_ != new_price || order->qty_ < new_quantity ) {
+		else if(order->price_ != new_price || order->qty_ < new_quantity || order->hidden_qty_) {
+			// Icebergs with a reserve left are always replaced, keeping their peak size; the replacement keeps the expiry too.
+			const auto side = order->side_;
+			const auto display_qty = order->display_qty_;
+			const auto expire_time = order->timer_slot_ != utils::INVALID_TIMER_SLOT ? order->timer_tick_ * EXPIRY_TICK : 0;
 			cancel(client_id, client_order_id);
-			add(client_id, client_order_id, order->side_, new_price, new_quantity);
+			add(client_id, client_order_id, side, new_price, new_quantity, models::order_type_t::LIMIT, models::time_in_force_t::GTC, models::INVALID_PRICE, display_qty, stp_mode, expire_time);
 		}
 		else {
+			get_price_level(order->side_, order->price_)->qty_ -= order->qty_ - new_quantity;
 			order->qty_ = new_quantity;
 
 			client_response_ = { models::client_response_type::MODIFIED, client_id, instrument_id_, client_order_id, order->market_order_id_, order->side_, new_price, 0 , new_quantity };
@@ -168,6 +563,348 @@ namespace kse::engine {
 		}
 	}
 
+	auto order_book::quote(models::client_id_t client_id, models::order_id_t client_order_id, models::side_t side, models::price_t price, models::quantity_t quantity, models::stp_mode_t stp_mode) noexcept -> void
+	{
+		const auto* order = find_order(client_id, client_order_id);
+		if (order && order->side_ == side) {
+			modify(client_id, client_order_id, price, quantity, stp_mode);
+			return;
+		}
+
+		if (order) [[unlikely]] {
+			cancel(client_id, client_order_id);
+		}
+		add(client_id, client_order_id, side, price, quantity, models::order_type_t::LIMIT, models::time_in_force_t::GTC, models::INVALID_PRICE, models::INVALID_QUANTITY, stp_mode);
+	}
+
+	auto order_book::start_auction() noexcept -> void
+	{
+		phase_ = models::trading_phase_t::AUCTION;
+		last_indicative_ = {};
+		publish_trading_status(models::INVALID_PRICE);
+	}
+
+	auto order_book::trip_circuit_breaker(models::side_t side, models::price_t breach_price) noexcept -> void
+	{
+		logger_->log("%:% %() % Circuit breaker instrument:% side:% breach:% band_limit:% last_trade:%\n", __FILE__, __LINE__, __func__, utils::get_curren_time_str(&time_str_),
+			models::instrument_id_to_string(instrument_id_), models::side_to_string(side), models::price_to_string(breach_price),
+			models::price_to_string(get_band_limit(side)), models::price_to_string(last_trade_price_));
+
+		phase_ = matching_.breach_phase_;
+		last_indicative_ = {};
+		publish_trading_status(breach_price);
+	}
+
+	auto order_book::publish_trading_status(models::price_t breach_price) noexcept -> void
+	{
+		market_update_ = { models::market_update_type::TRADING_STATUS, models::INVALID_ORDER_ID, instrument_id_, models::side_t::INVALID, breach_price,
+			static_cast<models::quantity_t>(phase_), models::INVALID_PRIORITY };
+		message_handler_->send_market_update(market_update_);
+	}
+
+	auto order_book::find_uncross() noexcept -> uncross_result
+	{
+		if (!bid_ || !ask_ || bid_->price_ < ask_->price_) {
+			return {};
+		}
+
+		// The ladder is every level price between the best ask and the best bid; nothing outside that range can trade.
+		auction_prices_.clear();
+		for (const auto* level = ask_; level && level->price_ <= bid_->price_; level = level->next_entry_ == ask_ ? nullptr : level->next_entry_) {
+			auction_prices_.push_back(level->price_);
+		}
+		for (const auto* level = bid_; level && level->price_ >= ask_->price_; level = level->next_entry_ == bid_ ? nullptr : level->next_entry_) {
+			auction_prices_.push_back(level->price_);
+		}
+		std::ranges::sort(auction_prices_);
+		auction_prices_.erase(std::unique(auction_prices_.begin(), auction_prices_.end()), auction_prices_.end());
+
+		const auto num_prices = auction_prices_.size();
+		auction_bid_volumes_.resize(num_prices);
+		auction_ask_volumes_.resize(num_prices);
+		for (size_t i = 0; i < num_prices; ++i) {
+			const auto* bid_level = get_price_level(models::side_t::BUY, auction_prices_[i]);
+			const auto* ask_level = get_price_level(models::side_t::SELL, auction_prices_[i]);
+			auction_bid_volumes_[i] = bid_level ? bid_level->qty_ : 0;
+			auction_ask_volumes_[i] = ask_level ? ask_level->qty_ : 0;
+		}
+
+		// Buyers take any price up to their limit and sellers any price down to theirs, so demand accumulates from the top and supply from the bottom.
+		std::inclusive_scan(auction_bid_volumes_.rbegin(), auction_bid_volumes_.rend(), auction_bid_volumes_.rbegin());
+		std::inclusive_scan(auction_ask_volumes_.begin(), auction_ask_volumes_.end(), auction_ask_volumes_.begin());
+
+		const auto distance_to_last_trade = [this](models::price_t price) {
+			return last_trade_price_ == models::INVALID_PRICE ? 0 : std::abs(price - last_trade_price_);
+		};
+
+		size_t best = 0;
+		uint64_t best_volume = 0;
+		uint64_t best_surplus = 0;
+		for (size_t i = 0; i < num_prices; ++i) {
+			const auto volume = std::min(auction_bid_volumes_[i], auction_ask_volumes_[i]);
+			const auto surplus = std::max(auction_bid_volumes_[i], auction_ask_volumes_[i]) - volume;
+			if (volume > best_volume || (volume == best_volume && (surplus < best_surplus ||
+				(surplus == best_surplus && distance_to_last_trade(auction_prices_[i]) < distance_to_last_trade(auction_prices_[best]))))) {
+				best = i;
+				best_volume = volume;
+				best_surplus = surplus;
+			}
+		}
+
+		const auto surplus_side = auction_bid_volumes_[best] > auction_ask_volumes_[best] ? models::side_t::BUY :
+			auction_ask_volumes_[best] > auction_bid_volumes_[best] ? models::side_t::SELL : models::side_t::INVALID;
+		return { auction_prices_[best], static_cast<models::quantity_t>(best_volume), surplus_side, static_cast<models::quantity_t>(best_surplus) };
+	}
+
+	auto order_book::publish_indicative() noexcept -> void
+	{
+		const auto indicative = find_uncross();
+		if (indicative == last_indicative_) {
+			return;
+		}
+		last_indicative_ = indicative;
+
+		market_update_ = { models::market_update_type::INDICATIVE, models::INVALID_ORDER_ID, instrument_id_, indicative.surplus_side_, indicative.price_, indicative.volume_, indicative.surplus_qty_ };
+		message_handler_->send_market_update(market_update_);
+	}
+
+	auto order_book::uncross() noexcept -> void
+	{
+		const auto result = find_uncross();
+
+		// Every buy at or above the price and every sell at or below it is in the volume, so the fronts of both sides are always eligible.
+		for (auto remaining = result.volume_; remaining;) {
+			auto* bid_order = bid_->first_order_;
+			auto* ask_order = ask_->first_order_;
+			const auto quantity = std::min({ remaining, bid_order->qty_, ask_order->qty_ });
+
+			market_update_ = { models::market_update_type::TRADE, models::INVALID_ORDER_ID, instrument_id_, models::side_t::INVALID, result.price_, quantity, models::INVALID_PRIORITY };
+			message_handler_->send_market_update(market_update_);
+
+			fill_in_auction(*bid_order, quantity, result.price_);
+			fill_in_auction(*ask_order, quantity, result.price_);
+			remaining -= quantity;
+		}
+
+		if (result.volume_) {
+			last_trade_price_ = result.price_;
+		}
+		phase_ = models::trading_phase_t::CONTINUOUS;
+		publish_trading_status(models::INVALID_PRICE);
+
+		if (is_triggered(buy_stops_) || is_triggered(sell_stops_)) [[unlikely]] {
+			trigger_stops();
+		}
+	}
+
+	auto order_book::fill_in_auction(models::order& order, models::quantity_t quantity, models::price_t price) noexcept -> void
+	{
+		const auto old_qty = order.qty_;
+		order.qty_ -= quantity;
+		get_price_level(order.side_, order.price_)->qty_ -= quantity;
+
+		client_response_ = { models::client_response_type::FILLED, order.client_id_, instrument_id_, order.client_order_id_, order.market_order_id_, order.side_, price, quantity, order.qty_ + order.hidden_qty_ };
+		message_handler_->send_client_response(client_response_);
+
+		if (!order.qty_ && order.hidden_qty_) {
+			replenish(order);
+		}
+		else if (!order.qty_) {
+			market_update_ = { models::market_update_type::CANCEL, order.market_order_id_, instrument_id_, order.side_, order.price_, old_qty, order.priority_ };
+			message_handler_->send_market_update(market_update_);
+			remove_order(&order);
+		}
+		else {
+			market_update_ = { models::market_update_type::MODIFY, order.market_order_id_, instrument_id_, order.side_, order.price_, order.qty_, order.priority_ };
+			message_handler_->send_market_update(market_update_);
+		}
+	}
+
+	auto order_book::state_hash(uint64_t hash) const noexcept -> uint64_t {
+		const auto mix = [&hash](const auto& value) {
+			hash = utils::fnv1a(&value, sizeof(value), hash);
+		};
+
+		mix(instrument_id_);
+		for (const auto* best : { bid_, ask_ }) {
+			if (!best) {
+				mix(models::INVALID_PRICE);
+				continue;
+			}
+			const auto* level = best;
+			do {
+				mix(level->price_);
+				mix(level->qty_);
+				const auto* order = level->first_order_;
+				do {
+					mix(order->client_id_);
+					mix(order->client_order_id_);
+					mix(order->market_order_id_);
+					mix(order->side_);
+					mix(order->qty_);
+					mix(order->hidden_qty_);
+					mix(order->display_qty_);
+					mix(order->priority_);
+					mix(order->timer_slot_ == utils::INVALID_TIMER_SLOT ? uint64_t{ 0 } : order->timer_tick_);
+					order = order->next_order_;
+				} while (order != level->first_order_);
+				level = level->next_entry_;
+			} while (level != best);
+		}
+
+		for (const auto* stops : { &buy_stops_, &sell_stops_ }) {
+			mix(stops->size());
+			for (const auto& stop : *stops) {
+				mix(stop.client_id_);
+				mix(stop.client_order_id_);
+				mix(stop.market_order_id_);
+				mix(stop.stop_price_);
+				mix(stop.price_);
+				mix(stop.qty_);
+				mix(stop.order_type_);
+				mix(stop.time_in_force_);
+				mix(stop.expire_time_);
+			}
+		}
+
+		mix(phase_);
+		mix(last_trade_price_);
+		mix(next_market_order_id_);
+		return hash;
+	}
+
+	auto order_book::checkpoint_size() const noexcept -> size_t {
+		size_t num_orders = 0;
+		for (const auto* client_order_list : client_order_lists_) {
+			if (!client_order_list) {
+				continue;
+			}
+			const auto* order = client_order_list;
+			do {
+				++num_orders;
+				order = order->next_client_order_;
+			} while (order != client_order_list);
+		}
+
+		return sizeof(book_checkpoint_header) + num_orders * (sizeof(checkpoint_order) + sizeof(checkpoint_client_order)) +
+			(buy_stops_.size() + sell_stops_.size()) * sizeof(models::stop_order);
+	}
+
+	auto order_book::write_checkpoint(char* out) const noexcept -> size_t {
+		auto* cursor = out + sizeof(book_checkpoint_header);
+		const auto put = [&cursor](const auto& value) {
+			std::memcpy(cursor, &value, sizeof(value));
+			cursor += sizeof(value);
+		};
+
+		book_checkpoint_header header{ instrument_id_, phase_, last_trade_price_, next_market_order_id_, last_indicative_.price_, last_indicative_.volume_,
+			last_indicative_.surplus_side_, last_indicative_.surplus_qty_, 0, static_cast<uint32_t>(buy_stops_.size()), static_cast<uint32_t>(sell_stops_.size()) };
+
+		for (const auto* best : { bid_, ask_ }) {
+			if (!best) {
+				continue;
+			}
+			const auto* level = best;
+			do {
+				const auto* order = level->first_order_;
+				do {
+					put(checkpoint_order{ order->client_id_, order->client_order_id_, order->market_order_id_, order->side_, order->price_, order->qty_,
+						order->hidden_qty_, order->display_qty_, order->priority_, order->timer_slot_ == utils::INVALID_TIMER_SLOT ? 0 : order->timer_tick_ });
+					++header.num_orders_;
+					order = order->next_order_;
+				} while (order != level->first_order_);
+				level = level->next_entry_;
+			} while (level != best);
+		}
+
+		for (const auto* stops : { &buy_stops_, &sell_stops_ }) {
+			for (const auto& stop : *stops) {
+				put(stop);
+			}
+		}
+
+		for (const auto* client_order_list : client_order_lists_) {
+			if (!client_order_list) {
+				continue;
+			}
+			const auto* order = client_order_list;
+			do {
+				put(checkpoint_client_order{ order->client_id_, order->client_order_id_ });
+				order = order->next_client_order_;
+			} while (order != client_order_list);
+		}
+
+		std::memcpy(out, &header, sizeof(header));
+		return static_cast<size_t>(cursor - out);
+	}
+
+	auto order_book::restore_checkpoint(const char* in, size_t size) noexcept -> bool {
+		book_checkpoint_header header;
+		if (size < sizeof(header) || bid_ || ask_ || !buy_stops_.empty() || !sell_stops_.empty()) {
+			return false;
+		}
+		std::memcpy(&header, in, sizeof(header));
+		if (header.instrument_id_ != instrument_id_ || header.num_orders_ > models::MAX_NUM_ORDERS ||
+			size != sizeof(header) + header.num_orders_ * (sizeof(checkpoint_order) + sizeof(checkpoint_client_order)) +
+				(static_cast<size_t>(header.num_buy_stops_) + header.num_sell_stops_) * sizeof(models::stop_order)) {
+			return false;
+		}
+
+		const auto* cursor = in + sizeof(header);
+		const auto get = [&cursor](auto& value) {
+			std::memcpy(&value, cursor, sizeof(value));
+			cursor += sizeof(value);
+		};
+
+		phase_ = header.phase_;
+		last_trade_price_ = header.last_trade_price_;
+		next_market_order_id_ = header.next_market_order_id_;
+		last_indicative_ = { header.indicative_price_, header.indicative_volume_, header.indicative_surplus_side_, header.indicative_surplus_qty_ };
+
+		// Orders come level by level in time order, so appending each one to its level restores the queue priorities.
+		for (uint32_t i = 0; i < header.num_orders_; ++i) {
+			checkpoint_order entry;
+			get(entry);
+			if (entry.client_order_id_ >= models::MAX_NUM_ORDERS || (entry.side_ != models::side_t::BUY && entry.side_ != models::side_t::SELL)) {
+				return false;
+			}
+			if (entry.client_id_ >= client_orders_.size()) {
+				client_orders_.resize(entry.client_id_ + 1, models::order_map(models::MAX_NUM_ORDERS, nullptr));
+				client_order_lists_.resize(entry.client_id_ + 1, nullptr);
+			}
+
+			auto* order = order_pool_.alloc(instrument_id_, entry.client_id_, entry.client_order_id_, entry.market_order_id_, entry.side_, entry.price_, entry.qty_,
+				entry.priority_, nullptr, nullptr);
+			order->display_qty_ = entry.display_qty_;
+			order->hidden_qty_ = entry.hidden_qty_;
+			add_order(order);
+
+			if (entry.expiry_tick_ && expiries_) {
+				expiries_->schedule(order, entry.expiry_tick_);
+			}
+		}
+
+		for (auto* stops : { &buy_stops_, &sell_stops_ }) {
+			stops->resize(stops == &buy_stops_ ? header.num_buy_stops_ : header.num_sell_stops_);
+			for (auto& stop : *stops) {
+				get(stop);
+			}
+		}
+
+		// add_order() linked the client lists in book order; relink them in the order they were recorded.
+		std::fill(client_order_lists_.begin(), client_order_lists_.end(), nullptr);
+		for (uint32_t i = 0; i < header.num_orders_; ++i) {
+			checkpoint_client_order entry;
+			get(entry);
+			auto* order = entry.client_order_id_ < models::MAX_NUM_ORDERS ? find_order(entry.client_id_, entry.client_order_id_) : nullptr;
+			if (!order) {
+				return false;
+			}
+			link_client_order(order);
+		}
+		return true;
+	}
+
 	auto order_book::to_string(bool detailed, bool validity_check) const -> std::string {
 		std::stringstream ss;
 
@@ -2,8 +2,10 @@
 
 #include <array>
 #include <functional>
+#include <limits>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "models/constants.hpp"
 #include "models/client_response.hpp"
@@ -12,15 +14,35 @@
 
 #include "utils/logger.hpp"
 #include "utils/memory_pool.hpp"
+#include "utils/timer_wheel.hpp"
 #include "utils/utils.hpp"
 
+#include "checkpoint.hpp"
+#include "matching_policy.hpp"
 #include "message_handler.hpp"
 
 
 namespace kse::engine {
+	/// Expiry timers of resting DAY, GTD and GTT orders, shared by the order books of one matching engine.
+	using expiry_wheel = utils::timer_wheel<models::order>;
+
+	/// Resolution of the expiry wheel.
+	constexpr utils::nananoseconds_t EXPIRY_TICK = utils::NANOS_PER_MILLIS;
+
+	/// Where a call phase would uncross: the price that matches the most volume and what would be left over there.
+	struct uncross_result {
+		models::price_t price_ = models::INVALID_PRICE; //INVALID_PRICE while the book is not crossed
+		models::quantity_t volume_ = 0;
+		models::side_t surplus_side_ = models::side_t::INVALID;
+		models::quantity_t surplus_qty_ = 0;
+
+		auto operator==(const uncross_result&) const -> bool = default;
+	};
+
 	class order_book {
 	public:
-		explicit order_book(models::instrument_id_t instrument_id, utils::logger* logger, message_handler* message_handler);
+		explicit order_book(models::instrument_id_t instrument_id, utils::logger* logger, message_handler* message_handler, const matching_params& matching = {},
+			expiry_wheel* expiries = nullptr);
 
 		~order_book();
 
@@ -30,9 +52,49 @@ namespace kse::engine {
 		order_book& operator=(const order_book&) = delete;
 		order_book& operator=(order_book&&) = delete;
 
-		auto add(models::client_id_t client_id, models::order_id_t client_order_id, models::side_t side, models::price_t price, models::quantity_t quantity) noexcept -> void;
+		auto add(models::client_id_t client_id, models::order_id_t client_order_id, models::side_t side, models::price_t price, models::quantity_t quantity,
+			models::order_type_t order_type = models::order_type_t::LIMIT, models::time_in_force_t time_in_force = models::time_in_force_t::GTC,
+			models::price_t stop_price = models::INVALID_PRICE, models::quantity_t display_qty = models::INVALID_QUANTITY, models::stp_mode_t stp_mode = models::stp_mode_t::NONE,
+			uint64_t expire_time = 0) noexcept -> void;
 		auto cancel(models::client_id_t client_id, models::order_id_t client_order_id) noexcept -> void;
-		auto modify(models::client_id_t client_id, models::order_id_t client_order_id, models::price_t price, models::quantity_t quantity) noexcept -> void;
+		auto modify(models::client_id_t client_id, models::order_id_t client_order_id, models::price_t price, models::quantity_t quantity,
+			models::stp_mode_t stp_mode = models::stp_mode_t::NONE) noexcept -> void;
+		/// Cancels every resting order and pending stop of the client, or only those on one side, by walking the client's own order list. Returns the number canceled.
+		auto mass_cancel(models::client_id_t client_id, models::side_t side) noexcept -> models::quantity_t;
+		/// Mass quote side: modifies the client's live order with this id, or adds it if there is none. A live order on the other side is replaced.
+		auto quote(models::client_id_t client_id, models::order_id_t client_order_id, models::side_t side, models::price_t price, models::quantity_t quantity,
+			models::stp_mode_t stp_mode = models::stp_mode_t::NONE) noexcept -> void;
+		/// Starts a call phase: from now on orders rest without matching, and immediate orders are canceled.
+		auto start_auction() noexcept -> void;
+		/// Ends the call phase: executes everything that crosses at the equilibrium price in one pass and resumes continuous trading.
+		auto uncross() noexcept -> void;
+		/**
+		 * Equilibrium of the resting orders: the price with the most executable volume, then the smallest surplus, then the one closest to the last trade.
+		 * Cumulative buy and sell volumes are prefix sums over the crossed part of the price ladder, kept in contiguous arrays.
+		 */
+		auto find_uncross() noexcept -> uncross_result;
+		/// Publishes an INDICATIVE market update if the equilibrium changed since the last one.
+		auto publish_indicative() noexcept -> void;
+		auto in_auction() const noexcept -> bool { return phase_ == models::trading_phase_t::AUCTION; }
+		/// Cancels a resting order whose expiry timer fired; the wheel has already unlinked it.
+		auto expire(models::order* order) noexcept -> void { cancel_order(order); }
+		/// Replays an expiry from the journal: cancels the client's order if it is still resting.
+		auto expire(models::client_id_t client_id, models::order_id_t client_order_id) noexcept -> void {
+			if (auto* order = find_order(client_id, client_order_id)) {
+				cancel_order(order);
+			}
+		}
+		/// Extends `hash` over everything that decides how the book trades next: resting orders in priority order, pending stops, phase and last trade.
+		auto state_hash(uint64_t hash) const noexcept -> uint64_t;
+		/// Bytes write_checkpoint() needs for the book as it is now.
+		auto checkpoint_size() const noexcept -> size_t;
+		/// Writes the book's section of a checkpoint (see checkpoint.hpp) and returns its size.
+		auto write_checkpoint(char* out) const noexcept -> size_t;
+		/**
+		 * Rebuilds an empty book from its checkpoint section: orders are allocated from the pool again and linked into their price levels,
+		 * client order lists and the expiry wheel in the recorded order. Returns false, with the book in an unspecified state, if the section does not fit this book.
+		 */
+		auto restore_checkpoint(const char* in, size_t size) noexcept -> bool;
 		auto to_string(bool verbose = false, bool validity_check=true) const -> std::string;
 
 		auto get_client_response() const noexcept -> const models::client_response_internal& { return client_response_; }
@@ -43,11 +105,12 @@ namespace kse::engine {
 		message_handler* message_handler_ = nullptr;
 
 		models::client_order_map client_orders_{ };
+		std::vector<models::order*> client_order_lists_; //indexed by client id, any one of the client's resting orders or nullptr
 
 		utils::memory_pool<models::price_level> price_level_pool_;
 		models::price_level *bid_ = nullptr;
 		models::price_level *ask_ = nullptr;
-		models::order_at_price_level_map price_levels_{};
+		std::array<models::order_at_price_level_map, 2> price_levels_{}; //bids, then asks; a crossed book in a call phase has both at one price
 
 		utils::memory_pool<models::order> order_pool_;
 		models::client_response_internal client_response_;
@@ -55,12 +118,100 @@ namespace kse::engine {
 
 		models::order_id_t next_market_order_id_ = 1;
 
+		models::stop_order_index buy_stops_; //trigger when a trade prints at or above the stop price
+		models::stop_order_index sell_stops_; //trigger when a trade prints at or below the stop price
+		models::price_t last_trade_price_ = models::INVALID_PRICE;
+
+		models::trading_phase_t phase_ = models::trading_phase_t::CONTINUOUS;
+		std::vector<models::price_t> auction_prices_; //scratch space of find_uncross(), reserved once
+		std::vector<uint64_t> auction_bid_volumes_;
+		std::vector<uint64_t> auction_ask_volumes_;
+		uncross_result last_indicative_;
+
+		matching_params matching_;
+		bool has_price_bands_ = false;
+		expiry_wheel* expiries_ = nullptr; //nullptr if orders never expire
+		std::vector<models::order*> allocation_orders_; //scratch space of the pro-rata and LMM policies: one price level in time order
+		std::vector<models::quantity_t> allocation_qtys_;
+		std::vector<models::quantity_t> allocation_fills_;
+
 		std::string time_str_;
 		utils::logger* logger_ = nullptr;
 	
 	private:
 		auto match(models::client_id_t client_id, models::side_t side, models::order_id_t client_order_id, models::order_id_t market_order_id, models::quantity_t leaves_qty, models::order& order_to_match_with) noexcept -> models::quantity_t;
-		auto check_for_match(models::client_id_t client_id, models::order_id_t client_order_id, models::order_id_t new_market_order_id, models::side_t side, models::price_t price, models::quantity_t qty) noexcept -> models::quantity_t;
+		/// Trades exactly `matched_qty` of the incoming order with a resting order. Returns the incoming order's leaves.
+		auto fill(models::client_id_t client_id, models::side_t side, models::order_id_t client_order_id, models::order_id_t market_order_id, models::quantity_t leaves_qty,
+			models::quantity_t matched_qty, models::order& order_to_match_with) noexcept -> models::quantity_t;
+		auto cancel_order(models::order* order) noexcept -> void;
+		/// Matches an accepted order and rests what is left, unless it is a market or immediate order. An iceberg rests with only its peak displayed.
+		auto execute(models::client_id_t client_id, models::order_id_t client_order_id, models::order_id_t market_order_id, models::side_t side, models::price_t price,
+			models::quantity_t quantity, models::order_type_t order_type, models::time_in_force_t time_in_force, models::quantity_t display_qty, models::stp_mode_t stp_mode,
+			uint64_t expire_time) noexcept -> void;
+		/// Refills an iceberg whose peak was just taken from its reserve and sends it to the back of its price level.
+		auto replenish(models::order& order) noexcept -> void;
+		auto add_stop(const models::stop_order& stop) noexcept -> void;
+		/// Executes the stops the last trade reached, one at a time, until no stop is triggered.
+		auto trigger_stops() noexcept -> void;
+		auto cancel_stop(models::client_id_t client_id, models::order_id_t client_order_id) noexcept -> bool;
+		auto cancel_stops(models::client_id_t client_id, models::side_t side) noexcept -> models::quantity_t;
+		/// Stops continuous trading after an order on this side would have traded at breach_price, outside the price band.
+		auto trip_circuit_breaker(models::side_t side, models::price_t breach_price) noexcept -> void;
+		auto publish_trading_status(models::price_t breach_price) noexcept -> void;
+		/// Fills a resting order at the uncross price and publishes what is left of it.
+		auto fill_in_auction(models::order& order, models::quantity_t quantity, models::price_t price) noexcept -> void;
+		/**
+		 * Quantity an incoming order of the client could trade up to price, capped at needed. With self-trade prevention on,
+		 * the client's own orders never trade: cancel oldest steps over them, and the other modes stop where matching would meet one.
+		 */
+		auto available_qty(models::client_id_t client_id, models::side_t side, models::price_t price, models::quantity_t needed, models::stp_mode_t stp_mode) const noexcept -> models::quantity_t;
+		/// Runs the matching loop specialised for the instrument's policy.
+		auto match_incoming(models::client_id_t client_id, models::order_id_t client_order_id, models::order_id_t new_market_order_id, models::side_t side, models::price_t price, models::quantity_t qty,
+			models::stp_mode_t stp_mode) noexcept -> models::quantity_t;
+		template<typename Policy>
+		auto check_for_match(models::client_id_t client_id, models::order_id_t client_order_id, models::order_id_t new_market_order_id, models::side_t side, models::price_t price, models::quantity_t qty,
+			models::stp_mode_t stp_mode) noexcept -> models::quantity_t;
+		/**
+		 * Splits what the incoming order takes from one price level among the level's orders with the policy, then fills them in time order.
+		 * A level holding an order of the same client only gets self-trade prevention applied against it; the caller comes back for the rest.
+		 */
+		template<typename Policy>
+		auto allocate_level(models::client_id_t client_id, models::order_id_t client_order_id, models::order_id_t market_order_id, models::side_t side, models::price_t price,
+			models::quantity_t leaves_qty, models::stp_mode_t stp_mode, models::price_level& price_level) noexcept -> models::quantity_t;
+		/// Applies the incoming order's self-trade prevention mode against a resting order of the same client. Returns the incoming order's leaves, 0 once it is canceled.
+		auto prevent_self_trade(models::stp_mode_t stp_mode, models::client_id_t client_id, models::order_id_t client_order_id, models::order_id_t market_order_id, models::side_t side,
+			models::price_t price, models::quantity_t leaves_qty, models::order& resting_order) noexcept -> models::quantity_t;
+
+		auto find_order(models::client_id_t client_id, models::order_id_t client_order_id) const noexcept -> models::order* {
+			return client_id < client_orders_.size() ? client_orders_.at(client_id).at(client_order_id) : nullptr;
+		}
+
+		/// Only the back of the index is looked at, so books without stops pay one empty() check per order.
+		auto is_triggered(const models::stop_order_index& stops) const noexcept -> bool {
+			if (stops.empty() || last_trade_price_ == models::INVALID_PRICE) [[likely]] {
+				return false;
+			}
+			const auto& next = stops.back();
+			return next.side_ == models::side_t::BUY ? last_trade_price_ >= next.stop_price_ : last_trade_price_ <= next.stop_price_;
+		}
+
+		/**
+		 * The furthest price an order on this side may trade at: the tighter of the static band around the reference price
+		 * and the dynamic band around the last trade. Only the side an aggressor sweeps towards is bounded.
+		 */
+		auto get_band_limit(models::side_t side) const noexcept -> models::price_t {
+			auto limit = side == models::side_t::BUY ? std::numeric_limits<models::price_t>::max() : std::numeric_limits<models::price_t>::min();
+			const auto tighten = [&](models::price_t centre, uint32_t band_bps) {
+				if (!band_bps || centre == models::INVALID_PRICE) {
+					return;
+				}
+				const auto width = centre * static_cast<models::price_t>(band_bps) / 10000;
+				limit = side == models::side_t::BUY ? std::min(limit, centre + width) : std::max(limit, centre - width);
+			};
+			tighten(matching_.reference_price_, matching_.static_band_bps_);
+			tighten(last_trade_price_, matching_.dynamic_band_bps_);
+			return limit;
+		}
 
 		auto get_new_market_order_id() noexcept -> models::order_id_t { 
 			return next_market_order_id_++; 
@@ -71,17 +222,17 @@ namespace kse::engine {
 		}
 
 		auto get_price_level(models::side_t side, models::price_t price) const noexcept -> models::price_level* { 
-			auto* price_level = price_levels_.at(price_to_index(price));
+			auto* price_level = price_levels_[side == models::side_t::BUY ? 0 : 1].at(price_to_index(price));
 			return price_level && price_level->side_ == side ? price_level : nullptr;
 		}
 
 		auto get_order_priority_at_price_level(models::side_t side, models::price_t price) const noexcept -> models::priority_t {
 			const auto* orders_at_price_level = get_price_level(side, price);
-			return orders_at_price_level ? orders_at_price_level->first_order_->priority_ + 1 : 1;
+			return orders_at_price_level ? orders_at_price_level->first_order_->prev_order_->priority_ + 1 : 1;
 		}
 
 		auto add_price_level(models::price_level* new_price_level) noexcept -> void {
-			price_levels_.at(price_to_index(new_price_level->price_)) = new_price_level;
+			price_levels_[new_price_level->side_ == models::side_t::BUY ? 0 : 1].at(price_to_index(new_price_level->price_)) = new_price_level;
 
 			auto*& best_price_level = new_price_level->side_ == models::side_t::BUY ? bid_ : ask_;
 			
@@ -152,12 +303,12 @@ namespace kse::engine {
 				orders_at_price_level->next_entry_ = orders_at_price_level->prev_entry_ = nullptr;
 			}
 
-			price_levels_.at(price_to_index(price)) = nullptr;
+			price_levels_[side == models::side_t::BUY ? 0 : 1].at(price_to_index(price)) = nullptr;
 			price_level_pool_.free(orders_at_price_level);
 		}
 
 		auto add_order(models::order* order) noexcept -> void { 
-			const auto* orders_at_price_level = get_price_level(order->side_, order->price_);
+			auto* orders_at_price_level = get_price_level(order->side_, order->price_);
 
 			if (!orders_at_price_level) {
 				order->next_order_ = order->prev_order_ = order;
@@ -168,6 +319,7 @@ namespace kse::engine {
 			}
 			else {
 				utils::DEBUG_ASSERT(orders_at_price_level->side_ == order->side_, "Side mismatch");
+				orders_at_price_level->qty_ += order->qty_ + order->hidden_qty_;
 				auto* old_last_order_at_price_level = orders_at_price_level->first_order_->prev_order_;
 				old_last_order_at_price_level->next_order_ = order;
 				order->prev_order_ = old_last_order_at_price_level;
@@ -176,11 +328,31 @@ namespace kse::engine {
 			}
 
 			client_orders_.at(order->client_id_).at(order->client_order_id_) = order;
+			link_client_order(order);
+		}
+
+		/// Appends an order to the end of its client's order list.
+		auto link_client_order(models::order* order) noexcept -> void {
+			auto*& client_order_list = client_order_lists_.at(order->client_id_);
+			if (!client_order_list) {
+				order->prev_client_order_ = order->next_client_order_ = order;
+				client_order_list = order;
+			}
+			else {
+				order->next_client_order_ = client_order_list;
+				order->prev_client_order_ = client_order_list->prev_client_order_;
+				client_order_list->prev_client_order_->next_client_order_ = order;
+				client_order_list->prev_client_order_ = order;
+			}
 		}
 
 		auto remove_order(models::order* order) noexcept -> void {
 			auto* orders_at_price_level = get_price_level(order->side_, order->price_);
 
+			if (order->timer_slot_ != utils::INVALID_TIMER_SLOT) [[unlikely]] {
+				expiries_->cancel(order);
+			}
+
 			if (order->prev_order_ == order) {
 				remove_price_level(order->side_, order->price_);
 			}
@@ -188,6 +360,8 @@ namespace kse::engine {
 				const auto order_before = order->prev_order_;
 				const auto order_after = order->next_order_;
 
+				orders_at_price_level->qty_ -= order->qty_ + order->hidden_qty_;
+
 				order_before->next_order_ = order_after;
 				order_after->prev_order_ = order_before;
 
@@ -199,6 +373,20 @@ namespace kse::engine {
 			}
 
 			client_orders_.at(order->client_id_).at(order->client_order_id_) = nullptr;
+
+			auto*& client_order_list = client_order_lists_.at(order->client_id_);
+			if (order->next_client_order_ == order) {
+				client_order_list = nullptr;
+			}
+			else {
+				order->prev_client_order_->next_client_order_ = order->next_client_order_;
+				order->next_client_order_->prev_client_order_ = order->prev_client_order_;
+				if (client_order_list == order) {
+					client_order_list = order->next_client_order_;
+				}
+			}
+			order->prev_client_order_ = order->next_client_order_ = nullptr;
+
 			order_pool_.free(order);
 		}
 
@@ -0,0 +1,70 @@
+#include "replication.hpp"
+
+#include "request_journal.hpp"
+
+auto kse::engine::standby_replica::connect(std::string_view name, const std::string& journal_directory, uint64_t applied_sequence_number) -> std::unique_ptr<standby_replica>
+{
+	auto segment = utils::shared_memory_segment::open(name, sizeof(replication_layout));
+	if (!segment) {
+		return nullptr;
+	}
+
+	auto* layout = static_cast<replication_layout*>(segment->data());
+	if (layout->magic_ != REPLICATION_SEGMENT_MAGIC) {
+		return nullptr;
+	}
+	return std::unique_ptr<standby_replica>(new standby_replica(std::move(segment), layout, journal_directory, applied_sequence_number));
+}
+
+kse::engine::standby_replica::standby_replica(std::unique_ptr<utils::shared_memory_segment> segment, replication_layout* layout, const std::string& journal_directory,
+	uint64_t applied_sequence_number) noexcept :
+	segment_{ std::move(segment) }, layout_{ layout }, journal_directory_{ journal_directory }, applied_sequence_number_{ applied_sequence_number }
+{
+}
+
+kse::engine::standby_replica::~standby_replica() = default;
+
+auto kse::engine::standby_replica::next() noexcept -> const journal_record*
+{
+	while (true) {
+		if (catch_up_) [[unlikely]] {
+			const auto* record = catch_up_->next();
+			if (record && record->sequence_number_ <= catch_up_to_) {
+				if (record->sequence_number_ != applied_sequence_number_ + 1) [[unlikely]] {
+					utils::FATAL("Standby expected record " + std::to_string(applied_sequence_number_ + 1) + " but " + journal_directory_ +
+						" continues at " + std::to_string(record->sequence_number_));
+				}
+				applied_sequence_number_ = record->sequence_number_;
+				layout_->standby_sequence_number_.store(applied_sequence_number_, std::memory_order_release);
+				return record;
+			}
+			if (applied_sequence_number_ < catch_up_to_) {
+				utils::FATAL("Standby lost records " + std::to_string(applied_sequence_number_ + 1) + " to " + std::to_string(catch_up_to_) +
+					": they are neither in the replication ring nor in " + journal_directory_);
+			}
+			catch_up_.reset();
+		}
+
+		const auto* slot = layout_->records_.get_next_read_element();
+		if (!slot) {
+			return nullptr;
+		}
+
+		// Everything the ring dropped was appended to the journal files before the record that follows the gap.
+		if (slot->sequence_number_ > applied_sequence_number_ + 1) [[unlikely]] {
+			catch_up_ = std::make_unique<journal_reader>(journal_directory_, applied_sequence_number_ + 1);
+			catch_up_to_ = slot->sequence_number_ - 1;
+			continue;
+		}
+
+		record_ = *slot;
+		layout_->records_.next_read_index();
+		if (record_.sequence_number_ <= applied_sequence_number_) {
+			continue;
+		}
+
+		applied_sequence_number_ = record_.sequence_number_;
+		layout_->standby_sequence_number_.store(applied_sequence_number_, std::memory_order_release);
+		return &record_;
+	}
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "journal_record.hpp"
+
+#include "utils/shared_memory.hpp"
+#include "utils/utils.hpp"
+
+
+namespace kse::engine {
+	constexpr std::string_view DEFAULT_REPLICATION_SEGMENT_NAME = "kse_replication";
+	constexpr size_t REPLICATION_RING_SIZE = 64 * 1024;
+	constexpr uint64_t REPLICATION_SEGMENT_MAGIC = 0x4B53455245504C32; //"KSEREPL2", bumped whenever the layout changes
+	constexpr utils::nananoseconds_t DEFAULT_FAILOVER_TIMEOUT = 500 * utils::NANOS_PER_MILLIS;
+	constexpr utils::nananoseconds_t HEARTBEAT_INTERVAL = 10 * utils::NANOS_PER_MILLIS;
+
+	/// Shared memory between a primary and its standby: the journal records as the primary appends them, and both sides' progress.
+	struct replication_layout {
+		uint64_t magic_ = REPLICATION_SEGMENT_MAGIC;
+		std::atomic<int64_t> primary_pid_ = 0; //0 once the primary shut down
+		alignas(64) std::atomic<uint64_t> primary_sequence_number_ = 0; //last record the primary appended
+		std::atomic<utils::nananoseconds_t> primary_heartbeat_ = 0; //monotonic clock, beaten by the publisher's heartbeat thread
+		alignas(64) std::atomic<uint64_t> standby_sequence_number_ = 0; //last record the standby applied
+
+		utils::shm_spsc_ring<journal_record, REPLICATION_RING_SIZE> records_;
+	};
+
+	/**
+	 * Primary side of journal replication. The request journal hands it every record it appends; a record the ring has
+	 * no room for is dropped, never waited for, and the standby reads it from the journal files instead.
+	 * The heartbeat has a thread of its own that does no I/O, so a slow disk does not look like a dead primary.
+	 */
+	class replication_publisher {
+	public:
+		/// Returns nullptr if the segment cannot be created.
+		static auto create(std::string_view name) -> std::unique_ptr<replication_publisher> {
+			auto segment = utils::shared_memory_segment::create(name, sizeof(replication_layout));
+			if (!segment) {
+				return nullptr;
+			}
+			auto* layout = new (segment->data()) replication_layout{};
+			layout->primary_pid_.store(utils::get_process_id(), std::memory_order_release);
+			layout->primary_heartbeat_.store(utils::get_monotonic_timestamp(), std::memory_order_release);
+			return std::unique_ptr<replication_publisher>(new replication_publisher(std::move(segment), layout));
+		}
+
+		/// A clean shutdown clears the primary's pid, so the standby takes over as soon as the heartbeat goes stale.
+		~replication_publisher() {
+			running_.store(false, std::memory_order_release);
+			if (heartbeat_thread_.joinable()) {
+				heartbeat_thread_.join();
+			}
+			layout_->primary_pid_.store(0, std::memory_order_release);
+		}
+
+		replication_publisher(const replication_publisher&) = delete;
+		replication_publisher& operator=(const replication_publisher&) = delete;
+
+		/// Matching engine thread.
+		auto publish(const journal_record& record) noexcept -> void {
+			if (auto* slot = layout_->records_.get_next_write_element()) [[likely]] {
+				*slot = record;
+				layout_->records_.next_write_index();
+			}
+			layout_->primary_sequence_number_.store(record.sequence_number_, std::memory_order_release);
+		}
+
+		/// How far the standby is behind.
+		auto lag() const noexcept -> uint64_t {
+			return layout_->primary_sequence_number_.load(std::memory_order_acquire) - layout_->standby_sequence_number_.load(std::memory_order_acquire);
+		}
+
+	private:
+		replication_publisher(std::unique_ptr<utils::shared_memory_segment> segment, replication_layout* layout) noexcept
+			: segment_{ std::move(segment) }, layout_{ layout } {
+			heartbeat_thread_ = utils::create_thread(-1, [this]() { run_heartbeat(); });
+		}
+
+		auto run_heartbeat() noexcept -> void {
+			while (running_.load(std::memory_order_acquire)) {
+				layout_->primary_heartbeat_.store(utils::get_monotonic_timestamp(), std::memory_order_release);
+				std::this_thread::sleep_for(std::chrono::nanoseconds{ HEARTBEAT_INTERVAL });
+			}
+		}
+
+		std::unique_ptr<utils::shared_memory_segment> segment_;
+		replication_layout* layout_ = nullptr;
+
+		std::atomic<bool> running_ = true;
+		std::jthread heartbeat_thread_;
+	};
+
+	class journal_reader;
+
+	/**
+	 * Standby side of journal replication: yields the primary's records in sequence. When the standby fell behind by more
+	 * than the ring, the records the ring dropped are read from the primary's journal files, which are on the same host.
+	 */
+	class standby_replica {
+	public:
+		/// Attaches to the primary's segment, continuing after applied_sequence_number. Returns nullptr if no primary is running.
+		static auto connect(std::string_view name, const std::string& journal_directory, uint64_t applied_sequence_number) -> std::unique_ptr<standby_replica>;
+
+		~standby_replica();
+
+		standby_replica(const standby_replica&) = delete;
+		standby_replica& operator=(const standby_replica&) = delete;
+
+		/// The record after the last one returned, or nullptr if the primary has not appended it yet. It stays valid until the next call.
+		auto next() noexcept -> const journal_record*;
+
+		auto applied_sequence_number() const noexcept -> uint64_t { return applied_sequence_number_; }
+
+		auto lag() const noexcept -> uint64_t {
+			return layout_->primary_sequence_number_.load(std::memory_order_acquire) - applied_sequence_number_;
+		}
+
+		/**
+		 * Whether the primary's heartbeat is younger than the timeout, or its process still runs. A primary that stalls
+		 * without exiting keeps its journal, so it is never taken over.
+		 */
+		auto primary_alive(utils::nananoseconds_t timeout) const noexcept -> bool {
+			if (utils::get_monotonic_timestamp() - layout_->primary_heartbeat_.load(std::memory_order_acquire) < timeout) [[likely]] {
+				return true;
+			}
+			const auto pid = layout_->primary_pid_.load(std::memory_order_acquire);
+			return pid && utils::is_process_alive(pid);
+		}
+
+	private:
+		standby_replica(std::unique_ptr<utils::shared_memory_segment> segment, replication_layout* layout, const std::string& journal_directory,
+			uint64_t applied_sequence_number) noexcept;
+
+		std::unique_ptr<utils::shared_memory_segment> segment_;
+		replication_layout* layout_ = nullptr;
+		std::string journal_directory_;
+
+		uint64_t applied_sequence_number_ = 0;
+		journal_record record_;
+
+		std::unique_ptr<journal_reader> catch_up_; //open while reading records the ring dropped
+		uint64_t catch_up_to_ = 0;
+	};
+}
@@ -0,0 +1,302 @@
+#include "request_journal.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <system_error>
+#include <utility>
+
+namespace {
+	constexpr std::string_view SEGMENT_PREFIX = "kse_journal_";
+	constexpr std::string_view SEGMENT_SUFFIX = ".seg";
+
+	auto segment_path(const std::string& directory, uint64_t index) -> std::string {
+		return (std::filesystem::path{ directory } / (std::string{ SEGMENT_PREFIX } + std::to_string(index) + std::string{ SEGMENT_SUFFIX })).string();
+	}
+
+	/// Segment files of a journal directory by index.
+	auto list_segments(const std::string& directory) -> std::vector<std::pair<uint64_t, std::string>> {
+		std::vector<std::pair<uint64_t, std::string>> segments;
+		std::error_code error;
+		for (const auto& entry : std::filesystem::directory_iterator{ directory, error }) {
+			const auto name = entry.path().filename().string();
+			if (name.size() <= SEGMENT_PREFIX.size() + SEGMENT_SUFFIX.size() || !name.starts_with(SEGMENT_PREFIX) || !name.ends_with(SEGMENT_SUFFIX)) {
+				continue;
+			}
+			const auto digits = name.substr(SEGMENT_PREFIX.size(), name.size() - SEGMENT_PREFIX.size() - SEGMENT_SUFFIX.size());
+			if (!std::all_of(digits.begin(), digits.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+				continue;
+			}
+			segments.emplace_back(std::stoull(digits), entry.path().string());
+		}
+		std::sort(segments.begin(), segments.end());
+		return segments;
+	}
+
+	auto header_of(const kse::utils::mapped_file& file) noexcept -> kse::engine::journal_segment_header {
+		kse::engine::journal_segment_header header;
+		std::memcpy(&header, file.data(), sizeof(header));
+		return header;
+	}
+
+	auto write_header(const kse::engine::journal_segment& segment) noexcept -> void {
+		const kse::engine::journal_segment_header header{ kse::engine::JOURNAL_SEGMENT_MAGIC, segment.index_, segment.first_sequence_number_ };
+		std::memcpy(segment.file_->data(), &header, sizeof(header));
+	}
+
+	/// Number of valid records at the start of a segment.
+	auto count_records(const kse::utils::mapped_file& file, uint64_t first_sequence_number) noexcept -> size_t {
+		const auto capacity = (file.size() - kse::engine::JOURNAL_HEADER_SIZE) / sizeof(kse::engine::journal_record);
+		size_t count = 0;
+		for (; count < capacity; ++count) {
+			const auto* record = reinterpret_cast<const kse::engine::journal_record*>(file.data() + kse::engine::JOURNAL_HEADER_SIZE + count * sizeof(kse::engine::journal_record));
+			if (record->sequence_number_ != first_sequence_number + count || record->checksum_ != record->compute_checksum()) {
+				break;
+			}
+		}
+		return count;
+	}
+}
+
+auto kse::engine::request_journal::open(const journal_config& config) -> std::unique_ptr<request_journal>
+{
+	if (config.directory_.empty() || config.segment_size_ < JOURNAL_HEADER_SIZE + sizeof(journal_record)) {
+		return nullptr;
+	}
+
+	std::error_code error;
+	std::filesystem::create_directories(config.directory_, error);
+	if (error) {
+		return nullptr;
+	}
+
+	// The tail is the last segment that was ever written to. Spares the flusher prepared but the engine never reached are dropped.
+	std::unique_ptr<utils::mapped_file> tail;
+	for (const auto& [index, path] : list_segments(config.directory_)) {
+		auto file = utils::mapped_file::open(path, true);
+		if (!file || file->size() < JOURNAL_HEADER_SIZE) {
+			return nullptr;
+		}
+
+		const auto header = header_of(*file);
+		if (header.magic_ == 0) {
+			file.reset();
+			std::filesystem::remove(path, error);
+			continue;
+		}
+		if (header.magic_ != JOURNAL_SEGMENT_MAGIC || header.record_size_ != sizeof(journal_record) || header.segment_index_ != index) {
+			return nullptr;
+		}
+		tail = std::move(file);
+	}
+
+	auto active = std::make_unique<journal_segment>();
+	size_t next_record = 0;
+	uint64_t next_sequence_number = 1;
+	if (tail) {
+		const auto header = header_of(*tail);
+		next_record = count_records(*tail, header.first_sequence_number_);
+		next_sequence_number = header.first_sequence_number_ + next_record;
+		active->index_ = header.segment_index_;
+		active->first_sequence_number_ = header.first_sequence_number_;
+
+		// A tail sized for another segment size is closed and the journal continues in a new one.
+		if (tail->size() == config.segment_size_) {
+			active->file_ = std::move(tail);
+		}
+		else {
+			++active->index_;
+		}
+	}
+
+	if (!active->file_) {
+		active->file_ = utils::mapped_file::create(segment_path(config.directory_, active->index_), config.segment_size_);
+		if (!active->file_) {
+			return nullptr;
+		}
+		active->first_sequence_number_ = next_sequence_number;
+		next_record = 0;
+		write_header(*active);
+	}
+
+	return std::unique_ptr<request_journal>(new request_journal(config, std::move(active), next_record, next_sequence_number));
+}
+
+kse::engine::request_journal::request_journal(const journal_config& config, std::unique_ptr<journal_segment> active, size_t next_record, uint64_t next_sequence_number) :
+	config_{ config }, records_per_segment_{ (config.segment_size_ - JOURNAL_HEADER_SIZE) / sizeof(journal_record) }, next_record_{ next_record },
+	next_sequence_number_{ next_sequence_number }, committed_sequence_number_{ next_sequence_number - 1 }, durable_sequence_number_{ next_sequence_number - 1 },
+	next_segment_index_{ active->index_ + 1 }
+{
+	active_ = active.release();
+	published_active_.store(active_, std::memory_order_release);
+	flusher_ = utils::create_thread(-1, [this]() { run_flusher(); });
+}
+
+kse::engine::request_journal::~request_journal()
+{
+	running_.store(false, std::memory_order_release);
+	if (flusher_.joinable()) {
+		flusher_.join();
+	}
+
+	commit();
+	if (auto* retired = retired_.exchange(nullptr)) {
+		if (config_.sync_policy_ == journal_sync_policy::BATCHED) {
+			sync(*retired, retired->first_sequence_number_ + records_per_segment_ - 1);
+		}
+		delete retired;
+	}
+	if (config_.sync_policy_ == journal_sync_policy::BATCHED) {
+		sync(*active_, committed_sequence_number());
+	}
+	delete active_;
+
+	// A spare that was never written to is removed, the same way open() drops it.
+	if (auto* spare = spare_.exchange(nullptr)) {
+		spare->file_.reset();
+		std::error_code error;
+		std::filesystem::remove(segment_path(config_.directory_, spare->index_), error);
+		delete spare;
+	}
+}
+
+auto kse::engine::request_journal::roll() noexcept -> void
+{
+	commit();
+
+	journal_segment* spare = nullptr;
+	while (!(spare = spare_.exchange(nullptr, std::memory_order_acq_rel))) {
+		std::this_thread::yield();
+	}
+	while (retired_.load(std::memory_order_acquire)) {
+		std::this_thread::yield();
+	}
+
+	spare->first_sequence_number_ = next_sequence_number_;
+	write_header(*spare);
+
+	retired_.store(active_, std::memory_order_release);
+	active_ = spare;
+	published_active_.store(active_, std::memory_order_release);
+	next_record_ = 0;
+}
+
+auto kse::engine::request_journal::run_flusher() noexcept -> void
+{
+	const auto batched = config_.sync_policy_ == journal_sync_policy::BATCHED;
+	while (running_.load(std::memory_order_acquire)) {
+		if (!spare_.load(std::memory_order_acquire)) {
+			auto spare = std::make_unique<journal_segment>();
+			spare->index_ = next_segment_index_;
+			spare->file_ = utils::mapped_file::create(segment_path(config_.directory_, spare->index_), config_.segment_size_);
+			if (!spare->file_) {
+				utils::FATAL("Failed to create journal segment " + segment_path(config_.directory_, spare->index_));
+			}
+			++next_segment_index_;
+			spare_.store(spare.release(), std::memory_order_release);
+		}
+
+		// The active segment is loaded before the retired one: a roll in between retires the segment just loaded, and its tail
+		// has to be synced before anything in the next segment can be. The flusher is the only thread that frees segments.
+		auto* active = published_active_.load(std::memory_order_acquire);
+		if (auto* retired = retired_.load(std::memory_order_acquire)) {
+			if (batched) {
+				sync(*retired, retired->first_sequence_number_ + records_per_segment_ - 1);
+			}
+			if (retired == active) {
+				active = nullptr;
+			}
+			delete retired;
+			retired_.store(nullptr, std::memory_order_release);
+		}
+
+		if (batched && active) {
+			sync(*active, committed_sequence_number());
+		}
+		std::this_thread::sleep_for(std::chrono::nanoseconds{ config_.sync_interval_ });
+	}
+}
+
+auto kse::engine::request_journal::sync(const journal_segment& segment, uint64_t last_sequence_number) noexcept -> void
+{
+	const auto durable = durable_sequence_number_.load(std::memory_order_relaxed);
+	last_sequence_number = std::min(last_sequence_number, segment.first_sequence_number_ + records_per_segment_ - 1);
+	if (last_sequence_number < segment.first_sequence_number_ || last_sequence_number <= durable) {
+		return;
+	}
+
+	// A segment's first sync also covers its header.
+	const auto from = std::max(durable + 1, segment.first_sequence_number_);
+	const auto offset = from == segment.first_sequence_number_ ? 0 : JOURNAL_HEADER_SIZE + (from - segment.first_sequence_number_) * sizeof(journal_record);
+	const auto end = JOURNAL_HEADER_SIZE + (last_sequence_number - segment.first_sequence_number_ + 1) * sizeof(journal_record);
+	if (segment.file_->sync(offset, end - offset)) {
+		durable_sequence_number_.store(last_sequence_number, std::memory_order_release);
+	}
+}
+
+auto kse::engine::request_journal::checkpoint_path() const -> std::string
+{
+	return (std::filesystem::path{ config_.directory_ } / CHECKPOINT_FILE_NAME).string();
+}
+
+kse::engine::journal_reader::journal_reader(const std::string& directory, uint64_t first_sequence_number) :
+	first_sequence_number_{ first_sequence_number }
+{
+	for (auto& [index, path] : list_segments(directory)) {
+		paths_.push_back(std::move(path));
+	}
+}
+
+auto kse::engine::journal_reader::next() noexcept -> const journal_record*
+{
+	while (true) {
+		while (next_record_ == records_in_segment_) {
+			if (!open_segment()) {
+				return nullptr;
+			}
+		}
+
+		// A segment ends at its first invalid record; the journal goes on only if the next segment starts right after it.
+		const auto* record = reinterpret_cast<const journal_record*>(segment_->data() + JOURNAL_HEADER_SIZE + next_record_ * sizeof(journal_record));
+		if (record->sequence_number_ != next_sequence_number_ || record->checksum_ != record->compute_checksum()) {
+			records_in_segment_ = next_record_;
+			continue;
+		}
+
+		++next_record_;
+		++next_sequence_number_;
+		return record;
+	}
+}
+
+auto kse::engine::journal_reader::open_segment() noexcept -> bool
+{
+	segment_.reset();
+	records_in_segment_ = next_record_ = 0;
+	if (next_path_ == paths_.size()) {
+		return false;
+	}
+
+	segment_ = utils::mapped_file::open(paths_[next_path_++], false);
+	if (!segment_ || segment_->size() < JOURNAL_HEADER_SIZE) {
+		next_path_ = paths_.size();
+		return false;
+	}
+
+	const auto header = header_of(*segment_);
+	if (header.magic_ != JOURNAL_SEGMENT_MAGIC || header.record_size_ != sizeof(journal_record) ||
+		(next_sequence_number_ && header.first_sequence_number_ != next_sequence_number_)) {
+		next_path_ = paths_.size();
+		return false;
+	}
+
+	next_sequence_number_ = header.first_sequence_number_;
+	records_in_segment_ = (segment_->size() - JOURNAL_HEADER_SIZE) / sizeof(journal_record);
+
+	// Records are at fixed offsets, so the ones already covered by a checkpoint are skipped without reading them.
+	if (first_sequence_number_ > next_sequence_number_) {
+		next_record_ = static_cast<size_t>(std::min<uint64_t>(records_in_segment_, first_sequence_number_ - next_sequence_number_));
+		next_sequence_number_ += next_record_;
+	}
+	return true;
+}
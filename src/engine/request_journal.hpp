@@ -0,0 +1,189 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "models/client_request.hpp"
+
+#include "journal_record.hpp"
+#include "replication.hpp"
+
+#include "utils/mapped_file.hpp"
+#include "utils/utils.hpp"
+
+
+namespace kse::engine {
+	constexpr uint64_t JOURNAL_SEGMENT_MAGIC = 0x4B53454A524E4C31; //"KSEJRNL1", bumped whenever the record layout changes
+	constexpr size_t DEFAULT_JOURNAL_SEGMENT_SIZE = 64 * 1024 * 1024;
+	constexpr size_t JOURNAL_COMMIT_BATCH = 256;
+	constexpr uint64_t DEFAULT_CHECKPOINT_INTERVAL = 1'000'000;
+	constexpr std::string_view CHECKPOINT_FILE_NAME = "kse_checkpoint.bin";
+
+	enum class journal_sync_policy : uint8_t {
+		NONE = 0, //records reach the page cache only; they survive a crash of the exchange but not of the machine
+		BATCHED = 1 //the flusher thread also writes committed records to the disk every sync interval
+	};
+
+	struct journal_config {
+		std::string directory_; //empty disables the journal
+		size_t segment_size_ = DEFAULT_JOURNAL_SEGMENT_SIZE;
+		journal_sync_policy sync_policy_ = journal_sync_policy::NONE;
+		utils::nananoseconds_t sync_interval_ = utils::NANOS_PER_MILLIS; //also how often the flusher prepares segments
+		uint64_t checkpoint_interval_ = 0; //records between order book checkpoints written next to the segments, 0 for none
+	};
+
+	/// Start of every segment file; the records follow at JOURNAL_HEADER_SIZE.
+	struct journal_segment_header {
+		uint64_t magic_ = JOURNAL_SEGMENT_MAGIC;
+		uint64_t segment_index_ = 0;
+		uint64_t first_sequence_number_ = 0;
+		uint32_t record_size_ = sizeof(journal_record);
+	};
+
+	constexpr size_t JOURNAL_HEADER_SIZE = 64;
+	static_assert(sizeof(journal_segment_header) <= JOURNAL_HEADER_SIZE);
+
+	/// A mapped segment file and the range of sequence numbers it holds.
+	struct journal_segment {
+		std::unique_ptr<utils::mapped_file> file_;
+		uint64_t index_ = 0;
+		uint64_t first_sequence_number_ = 0;
+	};
+
+	/**
+	 * Append-only write-ahead journal of the requests the matching engine sequences, kept in preallocated memory-mapped
+	 * segment files named kse_journal_<index>.seg. Appending is a copy into the mapping, so a record survives a crash of
+	 * the exchange as soon as it is written. Records are committed in groups: commit() publishes everything appended so
+	 * far to a flusher thread, which under BATCHED writes the committed range to the disk every sync interval, and which
+	 * creates the next segment ahead of time and unmaps full ones, so the engine thread never touches the file system.
+	 *
+	 * append() and commit() belong to the matching engine thread.
+	 */
+	class request_journal {
+	public:
+		/// Opens the journal in config.directory_, continuing after its last valid record. Returns nullptr if it is disabled or cannot be opened.
+		static auto open(const journal_config& config) -> std::unique_ptr<request_journal>;
+
+		~request_journal();
+
+		request_journal(const request_journal&) = delete;
+		request_journal(request_journal&&) = delete;
+
+		request_journal& operator=(const request_journal&) = delete;
+		request_journal& operator=(request_journal&&) = delete;
+
+		/// Appends a request and returns its sequence number. Every JOURNAL_COMMIT_BATCH records are committed on the way.
+		auto append(const models::client_request_internal& request, utils::nananoseconds_t timestamp) noexcept -> uint64_t {
+			if (next_record_ == records_per_segment_) [[unlikely]] {
+				roll();
+			}
+
+			journal_record record{ next_sequence_number_, timestamp, request };
+			record.checksum_ = record.compute_checksum();
+			std::memcpy(active_->file_->data() + JOURNAL_HEADER_SIZE + next_record_ * sizeof(journal_record), &record, sizeof(journal_record));
+			++next_record_;
+			if (auto* replication = replication_.load(std::memory_order_relaxed)) {
+				replication->publish(record);
+			}
+
+			if (++uncommitted_ == JOURNAL_COMMIT_BATCH) [[unlikely]] {
+				commit();
+			}
+			return next_sequence_number_++;
+		}
+
+		/// Hands every appended record to the flusher. Cheap enough to call whenever the engine is idle.
+		auto commit() noexcept -> void {
+			if (uncommitted_) {
+				committed_sequence_number_.store(next_sequence_number_ - 1, std::memory_order_release);
+				uncommitted_ = 0;
+			}
+		}
+
+		auto next_sequence_number() const noexcept -> uint64_t { return next_sequence_number_; }
+		auto committed_sequence_number() const noexcept -> uint64_t { return committed_sequence_number_.load(std::memory_order_acquire); }
+
+		/// Last sequence number known to be on the disk; only advances under BATCHED.
+		auto durable_sequence_number() const noexcept -> uint64_t { return durable_sequence_number_.load(std::memory_order_acquire); }
+
+		/// Commits and, under BATCHED, waits for the flusher to write everything appended so far to the disk.
+		auto flush() noexcept -> void {
+			commit();
+			while (config_.sync_policy_ == journal_sync_policy::BATCHED && durable_sequence_number() < next_sequence_number_ - 1) {
+				std::this_thread::yield();
+			}
+		}
+
+		/// Whether checkpoint_interval_ records were appended since the last checkpoint.
+		auto checkpoint_due() const noexcept -> bool {
+			return config_.checkpoint_interval_ && next_sequence_number_ - 1 >= last_checkpoint_ + config_.checkpoint_interval_;
+		}
+		auto set_last_checkpoint(uint64_t sequence_number) noexcept -> void { last_checkpoint_ = sequence_number; }
+
+		/// Replicates every record appended from now on to a standby. nullptr stops it.
+		auto set_replication(replication_publisher* replication) noexcept -> void { replication_.store(replication, std::memory_order_release); }
+		auto checkpoint_path() const -> std::string;
+
+	private:
+		request_journal(const journal_config& config, std::unique_ptr<journal_segment> active, size_t next_record, uint64_t next_sequence_number);
+
+		/// Retires the full active segment to the flusher and continues in the spare it prepared.
+		auto roll() noexcept -> void;
+
+		auto run_flusher() noexcept -> void;
+		auto sync(const journal_segment& segment, uint64_t last_sequence_number) noexcept -> void;
+
+		journal_config config_;
+		size_t records_per_segment_ = 0;
+
+		//matching engine thread
+		journal_segment* active_ = nullptr;
+		size_t next_record_ = 0; //slot of the next record in the active segment
+		uint64_t next_sequence_number_ = 1;
+		size_t uncommitted_ = 0;
+		uint64_t last_checkpoint_ = 0; //sequence number the last checkpoint covers
+
+		//shared with the flusher, which owns every segment
+		std::atomic<journal_segment*> published_active_ = nullptr;
+		std::atomic<journal_segment*> spare_ = nullptr;
+		std::atomic<journal_segment*> retired_ = nullptr;
+		std::atomic<uint64_t> committed_sequence_number_ = 0;
+		std::atomic<uint64_t> durable_sequence_number_ = 0;
+		std::atomic<bool> running_ = true;
+		std::atomic<replication_publisher*> replication_ = nullptr;
+
+		//flusher thread
+		uint64_t next_segment_index_ = 0;
+
+		std::jthread flusher_;
+	};
+
+	/// Reads the records of a journal directory in sequence order, stopping at the first missing, torn or out of sequence record.
+	class journal_reader {
+	public:
+		/// Starts at first_sequence_number, skipping whole segments before it; the records before it are not checked.
+		explicit journal_reader(const std::string& directory, uint64_t first_sequence_number = 1);
+
+		/// The next record, or nullptr at the end of the journal. The record stays valid until the reader moves past its segment.
+		auto next() noexcept -> const journal_record*;
+
+	private:
+		auto open_segment() noexcept -> bool;
+
+		std::vector<std::string> paths_;
+		size_t next_path_ = 0;
+
+		std::unique_ptr<utils::mapped_file> segment_;
+		size_t records_in_segment_ = 0;
+		size_t next_record_ = 0;
+		uint64_t next_sequence_number_ = 0; //0 until the first segment, which may start anywhere
+		uint64_t first_sequence_number_ = 1;
+	};
+}
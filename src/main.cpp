@@ -2,12 +2,17 @@
 #include "market_data/market_data_publisher.hpp"
 #include "engine/matching_engine.hpp"
 
+#include <algorithm>
 #include <csignal>
+#include <filesystem>
 #include <iostream>
+#include <string_view>
 
 
 kse::utils::logger* logger = nullptr;
 kse::engine::matching_engine* matching_engine = nullptr;
+std::unique_ptr<kse::engine::request_journal> request_journal;
+std::unique_ptr<kse::engine::replication_publisher> replication;
 
 void signal_handler(int) {
 	using namespace std::literals::chrono_literals;
@@ -15,14 +20,18 @@ void signal_handler(int) {
 
 	delete logger; logger = nullptr;
 	delete matching_engine; matching_engine = nullptr;
+	request_journal.reset();
+	replication.reset();
 
 	std::this_thread::sleep_for(10s);
 
 	exit(EXIT_SUCCESS);
 }
 
-int main() {
-	logger = new kse::utils::logger("kse.log");
+/// Started with --standby, the exchange follows a primary on the same host and takes over when the primary's heartbeat stops and its process is gone.
+int main(int argc, char** argv) {
+	const bool standby = argc > 1 && std::string_view{ argv[1] } == "--standby";
+	logger = new kse::utils::logger(standby ? "kse_standby.log" : "kse.log");
 
 	std::signal(SIGINT, signal_handler);
 
@@ -34,12 +43,65 @@ int main() {
 
 	std::string time_str;
 
-	logger->log("%:% %() % Starting Matching Engine...\n", __FILE__, __LINE__, __func__, kse::utils::get_curren_time_str(&time_str));
+	kse::engine::journal_config journal_config;
+	journal_config.directory_ = "kse_journal";
+	journal_config.sync_policy_ = kse::engine::journal_sync_policy::BATCHED;
+	journal_config.checkpoint_interval_ = kse::engine::DEFAULT_CHECKPOINT_INTERVAL;
+	const auto checkpoint_path = (std::filesystem::path{ journal_config.directory_ } / kse::engine::CHECKPOINT_FILE_NAME).string();
+
+	logger->log("%:% %() % Creating Matching Engine...\n", __FILE__, __LINE__, __func__, kse::utils::get_curren_time_str(&time_str));
 	matching_engine = new kse::engine::matching_engine(&client_requests, &client_responses, &market_updates);
+
+	logger->log("%:% %() % Restoring Checkpoint and Replaying Request Journal...\n", __FILE__, __LINE__, __func__, kse::utils::get_curren_time_str(&time_str));
+	const auto checkpoint_sequence_number = matching_engine->restore_checkpoint(checkpoint_path);
+	auto applied_sequence_number = checkpoint_sequence_number;
+	{
+		kse::engine::journal_reader journal_reader{ journal_config.directory_, checkpoint_sequence_number + 1 };
+		const auto replayed = matching_engine->replay(journal_reader);
+		applied_sequence_number = std::max(applied_sequence_number, replayed.last_sequence_number_);
+		logger->log("%:% %() % Replayed % requests in %ns, state hash %\n", __FILE__, __LINE__, __func__, kse::utils::get_curren_time_str(&time_str),
+			replayed.requests_, replayed.elapsed_, replayed.state_hash_);
+	}
+
+	if (standby) {
+		using namespace std::literals::chrono_literals;
+
+		logger->log("%:% %() % Waiting for the Primary...\n", __FILE__, __LINE__, __func__, kse::utils::get_curren_time_str(&time_str));
+		auto replica = kse::engine::standby_replica::connect(kse::engine::DEFAULT_REPLICATION_SEGMENT_NAME, journal_config.directory_, applied_sequence_number);
+		while (!replica) {
+			std::this_thread::sleep_for(100ms);
+			replica = kse::engine::standby_replica::connect(kse::engine::DEFAULT_REPLICATION_SEGMENT_NAME, journal_config.directory_, applied_sequence_number);
+		}
+
+		applied_sequence_number = matching_engine->follow(*replica);
+		replica.reset();
+
+		// The primary may have journaled records it never got to replicate.
+		kse::engine::journal_reader journal_reader{ journal_config.directory_, applied_sequence_number + 1 };
+		const auto replayed = matching_engine->replay(journal_reader);
+		logger->log("%:% %() % Taking over from the Primary after % more requests, state hash %\n", __FILE__, __LINE__, __func__, kse::utils::get_curren_time_str(&time_str),
+			replayed.requests_, replayed.state_hash_);
+	}
+
+	logger->log("%:% %() % Opening Request Journal...\n", __FILE__, __LINE__, __func__, kse::utils::get_curren_time_str(&time_str));
+	request_journal = kse::engine::request_journal::open(journal_config);
+	if (!request_journal) {
+		kse::utils::FATAL("Failed to open the request journal");
+	}
+	request_journal->set_last_checkpoint(checkpoint_sequence_number);
+	matching_engine->set_journal(request_journal.get());
+
+	replication = kse::engine::replication_publisher::create(kse::engine::DEFAULT_REPLICATION_SEGMENT_NAME);
+	if (replication) {
+		request_journal->set_replication(replication.get());
+	}
+
+	logger->log("%:% %() % Starting Matching Engine...\n", __FILE__, __LINE__, __func__, kse::utils::get_curren_time_str(&time_str));
 	matching_engine->start();
 	
 	logger->log("%:% %() % Starting Order Server...\n", __FILE__, __LINE__, __func__, kse::utils::get_curren_time_str(&time_str));
-	auto& server = kse::server::order_server::get_instance(&client_requests, &client_responses, "0.0.0.0", 54321);
+	auto& server = kse::server::order_server::get_instance(&client_requests, &client_responses, "0.0.0.0", 54321, {}, {},
+		{}, {}, {}, kse::server::DEFAULT_SHM_SEGMENT_NAME, true);
 	server.start(); 
 
 	auto& market_updates_publisher = kse::market_data::market_data_publisher::get_instance(&market_updates, "233.252.14.1", 54322, "233.252.14.3", 54323);
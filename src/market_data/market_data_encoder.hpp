@@ -1,44 +1,24 @@
 #pragma once 
 
 #include "models/market_update.hpp"
-#include "utils/utils.hpp"
+#include "models/wire_codecs.hpp"
+#include "models/wire_v2.hpp"
 
 
 
 namespace kse::market_data {
     inline void serialize_client_market_update(const kse::models::client_market_update& update, char* buffer) {
-        size_t offset = 0;
-
-        uint64_t seq_number_be = kse::utils::to_big_endian_64(update.sequence_number_);
-        std::memcpy(&buffer[offset], &seq_number_be, sizeof(seq_number_be));
-        offset += sizeof(seq_number_be);
-
-        uint8_t type = static_cast<uint8_t>(update.update_.type_);
-        std::memcpy(&buffer[offset], &type, sizeof(type));
-        offset += sizeof(type);
-
-        uint64_t order_id_be = kse::utils::to_big_endian_64(update.update_.order_id_);
-        std::memcpy(&buffer[offset], &order_id_be, sizeof(order_id_be));
-        offset += sizeof(order_id_be);
-
-        uint8_t instrument_id = update.update_.instrument_id_;
-        std::memcpy(&buffer[offset], &instrument_id, sizeof(instrument_id));
-        offset += sizeof(instrument_id);
-
-        uint8_t side = static_cast<uint8_t>(update.update_.side_);
-        std::memcpy(&buffer[offset], &side, sizeof(side));
-        offset += sizeof(side);
-
-        int64_t price_be = kse::utils::to_big_endian_64(update.update_.price_);
-        std::memcpy(&buffer[offset], &price_be, sizeof(price_be));
-        offset += sizeof(price_be);
+        kse::models::client_market_update_codec::encode(update, buffer);
+    }
 
-        uint32_t qty_be = kse::utils::to_big_endian_32(update.update_.qty_);
-        std::memcpy(&buffer[offset], &qty_be, sizeof(qty_be));
-        offset += sizeof(qty_be);
+    /// Encodes an update with the given protocol version and returns the number of bytes written.
+    inline auto serialize_client_market_update(const kse::models::client_market_update& update, kse::models::protocol_version version,
+        const kse::models::reference_price_table& reference_prices, char* buffer) -> size_t {
+        if (version == kse::models::protocol_version::V2) {
+            return kse::models::encode_v2_market_update(update, reference_prices, buffer);
+        }
 
-        uint64_t priority_be = kse::utils::to_big_endian_64(update.update_.priority_);
-        std::memcpy(&buffer[offset], &priority_be, sizeof(priority_be));
-        offset += sizeof(priority_be);
+        serialize_client_market_update(update, buffer);
+        return kse::models::client_market_update_codec::size;
     }
-}
\ No newline at end of file
+}
@@ -5,6 +5,7 @@
 #include "snapshot_synthesizer.hpp"
 
 #include "models/market_update.hpp"
+#include "models/wire_v2.hpp"
 
 #include <cstdint>
 
@@ -16,8 +17,9 @@ namespace kse::market_data
 	class market_data_publisher
 	{
 	public:
-		static market_data_publisher& get_instance(models::market_update_queue* market_updates = nullptr, const std::string& snapshot_ip = "", int snapshot_port = 0, const std::string& incremental_ip = "", int incremental_port = 0) {
-			static market_data_publisher instance(market_updates, snapshot_ip, snapshot_port, incremental_ip, incremental_port);
+		static market_data_publisher& get_instance(models::market_update_queue* market_updates = nullptr, const std::string& snapshot_ip = "", int snapshot_port = 0, const std::string& incremental_ip = "", int incremental_port = 0,
+			models::protocol_version version = models::protocol_version::V1, const models::reference_price_table& reference_prices = {}) {
+			static market_data_publisher instance(market_updates, snapshot_ip, snapshot_port, incremental_ip, incremental_port, version, reference_prices);
 			return instance;
 		}
 
@@ -34,6 +36,9 @@ namespace kse::market_data
 		std::string ip_;
 		int port_;
 
+		models::protocol_version protocol_version_ = models::protocol_version::V1;
+		models::reference_price_table reference_prices_{};
+
 		models::market_update_queue* outgoing_market_update_queue_{ nullptr };
 		models::client_market_update_queue snapshot_market_update_queue_;
 
@@ -53,12 +58,13 @@ namespace kse::market_data
 
 		market_data_publisher(models::market_update_queue* market_updates,
 			const std::string& snapshot_ip, int snapshot_port,
-			const std::string& incremental_ip, int incremental_port)
-			: ip_{ incremental_ip }, port_{ incremental_port }, outgoing_market_update_queue_(market_updates), snapshot_market_update_queue_{ models::MAX_MARKET_UPDATES },
+			const std::string& incremental_ip, int incremental_port,
+			models::protocol_version version, const models::reference_price_table& reference_prices)
+			: ip_{ incremental_ip }, port_{ incremental_port }, protocol_version_{ version }, reference_prices_{ reference_prices }, outgoing_market_update_queue_(market_updates), snapshot_market_update_queue_{ models::MAX_MARKET_UPDATES },
 			logger_{ "kse_market_data_publisher.log" }, loop_{ (uv_loop_t*)std::malloc(sizeof(uv_loop_t)) }, socket_{ (uv_udp_t*)std::malloc(sizeof(uv_udp_t)) },
 			idle_{ (uv_idle_t*)std::malloc(sizeof(uv_idle_t)) }, sender_{ (uv_udp_send_t*)std::malloc(sizeof(uv_udp_send_t)) } {
 			buffer_.resize(BUFFER_SIZE);
-			snapshot_synthesizer_ = &snapshot_synthesizer::get_instance(&snapshot_market_update_queue_, snapshot_ip, snapshot_port);
+			snapshot_synthesizer_ = &snapshot_synthesizer::get_instance(&snapshot_market_update_queue_, snapshot_ip, snapshot_port, version, reference_prices);
 		}
 
 		~market_data_publisher() {
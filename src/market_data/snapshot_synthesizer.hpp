@@ -2,6 +2,7 @@
 
 #include "uv.h"
 #include "models/market_update.hpp"
+#include "models/wire_v2.hpp"
 #include "utils/utils.hpp"
 #include "utils/logger.hpp"
 #include "utils/memory_pool.hpp"
@@ -22,9 +23,11 @@ namespace kse::market_data
 		static snapshot_synthesizer& get_instance(
 			models::client_market_update_queue* market_update_queue = nullptr,
 			std::string_view ip = "",
-			int port = 0)
+			int port = 0,
+			models::protocol_version version = models::protocol_version::V1,
+			const models::reference_price_table& reference_prices = {})
 		{
-			static snapshot_synthesizer instance(market_update_queue, ip, port);
+			static snapshot_synthesizer instance(market_update_queue, ip, port, version, reference_prices);
 			return instance;
 		}
 
@@ -64,6 +67,9 @@ namespace kse::market_data
 		std::string ip_;
 		int port_;
 
+		models::protocol_version protocol_version_ = models::protocol_version::V1;
+		models::reference_price_table reference_prices_{};
+
 		models::client_market_update_queue* market_update_queue_{ nullptr };
 
 		utils::logger logger_;
@@ -84,8 +90,9 @@ namespace kse::market_data
 
 		utils::memory_pool<models::market_update> market_update_pool_;
 
-		snapshot_synthesizer(models::client_market_update_queue* market_update_queue, std::string_view ip, int port) : 
-			ip_{ ip }, port_{ port }, market_update_queue_{ market_update_queue }, logger_{ "kse_snapshot_synthesizer.log" }, 
+		snapshot_synthesizer(models::client_market_update_queue* market_update_queue, std::string_view ip, int port,
+			models::protocol_version version, const models::reference_price_table& reference_prices) : 
+			ip_{ ip }, port_{ port }, protocol_version_{ version }, reference_prices_{ reference_prices }, market_update_queue_{ market_update_queue }, logger_{ "kse_snapshot_synthesizer.log" }, 
 			loop_{(uv_loop_t*)std::malloc(sizeof(uv_loop_t))}, socket_{(uv_udp_t*)std::malloc(sizeof(uv_udp_t))}, 
 			idle_{(uv_idle_t*)std::malloc(sizeof(uv_idle_t))}, timer_{(uv_timer_t*)std::malloc(sizeof(uv_timer_t))}, 
 			sender_{(uv_udp_send_t*)std::malloc(sizeof(uv_udp_send_t))}, market_update_pool_{ models::MAX_NUM_ORDERS } {
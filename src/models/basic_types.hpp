@@ -83,4 +83,99 @@ namespace kse::models {
 
 		return "UNKNOWN";
 	}
+
+	enum class order_type_t : uint8_t {
+		LIMIT = 0,
+		MARKET = 1, //matches at any price and never rests; its price is ignored
+		STOP = 2, //held until a trade reaches its stop price, then matches as a market order
+		STOP_LIMIT = 3 //held until a trade reaches its stop price, then matches as a limit order at its price
+	};
+
+	inline auto order_type_to_string(order_type_t type) -> std::string {
+		switch (type) {
+		case order_type_t::LIMIT:
+			return "LIMIT";
+		case order_type_t::MARKET:
+			return "MARKET";
+		case order_type_t::STOP:
+			return "STOP";
+		case order_type_t::STOP_LIMIT:
+			return "STOP_LIMIT";
+		}
+
+		return "UNKNOWN";
+	}
+
+	enum class time_in_force_t : uint8_t {
+		GTC = 0, //rests until filled or canceled
+		IOC = 1, //fills what it can immediately, the rest is canceled
+		FOK = 2, //fills completely and immediately or not at all
+		DAY = 3, //rests until the session close
+		GTD = 4, //rests until the session close of the date in expire_time_
+		GTT = 5 //rests until the time in expire_time_
+	};
+
+	inline auto time_in_force_to_string(time_in_force_t time_in_force) -> std::string {
+		switch (time_in_force) {
+		case time_in_force_t::GTC:
+			return "GTC";
+		case time_in_force_t::IOC:
+			return "IOC";
+		case time_in_force_t::FOK:
+			return "FOK";
+		case time_in_force_t::DAY:
+			return "DAY";
+		case time_in_force_t::GTD:
+			return "GTD";
+		case time_in_force_t::GTT:
+			return "GTT";
+		}
+
+		return "UNKNOWN";
+	}
+
+	/// Self-trade prevention: what happens when an incoming order would match a resting order of the same client.
+	enum class stp_mode_t : uint8_t {
+		NONE = 0, //the orders trade
+		CANCEL_NEWEST = 1, //the incoming order's remainder is canceled
+		CANCEL_OLDEST = 2, //the resting order is canceled and matching goes on
+		CANCEL_BOTH = 3, //both are canceled
+		DECREMENT = 4 //both are reduced by the smaller quantity without a trade; an order reduced to nothing is canceled
+	};
+
+	inline auto stp_mode_to_string(stp_mode_t mode) -> std::string {
+		switch (mode) {
+		case stp_mode_t::NONE:
+			return "NONE";
+		case stp_mode_t::CANCEL_NEWEST:
+			return "CANCEL_NEWEST";
+		case stp_mode_t::CANCEL_OLDEST:
+			return "CANCEL_OLDEST";
+		case stp_mode_t::CANCEL_BOTH:
+			return "CANCEL_BOTH";
+		case stp_mode_t::DECREMENT:
+			return "DECREMENT";
+		}
+
+		return "UNKNOWN";
+	}
+
+	enum class trading_phase_t : uint8_t {
+		CONTINUOUS = 0, //incoming orders match on arrival
+		AUCTION = 1, //call phase: orders rest without matching until the uncross
+		HALTED = 2 //a circuit breaker tripped: orders rest without matching and no indicative price is published until the exchange reopens the instrument
+	};
+
+	inline auto trading_phase_to_string(trading_phase_t phase) -> std::string {
+		switch (phase) {
+		case trading_phase_t::CONTINUOUS:
+			return "CONTINUOUS";
+		case trading_phase_t::AUCTION:
+			return "AUCTION";
+		case trading_phase_t::HALTED:
+			return "HALTED";
+		}
+
+		return "UNKNOWN";
+	}
 }
\ No newline at end of file
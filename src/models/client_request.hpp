@@ -17,9 +17,22 @@ namespace kse::models {
 		INVALID = 0,
 		NEW = 1,
 		CANCEL = 2,
-		MODIFY = 3
+		MODIFY = 3,
+		LOGON = 4,
+		RESEND = 5,
+		BATCH_NEW = 6,
+		BATCH_CANCEL = 7,
+		MASS_QUOTE = 8,
+		BATCH_ENTRY = 9,
+		MASS_CANCEL = 10, //cancels the client's resting orders; INVALID_INSTRUMENT_ID and side_t::INVALID match all
+		START_AUCTION = 11, //issued by the exchange: the instrument enters a call phase
+		UNCROSS = 12, //issued by the exchange: the call phase ends with an uncross and continuous trading resumes
+		EXPIRE = 13 //written by the matching engine to its journal when a resting order expires, so a replay expires it at the same point
 	};
 
+	/// Most entries a batch may carry: a two-sided quote on every instrument.
+	constexpr size_t MAX_BATCH_ENTRIES = 2 * MAX_NUM_INSTRUMENTS;
+
 	inline std::string client_request_type_to_string(client_request_type type) {
 		switch (type) {
 		case client_request_type::NEW:
@@ -28,6 +41,26 @@ namespace kse::models {
 			return "CANCEL";
 		case client_request_type::MODIFY:
 			return "MODIFY";
+		case client_request_type::LOGON:
+			return "LOGON";
+		case client_request_type::RESEND:
+			return "RESEND";
+		case client_request_type::BATCH_NEW:
+			return "BATCH_NEW";
+		case client_request_type::BATCH_CANCEL:
+			return "BATCH_CANCEL";
+		case client_request_type::MASS_QUOTE:
+			return "MASS_QUOTE";
+		case client_request_type::BATCH_ENTRY:
+			return "BATCH_ENTRY";
+		case client_request_type::MASS_CANCEL:
+			return "MASS_CANCEL";
+		case client_request_type::START_AUCTION:
+			return "START_AUCTION";
+		case client_request_type::UNCROSS:
+			return "UNCROSS";
+		case client_request_type::EXPIRE:
+			return "EXPIRE";
 		case client_request_type::INVALID:
 			return "INVALID";
 		}
@@ -43,6 +76,12 @@ namespace kse::models {
 		side_t side_ = side_t::INVALID;
 		price_t price_ = INVALID_PRICE;
 		quantity_t qty_ = INVALID_QUANTITY;
+		order_type_t order_type_ = order_type_t::LIMIT;
+		time_in_force_t time_in_force_ = time_in_force_t::GTC;
+		price_t stop_price_ = INVALID_PRICE; //trigger price of STOP and STOP_LIMIT orders
+		quantity_t display_qty_ = INVALID_QUANTITY; //iceberg peak; the whole order is displayed unless this is below qty_
+		stp_mode_t stp_mode_ = stp_mode_t::NONE; //chosen by the client on LOGON; the order server stamps the session's mode on every other request
+		uint64_t expire_time_ = 0; //GTD: days since the epoch; GTT: nanoseconds since the epoch
 
 		auto to_string() const {
 			std::stringstream ss;
@@ -55,6 +94,12 @@ namespace kse::models {
 				<< " side:" << side_to_string(side_)
 				<< " qty:" << quantity_to_string(qty_)
 				<< " price:" << price_to_string(price_)
+				<< " type:" << order_type_to_string(order_type_)
+				<< " tif:" << time_in_force_to_string(time_in_force_)
+				<< " stop:" << price_to_string(stop_price_)
+				<< " display:" << quantity_to_string(display_qty_)
+				<< " stp:" << stp_mode_to_string(stp_mode_)
+				<< " expire:" << expire_time_
 				<< "]";
 			return ss.str();
 		}
@@ -76,5 +121,45 @@ namespace kse::models {
 	};
 #pragma pack(pop)
 
+	/**
+	 * A batch travels as a header request (BATCH_NEW, BATCH_CANCEL or MASS_QUOTE) followed by BATCH_ENTRY requests.
+	 * The header's order_id_ is the client's batch id and its qty_ the number of entries; each entry carries the
+	 * instrument, order id, side, price and quantity of one order. The whole batch takes one sequence number.
+	 */
+	inline auto is_batch_header(client_request_type type) noexcept -> bool {
+		return type == client_request_type::BATCH_NEW || type == client_request_type::BATCH_CANCEL || type == client_request_type::MASS_QUOTE;
+	}
+
+	/**
+	 * Number of requests a request occupies on the v1 wire, in a shared memory ring and in the matching engine queue.
+	 * A header announcing no entries or more than MAX_BATCH_ENTRIES is malformed and stands alone.
+	 */
+	inline auto batch_length(const client_request_internal& request) noexcept -> size_t {
+		return is_batch_header(request.type_) && request.qty_ && request.qty_ <= MAX_BATCH_ENTRIES ? 1 + static_cast<size_t>(request.qty_) : 1;
+	}
+
+	/**
+	 * The single request a batch entry stands for. Mass quote entries are upserts: a zero quantity pulls the quote,
+	 * anything else is a NEW that the engine turns into a modify when the order is already live.
+	 */
+	inline auto batch_entry_as_request(client_request_type batch_type, const client_request_internal& entry) noexcept -> client_request_internal {
+		auto request = entry;
+		switch (batch_type) {
+		case client_request_type::BATCH_NEW:
+			request.type_ = client_request_type::NEW;
+			break;
+		case client_request_type::BATCH_CANCEL:
+			request.type_ = client_request_type::CANCEL;
+			break;
+		case client_request_type::MASS_QUOTE:
+			request.type_ = entry.qty_ ? client_request_type::NEW : client_request_type::CANCEL;
+			break;
+		default:
+			request.type_ = client_request_type::INVALID;
+			break;
+		}
+		return request;
+	}
+
 	using client_request_queue = kse::utils::lock_free_queue<client_request_internal>;
 }
@@ -21,6 +21,15 @@ namespace kse::models {
 		CANCEL_REJECTED = 5,
 		MODIFY_REJECTED = 6,
 		INVALID_REQUEST = 7,
+		LOGGED_ON = 8,
+		LOGON_REJECTED = 9,
+		GAP_FILL = 10,
+		RISK_REJECTED = 11,
+		BATCH_ACK = 12, //client_order_id_ is the batch id, exec_qty_ the entries applied and leaves_qty_ the entries rejected or canceled
+		BATCH_ENTRY = 13, //internal: precedes a batch entry's responses, the first acknowledgement of client_order_id_ is folded into the BATCH_ACK; never sent to clients
+		MASS_CANCELED = 14, //follows the CANCELED of every order a mass cancel removed; exec_qty_ is their count
+		TRIGGERED = 15, //a stop order's stop price was reached (price_) and it now matches like the order it becomes
+		DECREMENTED = 16, //self-trade prevention reduced a live order by exec_qty_ without a trade; leaves_qty_ is what remains
 	};
 
 	inline std::string client_response_type_to_string(client_response_type type) {
@@ -39,6 +48,24 @@ namespace kse::models {
 			return "MODIFY_REJECTED";
 		case client_response_type::INVALID_REQUEST:
 			return "INVALID_REQUEST";
+		case client_response_type::LOGGED_ON:
+			return "LOGGED_ON";
+		case client_response_type::LOGON_REJECTED:
+			return "LOGON_REJECTED";
+		case client_response_type::GAP_FILL:
+			return "GAP_FILL";
+		case client_response_type::RISK_REJECTED:
+			return "RISK_REJECTED";
+		case client_response_type::BATCH_ACK:
+			return "BATCH_ACK";
+		case client_response_type::BATCH_ENTRY:
+			return "BATCH_ENTRY";
+		case client_response_type::MASS_CANCELED:
+			return "MASS_CANCELED";
+		case client_response_type::TRIGGERED:
+			return "TRIGGERED";
+		case client_response_type::DECREMENTED:
+			return "DECREMENTED";
 		case client_response_type::INVALID:
 			return "INVALID";
 		}
@@ -12,7 +12,7 @@ namespace kse::models {
 	/// Maximum number of market updates between components.
 	constexpr size_t MAX_MARKET_UPDATES = 256 * 1024;
 
-	/// Maximum trading clients.
+	/// Number of clients per-client tables are presized for; they grow beyond it as new client ids appear.
 	constexpr size_t MAX_NUM_CLIENTS = 10;
 
 	/// Maximum number of orders
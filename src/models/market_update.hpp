@@ -18,6 +18,8 @@ namespace kse::models {
 		TRADE = 5,
 		SNAPSHOT_START = 6,
 		SNAPSHOT_END = 7,
+		INDICATIVE = 8, //call phase: price_ is the indicative uncross price, qty_ the volume that would match, side_ the side with surplus and priority_ its size
+		TRADING_STATUS = 9, //the instrument changed trading phase: qty_ is the new trading_phase_t, price_ the price that breached a band or INVALID_PRICE
 	};
 
 	inline std::string market_update_type_to_string(market_update_type type) {
@@ -36,6 +38,10 @@ namespace kse::models {
 			return "SNAPSHOT_START";
 		case market_update_type::SNAPSHOT_END:
 			return "SNAPSHOT_END";
+		case market_update_type::INDICATIVE:
+			return "INDICATIVE";
+		case market_update_type::TRADING_STATUS:
+			return "TRADING_STATUS";
 		case market_update_type::INVALID:
 			return "INVALID";
 		}
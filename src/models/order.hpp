@@ -2,10 +2,13 @@
 
 #include <array>
 #include <sstream>
+#include <vector>
 
 #include "constants.hpp"
 #include "basic_types.hpp"
 
+#include "utils/timer_wheel.hpp"
+
 namespace kse::models {
 	struct order {
 		instrument_id_t instrument_id_ = INVALID_INSTRUMENT_ID;
@@ -16,10 +19,20 @@ namespace kse::models {
 		price_t price_ = INVALID_PRICE;
 		quantity_t qty_ = INVALID_QUANTITY;
 		priority_t priority_ = INVALID_PRIORITY;
+		quantity_t display_qty_ = INVALID_QUANTITY; //iceberg peak size; qty_ is the displayed part
+		quantity_t hidden_qty_ = 0; //iceberg reserve, never published
 
 		order* prev_order_ = nullptr;
 		order* next_order_ = nullptr;
 
+		order* prev_client_order_ = nullptr; //circular list of the same client's resting orders in the book
+		order* next_client_order_ = nullptr;
+
+		order* prev_timer_ = nullptr; //expiry timer of DAY, GTD and GTT orders, linked into the matching engine's timer wheel
+		order* next_timer_ = nullptr;
+		uint64_t timer_tick_ = 0;
+		uint32_t timer_slot_ = utils::INVALID_TIMER_SLOT;
+
 		order() = default;
 
 		order(instrument_id_t instrument_id, client_id_t client_id, order_id_t client_order_id, order_id_t market_order_id, 
@@ -37,6 +50,7 @@ namespace kse::models {
 				<< "side:" << side_to_string(side_) << " "
 				<< "price:" << price_to_string(price_) << " "
 				<< "qty:" << quantity_to_string(qty_) << " "
+				<< "hidden:" << quantity_to_string(hidden_qty_) << " "
 				<< "priority:" << priority_to_string(priority_) << "]";
 			return ss.str();
 		}
@@ -48,13 +62,14 @@ namespace kse::models {
 		order* first_order_ = nullptr;
 		price_level* prev_entry_ = nullptr;
 		price_level* next_entry_ = nullptr;
+		quantity_t qty_ = 0; //total resting quantity including iceberg reserves, so liquidity checks walk levels instead of orders
 
 		price_level() = default;
 
 		price_level(side_t side, price_t price, order* first_order,
 			price_level* prev_entry, price_level* next_entry)
 			: side_(side), price_(price), first_order_(first_order),
-			prev_entry_(prev_entry), next_entry_(next_entry) {
+			prev_entry_(prev_entry), next_entry_(next_entry), qty_(first_order ? first_order->qty_ + first_order->hidden_qty_ : 0) {
 		}
 
 		auto to_string() const -> std::string {
@@ -70,6 +85,26 @@ namespace kse::models {
 	};
 
 	using order_map = std::vector<order*>;
-	using client_order_map = std::array<order_map, MAX_NUM_CLIENTS>;
+	/// Indexed by client id, then client order id. Grows when a client id beyond the current size places its first order.
+	using client_order_map = std::vector<order_map>;
 	using order_at_price_level_map = std::array<price_level*, MAX_PRICE_LEVELS>;
+
+	/// A stop or stop-limit order waiting for its stop price. It is not in the book and has no market data until it triggers.
+	struct stop_order {
+		client_id_t client_id_ = INVALID_CLIENT_ID;
+		order_id_t client_order_id_ = INVALID_ORDER_ID;
+		order_id_t market_order_id_ = INVALID_ORDER_ID;
+		side_t side_ = side_t::INVALID;
+		price_t stop_price_ = INVALID_PRICE;
+		price_t price_ = INVALID_PRICE;
+		quantity_t qty_ = INVALID_QUANTITY;
+		order_type_t order_type_ = order_type_t::MARKET; //what the order becomes once triggered: MARKET or LIMIT
+		time_in_force_t time_in_force_ = time_in_force_t::GTC;
+		quantity_t display_qty_ = INVALID_QUANTITY;
+		stp_mode_t stp_mode_ = stp_mode_t::NONE;
+		uint64_t expire_time_ = 0; //nanoseconds since the epoch once resting, 0 for orders that never expire
+	};
+
+	/// One side's stops, sorted so that the next one to trigger is at the back; stops with the same stop price trigger in arrival order.
+	using stop_order_index = std::vector<stop_order>;
 }
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <bit>
+
+#include "client_request.hpp"
+#include "client_response.hpp"
+#include "market_update.hpp"
+
+#include "utils/codec.hpp"
+
+namespace kse::models {
+	/// Byte order of the binary protocol.
+	constexpr auto WIRE_BYTE_ORDER = std::endian::big;
+
+	/// Wire layout of a client request. Fields are listed in the order they are sent.
+	using client_request_codec = utils::message_codec<client_request_external, WIRE_BYTE_ORDER,
+		utils::field<&client_request_external::sequence_number_>,
+		utils::field<&client_request_external::request_, &client_request_internal::type_>,
+		utils::field<&client_request_external::request_, &client_request_internal::client_id_>,
+		utils::field<&client_request_external::request_, &client_request_internal::instrument_id_>,
+		utils::field<&client_request_external::request_, &client_request_internal::order_id_>,
+		utils::field<&client_request_external::request_, &client_request_internal::side_>,
+		utils::field<&client_request_external::request_, &client_request_internal::price_>,
+		utils::field<&client_request_external::request_, &client_request_internal::qty_>,
+		utils::field<&client_request_external::request_, &client_request_internal::order_type_>,
+		utils::field<&client_request_external::request_, &client_request_internal::time_in_force_>,
+		utils::field<&client_request_external::request_, &client_request_internal::stop_price_>,
+		utils::field<&client_request_external::request_, &client_request_internal::display_qty_>,
+		utils::field<&client_request_external::request_, &client_request_internal::stp_mode_>,
+		utils::field<&client_request_external::request_, &client_request_internal::expire_time_>>;
+
+	/// Wire layout of a client response.
+	using client_response_codec = utils::message_codec<client_response_external, WIRE_BYTE_ORDER,
+		utils::field<&client_response_external::sequence_number_>,
+		utils::field<&client_response_external::response_, &client_response_internal::type_>,
+		utils::field<&client_response_external::response_, &client_response_internal::client_id_>,
+		utils::field<&client_response_external::response_, &client_response_internal::instrument_id_>,
+		utils::field<&client_response_external::response_, &client_response_internal::client_order_id_>,
+		utils::field<&client_response_external::response_, &client_response_internal::market_order_id_>,
+		utils::field<&client_response_external::response_, &client_response_internal::side_>,
+		utils::field<&client_response_external::response_, &client_response_internal::price_>,
+		utils::field<&client_response_external::response_, &client_response_internal::exec_qty_>,
+		utils::field<&client_response_external::response_, &client_response_internal::leaves_qty_>>;
+
+	/// Wire layout of a market data update, shared by the incremental and snapshot streams.
+	using client_market_update_codec = utils::message_codec<client_market_update, WIRE_BYTE_ORDER,
+		utils::field<&client_market_update::sequence_number_>,
+		utils::field<&client_market_update::update_, &market_update::type_>,
+		utils::field<&client_market_update::update_, &market_update::order_id_>,
+		utils::field<&client_market_update::update_, &market_update::instrument_id_>,
+		utils::field<&client_market_update::update_, &market_update::side_>,
+		utils::field<&client_market_update::update_, &market_update::price_>,
+		utils::field<&client_market_update::update_, &market_update::qty_>,
+		utils::field<&client_market_update::update_, &market_update::priority_>>;
+
+	// Framing on both ends uses sizeof() of the packed structs, so the generated layouts must match them exactly.
+	static_assert(client_request_codec::size == sizeof(client_request_external), "client request wire size mismatch");
+	static_assert(client_response_codec::size == sizeof(client_response_external), "client response wire size mismatch");
+	static_assert(client_market_update_codec::size == sizeof(client_market_update), "market update wire size mismatch");
+}
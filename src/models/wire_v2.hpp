@@ -0,0 +1,567 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#include "constants.hpp"
+#include "basic_types.hpp"
+#include "client_request.hpp"
+#include "client_response.hpp"
+#include "market_update.hpp"
+
+#include "utils/codec.hpp"
+
+namespace kse::models {
+	enum class protocol_version : uint8_t {
+		INVALID = 0,
+		V1 = 1,
+		V2 = 2
+	};
+
+	constexpr auto LATEST_PROTOCOL_VERSION = protocol_version::V2;
+
+	/// Prices on the v2 wire are 32-bit offsets from a per-instrument reference price.
+	using reference_price_table = std::array<price_t, MAX_NUM_INSTRUMENTS>;
+
+	/// All v2 message types are non-zero. A v1 frame always starts with the most significant byte of a
+	/// big-endian sequence number, which is zero, so the first byte of a frame tells the two versions apart.
+	enum class v2_message_type : uint8_t {
+		INVALID = 0,
+		HELLO = 0xA1,
+		HELLO_ACK = 0xA2,
+		REFERENCE_PRICE = 0xA3,
+		RESEND_REQUEST = 0xA4,
+		NEW_ORDER = 0xB1,
+		CANCEL_ORDER = 0xB2,
+		MODIFY_ORDER = 0xB3,
+		BATCH_NEW_ORDERS = 0xB4,
+		BATCH_CANCEL_ORDERS = 0xB5,
+		MASS_QUOTE = 0xB6,
+		MASS_CANCEL = 0xB7,
+		RESPONSE = 0xC1,
+		MARKET_UPDATE = 0xD1
+	};
+
+	constexpr uint16_t V2_HELLO_MAGIC = 0x4B53;
+
+	constexpr auto V2_INVALID_PRICE = std::numeric_limits<int32_t>::max();
+	constexpr auto V2_INVALID_ORDER_ID = std::numeric_limits<uint32_t>::max();
+	constexpr auto V2_INVALID_PRIORITY = std::numeric_limits<uint32_t>::max();
+
+#pragma pack(push, 1)
+	struct v2_header {
+		v2_message_type type_ = v2_message_type::INVALID;
+		uint8_t length_ = 0;
+	};
+
+	struct v2_hello {
+		v2_header header_;
+		uint16_t magic_ = V2_HELLO_MAGIC;
+		protocol_version version_ = protocol_version::INVALID;
+	};
+
+	struct v2_hello_ack {
+		v2_header header_;
+		protocol_version version_ = protocol_version::INVALID;
+	};
+
+	struct v2_reference_price {
+		v2_header header_;
+		instrument_id_t instrument_id_ = INVALID_INSTRUMENT_ID;
+		price_t price_ = INVALID_PRICE;
+	};
+
+	struct v2_resend_request {
+		v2_header header_;
+		uint32_t from_sequence_number_ = 0;
+	};
+
+	struct v2_new_order {
+		v2_header header_;
+		uint32_t sequence_number_ = 0;
+		instrument_id_t instrument_id_ = INVALID_INSTRUMENT_ID;
+		uint32_t order_id_ = V2_INVALID_ORDER_ID;
+		side_t side_ = side_t::INVALID;
+		int32_t price_ = V2_INVALID_PRICE;
+		quantity_t qty_ = INVALID_QUANTITY;
+		order_type_t order_type_ = order_type_t::LIMIT;
+		time_in_force_t time_in_force_ = time_in_force_t::GTC;
+		int32_t stop_price_ = V2_INVALID_PRICE;
+		quantity_t display_qty_ = INVALID_QUANTITY;
+		uint64_t expire_time_ = 0;
+	};
+
+	struct v2_cancel_order {
+		v2_header header_;
+		uint32_t sequence_number_ = 0;
+		instrument_id_t instrument_id_ = INVALID_INSTRUMENT_ID;
+		uint32_t order_id_ = V2_INVALID_ORDER_ID;
+	};
+
+	struct v2_modify_order {
+		v2_header header_;
+		uint32_t sequence_number_ = 0;
+		instrument_id_t instrument_id_ = INVALID_INSTRUMENT_ID;
+		uint32_t order_id_ = V2_INVALID_ORDER_ID;
+		int32_t price_ = V2_INVALID_PRICE;
+		quantity_t qty_ = INVALID_QUANTITY;
+	};
+
+	struct v2_mass_cancel {
+		v2_header header_;
+		uint32_t sequence_number_ = 0;
+		uint32_t mass_cancel_id_ = V2_INVALID_ORDER_ID;
+		instrument_id_t instrument_id_ = INVALID_INSTRUMENT_ID;
+		side_t side_ = side_t::INVALID;
+	};
+
+	/// Fixed part of a batch frame, followed by count_ entries of the type's entry layout.
+	struct v2_batch_header {
+		v2_header header_;
+		uint32_t sequence_number_ = 0;
+		uint32_t batch_id_ = V2_INVALID_ORDER_ID;
+		uint8_t count_ = 0;
+	};
+
+	struct v2_batch_order_entry {
+		instrument_id_t instrument_id_ = INVALID_INSTRUMENT_ID;
+		uint32_t order_id_ = V2_INVALID_ORDER_ID;
+		side_t side_ = side_t::INVALID;
+		int32_t price_ = V2_INVALID_PRICE;
+		quantity_t qty_ = INVALID_QUANTITY;
+	};
+
+	struct v2_batch_cancel_entry {
+		instrument_id_t instrument_id_ = INVALID_INSTRUMENT_ID;
+		uint32_t order_id_ = V2_INVALID_ORDER_ID;
+	};
+
+	/// Both sides of one instrument's quote. A side with a zero quantity is pulled; a side with an invalid order id is left out.
+	struct v2_quote_entry {
+		instrument_id_t instrument_id_ = INVALID_INSTRUMENT_ID;
+		uint32_t bid_order_id_ = V2_INVALID_ORDER_ID;
+		int32_t bid_price_ = V2_INVALID_PRICE;
+		quantity_t bid_qty_ = 0;
+		uint32_t ask_order_id_ = V2_INVALID_ORDER_ID;
+		int32_t ask_price_ = V2_INVALID_PRICE;
+		quantity_t ask_qty_ = 0;
+	};
+
+	struct v2_response {
+		v2_header header_;
+		uint32_t sequence_number_ = 0;
+		client_response_type type_ = client_response_type::INVALID;
+		instrument_id_t instrument_id_ = INVALID_INSTRUMENT_ID;
+		uint32_t client_order_id_ = V2_INVALID_ORDER_ID;
+		order_id_t market_order_id_ = INVALID_ORDER_ID;
+		side_t side_ = side_t::INVALID;
+		int32_t price_ = V2_INVALID_PRICE;
+		quantity_t exec_qty_ = INVALID_QUANTITY;
+		quantity_t leaves_qty_ = INVALID_QUANTITY;
+	};
+
+	struct v2_market_update {
+		v2_header header_;
+		uint32_t sequence_number_ = 0;
+		market_update_type type_ = market_update_type::INVALID;
+		instrument_id_t instrument_id_ = INVALID_INSTRUMENT_ID;
+		order_id_t order_id_ = INVALID_ORDER_ID;
+		side_t side_ = side_t::INVALID;
+		int32_t price_ = V2_INVALID_PRICE;
+		quantity_t qty_ = INVALID_QUANTITY;
+		uint32_t priority_ = V2_INVALID_PRIORITY;
+	};
+#pragma pack(pop)
+
+	template<typename T, auto... Members>
+	using v2_codec = utils::message_codec<T, std::endian::little,
+		utils::field<&T::header_, &v2_header::type_>,
+		utils::field<&T::header_, &v2_header::length_>,
+		utils::field<Members>...>;
+
+	using v2_hello_codec = v2_codec<v2_hello, &v2_hello::magic_, &v2_hello::version_>;
+	using v2_hello_ack_codec = v2_codec<v2_hello_ack, &v2_hello_ack::version_>;
+	using v2_reference_price_codec = v2_codec<v2_reference_price, &v2_reference_price::instrument_id_, &v2_reference_price::price_>;
+	using v2_resend_request_codec = v2_codec<v2_resend_request, &v2_resend_request::from_sequence_number_>;
+	using v2_new_order_codec = v2_codec<v2_new_order, &v2_new_order::sequence_number_, &v2_new_order::instrument_id_, &v2_new_order::order_id_,
+		&v2_new_order::side_, &v2_new_order::price_, &v2_new_order::qty_, &v2_new_order::order_type_, &v2_new_order::time_in_force_,
+		&v2_new_order::stop_price_, &v2_new_order::display_qty_,
+		&v2_new_order::expire_time_>;
+	using v2_cancel_order_codec = v2_codec<v2_cancel_order, &v2_cancel_order::sequence_number_, &v2_cancel_order::instrument_id_, &v2_cancel_order::order_id_>;
+	using v2_modify_order_codec = v2_codec<v2_modify_order, &v2_modify_order::sequence_number_, &v2_modify_order::instrument_id_, &v2_modify_order::order_id_,
+		&v2_modify_order::price_, &v2_modify_order::qty_>;
+	using v2_mass_cancel_codec = v2_codec<v2_mass_cancel, &v2_mass_cancel::sequence_number_, &v2_mass_cancel::mass_cancel_id_, &v2_mass_cancel::instrument_id_,
+		&v2_mass_cancel::side_>;
+	using v2_batch_header_codec = v2_codec<v2_batch_header, &v2_batch_header::sequence_number_, &v2_batch_header::batch_id_, &v2_batch_header::count_>;
+
+	/// Batch entries have no header of their own.
+	template<typename T, auto... Members>
+	using v2_entry_codec = utils::message_codec<T, std::endian::little, utils::field<Members>...>;
+
+	using v2_batch_order_entry_codec = v2_entry_codec<v2_batch_order_entry, &v2_batch_order_entry::instrument_id_, &v2_batch_order_entry::order_id_,
+		&v2_batch_order_entry::side_, &v2_batch_order_entry::price_, &v2_batch_order_entry::qty_>;
+	using v2_batch_cancel_entry_codec = v2_entry_codec<v2_batch_cancel_entry, &v2_batch_cancel_entry::instrument_id_, &v2_batch_cancel_entry::order_id_>;
+	using v2_quote_entry_codec = v2_entry_codec<v2_quote_entry, &v2_quote_entry::instrument_id_, &v2_quote_entry::bid_order_id_, &v2_quote_entry::bid_price_,
+		&v2_quote_entry::bid_qty_, &v2_quote_entry::ask_order_id_, &v2_quote_entry::ask_price_, &v2_quote_entry::ask_qty_>;
+
+	/// Quotes carry two entries each, so a mass quote frame holds up to one quote per instrument.
+	constexpr size_t V2_MAX_QUOTE_ENTRIES = MAX_BATCH_ENTRIES / 2;
+
+	using v2_response_codec = v2_codec<v2_response, &v2_response::sequence_number_, &v2_response::type_, &v2_response::instrument_id_,
+		&v2_response::client_order_id_, &v2_response::market_order_id_, &v2_response::side_, &v2_response::price_, &v2_response::exec_qty_, &v2_response::leaves_qty_>;
+	using v2_market_update_codec = v2_codec<v2_market_update, &v2_market_update::sequence_number_, &v2_market_update::type_, &v2_market_update::instrument_id_,
+		&v2_market_update::order_id_, &v2_market_update::side_, &v2_market_update::price_, &v2_market_update::qty_, &v2_market_update::priority_>;
+
+	/// Largest v2 frame, used to size buffers that may hold either version.
+	constexpr size_t V2_MAX_FRAME_SIZE = std::max({ v2_hello_codec::size, v2_hello_ack_codec::size, v2_reference_price_codec::size, v2_resend_request_codec::size, v2_new_order_codec::size,
+		v2_cancel_order_codec::size, v2_modify_order_codec::size, v2_mass_cancel_codec::size, v2_response_codec::size, v2_market_update_codec::size,
+		v2_batch_header_codec::size + MAX_BATCH_ENTRIES * v2_batch_order_entry_codec::size,
+		v2_batch_header_codec::size + MAX_BATCH_ENTRIES * v2_batch_cancel_entry_codec::size,
+		v2_batch_header_codec::size + V2_MAX_QUOTE_ENTRIES * v2_quote_entry_codec::size });
+
+	static_assert(V2_MAX_FRAME_SIZE <= std::numeric_limits<uint8_t>::max(), "v2 frame length must fit in the header");
+	static_assert(v2_response_codec::size <= sizeof(client_response_external), "v2 responses must fit in a v1 response slot");
+	static_assert(v2_market_update_codec::size <= sizeof(client_market_update), "v2 market updates must fit in a v1 market update slot");
+
+	inline auto is_v2_frame_start(char first_byte) noexcept -> bool {
+		return first_byte != 0;
+	}
+
+	inline auto peek_v2_header(const char* buffer) noexcept -> v2_header {
+		return { static_cast<v2_message_type>(buffer[0]), static_cast<uint8_t>(buffer[1]) };
+	}
+
+	/// Whether a price has a v2 encoding: no price at all, or an offset from the reference price that fits in 32 bits.
+	inline auto fits_v2_price(price_t price, price_t reference_price) noexcept -> bool {
+		if (price == INVALID_PRICE) {
+			return true;
+		}
+		const auto offset = price - reference_price;
+		return offset < V2_INVALID_PRICE && offset >= std::numeric_limits<int32_t>::min();
+	}
+
+	/**
+	 * A price with no v2 encoding goes out as V2_INVALID_PRICE, the same as no price. The order server rejects a request
+	 * whose price arrives that way as MALFORMED, and the risk gate rejects any order whose price does not fit with
+	 * PRICE_RANGE, whatever its transport, so no response or market update ever carries such a price.
+	 */
+	inline auto to_v2_price(price_t price, price_t reference_price) noexcept -> int32_t {
+		if (price == INVALID_PRICE || !fits_v2_price(price, reference_price)) [[unlikely]] {
+			return V2_INVALID_PRICE;
+		}
+		return static_cast<int32_t>(price - reference_price);
+	}
+
+	inline auto from_v2_price(int32_t price, price_t reference_price) noexcept -> price_t {
+		return price == V2_INVALID_PRICE ? INVALID_PRICE : reference_price + price;
+	}
+
+	inline auto to_v2_order_id(order_id_t order_id) noexcept -> uint32_t {
+		return order_id >= V2_INVALID_ORDER_ID ? V2_INVALID_ORDER_ID : static_cast<uint32_t>(order_id);
+	}
+
+	inline auto from_v2_order_id(uint32_t order_id) noexcept -> order_id_t {
+		return order_id == V2_INVALID_ORDER_ID ? INVALID_ORDER_ID : order_id;
+	}
+
+	inline auto to_v2_priority(priority_t priority) noexcept -> uint32_t {
+		return priority >= V2_INVALID_PRIORITY ? V2_INVALID_PRIORITY : static_cast<uint32_t>(priority);
+	}
+
+	inline auto from_v2_priority(uint32_t priority) noexcept -> priority_t {
+		return priority == V2_INVALID_PRIORITY ? INVALID_PRIORITY : priority;
+	}
+
+	/// Rebuilds a 64-bit sequence number from the 32 bits on the v2 wire, picking the value closest to the expected one.
+	inline auto extend_sequence_number(uint32_t wire_sequence_number, uint64_t expected) noexcept -> uint64_t {
+		const auto delta = static_cast<int32_t>(wire_sequence_number - static_cast<uint32_t>(expected));
+		return expected + delta;
+	}
+
+	inline auto reference_price_of(const reference_price_table& reference_prices, instrument_id_t instrument_id) noexcept -> price_t {
+		return instrument_id < reference_prices.size() ? reference_prices[instrument_id] : 0;
+	}
+
+	/**
+	 * Encodes a client request as the matching v2 order entry message.
+	 * The client id is not sent: on v2 it is implied by the session.
+	 *
+	 * @return The number of bytes written, or 0 if the request type has no v2 encoding.
+	 */
+	inline auto encode_v2_request(const client_request_external& request, const reference_price_table& reference_prices, char* buffer) noexcept -> size_t {
+		const auto& r = request.request_;
+		const auto sequence_number = static_cast<uint32_t>(request.sequence_number_);
+		const auto reference_price = reference_price_of(reference_prices, r.instrument_id_);
+
+		switch (r.type_) {
+		case client_request_type::NEW:
+			v2_new_order_codec::encode({ { v2_message_type::NEW_ORDER, v2_new_order_codec::size }, sequence_number, r.instrument_id_,
+				to_v2_order_id(r.order_id_), r.side_, to_v2_price(r.price_, reference_price), r.qty_, r.order_type_, r.time_in_force_,
+				to_v2_price(r.stop_price_, reference_price), r.display_qty_, r.expire_time_ }, buffer);
+			return v2_new_order_codec::size;
+		case client_request_type::CANCEL:
+			v2_cancel_order_codec::encode({ { v2_message_type::CANCEL_ORDER, v2_cancel_order_codec::size }, sequence_number, r.instrument_id_,
+				to_v2_order_id(r.order_id_) }, buffer);
+			return v2_cancel_order_codec::size;
+		case client_request_type::MODIFY:
+			v2_modify_order_codec::encode({ { v2_message_type::MODIFY_ORDER, v2_modify_order_codec::size }, sequence_number, r.instrument_id_,
+				to_v2_order_id(r.order_id_), to_v2_price(r.price_, reference_price), r.qty_ }, buffer);
+			return v2_modify_order_codec::size;
+		case client_request_type::MASS_CANCEL:
+			v2_mass_cancel_codec::encode({ { v2_message_type::MASS_CANCEL, v2_mass_cancel_codec::size }, sequence_number, to_v2_order_id(r.order_id_),
+				r.instrument_id_, r.side_ }, buffer);
+			return v2_mass_cancel_codec::size;
+		case client_request_type::RESEND:
+			v2_resend_request_codec::encode({ { v2_message_type::RESEND_REQUEST, v2_resend_request_codec::size }, static_cast<uint32_t>(r.order_id_) }, buffer);
+			return v2_resend_request_codec::size;
+		default:
+			return 0;
+		}
+	}
+
+	/**
+	 * Decodes a complete v2 order entry frame.
+	 *
+	 * @return false if the frame is not an order entry message or its length does not match its type.
+	 */
+	inline auto decode_v2_request(const char* frame, client_id_t client_id, uint64_t expected_sequence_number,
+		const reference_price_table& reference_prices, client_request_external* request) noexcept -> bool {
+		const auto header = peek_v2_header(frame);
+		auto& r = request->request_;
+		r.client_id_ = client_id;
+
+		switch (header.type_) {
+		case v2_message_type::NEW_ORDER: {
+			if (header.length_ != v2_new_order_codec::size) [[unlikely]] return false;
+			const auto message = v2_new_order_codec::decode(frame);
+			request->sequence_number_ = extend_sequence_number(message.sequence_number_, expected_sequence_number);
+			r.type_ = client_request_type::NEW;
+			r.instrument_id_ = message.instrument_id_;
+			r.order_id_ = from_v2_order_id(message.order_id_);
+			r.side_ = message.side_;
+			r.price_ = from_v2_price(message.price_, reference_price_of(reference_prices, message.instrument_id_));
+			r.qty_ = message.qty_;
+			r.order_type_ = message.order_type_;
+			r.time_in_force_ = message.time_in_force_;
+			r.stop_price_ = from_v2_price(message.stop_price_, reference_price_of(reference_prices, message.instrument_id_));
+			r.display_qty_ = message.display_qty_;
+			r.expire_time_ = message.expire_time_;
+		} return true;
+		case v2_message_type::CANCEL_ORDER: {
+			if (header.length_ != v2_cancel_order_codec::size) [[unlikely]] return false;
+			const auto message = v2_cancel_order_codec::decode(frame);
+			request->sequence_number_ = extend_sequence_number(message.sequence_number_, expected_sequence_number);
+			r.type_ = client_request_type::CANCEL;
+			r.instrument_id_ = message.instrument_id_;
+			r.order_id_ = from_v2_order_id(message.order_id_);
+		} return true;
+		case v2_message_type::MODIFY_ORDER: {
+			if (header.length_ != v2_modify_order_codec::size) [[unlikely]] return false;
+			const auto message = v2_modify_order_codec::decode(frame);
+			request->sequence_number_ = extend_sequence_number(message.sequence_number_, expected_sequence_number);
+			r.type_ = client_request_type::MODIFY;
+			r.instrument_id_ = message.instrument_id_;
+			r.order_id_ = from_v2_order_id(message.order_id_);
+			r.price_ = from_v2_price(message.price_, reference_price_of(reference_prices, message.instrument_id_));
+			r.qty_ = message.qty_;
+		} return true;
+		case v2_message_type::MASS_CANCEL: {
+			if (header.length_ != v2_mass_cancel_codec::size) [[unlikely]] return false;
+			const auto message = v2_mass_cancel_codec::decode(frame);
+			request->sequence_number_ = extend_sequence_number(message.sequence_number_, expected_sequence_number);
+			r.type_ = client_request_type::MASS_CANCEL;
+			r.instrument_id_ = message.instrument_id_;
+			r.order_id_ = from_v2_order_id(message.mass_cancel_id_);
+			r.side_ = message.side_;
+		} return true;
+		case v2_message_type::RESEND_REQUEST: {
+			// Resend requests are not sequenced themselves; the response sequence number to resend from is taken as is.
+			if (header.length_ != v2_resend_request_codec::size) [[unlikely]] return false;
+			const auto message = v2_resend_request_codec::decode(frame);
+			request->sequence_number_ = 0;
+			r.type_ = client_request_type::RESEND;
+			r.order_id_ = message.from_sequence_number_;
+		} return true;
+		default:
+			return false;
+		}
+	}
+
+	inline auto is_v2_batch_message(v2_message_type type) noexcept -> bool {
+		return type == v2_message_type::BATCH_NEW_ORDERS || type == v2_message_type::BATCH_CANCEL_ORDERS || type == v2_message_type::MASS_QUOTE;
+	}
+
+	/**
+	 * Encodes a batch, given as its header request followed by its entries, as a single v2 frame.
+	 * Mass quote entries are paired into two-sided quotes when a BUY is directly followed by a SELL on the same instrument.
+	 *
+	 * @return The number of bytes written, or 0 if the batch is malformed or too large for one frame.
+	 */
+	inline auto encode_v2_batch(const client_request_external* batch, const reference_price_table& reference_prices, char* buffer) noexcept -> size_t {
+		const auto& header = batch[0].request_;
+		const auto* entries = batch + 1;
+		const auto num_entries = batch_length(header) - 1;
+		if (!num_entries) [[unlikely]] {
+			return 0;
+		}
+
+		auto message_type = v2_message_type::INVALID;
+		size_t size = v2_batch_header_codec::size;
+		size_t count = 0;
+
+		switch (header.type_) {
+		case client_request_type::BATCH_NEW:
+			message_type = v2_message_type::BATCH_NEW_ORDERS;
+			for (; count < num_entries; ++count) {
+				const auto& e = entries[count].request_;
+				v2_batch_order_entry_codec::encode({ e.instrument_id_, to_v2_order_id(e.order_id_), e.side_,
+					to_v2_price(e.price_, reference_price_of(reference_prices, e.instrument_id_)), e.qty_ }, buffer + size);
+				size += v2_batch_order_entry_codec::size;
+			}
+			break;
+		case client_request_type::BATCH_CANCEL:
+			message_type = v2_message_type::BATCH_CANCEL_ORDERS;
+			for (; count < num_entries; ++count) {
+				const auto& e = entries[count].request_;
+				v2_batch_cancel_entry_codec::encode({ e.instrument_id_, to_v2_order_id(e.order_id_) }, buffer + size);
+				size += v2_batch_cancel_entry_codec::size;
+			}
+			break;
+		case client_request_type::MASS_QUOTE:
+			message_type = v2_message_type::MASS_QUOTE;
+			for (size_t i = 0; i < num_entries; ++count) {
+				if (count == V2_MAX_QUOTE_ENTRIES) [[unlikely]] {
+					return 0;
+				}
+
+				const auto& e = entries[i].request_;
+				const auto reference_price = reference_price_of(reference_prices, e.instrument_id_);
+				v2_quote_entry quote{ e.instrument_id_ };
+				const auto paired = e.side_ == side_t::BUY && i + 1 < num_entries &&
+					entries[i + 1].request_.side_ == side_t::SELL && entries[i + 1].request_.instrument_id_ == e.instrument_id_;
+
+				if (e.side_ == side_t::BUY) {
+					quote.bid_order_id_ = to_v2_order_id(e.order_id_);
+					quote.bid_price_ = to_v2_price(e.price_, reference_price);
+					quote.bid_qty_ = e.qty_;
+				}
+				const auto& ask = paired ? entries[i + 1].request_ : e;
+				if (ask.side_ == side_t::SELL) {
+					quote.ask_order_id_ = to_v2_order_id(ask.order_id_);
+					quote.ask_price_ = to_v2_price(ask.price_, reference_price);
+					quote.ask_qty_ = ask.qty_;
+				}
+
+				v2_quote_entry_codec::encode(quote, buffer + size);
+				size += v2_quote_entry_codec::size;
+				i += paired ? 2 : 1;
+			}
+			break;
+		default:
+			return 0;
+		}
+
+		v2_batch_header_codec::encode({ { message_type, static_cast<uint8_t>(size) }, static_cast<uint32_t>(batch[0].sequence_number_),
+			to_v2_order_id(header.order_id_), static_cast<uint8_t>(count) }, buffer);
+		return size;
+	}
+
+	/**
+	 * Decodes a complete v2 batch frame into its header request and entries, the layout the v1 wire uses.
+	 *
+	 * @param batch Room for 1 + MAX_BATCH_ENTRIES requests.
+	 * @return The number of requests written, or 0 if the frame is not a batch or its length does not match its entries.
+	 */
+	inline auto decode_v2_batch(const char* frame, client_id_t client_id, uint64_t expected_sequence_number,
+		const reference_price_table& reference_prices, client_request_external* batch) noexcept -> size_t {
+		const auto header = peek_v2_header(frame);
+		if (header.length_ < v2_batch_header_codec::size) [[unlikely]] {
+			return 0;
+		}
+
+		const auto message = v2_batch_header_codec::decode(frame);
+		const auto* entries = frame + v2_batch_header_codec::size;
+		const auto sequence_number = extend_sequence_number(message.sequence_number_, expected_sequence_number);
+
+		auto& h = batch[0];
+		h = { sequence_number, { client_request_type::INVALID, client_id, INVALID_INSTRUMENT_ID, from_v2_order_id(message.batch_id_) } };
+
+		size_t count = 1;
+		const auto add_entry = [&](instrument_id_t instrument_id, uint32_t order_id, side_t side, price_t price, quantity_t qty) noexcept {
+			batch[count++] = { sequence_number, { client_request_type::BATCH_ENTRY, client_id, instrument_id, from_v2_order_id(order_id), side, price, qty } };
+		};
+
+		switch (header.type_) {
+		case v2_message_type::BATCH_NEW_ORDERS: {
+			if (message.count_ > MAX_BATCH_ENTRIES || header.length_ != v2_batch_header_codec::size + message.count_ * v2_batch_order_entry_codec::size) [[unlikely]] return 0;
+			h.request_.type_ = client_request_type::BATCH_NEW;
+			for (size_t i = 0; i < message.count_; ++i) {
+				const auto e = v2_batch_order_entry_codec::decode(entries + i * v2_batch_order_entry_codec::size);
+				add_entry(e.instrument_id_, e.order_id_, e.side_, from_v2_price(e.price_, reference_price_of(reference_prices, e.instrument_id_)), e.qty_);
+			}
+		} break;
+		case v2_message_type::BATCH_CANCEL_ORDERS: {
+			if (message.count_ > MAX_BATCH_ENTRIES || header.length_ != v2_batch_header_codec::size + message.count_ * v2_batch_cancel_entry_codec::size) [[unlikely]] return 0;
+			h.request_.type_ = client_request_type::BATCH_CANCEL;
+			for (size_t i = 0; i < message.count_; ++i) {
+				const auto e = v2_batch_cancel_entry_codec::decode(entries + i * v2_batch_cancel_entry_codec::size);
+				add_entry(e.instrument_id_, e.order_id_, side_t::INVALID, INVALID_PRICE, INVALID_QUANTITY);
+			}
+		} break;
+		case v2_message_type::MASS_QUOTE: {
+			if (message.count_ > V2_MAX_QUOTE_ENTRIES || header.length_ != v2_batch_header_codec::size + message.count_ * v2_quote_entry_codec::size) [[unlikely]] return 0;
+			h.request_.type_ = client_request_type::MASS_QUOTE;
+			for (size_t i = 0; i < message.count_; ++i) {
+				const auto e = v2_quote_entry_codec::decode(entries + i * v2_quote_entry_codec::size);
+				const auto reference_price = reference_price_of(reference_prices, e.instrument_id_);
+				if (e.bid_order_id_ != V2_INVALID_ORDER_ID) {
+					add_entry(e.instrument_id_, e.bid_order_id_, side_t::BUY, from_v2_price(e.bid_price_, reference_price), e.bid_qty_);
+				}
+				if (e.ask_order_id_ != V2_INVALID_ORDER_ID) {
+					add_entry(e.instrument_id_, e.ask_order_id_, side_t::SELL, from_v2_price(e.ask_price_, reference_price), e.ask_qty_);
+				}
+			}
+		} break;
+		default:
+			return 0;
+		}
+
+		h.request_.qty_ = static_cast<quantity_t>(count - 1);
+		return count;
+	}
+
+	inline auto encode_v2_response(const client_response_external& response, const reference_price_table& reference_prices, char* buffer) noexcept -> size_t {
+		const auto& r = response.response_;
+		v2_response_codec::encode({ { v2_message_type::RESPONSE, v2_response_codec::size }, static_cast<uint32_t>(response.sequence_number_), r.type_,
+			r.instrument_id_, to_v2_order_id(r.client_order_id_), r.market_order_id_, r.side_,
+			to_v2_price(r.price_, reference_price_of(reference_prices, r.instrument_id_)), r.exec_qty_, r.leaves_qty_ }, buffer);
+		return v2_response_codec::size;
+	}
+
+	inline auto decode_v2_response(const char* frame, client_id_t client_id, uint64_t expected_sequence_number,
+		const reference_price_table& reference_prices) noexcept -> client_response_external {
+		const auto message = v2_response_codec::decode(frame);
+		return { extend_sequence_number(message.sequence_number_, expected_sequence_number),
+			{ message.type_, client_id, message.instrument_id_, from_v2_order_id(message.client_order_id_), message.market_order_id_, message.side_,
+			  from_v2_price(message.price_, reference_price_of(reference_prices, message.instrument_id_)), message.exec_qty_, message.leaves_qty_ } };
+	}
+
+	inline auto encode_v2_market_update(const client_market_update& update, const reference_price_table& reference_prices, char* buffer) noexcept -> size_t {
+		const auto& u = update.update_;
+		v2_market_update_codec::encode({ { v2_message_type::MARKET_UPDATE, v2_market_update_codec::size }, static_cast<uint32_t>(update.sequence_number_),
+			u.type_, u.instrument_id_, u.order_id_, u.side_, to_v2_price(u.price_, reference_price_of(reference_prices, u.instrument_id_)), u.qty_,
+			to_v2_priority(u.priority_) }, buffer);
+		return v2_market_update_codec::size;
+	}
+
+	inline auto decode_v2_market_update(const char* frame, uint64_t expected_sequence_number, const reference_price_table& reference_prices) noexcept -> client_market_update {
+		const auto message = v2_market_update_codec::decode(frame);
+		return { extend_sequence_number(message.sequence_number_, expected_sequence_number),
+			{ message.type_, message.order_id_, message.instrument_id_, message.side_,
+			  from_v2_price(message.price_, reference_price_of(reference_prices, message.instrument_id_)), message.qty_, from_v2_priority(message.priority_) } };
+	}
+}
@@ -6,27 +6,65 @@
 #include "models/client_request.hpp"
 
 #include <algorithm>
-#include <array>
 #include <string>
+#include <vector>
 
 namespace kse::server
 {
 	constexpr size_t MAX_PENDING_REQUESTS = 1024;
 
+	struct sequencer_config {
+		/// Requests are held until the oldest pending one is this old; 0 publishes on every event loop iteration.
+		utils::nananoseconds_t batch_window_ = 0;
+		/// Publish as soon as this many requests are pending, regardless of the window; 0 disables the size trigger.
+		size_t max_batch_size_ = 0;
+	};
+
+	/**
+	 * Orders requests from all connections by receive time before handing them to the matching engine.
+	 * Requests of one connection arrive already in time order, so each connection keeps its own stream
+	 * and a batch is published by a k-way merge of the stream heads: O(n log k) for n requests from k clients.
+	 * Streams grow on demand, and a batch never publishes more than the matching engine queue can take;
+	 * whatever does not fit stays pending for the next call. A client's batch request (header and entries)
+	 * is published as one unit: contiguously, and only once it fits whole. Requests the exchange issues itself
+	 * carry INVALID_CLIENT_ID and have a stream of their own.
+	 */
 	class fifo_sequencer
 	{
+		/// Requests stamped with the same time are ordered by arrival, so frames from one read keep their order.
 		struct timed_client_request {
 			utils::nananoseconds_t recv_time_ = 0;
+			size_t arrival_index_ = 0;
 			models::client_request_internal request_;
 
-			auto operator<(const timed_client_request& rhs) {
-				return recv_time_ < rhs.recv_time_;
+			auto operator<(const timed_client_request& rhs) const {
+				return recv_time_ < rhs.recv_time_ || (recv_time_ == rhs.recv_time_ && arrival_index_ < rhs.arrival_index_);
 			}
 		};
 
+		struct client_stream {
+			std::vector<timed_client_request> requests_;
+			size_t next_ = 0;
+
+			auto empty() const { return next_ == requests_.size(); }
+			auto head() const -> const timed_client_request& { return requests_[next_]; }
+		};
+
+		struct stream_head {
+			timed_client_request const* request_ = nullptr;
+			size_t stream_ = 0;
+
+			/// Inverted so std::push_heap/pop_heap keep the earliest request on top.
+			auto operator<(const stream_head& rhs) const { return *rhs.request_ < *request_; }
+		};
+
 	public:
-		fifo_sequencer(models::client_request_queue* incoming_messsages, utils::logger* logger): 
-			incoming_requests_{ incoming_messsages }, logger_{ logger } {};
+		fifo_sequencer(models::client_request_queue* incoming_messsages, utils::logger* logger, const sequencer_config& config = {}):
+			incoming_requests_{ incoming_messsages }, logger_{ logger }, config_{ config } {
+			streams_.resize(models::MAX_NUM_CLIENTS + 1);
+			active_streams_.reserve(models::MAX_NUM_CLIENTS);
+			heads_.reserve(models::MAX_NUM_CLIENTS);
+		};
 		fifo_sequencer(fifo_sequencer const&) = delete;
 		fifo_sequencer(fifo_sequencer&&) = delete;
 		fifo_sequencer& operator=(fifo_sequencer const&) = delete;
@@ -34,44 +72,145 @@ namespace kse::server
 
 
 		auto add_request(utils::nananoseconds_t rx_time, const models::client_request_internal& request) -> void {
-			if (pending_size_ >= pending_client_requests_.size()) {
-				utils::FATAL("Too many pending requests");
+			const auto stream_index = get_stream_index(request.client_id_);
+			if (stream_index >= streams_.size()) [[unlikely]] {
+				streams_.resize(stream_index + 1);
+			}
+
+			auto& stream = streams_[stream_index];
+			if (stream.empty()) {
+				stream.requests_.clear();
+				stream.next_ = 0;
+				active_streams_.push_back(stream_index);
+			}
+
+			// The merge relies on every stream being sorted; a stamp can only go backwards if the caller mixes clocks.
+			if (!stream.requests_.empty() && rx_time < stream.requests_.back().recv_time_) [[unlikely]] {
+				rx_time = stream.requests_.back().recv_time_;
+			}
+
+			if (!pending_size_ || rx_time < oldest_recv_time_) {
+				oldest_recv_time_ = rx_time;
+			}
+
+			stream.requests_.push_back(timed_client_request{ rx_time, next_arrival_index_++, request });
+			++pending_size_;
+		}
+
+		/// Queues a batch header and its entries. They share the receive time and take consecutive arrival indices, so no other request can be merged in between.
+		auto add_batch(utils::nananoseconds_t rx_time, const models::client_request_internal& header, const models::client_request_internal* entries) -> void {
+			add_request(rx_time, header);
+			for (size_t i = 0; i + 1 < models::batch_length(header); ++i) {
+				add_request(rx_time, entries[i]);
+			}
+		}
+
+		/// True once the pending batch should be published under the configured window and size limits.
+		auto is_ready(utils::nananoseconds_t now) const -> bool {
+			if (!pending_size_) {
+				return false;
 			}
-			pending_client_requests_.at(pending_size_++) = timed_client_request{ rx_time, request };
+			return config_.batch_window_ <= 0 || now - oldest_recv_time_ >= config_.batch_window_ ||
+				(config_.max_batch_size_ && pending_size_ >= config_.max_batch_size_);
 		}
 
 		auto sequence_and_publish() -> void {
 			if (!pending_size_) [[unlikely]]
 				return;
 
-			logger_->debug_log("%:% %() % Processing % requests.\n", __FILE__, __LINE__, __func__, utils::get_curren_time_str(&time_str_), pending_size_);
+			const auto free_slots = incoming_requests_->capacity() - incoming_requests_->size();
 
-			std::sort(pending_client_requests_.begin(), pending_client_requests_.begin() + pending_size_);
+			logger_->debug_log("%:% %() % Processing up to % of % requests from % clients.\n", __FILE__, __LINE__, __func__,
+				utils::get_curren_time_str(&time_str_), free_slots, pending_size_, active_streams_.size());
+
+			heads_.clear();
+			for (const auto stream_index : active_streams_) {
+				heads_.push_back({ &streams_[stream_index].head(), stream_index });
+			}
+			std::make_heap(heads_.begin(), heads_.end());
+
+			size_t batch_size = 0;
+			while (!heads_.empty()) {
+				std::pop_heap(heads_.begin(), heads_.end());
+				auto& stream = streams_[heads_.back().stream_];
+
+				// A batch request goes out whole or waits, so the engine never sees a header without all of its entries.
+				const auto length = models::batch_length(stream.head().request_);
+				if (batch_size + length > free_slots) [[unlikely]] {
+					std::push_heap(heads_.begin(), heads_.end());
+					break;
+				}
+
+				for (size_t i = 0; i < length; ++i) {
+					const auto& client_request = stream.head();
+
+					logger_->debug_log("%:% %() % Writing RX:% Req:% to FIFO.\n", __FILE__, __LINE__, __func__, utils::get_curren_time_str(&time_str_),
+						client_request.recv_time_, client_request.request_.to_string());
+
+					auto next_write = incoming_requests_->get_next_write_element();
+					*next_write = client_request.request_;
+					incoming_requests_->next_write_index();
+					TIME_MEASURE(T2_OrderServer_LFQueue_write, (*logger_), time_str_);
+
+					++stream.next_;
+				}
+				batch_size += length;
+
+				if (stream.empty()) {
+					heads_.pop_back();
+				}
+				else {
+					heads_.back().request_ = &stream.head();
+					std::push_heap(heads_.begin(), heads_.end());
+				}
+			}
 
-			for (size_t i = 0; i < pending_size_; ++i) {
-				const auto& client_request = pending_client_requests_.at(i);
+			pending_size_ -= batch_size;
 
-				logger_->debug_log("%:% %() % Writing RX:% Req:% to FIFO.\n", __FILE__, __LINE__, __func__, utils::get_curren_time_str(&time_str_),
-					client_request.recv_time_, client_request.request_.to_string());
+			if (pending_size_) [[unlikely]] {
+				logger_->log("%:% %() % Matching engine queue full, % requests left pending.\n", __FILE__, __LINE__, __func__,
+					utils::get_curren_time_str(&time_str_), pending_size_);
+			}
 
-				auto next_write = incoming_requests_->get_next_write_element();
-				*next_write = client_request.request_;
-				incoming_requests_->next_write_index();
-				TIME_MEASURE(T2_OrderServer_LFQueue_write, (*logger_), time_str_);
+			// Drained streams are recycled on their next add_request, keeping their capacity.
+			active_streams_.clear();
+			for (const auto& head : heads_) {
+				active_streams_.push_back(head.stream_);
+			}
+			if (!heads_.empty()) {
+				oldest_recv_time_ = std::min_element(heads_.begin(), heads_.end(), [](const auto& lhs, const auto& rhs) {
+					return *lhs.request_ < *rhs.request_;
+				})->request_->recv_time_;
 			}
 
-			pending_size_ = 0;
+			for (const auto stream_index : active_streams_) {
+				auto& stream = streams_[stream_index];
+				stream.requests_.erase(stream.requests_.begin(), stream.requests_.begin() + stream.next_);
+				stream.next_ = 0;
+			}
 		}
 
 		auto is_empty() -> bool { return !pending_size_; }
 		auto size() -> size_t { return pending_size_; }
 	private:
+		/// Stream 0 belongs to the exchange, client streams follow.
+		static auto get_stream_index(models::client_id_t client_id) noexcept -> size_t {
+			return client_id == models::INVALID_CLIENT_ID ? 0 : static_cast<size_t>(client_id) + 1;
+		}
+
 		models::client_request_queue* incoming_requests_ = nullptr;
 
 		std::string time_str_;
 		utils::logger* logger_ = nullptr;
-		std::array<timed_client_request, MAX_PENDING_REQUESTS> pending_client_requests_;
+		sequencer_config config_;
+
+		std::vector<client_stream> streams_;
+		std::vector<size_t> active_streams_; //stream indices
+		std::vector<stream_head> heads_;
+
 		size_t pending_size_ = 0;
+		size_t next_arrival_index_ = 0;
+		utils::nananoseconds_t oldest_recv_time_ = 0;
 	};
 
-}
\ No newline at end of file
+}
@@ -22,24 +22,17 @@ auto kse::server::order_server::handle_new_connection(uv_stream_t* server, int s
 	uv_tcp_init(loop_, conn->handle_);
 	uv_tcp_nodelay(conn->handle_, 1);
 
-	uv_async_init(loop_, conn->async_write_msg_, write_message);
-
-	conn->async_write_msg_->data = conn.get();
-
-
 	if (uv_accept(server, (uv_stream_t*)conn->handle_) == 0) {
-		logger_.log("%:% %() % have_new_connection for clientID: %\n", __FILE__, __LINE__, __func__, utils::get_curren_time_str(&time_str_), next_client_id_);
+		logger_.log("%:% %() % have_new_connection, waiting for logon\n", __FILE__, __LINE__, __func__, utils::get_curren_time_str(&time_str_));
 
 		conn->handle_->data = conn.get();
 
-		send_connection_accepted_response(next_client_id_);
-
 		uv_read_start((uv_stream_t*)conn->handle_, alloc_buffer, on_read);
 
-		client_connections_.at(next_client_id_++) = std::move(conn);
+		auto* key = conn.get();
+		connections_.emplace(key, std::move(conn));
 	}
 	else {
-		uv_close((uv_handle_t*)conn->handle_, nullptr);
 		logger_.log("%:% %() %  can't establish connection\n", __FILE__, __LINE__, __func__, utils::get_curren_time_str(&time_str_));
 	}
 }
@@ -47,12 +40,16 @@ auto kse::server::order_server::handle_new_connection(uv_stream_t* server, int s
 auto kse::server::alloc_buffer(uv_handle_t* handle, size_t suggested_size [[maybe_unused]], uv_buf_t* buf) -> void
 {
 	tcp_connection_t* conn = static_cast<tcp_connection_t*>(handle->data);
-	buf->base = conn->inbound_data_.data();
-	buf->len = static_cast<unsigned long>(conn->inbound_data_.size());
+	// Append after the bytes still buffered: a partial frame, or frames held back by the throttle.
+	buf->base = conn->inbound_data_.data() + conn->next_rcv_valid_index_;
+	buf->len = static_cast<unsigned long>(conn->inbound_data_.size() - conn->next_rcv_valid_index_);
 }
 
 auto kse::server::on_read(uv_stream_t* stream, ssize_t nread, const uv_buf_t* buf [[maybe_unused]] ) -> void
 {
+	// Stamp before any logging so the receive time reflects when the bytes were handed to us, not our own overhead.
+	const utils::nananoseconds_t user_time = utils::get_monotonic_timestamp();
+
 	auto& self = order_server::get_instance();
 	TIME_MEASURE(T1_OrderServer_TCP_read, self.logger_, self.time_str_);
 	tcp_connection_t* conn = static_cast<tcp_connection_t*>(stream->data);
@@ -65,13 +62,11 @@ auto kse::server::on_read(uv_stream_t* stream, ssize_t nread, const uv_buf_t* bu
 			self.logger_.log("%:% %() %   read error\n", __FILE__, __LINE__, __func__, utils::get_curren_time_str(&self.time_str_));
 		}
 
-		uv_close((uv_handle_t*)stream, nullptr);
+		self.close_connection(conn);
 	}
 	else if (nread > 0) {
 		conn->next_rcv_valid_index_ += nread;
 
-		const utils::nananoseconds_t user_time = uv_now(self.loop_) * utils::NANOS_PER_MILLIS;
-
 		self.logger_.debug_log("%:% %() % read socket: len:% utime:% \n", __FILE__, __LINE__, __func__,
 			utils::get_curren_time_str(&self.time_str_), conn->next_rcv_valid_index_, user_time);
 
@@ -84,87 +79,741 @@ auto kse::server::order_server::read_data(tcp_connection_t* conn, utils::nananos
 	logger_.log("%:% %() % Received socket:len:% rx:%\n", __FILE__, __LINE__, __func__, utils::get_curren_time_str(&time_str_),
 		conn->next_rcv_valid_index_, user_time);
 
-	if (conn->next_rcv_valid_index_ >= sizeof(models::client_request_external)) {
-		size_t i = 0;
-		for (; i + sizeof(models::client_request_external) <= conn->next_rcv_valid_index_; i += sizeof(models::client_request_external)) {
+	size_t i = 0;
+	while (i < conn->next_rcv_valid_index_) {
+		const auto* frame = conn->inbound_data_.data() + i;
+		const auto available = conn->next_rcv_valid_index_ - i;
+
+		if (conn->protocol_version_ == models::protocol_version::V1 && !models::is_v2_frame_start(*frame)) [[likely]] {
+			if (available < sizeof(models::client_request_external)) {
+				break;
+			}
+
 			START_MEASURE(Exchange_odsDeserialization);
-			auto request = deserialize_client_request(conn->inbound_data_.data() + i);
+			auto request = deserialize_client_request(frame);
 			END_MEASURE(Exchange_odsDeserialization, logger_, time_str_);
-			
-			logger_.debug_log("%:% %() % Received %\n", __FILE__, __LINE__, __func__, utils::get_curren_time_str(&time_str_), request.to_string());
 
-			if (client_connections_[request.request_.client_id_].get() != conn) [[unlikely]] {
-				logger_.debug_log("%:% %() % Invalid socket for this ClientRequest from ClientId:% \n", __FILE__, __LINE__, __func__,
-					utils::get_curren_time_str(&time_str_), request.request_.client_id_);
-				send_invalid_response(request.request_.client_id_);
-				continue;
+			// A batch header is followed by its entries as separate frames; it is handled once they are all buffered.
+			const auto length = models::batch_length(request.request_);
+			if (available < length * sizeof(models::client_request_external)) [[unlikely]] {
+				break;
 			}
 
-			auto& next_incoming_seq_num = client_next_incoming_seq_num_[request.request_.client_id_];
-
-			if (request.sequence_number_ != next_incoming_seq_num) [[unlikely]] {
-				logger_.debug_log("%:% %() % Incorrect sequence number. ClientId:% SeqNum expected:% received:%\n", __FILE__, __LINE__, __func__,
-					utils::get_curren_time_str(&time_str_), request.request_.client_id_, next_incoming_seq_num, request.sequence_number_);
-				send_invalid_response(request.request_.client_id_);
-				continue;
+			if (request.request_.type_ == models::client_request_type::LOGON) [[unlikely]] {
+				handle_logon(conn, request);
+			}
+			else if (!conn->session_) [[unlikely]] {
+				logger_.log("%:% %() % Request received before logon %\n", __FILE__, __LINE__, __func__,
+					utils::get_curren_time_str(&time_str_), request.to_string());
+				send_unsequenced_response(conn, models::client_response_type::INVALID_REQUEST, request.request_.client_id_);
+			}
+			else {
+				const auto action = admit_frame(conn, user_time);
+				if (action == throttle_action::DEFER) [[unlikely]] {
+					break;
+				}
+
+				if (length > 1) [[unlikely]] {
+					batch_requests_[0] = request;
+					for (size_t entry = 1; entry < length; ++entry) {
+						batch_requests_[entry] = deserialize_client_request(frame + entry * sizeof(models::client_request_external));
+					}
+					process_batch(conn->session_, batch_requests_.data(), user_time, action == throttle_action::REJECT);
+				}
+				else {
+					process_request(conn->session_, request, user_time, action == throttle_action::REJECT);
+				}
 			}
+			i += length * sizeof(models::client_request_external);
+			continue;
+		}
+
+		if (available < sizeof(models::v2_header)) {
+			break;
+		}
+
+		const auto header = models::peek_v2_header(frame);
+		if (header.length_ < sizeof(models::v2_header)) [[unlikely]] {
+			logger_.log("%:% %() % Malformed v2 frame, dropping % buffered bytes\n", __FILE__, __LINE__, __func__,
+				utils::get_curren_time_str(&time_str_), available);
+			send_unsequenced_response(conn, models::client_response_type::INVALID_REQUEST, conn->session_ ? conn->session_->client_id_ : models::INVALID_CLIENT_ID);
+			i = conn->next_rcv_valid_index_;
+			break;
+		}
+
+		if (available < header.length_) {
+			break;
+		}
+
+		const auto action = admit_frame(conn, user_time);
+		if (action == throttle_action::DEFER) [[unlikely]] {
+			break;
+		}
+
+		process_v2_frame(conn, frame, user_time, action == throttle_action::REJECT);
+		i += header.length_;
+	}
+
+	conn->shift_inbound_buffer(i);
+}
+
+auto kse::server::order_server::admit_frame(tcp_connection_t* conn, utils::nananoseconds_t user_time) -> throttle_action
+{
+	auto* session = conn->session_;
+	if (!session) [[unlikely]] {
+		return throttle_action::ADMIT;
+	}
+
+	const auto action = session->throttle_.admit(user_time, throttle_config_.policy_);
+
+	if (action == throttle_action::DEFER && !conn->throttled_) {
+		// Stop reading so the backlog waits in this connection's socket buffers instead of the sequencer, and poll for tokens.
+		logger_.debug_log("%:% %() % Throttling ClientId:%\n", __FILE__, __LINE__, __func__, utils::get_curren_time_str(&time_str_), session->client_id_);
+		conn->throttled_ = true;
+		uv_read_stop((uv_stream_t*)conn->handle_);
+		throttled_connections_.push_back(conn);
+		uv_idle_start(idle_, on_idle);
+	}
+
+	return action;
+}
+
+auto kse::server::order_server::resume_throttled_connections(utils::nananoseconds_t now) -> void
+{
+	for (size_t i = 0; i < throttled_connections_.size();) {
+		auto* conn = throttled_connections_[i];
+		if (!conn->session_->throttle_.bucket_.has_token(now)) {
+			++i;
+			continue;
+		}
+
+		throttled_connections_[i] = throttled_connections_.back();
+		throttled_connections_.pop_back();
+		conn->throttled_ = false;
+
+		// Held back frames are stamped with the time they are admitted, so they cannot jump ahead of requests that arrived meanwhile.
+		read_data(conn, now);
+
+		if (!conn->throttled_) {
+			uv_read_start((uv_stream_t*)conn->handle_, alloc_buffer, on_read);
+		}
+	}
+}
+
+auto kse::server::order_server::process_v2_frame(tcp_connection_t* conn, const char* frame, utils::nananoseconds_t user_time, bool throttled) -> void
+{
+	const auto header = models::peek_v2_header(frame);
+	auto* session = conn->session_;
+
+	if (!session) [[unlikely]] {
+		logger_.log("%:% %() % v2 message received before logon\n", __FILE__, __LINE__, __func__, utils::get_curren_time_str(&time_str_));
+		send_unsequenced_response(conn, models::client_response_type::INVALID_REQUEST, models::INVALID_CLIENT_ID);
+		return;
+	}
+
+	if (header.type_ == models::v2_message_type::HELLO) {
+		if (header.length_ != models::v2_hello_codec::size || conn->negotiated_) [[unlikely]] {
+			send_invalid_response(session->client_id_);
+			return;
+		}
+		negotiate_protocol(conn, models::v2_hello_codec::decode(frame));
+		return;
+	}
+
+	if (conn->protocol_version_ != models::protocol_version::V2) [[unlikely]] {
+		logger_.log("%:% %() % v2 message received before negotiation from ClientId:%\n", __FILE__, __LINE__, __func__,
+			utils::get_curren_time_str(&time_str_), session->client_id_);
+		send_invalid_response(session->client_id_);
+		return;
+	}
+
+	if (models::is_v2_batch_message(header.type_)) [[unlikely]] {
+		START_MEASURE(Exchange_odsDeserialization);
+		const auto length = models::decode_v2_batch(frame, session->client_id_, session->next_incoming_seq_num_, reference_prices_, batch_requests_.data());
+		END_MEASURE(Exchange_odsDeserialization, logger_, time_str_);
+
+		if (!length) [[unlikely]] {
+			logger_.log("%:% %() % Malformed v2 batch type:% len:% from ClientId:%\n", __FILE__, __LINE__, __func__,
+				utils::get_curren_time_str(&time_str_), static_cast<unsigned>(header.type_), static_cast<unsigned>(header.length_), session->client_id_);
+			send_invalid_response(session->client_id_);
+			return;
+		}
+
+		process_batch(session, batch_requests_.data(), user_time, throttled);
+		return;
+	}
+
+	models::client_request_external request;
+
+	START_MEASURE(Exchange_odsDeserialization);
+	const auto decoded = models::decode_v2_request(frame, session->client_id_, session->next_incoming_seq_num_, reference_prices_, &request);
+	END_MEASURE(Exchange_odsDeserialization, logger_, time_str_);
+
+	if (!decoded) [[unlikely]] {
+		logger_.log("%:% %() % Unsupported v2 message type:% len:% from ClientId:%\n", __FILE__, __LINE__, __func__,
+			utils::get_curren_time_str(&time_str_), static_cast<unsigned>(header.type_), static_cast<unsigned>(header.length_), session->client_id_);
+		send_invalid_response(session->client_id_);
+		return;
+	}
+
+	process_request(session, request, user_time, throttled);
+}
 
-			++next_incoming_seq_num;
+auto kse::server::order_server::negotiate_protocol(tcp_connection_t* conn, const models::v2_hello& hello) -> void
+{
+	const auto requested = static_cast<uint8_t>(hello.version_);
+	const auto supported = static_cast<uint8_t>(models::LATEST_PROTOCOL_VERSION);
+
+	const auto version = hello.magic_ != models::V2_HELLO_MAGIC || requested < static_cast<uint8_t>(models::protocol_version::V1) ?
+		models::protocol_version::V1 : static_cast<models::protocol_version>(std::min(requested, supported));
+
+	logger_.log("%:% %() % ClientId:% requested protocol v% negotiated v%\n", __FILE__, __LINE__, __func__,
+		utils::get_curren_time_str(&time_str_), conn->session_->client_id_, static_cast<unsigned>(requested), static_cast<unsigned>(version));
+
+	conn->protocol_version_ = version;
+	conn->negotiated_ = true;
+	request_protocol_switch(conn->session_->client_id_, version);
+}
+
+auto kse::server::order_server::process_request(client_session* session, const models::client_request_external& request, utils::nananoseconds_t user_time, bool throttled) -> void
+{
+	logger_.debug_log("%:% %() % Received %\n", __FILE__, __LINE__, __func__, utils::get_curren_time_str(&time_str_), request.to_string());
+
+	if (request.request_.client_id_ != session->client_id_) [[unlikely]] {
+		logger_.debug_log("%:% %() % Invalid socket for this ClientRequest from ClientId:% \n", __FILE__, __LINE__, __func__,
+			utils::get_curren_time_str(&time_str_), request.request_.client_id_);
+		send_invalid_response(session->client_id_);
+		return;
+	}
 
-			START_MEASURE(Exchange_FIFOSequencer_addClientRequest);
-			fifo_sequencer_.add_request(user_time, request.request_);
-			END_MEASURE(Exchange_FIFOSequencer_addClientRequest, logger_, time_str_);
+	if (throttled && request.request_.type_ == models::client_request_type::RESEND) [[unlikely]] {
+		logger_.log("%:% %() % Throttled resend request from ClientId:%\n", __FILE__, __LINE__, __func__,
+			utils::get_curren_time_str(&time_str_), session->client_id_);
+		send_risk_reject(session->client_id_, request.request_, risk_reject_reason::MESSAGE_RATE);
+		return;
+	}
+
+	if (request.request_.type_ == models::client_request_type::RESEND) [[unlikely]] {
+		logger_.log("%:% %() % ClientId:% requested resend from seq:%\n", __FILE__, __LINE__, __func__,
+			utils::get_curren_time_str(&time_str_), session->client_id_, request.request_.order_id_);
+		request_resend(session->client_id_, request.request_.order_id_);
+		return;
+	}
+
+	if (!accept_sequence_number(session, request)) [[unlikely]] {
+		return;
+	}
+
+	START_MEASURE(Exchange_RiskGate_check);
+	const auto reject_reason = throttled ? risk_reject_reason::MESSAGE_RATE : risk_gate_.check(session->risk_, request.request_);
+	END_MEASURE(Exchange_RiskGate_check, logger_, time_str_);
+
+	if (reject_reason != risk_reject_reason::NONE) [[unlikely]] {
+		logger_.log("%:% %() % Risk rejected % reason:%\n", __FILE__, __LINE__, __func__,
+			utils::get_curren_time_str(&time_str_), request.to_string(), risk_reject_reason_to_string(reject_reason));
+		send_risk_reject(session->client_id_, request.request_, reject_reason);
+		return;
+	}
+
+	auto sequenced_request = request.request_;
+	sequenced_request.stp_mode_ = session->stp_mode_;
+
+	START_MEASURE(Exchange_FIFOSequencer_addClientRequest);
+	fifo_sequencer_.add_request(user_time, sequenced_request);
+	END_MEASURE(Exchange_FIFOSequencer_addClientRequest, logger_, time_str_);
+}
+
+auto kse::server::order_server::process_batch(client_session* session, const models::client_request_external* batch, utils::nananoseconds_t user_time, bool throttled) -> void
+{
+	const auto& header = batch[0];
+	const auto num_entries = models::batch_length(header.request_) - 1;
+
+	logger_.debug_log("%:% %() % Received batch of % %\n", __FILE__, __LINE__, __func__, utils::get_curren_time_str(&time_str_), num_entries, header.to_string());
+
+	for (size_t i = 0; i <= num_entries; ++i) {
+		if (batch[i].request_.client_id_ != session->client_id_) [[unlikely]] {
+			logger_.debug_log("%:% %() % Invalid socket for this batch from ClientId:% \n", __FILE__, __LINE__, __func__,
+				utils::get_curren_time_str(&time_str_), batch[i].request_.client_id_);
+			send_invalid_response(session->client_id_);
+			return;
 		}
-		conn->shift_inbound_buffer(i);
 	}
+
+	// The whole batch takes one sequence number and one throttle token.
+	if (!accept_sequence_number(session, header)) [[unlikely]] {
+		return;
+	}
+
+	for (size_t i = 0; i < num_entries; ++i) {
+		batch_entries_[i] = batch[i + 1].request_;
+		batch_entries_[i].stp_mode_ = session->stp_mode_;
+	}
+
+	START_MEASURE(Exchange_RiskGate_check);
+	const auto reject_reason = throttled ? risk_reject_reason::MESSAGE_RATE : risk_gate_.check_batch(session->risk_, header.request_, batch_entries_.data());
+	END_MEASURE(Exchange_RiskGate_check, logger_, time_str_);
+
+	if (reject_reason != risk_reject_reason::NONE) [[unlikely]] {
+		logger_.log("%:% %() % Risk rejected batch % reason:%\n", __FILE__, __LINE__, __func__,
+			utils::get_curren_time_str(&time_str_), header.to_string(), risk_reject_reason_to_string(reject_reason));
+		send_risk_reject(session->client_id_, header.request_, reject_reason);
+		return;
+	}
+
+	START_MEASURE(Exchange_FIFOSequencer_addClientRequest);
+	fifo_sequencer_.add_batch(user_time, header.request_, batch_entries_.data());
+	END_MEASURE(Exchange_FIFOSequencer_addClientRequest, logger_, time_str_);
+}
+
+auto kse::server::order_server::accept_sequence_number(client_session* session, const models::client_request_external& request) -> bool
+{
+	auto& next_incoming_seq_num = session->next_incoming_seq_num_;
+
+	if (request.sequence_number_ != next_incoming_seq_num) [[unlikely]] {
+		logger_.debug_log("%:% %() % Incorrect sequence number. ClientId:% SeqNum expected:% received:%\n", __FILE__, __LINE__, __func__,
+			utils::get_curren_time_str(&time_str_), request.request_.client_id_, next_incoming_seq_num, request.sequence_number_);
+		send_invalid_response(session->client_id_);
+		return false;
+	}
+
+	++next_incoming_seq_num;
+	return true;
+}
+
+auto kse::server::order_server::handle_logon(tcp_connection_t* conn, const models::client_request_external& request) -> void
+{
+	if (conn->session_) [[unlikely]] {
+		logger_.log("%:% %() % Duplicate logon on the connection of ClientId:%\n", __FILE__, __LINE__, __func__,
+			utils::get_curren_time_str(&time_str_), conn->session_->client_id_);
+		send_invalid_response(conn->session_->client_id_);
+		return;
+	}
+
+	auto* session = logon_session(request, session_transport::TCP);
+	if (!session) [[unlikely]] {
+		send_unsequenced_response(conn, models::client_response_type::LOGON_REJECTED, request.request_.client_id_);
+		return;
+	}
+
+	session->connection_ = conn;
+	conn->session_ = session;
+
+	begin_session(*session, request);
 }
 
-auto kse::server::order_server::write_to_socket(tcp_connection_t* conn) -> void
+auto kse::server::order_server::handle_shm_logon(shm_connection_t& conn, const models::client_request_external& request) -> void
 {
-	for (auto* data_index = conn->write_queue_.get_next_read_element();
-		conn->write_queue_.size() && data_index;
-		data_index = conn->write_queue_.get_next_read_element()) {
-		uv_buf_t buf = uv_buf_init(conn->get_response_buffer(*data_index), static_cast<unsigned int>(sizeof(models::client_response_external)));
+	if (conn.session_) [[unlikely]] {
+		logger_.log("%:% %() % Duplicate logon on the shared memory channel of ClientId:%\n", __FILE__, __LINE__, __func__,
+			utils::get_curren_time_str(&time_str_), conn.session_->client_id_);
+		send_invalid_response(conn.session_->client_id_);
+		return;
+	}
+
+	auto* session = logon_session(request, session_transport::SHM);
+	if (!session) [[unlikely]] {
+		push_shm_unsequenced_response(conn, models::client_response_type::LOGON_REJECTED, request.request_.client_id_);
+		return;
+	}
+
+	session->shm_connection_ = &conn;
+	conn.session_ = session;
+
+	begin_session(*session, request);
+}
+
+auto kse::server::order_server::logon_session(const models::client_request_external& request, session_transport transport) -> client_session*
+{
+	const auto requested_id = request.request_.client_id_;
+
+	if (request.request_.stp_mode_ > models::stp_mode_t::DECREMENT) [[unlikely]] {
+		logger_.log("%:% %() % Rejected logon for ClientId:% with stp mode:%\n", __FILE__, __LINE__, __func__,
+			utils::get_curren_time_str(&time_str_), models::client_id_to_string(requested_id), static_cast<int>(request.request_.stp_mode_));
+		return nullptr;
+	}
+
+	auto* session = sessions_.logon(requested_id);
+	if (!session) [[unlikely]] {
+		logger_.log("%:% %() % Rejected logon for ClientId:% (% of % sessions in use)\n", __FILE__, __LINE__, __func__,
+			utils::get_curren_time_str(&time_str_), models::client_id_to_string(requested_id), sessions_.size(), sessions_.capacity());
+		return nullptr;
+	}
+
+	if (!session->async_write_msg_) {
+		session->async_write_msg_ = (uv_async_t*)std::malloc(sizeof(uv_async_t));
+		uv_async_init(loop_, session->async_write_msg_, write_message);
+		session->async_write_msg_->data = session;
+	}
+
+	if (requested_id == models::INVALID_CLIENT_ID) {
+		session->throttle_.bucket_.configure(throttle_config_);
+	}
+	session->stp_mode_ = request.request_.stp_mode_;
+
+	// Anything still queued was encoded for the previous connection, possibly for another transport. The resend covers it.
+	while (session->write_queue_.size()) {
+		session->write_queue_.next_read_index();
+	}
+
+	// The response thread marks the session connected once the resend is queued.
+	session->transport_.store(transport, std::memory_order_release);
+
+	return session;
+}
+
+auto kse::server::order_server::begin_session(client_session& session, const models::client_request_external& request) -> void
+{
+	// A new session has nothing to resend. A resumed one gets everything after the last response the client saw.
+	const auto resumed = request.request_.client_id_ != models::INVALID_CLIENT_ID && request.request_.order_id_ != models::INVALID_ORDER_ID;
+	const auto resend_from = resumed ? request.request_.order_id_ + 1 : models::INVALID_ORDER_ID;
+
+	logger_.log("%:% %() % ClientId:% logged on over %, next incoming seq:% resend from:%\n", __FILE__, __LINE__, __func__,
+		utils::get_curren_time_str(&time_str_), session.client_id_, session.transport_ == session_transport::SHM ? "shm" : "tcp",
+		session.next_incoming_seq_num_, models::order_id_to_string(resend_from));
+
+	request_resend(session.client_id_, resend_from, session.next_incoming_seq_num_);
+}
+
+auto kse::server::order_server::detach_session(client_session& session) -> void
+{
+	session.connected_.store(false, std::memory_order_release);
+	session.connection_ = nullptr;
+	session.shm_connection_ = nullptr;
+	logger_.log("%:% %() % ClientId:% disconnected %\n", __FILE__, __LINE__, __func__, utils::get_curren_time_str(&time_str_),
+		session.client_id_, session.throttle_.stats().to_string());
+
+	if (cancel_on_disconnect_) {
+		// Issued by the server, so it takes no sequence number; the cancels are journaled and resent when the client resumes.
+		fifo_sequencer_.add_request(utils::get_monotonic_timestamp(), { models::client_request_type::MASS_CANCEL, session.client_id_,
+			models::INVALID_INSTRUMENT_ID, models::INVALID_ORDER_ID, models::side_t::INVALID });
+		uv_idle_start(idle_, on_idle);
+	}
+}
+
+auto kse::server::order_server::close_connection(tcp_connection_t* conn) -> void
+{
+	if (auto* session = conn->session_) {
+		detach_session(*session);
+	}
+
+	if (conn->throttled_) {
+		std::erase(throttled_connections_, conn);
+	}
+
+	connections_.erase(conn);
+}
+
+auto kse::server::order_server::send_unsequenced_response(tcp_connection_t* conn, models::client_response_type type, models::client_id_t client_id) -> void
+{
+	// Connections without a session have no response stream, so these go out directly with sequence number 0.
+	const models::client_response_external response{ 0, { type, client_id, models::INVALID_INSTRUMENT_ID, models::INVALID_ORDER_ID,
+		models::INVALID_ORDER_ID, models::side_t::INVALID, models::INVALID_PRICE, models::INVALID_QUANTITY, models::INVALID_QUANTITY } };
+
+	std::array<char, sizeof(models::client_response_external)> buffer;
+	serialize_client_response(response, buffer.data());
+
+	uv_buf_t buf = uv_buf_init(buffer.data(), static_cast<unsigned int>(buffer.size()));
+	if (uv_try_write((uv_stream_t*)conn->handle_, &buf, 1) != static_cast<int>(buffer.size())) [[unlikely]] {
+		logger_.log("%:% %() % could not send % to ClientId:%\n", __FILE__, __LINE__, __func__,
+			utils::get_curren_time_str(&time_str_), models::client_response_type_to_string(type), models::client_id_to_string(client_id));
+	}
+}
+
+auto kse::server::order_server::write_to_socket(client_session* session) -> void
+{
+	auto* conn = session->connection_;
+
+	for (auto* data_index = session->write_queue_.get_next_read_element();
+		session->write_queue_.size() && data_index;
+		data_index = session->write_queue_.get_next_read_element()) {
+		if (!conn) [[unlikely]] {
+			session->write_queue_.next_read_index();
+			continue;
+		}
+
+		uv_buf_t buf = uv_buf_init(session->get_response_buffer(data_index->index_), static_cast<unsigned int>(data_index->size_));
 		auto* writer = writer_pool_.alloc();
 
 		uv_write(writer, (uv_stream_t*)conn->handle_, &buf, 1, [](uv_write_t* req, int status) {
 			auto& self = order_server::get_instance();
 			TIME_MEASURE(T6t_OrderServer_TCP_write, self.logger_, self.time_str_);
+			self.writer_pool_.free(req);
 			if (status < 0) {
 				self.logger_.log("%:% %() % error writing data: %\n", __FILE__, __LINE__, __func__,
 					utils::get_curren_time_str(&self.time_str_), uv_strerror(status));
 				return;
 			}
-			self.writer_pool_.free(req);
 			self.logger_.log("%:% %() % send data to socket\n", __FILE__, __LINE__, __func__,
 				utils::get_curren_time_str(&self.time_str_));
 		});
 
-		conn->write_queue_.next_read_index();
+		session->write_queue_.next_read_index();
 	}
 }
 
 auto kse::server::write_message(uv_async_t* async) -> void
 {
 	auto& self = order_server::get_instance();
-	self.write_to_socket(static_cast<tcp_connection_t*>(async->data));
+	self.write_to_socket(static_cast<client_session*>(async->data));
 }
 
 auto kse::server::order_server::process_responses() -> void {
 	while (running_) {
+		process_resend_requests();
 		process_responses_helper(server_responses_);
 		process_responses_helper(*matching_engine_responses_);
 	}
 }
 
+auto kse::server::order_server::process_resend_requests() -> void
+{
+	for (auto* request = resend_requests_.get_next_read_element();
+		resend_requests_.size() && request;
+		request = resend_requests_.get_next_read_element()) {
+		auto* session = sessions_.get(request->client_id_);
+
+		if (session && request->protocol_version_ != models::protocol_version::INVALID) {
+			// A HELLO from a connection that has since gone away is dropped; the next connection negotiates again.
+			if (session->connected_.load(std::memory_order_acquire) && session->transport_.load(std::memory_order_acquire) == session_transport::TCP) {
+				session->switch_protocol(request->protocol_version_, reference_prices_);
+				uv_async_send(session->async_write_msg_);
+			}
+		}
+		else if (session) [[likely]] {
+			if (request->logon_next_incoming_seq_num_) {
+				// Every connection starts in v1 and negotiates again.
+				session->protocol_version_ = models::protocol_version::V1;
+				session->connected_.store(true, std::memory_order_release);
+			}
+
+			replay_responses(*session, request->from_sequence_number_);
+
+			if (request->logon_next_incoming_seq_num_) {
+				// LOGGED_ON is sequenced like any other response; client_order_id_ carries the next request sequence number the server expects.
+				deliver_response(*session, { models::client_response_type::LOGGED_ON, session->client_id_, models::INVALID_INSTRUMENT_ID,
+					request->logon_next_incoming_seq_num_, models::INVALID_ORDER_ID, models::side_t::INVALID, models::INVALID_PRICE,
+					models::INVALID_QUANTITY, models::INVALID_QUANTITY });
+			}
+		}
+
+		resend_requests_.next_read_index();
+	}
+}
+
+auto kse::server::order_server::replay_responses(client_session& session, uint64_t from_sequence_number) -> void
+{
+	const auto end = session.next_outgoing_seq_num_;
+	if (from_sequence_number >= end || !session.connected_.load(std::memory_order_acquire)) {
+		return;
+	}
+
+	from_sequence_number = std::max<uint64_t>(from_sequence_number, 1);
+
+	logger_response_.log("%:% %() % ClientId:% resending seq:% to %\n", __FILE__, __LINE__, __func__,
+		utils::get_curren_time_str(&time_str_response_), session.client_id_, from_sequence_number, end - 1);
+
+	// Responses that fell out of the journal are skipped with a GAP_FILL: it carries the first missing sequence number
+	// and, in client_order_id_, the sequence number that follows it.
+	const auto first_available = session.journal_.first_sequence_number();
+	if (from_sequence_number < first_available) {
+		models::client_response_internal gap_fill{ models::client_response_type::GAP_FILL, session.client_id_, models::INVALID_INSTRUMENT_ID,
+			first_available, models::INVALID_ORDER_ID, models::side_t::INVALID, models::INVALID_PRICE, models::INVALID_QUANTITY, models::INVALID_QUANTITY };
+		session.append_to_outbound_buffer(gap_fill, from_sequence_number, reference_prices_);
+		from_sequence_number = first_available;
+	}
+
+	for (auto sequence_number = from_sequence_number; sequence_number < end; ++sequence_number) {
+		auto response = session.journal_.at(sequence_number);
+		session.append_to_outbound_buffer(response, sequence_number, reference_prices_);
+	}
+
+	if (session.transport_.load(std::memory_order_acquire) == session_transport::TCP) {
+		uv_async_send(session.async_write_msg_);
+	}
+}
+
 auto kse::server::on_check(uv_check_t* req [[maybe_unused]] ) -> void
 {
 	auto& self = order_server::get_instance();
-	if (self.fifo_sequencer_.is_empty()) {
+	if (self.shm_order_entry_) {
+		self.poll_shm_channels(utils::get_monotonic_timestamp());
+	}
+
+	if (!self.throttled_connections_.empty()) [[unlikely]] {
+		self.resume_throttled_connections(utils::get_monotonic_timestamp());
+	}
+
+	if (self.exchange_requests_.size()) [[unlikely]] {
+		self.process_exchange_requests();
+	}
+
+	if (self.fifo_sequencer_.is_empty() && self.throttled_connections_.empty()) {
 		return;
 	}
 
-	START_MEASURE(Exchange_FIFOSequencer_sequenceAndPublish);
-	self.fifo_sequencer_.sequence_and_publish();
-	END_MEASURE(Exchange_FIFOSequencer_sequenceAndPublish, self.logger_, self.time_str_);
+	if (!self.fifo_sequencer_.is_empty() && self.fifo_sequencer_.is_ready(utils::get_monotonic_timestamp())) {
+		START_MEASURE(Exchange_FIFOSequencer_sequenceAndPublish);
+		self.fifo_sequencer_.sequence_and_publish();
+		END_MEASURE(Exchange_FIFOSequencer_sequenceAndPublish, self.logger_, self.time_str_);
+	}
+
+	if (self.fifo_sequencer_.is_empty() && self.throttled_connections_.empty() && !self.shm_order_entry_) {
+		uv_idle_stop(self.idle_);
+	}
+	else {
+		uv_idle_start(self.idle_, on_idle);
+	}
+}
+
+auto kse::server::on_idle(uv_idle_t* req [[maybe_unused]] ) -> void
+{
+}
+
+auto kse::server::on_exchange_request(uv_async_t* async [[maybe_unused]] ) -> void
+{
+	order_server::get_instance().process_exchange_requests();
+}
+
+auto kse::server::order_server::process_exchange_requests() -> void
+{
+	for (auto* request = exchange_requests_.get_next_read_element();
+		exchange_requests_.size() && request;
+		request = exchange_requests_.get_next_read_element()) {
+		logger_.log("%:% %() % Exchange request %\n", __FILE__, __LINE__, __func__, utils::get_curren_time_str(&time_str_), request->to_string());
+
+		fifo_sequencer_.add_request(utils::get_monotonic_timestamp(), *request);
+		exchange_requests_.next_read_index();
+	}
+	uv_idle_start(idle_, on_idle);
+}
+
+auto kse::server::order_server::poll_shm_channels(utils::nananoseconds_t now) -> void
+{
+	for (size_t i = 0; i < shm_connections_.size(); ++i) {
+		auto& channel = shm_order_entry_->channel(i);
+		const auto state = channel.state_.load(std::memory_order_acquire);
+		if (state == shm_channel_state::FREE) [[likely]] {
+			continue;
+		}
+
+		auto& conn = shm_connections_[i];
+		if (!conn.channel_) [[unlikely]] {
+			conn.channel_ = &channel;
+			conn.next_liveness_check_ = now;
+		}
+
+		// A client that exits cleanly marks its channel; one that crashes is found by checking its process once a second.
+		if (now >= conn.next_liveness_check_) [[unlikely]] {
+			const auto owner_pid = channel.owner_pid_.load(std::memory_order_acquire);
+			if (owner_pid && !utils::is_process_alive(owner_pid)) {
+				close_shm_connection(conn);
+				continue;
+			}
+			conn.next_liveness_check_ = now + utils::NANOS_PER_SECS;
+		}
+
+		if (state == shm_channel_state::DETACHING) [[unlikely]] {
+			close_shm_connection(conn);
+			continue;
+		}
+
+		read_shm_requests(conn, now);
+
+		if (conn.session_) {
+			write_shm_responses(conn);
+		}
+	}
+}
+
+auto kse::server::order_server::read_shm_requests(shm_connection_t& conn, utils::nananoseconds_t now) -> void
+{
+	auto& requests = conn.channel_->requests_;
+
+	for (auto* request = requests.get_next_read_element(); request; request = requests.get_next_read_element()) {
+		// A batch is taken off the ring only once the client has written all of its entries.
+		const auto length = models::batch_length(request->request_);
+		if (requests.size() < length) [[unlikely]] {
+			break;
+		}
+
+		if (request->request_.type_ == models::client_request_type::LOGON) [[unlikely]] {
+			handle_shm_logon(conn, *request);
+		}
+		else if (!conn.session_) [[unlikely]] {
+			logger_.log("%:% %() % Request received before logon %\n", __FILE__, __LINE__, __func__,
+				utils::get_curren_time_str(&time_str_), request->to_string());
+			push_shm_unsequenced_response(conn, models::client_response_type::INVALID_REQUEST, request->request_.client_id_);
+		}
+		else {
+			// Requests held back by the throttle wait in the ring; retry only once a token is back.
+			if (conn.throttled_ && !conn.session_->throttle_.bucket_.has_token(now)) {
+				break;
+			}
+
+			const auto action = conn.session_->throttle_.admit(now, throttle_config_.policy_);
+			conn.throttled_ = action == throttle_action::DEFER;
+			if (conn.throttled_) [[unlikely]] {
+				break;
+			}
+
+			if (length > 1) [[unlikely]] {
+				for (size_t entry = 0; entry < length; ++entry) {
+					batch_requests_[entry] = *requests.get_next_read_element();
+					requests.next_read_index();
+				}
+				process_batch(conn.session_, batch_requests_.data(), now, action == throttle_action::REJECT);
+				continue;
+			}
+
+			process_request(conn.session_, *request, now, action == throttle_action::REJECT);
+		}
+
+		for (size_t entry = 0; entry < length; ++entry) {
+			requests.next_read_index();
+		}
+	}
+}
+
+auto kse::server::order_server::write_shm_responses(shm_connection_t& conn) -> void
+{
+	auto* session = conn.session_;
+	auto& responses = conn.channel_->responses_;
+
+	// Responses are already in host order in the session's buffer, so they are copied into the ring as they are.
+	for (auto* data_index = session->write_queue_.get_next_read_element();
+		session->write_queue_.size() && data_index;
+		data_index = session->write_queue_.get_next_read_element()) {
+		auto* slot = responses.get_next_write_element();
+		if (!slot) [[unlikely]] {
+			break;
+		}
+
+		std::memcpy(slot, session->get_response_buffer(data_index->index_), sizeof(models::client_response_external));
+		responses.next_write_index();
+		session->write_queue_.next_read_index();
+	}
+}
+
+auto kse::server::order_server::push_shm_unsequenced_response(shm_connection_t& conn, models::client_response_type type, models::client_id_t client_id) -> void
+{
+	auto* slot = conn.channel_->responses_.get_next_write_element();
+	if (!slot) [[unlikely]] {
+		logger_.log("%:% %() % could not send % to ClientId:%, response ring full\n", __FILE__, __LINE__, __func__,
+			utils::get_curren_time_str(&time_str_), models::client_response_type_to_string(type), models::client_id_to_string(client_id));
+		return;
+	}
+
+	*slot = { 0, { type, client_id, models::INVALID_INSTRUMENT_ID, models::INVALID_ORDER_ID,
+		models::INVALID_ORDER_ID, models::side_t::INVALID, models::INVALID_PRICE, models::INVALID_QUANTITY, models::INVALID_QUANTITY } };
+	conn.channel_->responses_.next_write_index();
+}
+
+auto kse::server::order_server::close_shm_connection(shm_connection_t& conn) -> void
+{
+	if (auto* session = conn.session_) {
+		detach_session(*session);
+	}
+
+	shm_order_entry_->release(*conn.channel_);
+	conn = {};
 }
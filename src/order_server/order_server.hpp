@@ -7,45 +7,48 @@
 #include "utils/logger.hpp"
 #include "utils/memory_pool.hpp"
 #include <array>
+#include <atomic>
 #include <mutex>
 #include <string>
 #include <string_view>
 #include <stdlib.h>
+#include <unordered_map>
 #include <vector>
 
 #include "fifo_sequencer.hpp"
+#include "risk_gate.hpp"
 #include "serializer.hpp"
+#include "session_table.hpp"
+#include "shm_transport.hpp"
+#include "throttle.hpp"
 
 
 namespace kse::server {
 	constexpr size_t TCP_BUFFER_SIZE = 64 * 1024 * 1024;
-
-	constexpr size_t MAX_BUFFERED_RESPONSE = 1024 * 1024;
+	constexpr size_t MAX_PENDING_WRITES = 1024 * 1024; //socket writes in flight across every connection
+
+	/// Asks the response thread to resend a session's journaled responses from a sequence number on, or to switch its protocol.
+	struct resend_request {
+		models::client_id_t client_id_ = models::INVALID_CLIENT_ID;
+		uint64_t from_sequence_number_ = 0;
+		uint64_t logon_next_incoming_seq_num_ = 0; //non-zero for a logon: LOGGED_ON follows the resent responses
+		models::protocol_version protocol_version_ = models::protocol_version::INVALID; //set for a HELLO: switch and queue the HELLO_ACK
+	};
 
 	struct tcp_connection_t {
 		uv_tcp_t* handle_ = nullptr;
-		uv_async_t* async_write_msg_ = nullptr;
-		std::vector<char> outbound_data_;
-		size_t next_send_valid_index_ = 0;
+		client_session* session_ = nullptr; //set once the client has logged on
 		std::vector<char> inbound_data_;
 		size_t next_rcv_valid_index_ = 0;
+		models::protocol_version protocol_version_ = models::protocol_version::V1; //version of the client's requests
+		bool negotiated_ = false; //a HELLO was answered; a repeat is rejected
+		bool throttled_ = false; //reading is paused until the session has tokens again
 
-		utils::lock_free_queue<size_t> write_queue_; //contains index of the outbound buffer
-
-		explicit tcp_connection_t() : handle_{ (uv_tcp_t*)std::malloc(sizeof(uv_tcp_t)) }, async_write_msg_{ (uv_async_t*)std::malloc(sizeof(uv_async_t)) }, 
-			write_queue_{ MAX_BUFFERED_RESPONSE } {
-			outbound_data_.resize(sizeof(models::client_response_external) * MAX_BUFFERED_RESPONSE);
+		explicit tcp_connection_t() : handle_{ (uv_tcp_t*)std::malloc(sizeof(uv_tcp_t)) } {
 			inbound_data_.resize(TCP_BUFFER_SIZE);
 		}
 
 		~tcp_connection_t() noexcept {
-			if (async_write_msg_) {
-				if (!uv_is_closing((uv_handle_t*)async_write_msg_)) {
-					uv_close((uv_handle_t*)async_write_msg_, [](uv_handle_t* handle) { std::free(handle); });
-				}
-				async_write_msg_ = nullptr;
-			}
-
 			if (handle_) {
 				if (!uv_is_closing((uv_handle_t*)handle_)) {
 					uv_close((uv_handle_t*)handle_, [](uv_handle_t* handle) { std::free(handle); });
@@ -54,24 +57,6 @@ namespace kse::server {
 			}
 		}
 
-		auto append_to_outbound_buffer(models::client_response_internal& response, uint64_t sequence_number) -> size_t {
-			if (next_send_valid_index_ > MAX_BUFFERED_RESPONSE) [[unlikely]] {
-				next_send_valid_index_ = 0;
-			}
-
-			*write_queue_.get_next_write_element() = next_send_valid_index_;
-			write_queue_.next_write_index();
-
-			serialize_client_response({ sequence_number, std::move(response) }, get_response_buffer(next_send_valid_index_));
-			next_send_valid_index_ += 1;
-
-			return next_send_valid_index_ - 1;
-		}
-
-		auto get_response_buffer(size_t index) -> char* {
-			return outbound_data_.data() + index * sizeof(models::client_response_external);
-		}
-
 		auto shift_inbound_buffer(size_t processed_bytes) -> void {
 			if (processed_bytes > 0 && processed_bytes <= next_rcv_valid_index_) {
 				std::memmove(inbound_data_.data(), inbound_data_.data() + processed_bytes, next_rcv_valid_index_ - processed_bytes);
@@ -80,6 +65,14 @@ namespace kse::server {
 		}
 	};
 
+	/// Event loop side of a shared memory channel.
+	struct shm_connection_t {
+		shm_channel* channel_ = nullptr; //set once a client claims the channel
+		client_session* session_ = nullptr; //set once the client has logged on
+		bool throttled_ = false; //requests wait in the ring until the session has tokens again
+		utils::nananoseconds_t next_liveness_check_ = 0;
+	};
+
 	auto on_new_connection(uv_stream_t* server, int status) -> void;
 
 	auto alloc_buffer(uv_handle_t* handle, size_t suggested_size [[maybe_unused]], uv_buf_t* buf) -> void;
@@ -90,15 +83,26 @@ namespace kse::server {
 
 	auto on_check(uv_check_t* req [[maybe_unused]] ) -> void;
 
+	auto on_idle(uv_idle_t* req [[maybe_unused]] ) -> void;
+
+	auto on_exchange_request(uv_async_t* async [[maybe_unused]] ) -> void;
+
 	class order_server {
 	public:
 		static order_server& get_instance(
 			models::client_request_queue* incoming_messages = nullptr,
 			models::client_response_queue* outgoing_messages = nullptr,
 			std::string_view ip = "",
-			int port = 0)
+			int port = 0,
+			const models::reference_price_table& reference_prices = {},
+			const sequencer_config& sequencer = {},
+			const session_config& sessions = {},
+			const risk_config& risk = {},
+			const throttle_config& throttle = {},
+			std::string_view shm_segment_name = "",
+			bool cancel_on_disconnect = false)
 		{
-			static order_server instance(incoming_messages, outgoing_messages, ip, port);
+			static order_server instance(incoming_messages, outgoing_messages, ip, port, reference_prices, sequencer, sessions, risk, throttle, shm_segment_name, cancel_on_disconnect);
 			return instance;
 		}
 
@@ -136,6 +140,21 @@ namespace kse::server {
 			uv_check_init(loop_, check_);
 			uv_check_start(check_, on_check);
 
+			uv_idle_init(loop_, idle_);
+
+			uv_async_init(loop_, exchange_async_, on_exchange_request);
+			exchange_async_ready_.store(true, std::memory_order_release);
+
+			// Shared memory channels have nothing to wake the loop, so while they are enabled the loop polls them continuously.
+			if (!shm_segment_name_.empty()) {
+				shm_order_entry_ = shm_order_entry::create(shm_segment_name_);
+				if (shm_order_entry_) {
+					uv_idle_start(idle_, on_idle);
+				}
+				logger_.log("%:% %() % shared memory order entry on % %\n", __FILE__, __LINE__, __func__, utils::get_curren_time_str(&time_str_),
+					shm_segment_name_, shm_order_entry_ ? "enabled" : "could not be created");
+			}
+
 			uv_run(loop_, UV_RUN_DEFAULT);
 		}
 
@@ -156,38 +175,133 @@ namespace kse::server {
 			push_server_response(response);
 		}
 
-		auto send_connection_accepted_response(models::client_id_t client_id) -> void {
-			auto response = models::client_response_internal{ models::client_response_type::ACCEPTED, client_id, models::INVALID_INSTRUMENT_ID, models::INVALID_ORDER_ID,
-			models::INVALID_ORDER_ID, models::side_t::INVALID, models::INVALID_PRICE, models::INVALID_QUANTITY, models::INVALID_QUANTITY };
+		/// Rejects a request that failed the pre-trade checks. The reason is carried in market_order_id.
+		auto send_risk_reject(models::client_id_t client_id, const models::client_request_internal& request, risk_reject_reason reason) -> void {
+			auto response = models::client_response_internal{
+				models::client_response_type::RISK_REJECTED, client_id,
+				request.instrument_id_, request.order_id_,
+				static_cast<models::order_id_t>(reason), request.side_,
+				request.price_, 0, request.qty_
+			};
 			push_server_response(response);
 		}
 
+		auto request_resend(models::client_id_t client_id, uint64_t from_sequence_number, uint64_t logon_next_incoming_seq_num = 0) -> void {
+			*resend_requests_.get_next_write_element() = { client_id, from_sequence_number, logon_next_incoming_seq_num };
+			resend_requests_.next_write_index();
+		}
+
+		/// The response thread switches the encoding and queues the HELLO_ACK, so the ack lands between the responses of either version.
+		auto request_protocol_switch(models::client_id_t client_id, models::protocol_version version) -> void {
+			*resend_requests_.get_next_write_element() = { client_id, models::INVALID_ORDER_ID, 0, version };
+			resend_requests_.next_write_index();
+		}
+
+		/// Puts an instrument into a call phase. Exchange requests may come from one thread other than the event loop; they are sequenced with the clients' requests.
+		auto start_auction(models::instrument_id_t instrument_id) -> void {
+			push_exchange_request({ models::client_request_type::START_AUCTION, models::INVALID_CLIENT_ID, instrument_id });
+		}
+
+		/// Ends an instrument's call phase with an uncross.
+		auto uncross(models::instrument_id_t instrument_id) -> void {
+			push_exchange_request({ models::client_request_type::UNCROSS, models::INVALID_CLIENT_ID, instrument_id });
+		}
+
+		auto push_exchange_request(const models::client_request_internal& request) -> void {
+			*exchange_requests_.get_next_write_element() = request;
+			exchange_requests_.next_write_index();
+			if (exchange_async_ready_.load(std::memory_order_acquire)) {
+				uv_async_send(exchange_async_);
+			}
+		}
+
+		auto process_exchange_requests() -> void;
+
+		/// Throttle counters of a session, safe to call from any thread.
+		auto get_throttle_stats(models::client_id_t client_id) -> throttle_stats {
+			auto* session = sessions_.get(client_id);
+			return session ? session->throttle_.stats() : throttle_stats{};
+		}
+
 		auto process_responses() -> void;
 
 		auto handle_new_connection(uv_stream_t* server, int status) -> void;
 
 		auto read_data(tcp_connection_t* conn, utils::nananoseconds_t user_time) -> void;
 
-		auto write_to_socket(tcp_connection_t* conn) -> void;
+		auto admit_frame(tcp_connection_t* conn, utils::nananoseconds_t user_time) -> throttle_action;
+
+		auto resume_throttled_connections(utils::nananoseconds_t now) -> void;
+
+		auto handle_logon(tcp_connection_t* conn, const models::client_request_external& request) -> void;
+
+		auto handle_shm_logon(shm_connection_t& conn, const models::client_request_external& request) -> void;
+
+		auto logon_session(const models::client_request_external& request, session_transport transport) -> client_session*;
+
+		auto begin_session(client_session& session, const models::client_request_external& request) -> void;
+
+		auto detach_session(client_session& session) -> void;
+
+		auto close_connection(tcp_connection_t* conn) -> void;
+
+		auto send_unsequenced_response(tcp_connection_t* conn, models::client_response_type type, models::client_id_t client_id) -> void;
+
+		auto process_request(client_session* session, const models::client_request_external& request, utils::nananoseconds_t user_time, bool throttled) -> void;
+
+		auto process_batch(client_session* session, const models::client_request_external* batch, utils::nananoseconds_t user_time, bool throttled) -> void;
+
+		auto accept_sequence_number(client_session* session, const models::client_request_external& request) -> bool;
+
+		auto process_v2_frame(tcp_connection_t* conn, const char* frame, utils::nananoseconds_t user_time, bool throttled) -> void;
+
+		auto negotiate_protocol(tcp_connection_t* conn, const models::v2_hello& hello) -> void;
+
+		auto write_to_socket(client_session* session) -> void;
+
+		auto poll_shm_channels(utils::nananoseconds_t now) -> void;
+
+		auto read_shm_requests(shm_connection_t& conn, utils::nananoseconds_t now) -> void;
+
+		auto write_shm_responses(shm_connection_t& conn) -> void;
+
+		auto push_shm_unsequenced_response(shm_connection_t& conn, models::client_response_type type, models::client_id_t client_id) -> void;
+
+		auto close_shm_connection(shm_connection_t& conn) -> void;
 
 		std::string ip_;
 		int port_;
-		models::client_id_t next_client_id_ = 0;
+		models::reference_price_table reference_prices_{};
 
 		models::client_response_queue* matching_engine_responses_;
 		models::client_response_queue server_responses_;
+		utils::lock_free_queue<resend_request> resend_requests_;
+		utils::lock_free_queue<models::client_request_internal> exchange_requests_; //written by the exchange's control thread, drained on the event loop
 
 		std::string time_str_;
+		std::string time_str_response_;
 		utils::logger logger_;
 		utils::logger logger_response_;
 
-		std::array<models::client_id_t, models::MAX_NUM_CLIENTS> client_next_outgoing_seq_num_;
-		std::array<models::client_id_t, models::MAX_NUM_CLIENTS> client_next_incoming_seq_num_;
-		std::array<std::unique_ptr<tcp_connection_t>, models::MAX_NUM_CLIENTS> client_connections_;
+		session_table sessions_;
+		risk_gate risk_gate_;
+		throttle_config throttle_config_;
+		std::vector<tcp_connection_t*> throttled_connections_; //event loop thread only
+		bool cancel_on_disconnect_ = false; //a session's resting orders are mass canceled when its connection drops
+		std::array<models::client_request_external, 1 + models::MAX_BATCH_ENTRIES> batch_requests_{}; //event loop thread, a batch being read off the wire
+		std::array<models::client_request_internal, models::MAX_BATCH_ENTRIES> batch_entries_{}; //event loop thread, the entries of the batch being checked
+
+		std::string shm_segment_name_;
+		std::unique_ptr<shm_order_entry> shm_order_entry_; //null unless shared memory order entry is enabled
+		std::array<shm_connection_t, SHM_MAX_CHANNELS> shm_connections_{}; //event loop thread only
+		std::unordered_map<tcp_connection_t*, std::unique_ptr<tcp_connection_t>> connections_; //event loop thread only
 		
 		uv_loop_t* loop_ {nullptr};
 		uv_tcp_t* server_{ nullptr };
 		uv_check_t* check_{ nullptr };
+		uv_async_t* exchange_async_{ nullptr }; //wakes the event loop for exchange requests
+		std::atomic<bool> exchange_async_ready_ = false;
+		uv_idle_t* idle_{ nullptr }; //active only while requests are pending or connections are throttled, so the loop polls instead of blocking until the batch window closes or tokens come back
 		utils::uv_memory_pool<uv_write_t> writer_pool_;
 
 		fifo_sequencer fifo_sequencer_;
@@ -199,12 +313,18 @@ namespace kse::server {
 			models::client_request_queue* incoming_messages,
 			models::client_response_queue* outgoing_messages,
 			std::string_view ip,
-			int port)
-			:ip_{ ip }, port_{ port }, matching_engine_responses_{ outgoing_messages }, server_responses_{ MAX_PENDING_REQUESTS }, 
-			logger_{ "kse_order_server.log" }, logger_response_{ "kse_order_server_responses.log" }, server_{ (uv_tcp_t*)std::malloc(sizeof(uv_tcp_t)) }, 
-			check_{ (uv_check_t*)std::malloc(sizeof(uv_check_t)) }, writer_pool_{ MAX_BUFFERED_RESPONSE }, fifo_sequencer_{ incoming_messages, &logger_ } {
-			client_next_incoming_seq_num_.fill(1);
-			client_next_outgoing_seq_num_.fill(1);
+			int port,
+			const models::reference_price_table& reference_prices,
+			const sequencer_config& sequencer,
+			const session_config& sessions,
+			const risk_config& risk,
+			const throttle_config& throttle,
+			std::string_view shm_segment_name,
+			bool cancel_on_disconnect)
+			:ip_{ ip }, port_{ port }, reference_prices_{ reference_prices }, matching_engine_responses_{ outgoing_messages }, server_responses_{ MAX_PENDING_REQUESTS }, resend_requests_{ MAX_PENDING_REQUESTS }, exchange_requests_{ MAX_PENDING_REQUESTS }, 
+			logger_{ "kse_order_server.log" }, logger_response_{ "kse_order_server_responses.log" }, sessions_{ sessions }, risk_gate_{ risk, reference_prices }, throttle_config_{ throttle }, cancel_on_disconnect_{ cancel_on_disconnect }, shm_segment_name_{ shm_segment_name }, server_{ (uv_tcp_t*)std::malloc(sizeof(uv_tcp_t)) }, 
+			check_{ (uv_check_t*)std::malloc(sizeof(uv_check_t)) }, exchange_async_{ (uv_async_t*)std::malloc(sizeof(uv_async_t)) }, idle_{ (uv_idle_t*)std::malloc(sizeof(uv_idle_t)) }, writer_pool_{ MAX_PENDING_WRITES },
+			fifo_sequencer_{ incoming_messages, &logger_, sequencer } {
 		}
 
 		~order_server()
@@ -219,6 +339,26 @@ namespace kse::server {
 				check_ = nullptr;
 			}
 
+			if (exchange_async_) {
+				if (exchange_async_ready_.exchange(false)) {
+					uv_close(reinterpret_cast<uv_handle_t*>(exchange_async_), [](uv_handle_t* handle) {
+						std::free(handle);
+						});
+				}
+				else {
+					std::free(exchange_async_);
+				}
+				exchange_async_ = nullptr;
+			}
+
+			if (idle_) {
+				uv_idle_stop(idle_);
+				uv_close(reinterpret_cast<uv_handle_t*>(idle_), [](uv_handle_t* handle) {
+					std::free(handle);
+					});
+				idle_ = nullptr;
+			}
+
 			if (server_) {
 				if (!uv_is_closing(reinterpret_cast<uv_handle_t*>(server_))) {
 					uv_close(reinterpret_cast<uv_handle_t*>(server_), [](uv_handle_t* handle) {
@@ -228,11 +368,7 @@ namespace kse::server {
 				server_ = nullptr;
 			}
 
-			for (auto& connection : client_connections_) {
-				if (connection) {
-					connection.reset();
-				}
-			}
+			connections_.clear();
 
 			if (loop_ && uv_loop_alive(loop_)) {
 				uv_stop(loop_);
@@ -240,11 +376,59 @@ namespace kse::server {
 			}
 
 			loop_ = nullptr;
+		}
+
+		/// Assigns the next sequence number, journals the response and sends it if the client is connected.
+		auto deliver_response(client_session& session, const models::client_response_internal& response) -> void {
+			const auto sequence_number = session.next_outgoing_seq_num_++;
+			session.journal_.record(sequence_number, response);
+
+			if (session.connected_.load(std::memory_order_acquire)) [[likely]] {
+				auto outbound = response;
+				START_MEASURE(Exchange_odsSerialization);
+				session.append_to_outbound_buffer(outbound, sequence_number, reference_prices_);
+				END_MEASURE(Exchange_odsSerialization, logger_response_, time_str_response_);
+
+				// Shared memory sessions are drained by the polling event loop, no wakeup needed.
+				if (session.transport_.load(std::memory_order_acquire) == session_transport::TCP) {
+					uv_async_send(session.async_write_msg_);
+				}
+			}
+			else {
+				logger_response_.log("%:% %() % ClientId:% is disconnected, journaled seq:%\n", __FILE__, __LINE__, __func__,
+					utils::get_curren_time_str(&time_str_response_), session.client_id_, sequence_number);
+			}
+		}
 
-			for(auto& connection : client_connections_) {
-				if (connection) {
-					connection.reset();
+		auto replay_responses(client_session& session, uint64_t from_sequence_number) -> void;
+
+		auto process_resend_requests() -> void;
+
+		/**
+		 * The first acknowledgement of each batch entry is folded into the BATCH_ACK. Fills, and responses for other orders
+		 * the entry touched (self-trade cancels, triggered stops, a mass quote's replacement), still go out one by one.
+		 * Returns true for responses that must not be delivered.
+		 */
+		auto coalesce_batch_response(client_session& session, const models::client_response_internal& response) noexcept -> bool {
+			switch (response.type_) {
+			case models::client_response_type::BATCH_ENTRY:
+				session.batch_entry_id_ = response.client_order_id_;
+				return true;
+			case models::client_response_type::BATCH_ACK:
+				session.batch_entry_id_ = models::INVALID_ORDER_ID;
+				return false;
+			case models::client_response_type::ACCEPTED:
+			case models::client_response_type::CANCELED:
+			case models::client_response_type::MODIFIED:
+			case models::client_response_type::CANCEL_REJECTED:
+			case models::client_response_type::MODIFY_REJECTED:
+				if (session.batch_entry_id_ != models::INVALID_ORDER_ID && response.client_order_id_ == session.batch_entry_id_) {
+					session.batch_entry_id_ = models::INVALID_ORDER_ID;
+					return true;
 				}
+				return false;
+			default:
+				return false;
 			}
 		}
 
@@ -256,25 +440,24 @@ namespace kse::server {
 
 				TIME_MEASURE(T5t_OrderServer_LFQueue_read, logger_response_, time);
 
-				auto& next_outgoing_seq_num = client_next_outgoing_seq_num_[client_response->client_id_];
+				auto* session = sessions_.get(client_response->client_id_);
+				if (!session) [[unlikely]] {
+					logger_response_.log("%:% %() % No session for ClientId:%, dropping %\n", __FILE__, __LINE__, __func__,
+						utils::get_curren_time_str(&time), client_response->client_id_, client_response->to_string());
+					responses.next_read_index();
+					continue;
+				}
 
 				logger_response_.debug_log("%:% %() % Processing cid:% seq:% %\n", __FILE__, __LINE__, __func__,
 					utils::get_curren_time_str(&time),
-					client_response->client_id_, next_outgoing_seq_num, client_response->to_string());
-
-				utils::DEBUG_ASSERT(client_connections_[client_response->client_id_] != nullptr,
-					"Don't have a TCPSocket for ClientId:" + std::to_string(client_response->client_id_));
+					client_response->client_id_, session->next_outgoing_seq_num_, client_response->to_string());
 
-				auto* conn = client_connections_[client_response->client_id_].get();
+				risk_gate_.on_response(session->risk_, *client_response);
+				if (!coalesce_batch_response(*session, *client_response)) [[likely]] {
+					deliver_response(*session, *client_response);
+				}
 
-				START_MEASURE(Exchange_odsSerialization);
-				conn->append_to_outbound_buffer(*client_response, next_outgoing_seq_num);
-				END_MEASURE(Exchange_odsSerialization, logger_response_, time);
-				
-				uv_async_send(conn->async_write_msg_);
-				
 				responses.next_read_index();
-				++next_outgoing_seq_num;
 			}
 		}
 	};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "models/client_response.hpp"
+#include "utils/utils.hpp"
+
+#include <vector>
+
+namespace kse::server {
+	/// Default number of most recent responses kept per session for retransmission.
+	constexpr size_t RESPONSE_JOURNAL_SIZE = 8 * 1024;
+
+	/**
+	 * Ring of the most recent responses of one session, indexed by sequence number.
+	 * Responses are kept unencoded so a resend after reconnect can use whatever protocol version the new connection negotiated.
+	 * Only the order server's response thread touches a journal.
+	 */
+	class response_journal {
+	public:
+		explicit response_journal(size_t capacity = RESPONSE_JOURNAL_SIZE) : entries_(capacity) {}
+
+		response_journal(const response_journal&) = delete;
+		response_journal& operator=(const response_journal&) = delete;
+
+		/// Sequence numbers must be recorded without gaps, starting at 1.
+		auto record(uint64_t sequence_number, const models::client_response_internal& response) noexcept -> void {
+			utils::DEBUG_ASSERT(sequence_number == next_sequence_number_, "Response journal sequence numbers must be contiguous");
+			entries_[sequence_number % entries_.size()] = response;
+			next_sequence_number_ = sequence_number + 1;
+		}
+
+		/// Oldest sequence number still held.
+		auto first_sequence_number() const noexcept -> uint64_t {
+			return next_sequence_number_ > entries_.size() ? next_sequence_number_ - entries_.size() : 1;
+		}
+
+		auto next_sequence_number() const noexcept -> uint64_t { return next_sequence_number_; }
+
+		auto contains(uint64_t sequence_number) const noexcept -> bool {
+			return sequence_number >= first_sequence_number() && sequence_number < next_sequence_number_;
+		}
+
+		auto at(uint64_t sequence_number) const noexcept -> const models::client_response_internal& {
+			utils::DEBUG_ASSERT(contains(sequence_number), "Sequence number " + std::to_string(sequence_number) + " is not in the journal");
+			return entries_[sequence_number % entries_.size()];
+		}
+
+	private:
+		std::vector<models::client_response_internal> entries_;
+		uint64_t next_sequence_number_ = 1;
+	};
+}
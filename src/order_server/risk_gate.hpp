@@ -0,0 +1,240 @@
+#pragma once
+
+#include "models/client_request.hpp"
+#include "models/client_response.hpp"
+#include "models/constants.hpp"
+#include "models/wire_v2.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <string>
+
+namespace kse::server {
+	enum class risk_reject_reason : uint8_t {
+		NONE = 0,
+		MALFORMED = 1,
+		MESSAGE_RATE = 2,
+		MAX_ORDER_QTY = 3,
+		MAX_NOTIONAL = 4,
+		PRICE_BAND = 5,
+		MAX_OPEN_ORDERS = 6,
+		PRICE_RANGE = 7 //the price is too far from the instrument's reference price for the v2 wire format
+	};
+
+	inline auto risk_reject_reason_to_string(risk_reject_reason reason) -> std::string {
+		switch (reason) {
+		case risk_reject_reason::NONE:
+			return "NONE";
+		case risk_reject_reason::MALFORMED:
+			return "MALFORMED";
+		case risk_reject_reason::MESSAGE_RATE:
+			return "MESSAGE_RATE";
+		case risk_reject_reason::MAX_ORDER_QTY:
+			return "MAX_ORDER_QTY";
+		case risk_reject_reason::MAX_NOTIONAL:
+			return "MAX_NOTIONAL";
+		case risk_reject_reason::PRICE_BAND:
+			return "PRICE_BAND";
+		case risk_reject_reason::MAX_OPEN_ORDERS:
+			return "MAX_OPEN_ORDERS";
+		case risk_reject_reason::PRICE_RANGE:
+			return "PRICE_RANGE";
+		}
+		return "UNKNOWN";
+	}
+
+	/// Limits applied to every client's orders in one instrument. The defaults disable each check.
+	struct risk_limits {
+		models::quantity_t max_order_qty_ = std::numeric_limits<models::quantity_t>::max();
+		/// Largest |price| * qty of a single order.
+		models::price_t max_notional_ = std::numeric_limits<models::price_t>::max();
+		/// Largest distance of an order's price from the last trade, or from the reference price before the first trade.
+		models::price_t price_band_ = std::numeric_limits<models::price_t>::max();
+		int32_t max_open_orders_ = std::numeric_limits<int32_t>::max();
+	};
+
+	struct risk_config {
+		std::array<risk_limits, models::MAX_NUM_INSTRUMENTS> instrument_limits_{};
+	};
+
+	/**
+	 * Risk counters of one client, kept in its session.
+	 * Open orders are counted up by the gate on the event loop thread when a NEW or MODIFY passes, and down by the
+	 * response thread when the engine reports the order gone. A MODIFY counts as one until its outcome is known:
+	 * MODIFIED or MODIFY_REJECTED take it back, a cancel/replace takes it back with the CANCELED of the old order.
+	 */
+	struct client_risk_state {
+		std::array<std::atomic<int32_t>, models::MAX_NUM_INSTRUMENTS> open_orders_{};
+	};
+
+	/**
+	 * Pre-trade checks run by the order server before a request is sequenced. Every check is a handful of
+	 * comparisons against per-instrument limits and per-client counters, and rejected requests never reach the matching engine.
+	 */
+	class risk_gate {
+	public:
+		explicit risk_gate(const risk_config& config = {}, const models::reference_price_table& reference_prices = {}) : config_{ config }, reference_prices_{ reference_prices } {
+			for (size_t i = 0; i < last_trade_prices_.size(); ++i) {
+				last_trade_prices_[i].store(reference_prices[i] ? reference_prices[i] : models::INVALID_PRICE, std::memory_order_relaxed);
+			}
+		}
+
+		risk_gate(const risk_gate&) = delete;
+		risk_gate& operator=(const risk_gate&) = delete;
+
+		/// Checks a sequenced request on the event loop thread and counts it against the client's limits if it passes.
+		auto check(client_risk_state& state, const models::client_request_internal& request) noexcept -> risk_reject_reason {
+			if (!is_well_formed(request)) [[unlikely]] {
+				return risk_reject_reason::MALFORMED;
+			}
+
+			if (request.type_ == models::client_request_type::CANCEL || request.type_ == models::client_request_type::MASS_CANCEL) {
+				return risk_reject_reason::NONE;
+			}
+
+			// Every price that rests or trades is sent to v2 sessions as an offset from the reference price, so it must have one.
+			const auto reference_price = reference_prices_[request.instrument_id_];
+			if (!models::fits_v2_price(request.price_, reference_price) || !models::fits_v2_price(request.stop_price_, reference_price)) [[unlikely]] {
+				return risk_reject_reason::PRICE_RANGE;
+			}
+
+			const auto& limits = config_.instrument_limits_[request.instrument_id_];
+			auto& open_orders = state.open_orders_[request.instrument_id_];
+
+			if (request.qty_ > limits.max_order_qty_) [[unlikely]] {
+				return risk_reject_reason::MAX_ORDER_QTY;
+			}
+
+			// A market order has no price of its own, so its notional is estimated at the anchor; a stop's at its stop price.
+			// Only resting limit prices are held to the band: stops are meant to sit away from the market.
+			const auto anchor = last_trade_prices_[request.instrument_id_].load(std::memory_order_relaxed);
+			const auto order_type = request.type_ == models::client_request_type::NEW ? request.order_type_ : models::order_type_t::LIMIT;
+			const auto price = order_type == models::order_type_t::MARKET ? anchor : order_type == models::order_type_t::STOP ? request.stop_price_ : request.price_;
+
+			const auto abs_price = price < 0 ? -price : price;
+			if (price != models::INVALID_PRICE && request.qty_ && abs_price > limits.max_notional_ / static_cast<models::price_t>(request.qty_)) [[unlikely]] {
+				return risk_reject_reason::MAX_NOTIONAL;
+			}
+
+			if (order_type == models::order_type_t::LIMIT && anchor != models::INVALID_PRICE && std::abs(request.price_ - anchor) > limits.price_band_) [[unlikely]] {
+				return risk_reject_reason::PRICE_BAND;
+			}
+
+			if (request.type_ == models::client_request_type::NEW && open_orders.load(std::memory_order_relaxed) >= limits.max_open_orders_) [[unlikely]] {
+				return risk_reject_reason::MAX_OPEN_ORDERS;
+			}
+
+			open_orders.fetch_add(1, std::memory_order_relaxed);
+			return risk_reject_reason::NONE;
+		}
+
+		/**
+		 * Checks every entry of a batch as the single request it stands for. The batch passes or fails as a whole:
+		 * if an entry fails, the entries before it are taken back off the client's counters.
+		 * A mass quote side counts as a new order until the engine reports that it replaced a live one.
+		 */
+		auto check_batch(client_risk_state& state, const models::client_request_internal& header, const models::client_request_internal* entries) noexcept -> risk_reject_reason {
+			const auto num_entries = models::batch_length(header) - 1;
+			if (!num_entries) [[unlikely]] {
+				return risk_reject_reason::MALFORMED;
+			}
+
+			for (size_t i = 0; i < num_entries; ++i) {
+				const auto reason = entries[i].type_ == models::client_request_type::BATCH_ENTRY ?
+					check(state, models::batch_entry_as_request(header.type_, entries[i])) : risk_reject_reason::MALFORMED;
+
+				if (reason != risk_reject_reason::NONE) [[unlikely]] {
+					for (size_t j = 0; j < i; ++j) {
+						release(state, models::batch_entry_as_request(header.type_, entries[j]));
+					}
+					return reason;
+				}
+			}
+			return risk_reject_reason::NONE;
+		}
+
+		/// Takes back the count of a request that passed check() but will not be sent to the engine.
+		auto release(client_risk_state& state, const models::client_request_internal& request) noexcept -> void {
+			if (request.type_ == models::client_request_type::NEW || request.type_ == models::client_request_type::MODIFY) {
+				state.open_orders_[request.instrument_id_].fetch_sub(1, std::memory_order_relaxed);
+			}
+		}
+
+		/// Updates open orders and the last trade price from an engine response, on the response thread.
+		auto on_response(client_risk_state& state, const models::client_response_internal& response) noexcept -> void {
+			if (response.instrument_id_ >= models::MAX_NUM_INSTRUMENTS) {
+				return;
+			}
+
+			auto& open_orders = state.open_orders_[response.instrument_id_];
+
+			switch (response.type_) {
+			case models::client_response_type::FILLED:
+				last_trade_prices_[response.instrument_id_].store(response.price_, std::memory_order_relaxed);
+				if (response.leaves_qty_ == 0) {
+					open_orders.fetch_sub(1, std::memory_order_relaxed);
+				}
+				break;
+			case models::client_response_type::CANCELED:
+			case models::client_response_type::MODIFIED:
+			case models::client_response_type::MODIFY_REJECTED:
+				open_orders.fetch_sub(1, std::memory_order_relaxed);
+				break;
+			default:
+				break;
+			}
+		}
+
+		auto last_trade_price(models::instrument_id_t instrument_id) const noexcept -> models::price_t {
+			return last_trade_prices_[instrument_id].load(std::memory_order_relaxed);
+		}
+
+	private:
+		/// Rejects anything the matching engine would index out of range or cannot process.
+		static auto is_well_formed(const models::client_request_internal& request) noexcept -> bool {
+			if (request.type_ == models::client_request_type::MASS_CANCEL) {
+				return (request.instrument_id_ < models::MAX_NUM_INSTRUMENTS || request.instrument_id_ == models::INVALID_INSTRUMENT_ID) &&
+					(request.side_ == models::side_t::BUY || request.side_ == models::side_t::SELL || request.side_ == models::side_t::INVALID);
+			}
+
+			if (request.instrument_id_ >= models::MAX_NUM_INSTRUMENTS || request.order_id_ >= models::MAX_NUM_ORDERS) {
+				return false;
+			}
+
+			switch (request.type_) {
+			case models::client_request_type::NEW:
+				if ((request.side_ != models::side_t::BUY && request.side_ != models::side_t::SELL) || request.time_in_force_ > models::time_in_force_t::GTT || !request.display_qty_) {
+					return false;
+				}
+				if ((request.time_in_force_ == models::time_in_force_t::GTD || request.time_in_force_ == models::time_in_force_t::GTT) && !request.expire_time_) {
+					return false;
+				}
+				if (request.order_type_ == models::order_type_t::STOP || request.order_type_ == models::order_type_t::STOP_LIMIT) {
+					if (request.stop_price_ <= 0 || request.stop_price_ == models::INVALID_PRICE) {
+						return false;
+					}
+				}
+				if (request.order_type_ == models::order_type_t::MARKET || request.order_type_ == models::order_type_t::STOP) {
+					return request.qty_ > 0 && request.qty_ != models::INVALID_QUANTITY;
+				}
+				if (request.order_type_ != models::order_type_t::LIMIT && request.order_type_ != models::order_type_t::STOP_LIMIT) {
+					return false;
+				}
+				[[fallthrough]];
+			case models::client_request_type::MODIFY:
+				return request.price_ > 0 && request.price_ != models::INVALID_PRICE && request.qty_ > 0 && request.qty_ != models::INVALID_QUANTITY;
+			case models::client_request_type::CANCEL:
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		risk_config config_;
+		models::reference_price_table reference_prices_{};
+		std::array<std::atomic<models::price_t>, models::MAX_NUM_INSTRUMENTS> last_trade_prices_;
+	};
+}
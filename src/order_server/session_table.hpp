@@ -0,0 +1,201 @@
+#pragma once
+
+#include "uv.h"
+#include "models/client_response.hpp"
+#include "models/wire_v2.hpp"
+#include "utils/lock_free_queue.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "response_journal.hpp"
+#include "risk_gate.hpp"
+#include "serializer.hpp"
+#include "throttle.hpp"
+
+
+namespace kse::server {
+	/// Default number of client ids the order server can hand out.
+	constexpr size_t DEFAULT_MAX_SESSIONS = 1024;
+	/// Default number of encoded responses a session holds while its connection writes them out.
+	constexpr size_t DEFAULT_MAX_BUFFERED_RESPONSES = 16 * 1024;
+
+	/**
+	 * Sizes of the session table and of every session's buffers. A session allocates its buffers at its first logon and
+	 * keeps them across reconnects, so they are paid for once per client id ever handed out.
+	 */
+	struct session_config {
+		size_t max_sessions_ = DEFAULT_MAX_SESSIONS;
+		size_t max_buffered_responses_ = DEFAULT_MAX_BUFFERED_RESPONSES; //must exceed response_journal_size_ so a full resend fits
+		size_t response_journal_size_ = RESPONSE_JOURNAL_SIZE;
+	};
+
+	struct outbound_message_t {
+		size_t index_ = 0;
+		size_t size_ = 0;
+	};
+
+	/// How a session's client is attached. Shared memory clients get responses in host order, without serialization.
+	enum class session_transport : uint8_t {
+		TCP = 0,
+		SHM = 1
+	};
+
+	struct tcp_connection_t;
+	struct shm_connection_t;
+
+	/**
+	 * Everything about a client that outlives a single connection: its id, both sequence numbers,
+	 * the negotiated protocol, the outbound response buffer and the journal of recent responses. The response thread only touches sessions,
+	 * never connections, so the event loop can close a connection while responses for it are still in flight.
+	 */
+	struct client_session {
+		models::client_id_t client_id_ = models::INVALID_CLIENT_ID;
+		uv_async_t* async_write_msg_ = nullptr; //initialized by the order server on first logon
+		tcp_connection_t* connection_ = nullptr; //event loop thread only, null while the client is disconnected
+		shm_connection_t* shm_connection_ = nullptr; //event loop thread only, set instead of connection_ for shared memory clients
+		std::atomic<session_transport> transport_ = session_transport::TCP;
+		std::atomic<bool> connected_ = false; //set by the response thread once pending resends are queued, cleared on disconnect
+		models::protocol_version protocol_version_ = models::protocol_version::V1; //response thread, encoding of TCP responses
+
+		uint64_t next_incoming_seq_num_ = 1; //event loop thread
+		models::stp_mode_t stp_mode_ = models::stp_mode_t::NONE; //event loop thread, taken from each LOGON and stamped on the session's requests
+		uint64_t next_outgoing_seq_num_ = 1; //response thread
+		response_journal journal_; //response thread
+		models::order_id_t batch_entry_id_ = models::INVALID_ORDER_ID; //response thread, the batch entry whose acknowledgement is still to be folded into the BATCH_ACK
+		client_risk_state risk_;
+		session_throttle throttle_;
+
+		size_t max_buffered_responses_ = 0;
+		std::vector<char> outbound_data_;
+		size_t next_send_valid_index_ = 0;
+		utils::lock_free_queue<outbound_message_t> write_queue_;
+
+		explicit client_session(models::client_id_t client_id, const session_config& config = {})
+			: client_id_{ client_id }, journal_{ config.response_journal_size_ }, max_buffered_responses_{ config.max_buffered_responses_ },
+			write_queue_{ config.max_buffered_responses_ } {
+			outbound_data_.resize(sizeof(models::client_response_external) * max_buffered_responses_);
+		}
+
+		client_session(const client_session&) = delete;
+		client_session& operator=(const client_session&) = delete;
+
+		~client_session() noexcept {
+			if (async_write_msg_) {
+				if (!uv_is_closing((uv_handle_t*)async_write_msg_)) {
+					uv_close((uv_handle_t*)async_write_msg_, [](uv_handle_t* handle) { std::free(handle); });
+				}
+				async_write_msg_ = nullptr;
+			}
+		}
+
+		auto append_to_outbound_buffer(models::client_response_internal& response, uint64_t sequence_number, const models::reference_price_table& reference_prices) -> size_t {
+			const models::client_response_external external_response{ sequence_number, std::move(response) };
+			auto* buffer = next_outbound_slot();
+			size_t size = sizeof(models::client_response_external);
+
+			if (transport_.load(std::memory_order_acquire) == session_transport::SHM) {
+				std::memcpy(buffer, &external_response, sizeof(external_response));
+			}
+			else if (protocol_version_ == models::protocol_version::V2) {
+				size = models::encode_v2_response(external_response, reference_prices, buffer);
+			}
+			else {
+				serialize_client_response(external_response, buffer);
+			}
+
+			return queue_outbound_slot(size);
+		}
+
+		/**
+		 * Encodes every response appended from now on with version. The HELLO_ACK, preceded in v2 by the reference prices,
+		 * is queued behind the responses already encoded with the old version, so the client sees the switch where it happens.
+		 */
+		auto switch_protocol(models::protocol_version version, const models::reference_price_table& reference_prices) -> void {
+			static_assert(models::v2_reference_price_codec::size <= sizeof(models::client_response_external));
+			static_assert(models::v2_hello_ack_codec::size <= sizeof(models::client_response_external));
+
+			protocol_version_ = version;
+
+			if (version == models::protocol_version::V2) {
+				for (models::instrument_id_t instrument_id = 0; instrument_id < reference_prices.size(); ++instrument_id) {
+					models::v2_reference_price_codec::encode({ { models::v2_message_type::REFERENCE_PRICE, models::v2_reference_price_codec::size },
+						instrument_id, reference_prices[instrument_id] }, next_outbound_slot());
+					queue_outbound_slot(models::v2_reference_price_codec::size);
+				}
+			}
+
+			models::v2_hello_ack_codec::encode({ { models::v2_message_type::HELLO_ACK, models::v2_hello_ack_codec::size }, version }, next_outbound_slot());
+			queue_outbound_slot(models::v2_hello_ack_codec::size);
+		}
+
+		auto get_response_buffer(size_t index) -> char* {
+			return outbound_data_.data() + index * sizeof(models::client_response_external);
+		}
+
+	private:
+		auto next_outbound_slot() -> char* {
+			if (next_send_valid_index_ == max_buffered_responses_) [[unlikely]] {
+				next_send_valid_index_ = 0;
+			}
+			return get_response_buffer(next_send_valid_index_);
+		}
+
+		auto queue_outbound_slot(size_t size) -> size_t {
+			*write_queue_.get_next_write_element() = { next_send_valid_index_, size };
+			write_queue_.next_write_index();
+
+			return next_send_valid_index_++;
+		}
+	};
+
+	/**
+	 * Client sessions indexed by client id. The table is sized once at startup and never reallocates,
+	 * so the response thread can look sessions up in O(1) while the event loop thread logs clients on and off.
+	 */
+	class session_table {
+	public:
+		explicit session_table(const session_config& config = {}) : config_{ config } {
+			utils::ASSERT(config_.max_buffered_responses_ > config_.response_journal_size_, "A session must buffer more responses than its journal holds");
+			sessions_.resize(config_.max_sessions_);
+		}
+
+		session_table(const session_table&) = delete;
+		session_table& operator=(const session_table&) = delete;
+
+		/// Session of a client id, or nullptr if the id was never handed out.
+		auto get(models::client_id_t client_id) const noexcept -> client_session* {
+			return client_id < sessions_.size() ? sessions_[client_id].get() : nullptr;
+		}
+
+		/**
+		 * Resolves a logon request. INVALID_CLIENT_ID asks for a new id; any other id resumes that session
+		 * together with its sequence numbers, provided it exists and is not connected elsewhere, over TCP or shared memory. Event loop thread only.
+		 *
+		 * @return The session to attach the connection to, or nullptr if the logon is rejected.
+		 */
+		auto logon(models::client_id_t requested_id) -> client_session* {
+			if (requested_id == models::INVALID_CLIENT_ID) {
+				if (next_client_id_ >= sessions_.size()) [[unlikely]] {
+					return nullptr;
+				}
+				auto& session = sessions_[next_client_id_];
+				session = std::make_unique<client_session>(next_client_id_++, config_);
+				return session.get();
+			}
+
+			auto* session = get(requested_id);
+			return session && !session->connection_ && !session->shm_connection_ ? session : nullptr;
+		}
+
+		auto size() const noexcept -> size_t { return next_client_id_; }
+		auto capacity() const noexcept -> size_t { return sessions_.size(); }
+
+	private:
+		session_config config_;
+		std::vector<std::unique_ptr<client_session>> sessions_;
+		models::client_id_t next_client_id_ = 0;
+	};
+}
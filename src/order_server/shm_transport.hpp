@@ -0,0 +1,122 @@
+#pragma once
+
+#include "models/client_request.hpp"
+#include "models/client_response.hpp"
+#include "utils/shared_memory.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <string_view>
+
+namespace kse::server {
+	constexpr std::string_view DEFAULT_SHM_SEGMENT_NAME = "kse_order_entry";
+	constexpr size_t SHM_MAX_CHANNELS = 16;
+	constexpr size_t SHM_RING_SIZE = 4096;
+	constexpr uint64_t SHM_SEGMENT_MAGIC = 0x4B53454F45534D36; //"KSEOESM6", bumped whenever the layout changes
+
+	enum class shm_channel_state : uint32_t {
+		FREE = 0, //available to clients
+		CLAIMED = 1, //taken by a client; its first request must be a LOGON
+		DETACHING = 2 //the client left, the server releases the channel
+	};
+
+	/**
+	 * One co-located client's order entry channel. Requests and responses are the host-order
+	 * client_request_external/client_response_external structs, so neither side serializes anything.
+	 * The client produces requests and consumes responses; the order server's event loop thread does the opposite.
+	 */
+	struct shm_channel {
+		std::atomic<shm_channel_state> state_ = shm_channel_state::FREE;
+		std::atomic<int64_t> owner_pid_ = 0;
+
+		utils::shm_spsc_ring<models::client_request_external, SHM_RING_SIZE> requests_;
+		utils::shm_spsc_ring<models::client_response_external, SHM_RING_SIZE> responses_;
+	};
+
+	struct shm_segment_layout {
+		uint64_t magic_ = SHM_SEGMENT_MAGIC;
+		std::array<shm_channel, SHM_MAX_CHANNELS> channels_;
+	};
+
+	/// Server side of the shared memory transport: creates the segment and exposes its channels.
+	class shm_order_entry {
+	public:
+		/// Returns nullptr if the segment cannot be created.
+		static auto create(std::string_view name) -> std::unique_ptr<shm_order_entry> {
+			auto segment = utils::shared_memory_segment::create(name, sizeof(shm_segment_layout));
+			if (!segment) {
+				return nullptr;
+			}
+			auto* layout = new (segment->data()) shm_segment_layout{};
+			return std::unique_ptr<shm_order_entry>(new shm_order_entry(std::move(segment), layout));
+		}
+
+		auto channel(size_t index) noexcept -> shm_channel& { return layout_->channels_[index]; }
+
+		/// Returns a channel to FREE once its client is gone. Event loop thread only.
+		auto release(shm_channel& channel) noexcept -> void {
+			channel.requests_.reset();
+			channel.responses_.reset();
+			channel.owner_pid_.store(0, std::memory_order_relaxed);
+			channel.state_.store(shm_channel_state::FREE, std::memory_order_release);
+		}
+
+	private:
+		shm_order_entry(std::unique_ptr<utils::shared_memory_segment> segment, shm_segment_layout* layout) noexcept
+			: segment_{ std::move(segment) }, layout_{ layout } {
+		}
+
+		std::unique_ptr<utils::shared_memory_segment> segment_;
+		shm_segment_layout* layout_ = nullptr;
+	};
+
+	/**
+	 * Client side of the shared memory transport. Claims a free channel for the lifetime of the object;
+	 * the session on top of it follows the same LOGON, sequencing and resend rules as TCP.
+	 */
+	class shm_client {
+	public:
+		/// Returns nullptr if no order server has the segment open or every channel is taken.
+		static auto connect(std::string_view name) -> std::unique_ptr<shm_client> {
+			auto segment = utils::shared_memory_segment::open(name, sizeof(shm_segment_layout));
+			if (!segment) {
+				return nullptr;
+			}
+
+			auto* layout = static_cast<shm_segment_layout*>(segment->data());
+			if (layout->magic_ != SHM_SEGMENT_MAGIC) {
+				return nullptr;
+			}
+
+			for (auto& channel : layout->channels_) {
+				auto expected = shm_channel_state::FREE;
+				if (channel.state_.compare_exchange_strong(expected, shm_channel_state::CLAIMED, std::memory_order_acq_rel)) {
+					channel.owner_pid_.store(utils::get_process_id(), std::memory_order_release);
+					return std::unique_ptr<shm_client>(new shm_client(std::move(segment), &channel));
+				}
+			}
+			return nullptr;
+		}
+
+		shm_client(const shm_client&) = delete;
+		shm_client& operator=(const shm_client&) = delete;
+
+		~shm_client() noexcept {
+			channel_->state_.store(shm_channel_state::DETACHING, std::memory_order_release);
+		}
+
+		auto requests() noexcept -> utils::shm_spsc_ring<models::client_request_external, SHM_RING_SIZE>& { return channel_->requests_; }
+		auto responses() noexcept -> utils::shm_spsc_ring<models::client_response_external, SHM_RING_SIZE>& { return channel_->responses_; }
+
+	private:
+		shm_client(std::unique_ptr<utils::shared_memory_segment> segment, shm_channel* channel) noexcept
+			: segment_{ std::move(segment) }, channel_{ channel } {
+		}
+
+		std::unique_ptr<utils::shared_memory_segment> segment_;
+		shm_channel* channel_ = nullptr;
+	};
+}
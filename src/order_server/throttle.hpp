@@ -0,0 +1,143 @@
+#pragma once
+
+#include "utils/utils.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <string>
+
+namespace kse::server {
+	/// What happens to a message that arrives while its session has no tokens left.
+	enum class throttle_policy : uint8_t {
+		REJECT = 0, //the message is answered with a reject and still consumes its sequence number
+		QUEUE = 1 //the message stays in the socket buffers and is read once a token is available
+	};
+
+	inline auto throttle_policy_to_string(throttle_policy policy) -> std::string {
+		switch (policy) {
+		case throttle_policy::REJECT:
+			return "REJECT";
+		case throttle_policy::QUEUE:
+			return "QUEUE";
+		}
+		return "UNKNOWN";
+	}
+
+	enum class throttle_action : uint8_t {
+		ADMIT = 0,
+		REJECT = 1,
+		DEFER = 2
+	};
+
+	struct throttle_config {
+		/// Sustained rate each session may send at. The default disables throttling.
+		uint32_t messages_per_second_ = std::numeric_limits<uint32_t>::max();
+		/// Messages a session may send back to back after being idle, 0 for one second's worth.
+		uint32_t burst_ = 0;
+		throttle_policy policy_ = throttle_policy::REJECT;
+	};
+
+	/**
+	 * Token bucket refilled from the monotonic receive timestamps, with no timer of its own.
+	 * Tokens are kept in nanosecond units of one message, so refilling is integer arithmetic without rounding drift.
+	 */
+	class token_bucket {
+	public:
+		explicit token_bucket(const throttle_config& config = {}) noexcept { configure(config); }
+
+		auto configure(const throttle_config& config) noexcept -> void {
+			unlimited_ = config.messages_per_second_ == std::numeric_limits<uint32_t>::max();
+			rate_ = config.messages_per_second_;
+			capacity_ = static_cast<utils::nananoseconds_t>(config.burst_ ? config.burst_ : config.messages_per_second_) * utils::NANOS_PER_SECS;
+			// Past this much idle time the bucket is full, which also keeps elapsed * rate from overflowing.
+			time_to_fill_ = rate_ ? capacity_ / rate_ + 1 : std::numeric_limits<utils::nananoseconds_t>::max();
+			tokens_ = capacity_;
+			last_refill_ = std::numeric_limits<utils::nananoseconds_t>::min();
+		}
+
+		/// Takes one token if available.
+		auto try_consume(utils::nananoseconds_t now) noexcept -> bool {
+			if (unlimited_) [[likely]] {
+				return true;
+			}
+
+			refill(now);
+			if (tokens_ < utils::NANOS_PER_SECS) {
+				return false;
+			}
+
+			tokens_ -= utils::NANOS_PER_SECS;
+			return true;
+		}
+
+		auto has_token(utils::nananoseconds_t now) noexcept -> bool {
+			if (unlimited_) [[likely]] {
+				return true;
+			}
+
+			refill(now);
+			return tokens_ >= utils::NANOS_PER_SECS;
+		}
+
+	private:
+		auto refill(utils::nananoseconds_t now) noexcept -> void {
+			if (last_refill_ == std::numeric_limits<utils::nananoseconds_t>::min() || now - last_refill_ >= time_to_fill_) {
+				tokens_ = capacity_;
+			}
+			else if (now > last_refill_) {
+				tokens_ = std::min(capacity_, tokens_ + (now - last_refill_) * rate_);
+			}
+			last_refill_ = std::max(last_refill_, now);
+		}
+
+		bool unlimited_ = true;
+		utils::nananoseconds_t rate_ = 0;
+		utils::nananoseconds_t capacity_ = 0;
+		utils::nananoseconds_t time_to_fill_ = 0;
+		utils::nananoseconds_t tokens_ = 0;
+		utils::nananoseconds_t last_refill_ = 0;
+	};
+
+	/// Snapshot of a session's throttle counters.
+	struct throttle_stats {
+		uint64_t admitted_ = 0;
+		uint64_t rejected_ = 0;
+		uint64_t deferred_ = 0;
+
+		auto to_string() const -> std::string {
+			return "throttle_stats[admitted:" + std::to_string(admitted_) + " rejected:" + std::to_string(rejected_) +
+				" deferred:" + std::to_string(deferred_) + "]";
+		}
+	};
+
+	/// Per-session throttle. The bucket belongs to the event loop thread; counters may be read from any thread for monitoring.
+	struct session_throttle {
+		token_bucket bucket_;
+
+		std::atomic<uint64_t> admitted_ = 0;
+		std::atomic<uint64_t> rejected_ = 0;
+		std::atomic<uint64_t> deferred_ = 0; //times the session's connection was paused under the QUEUE policy
+
+		/// Takes a token for the next message, or says how to handle it under the given policy.
+		auto admit(utils::nananoseconds_t now, throttle_policy policy) noexcept -> throttle_action {
+			if (bucket_.try_consume(now)) [[likely]] {
+				admitted_.fetch_add(1, std::memory_order_relaxed);
+				return throttle_action::ADMIT;
+			}
+
+			if (policy == throttle_policy::QUEUE) {
+				deferred_.fetch_add(1, std::memory_order_relaxed);
+				return throttle_action::DEFER;
+			}
+
+			rejected_.fetch_add(1, std::memory_order_relaxed);
+			return throttle_action::REJECT;
+		}
+
+		auto stats() const noexcept -> throttle_stats {
+			return { admitted_.load(std::memory_order_relaxed), rejected_.load(std::memory_order_relaxed), deferred_.load(std::memory_order_relaxed) };
+		}
+	};
+}
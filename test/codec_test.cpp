@@ -0,0 +1,255 @@
+#include <gtest/gtest.h>
+
+#include <array>
+#include <limits>
+
+#include "models/wire_codecs.hpp"
+#include "order_server/serializer.hpp"
+#include "market_data/market_data_encoder.hpp"
+
+using namespace kse::models;
+
+
+TEST(CodecTest, ByteSwap) {
+	static_assert(kse::utils::byte_swap<uint16_t>(0x0102) == 0x0201);
+	static_assert(kse::utils::byte_swap<uint32_t>(0x01020304) == 0x04030201);
+	static_assert(kse::utils::byte_swap<uint64_t>(0x0102030405060708) == 0x0807060504030201);
+
+	EXPECT_EQ(kse::utils::convert_endian<std::endian::big>(uint32_t{ 0x01020304 }), std::endian::native == std::endian::big ? 0x01020304u : 0x04030201u);
+	EXPECT_EQ(kse::utils::convert_endian<std::endian::native>(int64_t{ -42 }), -42);
+}
+
+TEST(CodecTest, ClientRequestLayoutIsBigEndian) {
+	const client_request_external request{ 0x0102030405060708, { client_request_type::NEW, 0x0A0B0C0D, 3, 0x1112131415161718, side_t::SELL, -2, 0x21222324,
+		order_type_t::MARKET, time_in_force_t::FOK, 0x3132333435363738, 0x41424344, stp_mode_t::DECREMENT, 0x5152535455565758 } };
+	std::array<char, client_request_codec::size> buffer{};
+
+	kse::server::serialize_client_request(request, buffer.data());
+
+	const std::array<uint8_t, client_request_codec::size> expected{
+		0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+		0x01,
+		0x0A, 0x0B, 0x0C, 0x0D,
+		0x03,
+		0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18,
+		0x02,
+		0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFE,
+		0x21, 0x22, 0x23, 0x24,
+		0x01,
+		0x02,
+		0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38,
+		0x41, 0x42, 0x43, 0x44,
+		0x04,
+		0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58
+	};
+
+	for (size_t i = 0; i < expected.size(); ++i) {
+		EXPECT_EQ(static_cast<uint8_t>(buffer[i]), expected[i]) << "byte " << i;
+	}
+}
+
+TEST(CodecTest, ClientRequestRoundTrip) {
+	const client_request_external request{ 7, { client_request_type::MODIFY, 4, 2, 99, side_t::BUY, 101, 250 } };
+	std::array<char, client_request_codec::size> buffer{};
+
+	kse::server::serialize_client_request(request, buffer.data());
+	const auto decoded = kse::server::deserialize_client_request(buffer.data());
+
+	EXPECT_EQ(decoded.sequence_number_, request.sequence_number_);
+	EXPECT_EQ(decoded.request_.type_, request.request_.type_);
+	EXPECT_EQ(decoded.request_.client_id_, request.request_.client_id_);
+	EXPECT_EQ(decoded.request_.instrument_id_, request.request_.instrument_id_);
+	EXPECT_EQ(decoded.request_.order_id_, request.request_.order_id_);
+	EXPECT_EQ(decoded.request_.side_, request.request_.side_);
+	EXPECT_EQ(decoded.request_.price_, request.request_.price_);
+	EXPECT_EQ(decoded.request_.qty_, request.request_.qty_);
+}
+
+TEST(CodecTest, ClientResponseRoundTrip) {
+	const client_response_external response{ 12, { client_response_type::FILLED, 3, 1, 55, 1001, side_t::SELL, 99, 10, 40 } };
+	std::array<char, client_response_codec::size> buffer{};
+
+	kse::server::serialize_client_response(response, buffer.data());
+	const auto decoded = kse::server::deserialize_client_response(buffer.data());
+
+	EXPECT_EQ(decoded.sequence_number_, response.sequence_number_);
+	EXPECT_EQ(decoded.response_.type_, response.response_.type_);
+	EXPECT_EQ(decoded.response_.client_id_, response.response_.client_id_);
+	EXPECT_EQ(decoded.response_.instrument_id_, response.response_.instrument_id_);
+	EXPECT_EQ(decoded.response_.client_order_id_, response.response_.client_order_id_);
+	EXPECT_EQ(decoded.response_.market_order_id_, response.response_.market_order_id_);
+	EXPECT_EQ(decoded.response_.side_, response.response_.side_);
+	EXPECT_EQ(decoded.response_.price_, response.response_.price_);
+	EXPECT_EQ(decoded.response_.exec_qty_, response.response_.exec_qty_);
+	EXPECT_EQ(decoded.response_.leaves_qty_, response.response_.leaves_qty_);
+}
+
+TEST(CodecTest, MarketUpdateRoundTrip) {
+	const client_market_update update{ 42, { market_update_type::MODIFY, 17, 5, side_t::BUY, 150, 30, 2 } };
+	std::array<char, client_market_update_codec::size> buffer{};
+
+	kse::market_data::serialize_client_market_update(update, buffer.data());
+	const auto decoded = client_market_update_codec::decode(buffer.data());
+
+	EXPECT_EQ(decoded.sequence_number_, update.sequence_number_);
+	EXPECT_EQ(decoded.update_.type_, update.update_.type_);
+	EXPECT_EQ(decoded.update_.order_id_, update.update_.order_id_);
+	EXPECT_EQ(decoded.update_.instrument_id_, update.update_.instrument_id_);
+	EXPECT_EQ(decoded.update_.side_, update.update_.side_);
+	EXPECT_EQ(decoded.update_.price_, update.update_.price_);
+	EXPECT_EQ(decoded.update_.qty_, update.update_.qty_);
+	EXPECT_EQ(decoded.update_.priority_, update.update_.priority_);
+}
+
+TEST(CodecTest, V2MessagesAreSmaller) {
+	EXPECT_LT(v2_new_order_codec::size, sizeof(client_request_external));
+	EXPECT_LT(v2_cancel_order_codec::size, sizeof(client_request_external));
+	EXPECT_LT(v2_response_codec::size, sizeof(client_response_external));
+	EXPECT_LT(v2_market_update_codec::size, sizeof(client_market_update));
+}
+
+TEST(CodecTest, V2FramesAreDistinguishableFromV1) {
+	std::array<char, client_request_codec::size> v1_buffer{};
+	kse::server::serialize_client_request({ 1, { client_request_type::NEW, 0, 0, 1, side_t::BUY, 100, 10 } }, v1_buffer.data());
+	EXPECT_FALSE(is_v2_frame_start(v1_buffer[0]));
+
+	std::array<char, v2_hello_codec::size> hello_buffer{};
+	v2_hello_codec::encode({ { v2_message_type::HELLO, v2_hello_codec::size }, V2_HELLO_MAGIC, protocol_version::V2 }, hello_buffer.data());
+	EXPECT_TRUE(is_v2_frame_start(hello_buffer[0]));
+	EXPECT_EQ(peek_v2_header(hello_buffer.data()).length_, v2_hello_codec::size);
+}
+
+TEST(CodecTest, V2RequestRoundTrip) {
+	reference_price_table reference_prices{};
+	reference_prices[2] = 10000;
+
+	const client_request_external request{ 5, { client_request_type::NEW, 3, 2, 77, side_t::SELL, 10025, 40, order_type_t::STOP_LIMIT, time_in_force_t::GTT, 9990, 10, stp_mode_t::NONE, 1'700'000'000'000'000'000 } };
+	std::array<char, V2_MAX_FRAME_SIZE> buffer{};
+
+	const auto size = encode_v2_request(request, reference_prices, buffer.data());
+	ASSERT_EQ(size, v2_new_order_codec::size);
+	EXPECT_EQ(peek_v2_header(buffer.data()).type_, v2_message_type::NEW_ORDER);
+
+	client_request_external decoded;
+	ASSERT_TRUE(decode_v2_request(buffer.data(), 3, 5, reference_prices, &decoded));
+	EXPECT_EQ(decoded.sequence_number_, request.sequence_number_);
+	EXPECT_EQ(decoded.request_.type_, request.request_.type_);
+	EXPECT_EQ(decoded.request_.client_id_, request.request_.client_id_);
+	EXPECT_EQ(decoded.request_.instrument_id_, request.request_.instrument_id_);
+	EXPECT_EQ(decoded.request_.order_id_, request.request_.order_id_);
+	EXPECT_EQ(decoded.request_.side_, request.request_.side_);
+	EXPECT_EQ(decoded.request_.price_, request.request_.price_);
+	EXPECT_EQ(decoded.request_.qty_, request.request_.qty_);
+	EXPECT_EQ(decoded.request_.order_type_, request.request_.order_type_);
+	EXPECT_EQ(decoded.request_.time_in_force_, request.request_.time_in_force_);
+	EXPECT_EQ(decoded.request_.stop_price_, request.request_.stop_price_);
+	EXPECT_EQ(decoded.request_.display_qty_, request.request_.display_qty_);
+	EXPECT_EQ(decoded.request_.expire_time_, request.request_.expire_time_);
+}
+
+TEST(CodecTest, V2ResendRequestRoundTrip) {
+	const client_request_external request{ 0, { client_request_type::RESEND, 3, INVALID_INSTRUMENT_ID, 4242, side_t::INVALID, INVALID_PRICE, INVALID_QUANTITY } };
+	std::array<char, V2_MAX_FRAME_SIZE> buffer{};
+
+	ASSERT_EQ(encode_v2_request(request, {}, buffer.data()), v2_resend_request_codec::size);
+
+	client_request_external decoded;
+	ASSERT_TRUE(decode_v2_request(buffer.data(), 3, 17, {}, &decoded));
+	EXPECT_EQ(decoded.request_.type_, client_request_type::RESEND);
+	EXPECT_EQ(decoded.request_.client_id_, 3);
+	EXPECT_EQ(decoded.request_.order_id_, 4242);
+}
+
+TEST(CodecTest, V2MassQuoteRoundTrip) {
+	reference_price_table reference_prices{};
+	reference_prices[1] = 10000;
+
+	const std::array<client_request_external, 4> batch{ {
+		{ 8, { client_request_type::MASS_QUOTE, 3, INVALID_INSTRUMENT_ID, 42, side_t::INVALID, INVALID_PRICE, 3 } },
+		{ 0, { client_request_type::BATCH_ENTRY, 3, 1, 10, side_t::BUY, 9990, 20 } },
+		{ 0, { client_request_type::BATCH_ENTRY, 3, 1, 11, side_t::SELL, 10010, 0 } },
+		{ 0, { client_request_type::BATCH_ENTRY, 3, 2, 12, side_t::SELL, 500, 5 } } } };
+	std::array<char, V2_MAX_FRAME_SIZE> buffer{};
+
+	// The first two entries pair up into one two-sided quote, the third is one-sided.
+	const auto size = encode_v2_batch(batch.data(), reference_prices, buffer.data());
+	ASSERT_EQ(size, v2_batch_header_codec::size + 2 * v2_quote_entry_codec::size);
+	EXPECT_TRUE(is_v2_batch_message(peek_v2_header(buffer.data()).type_));
+
+	std::array<client_request_external, 1 + MAX_BATCH_ENTRIES> decoded{};
+	ASSERT_EQ(decode_v2_batch(buffer.data(), 3, 8, reference_prices, decoded.data()), batch.size());
+	EXPECT_EQ(decoded[0].sequence_number_, 8);
+	EXPECT_EQ(decoded[0].request_.type_, client_request_type::MASS_QUOTE);
+	EXPECT_EQ(decoded[0].request_.order_id_, 42);
+	EXPECT_EQ(decoded[0].request_.qty_, 3);
+	for (size_t i = 1; i < batch.size(); ++i) {
+		EXPECT_EQ(decoded[i].request_.type_, client_request_type::BATCH_ENTRY);
+		EXPECT_EQ(decoded[i].request_.client_id_, 3);
+		EXPECT_EQ(decoded[i].request_.instrument_id_, batch[i].request_.instrument_id_);
+		EXPECT_EQ(decoded[i].request_.order_id_, batch[i].request_.order_id_);
+		EXPECT_EQ(decoded[i].request_.side_, batch[i].request_.side_);
+		EXPECT_EQ(decoded[i].request_.price_, batch[i].request_.price_);
+		EXPECT_EQ(decoded[i].request_.qty_, batch[i].request_.qty_);
+	}
+
+	// A frame whose length does not match its entry count is rejected.
+	buffer[1] = static_cast<char>(size - 1);
+	EXPECT_EQ(decode_v2_batch(buffer.data(), 3, 8, reference_prices, decoded.data()), 0);
+}
+
+TEST(CodecTest, V2PricesOutOfRangeHaveNoEncoding) {
+	constexpr price_t reference_price = 10000;
+	constexpr price_t max_offset = std::numeric_limits<int32_t>::max() - 1;
+	constexpr price_t min_offset = std::numeric_limits<int32_t>::min();
+
+	EXPECT_TRUE(fits_v2_price(INVALID_PRICE, reference_price));
+	EXPECT_TRUE(fits_v2_price(reference_price + max_offset, reference_price));
+	EXPECT_TRUE(fits_v2_price(reference_price + min_offset, reference_price));
+	EXPECT_FALSE(fits_v2_price(reference_price + max_offset + 1, reference_price));
+	EXPECT_FALSE(fits_v2_price(reference_price + min_offset - 1, reference_price));
+
+	// Such a price goes out as no price, which the order server rejects as malformed for a limit order.
+	EXPECT_EQ(to_v2_price(reference_price + max_offset, reference_price), max_offset);
+	EXPECT_EQ(to_v2_price(reference_price + max_offset + 1, reference_price), V2_INVALID_PRICE);
+	EXPECT_EQ(from_v2_price(to_v2_price(reference_price + min_offset - 1, reference_price), reference_price), INVALID_PRICE);
+}
+
+TEST(CodecTest, V2ResponseKeepsInvalidSentinels) {
+	const reference_price_table reference_prices{};
+	const client_response_external response{ 9, { client_response_type::CANCEL_REJECTED, 1, 0, 12, INVALID_ORDER_ID, side_t::INVALID, INVALID_PRICE, INVALID_QUANTITY, INVALID_QUANTITY } };
+	std::array<char, V2_MAX_FRAME_SIZE> buffer{};
+
+	ASSERT_EQ(encode_v2_response(response, reference_prices, buffer.data()), v2_response_codec::size);
+	const auto decoded = decode_v2_response(buffer.data(), 1, 9, reference_prices);
+
+	EXPECT_EQ(decoded.sequence_number_, 9u);
+	EXPECT_EQ(decoded.response_.type_, client_response_type::CANCEL_REJECTED);
+	EXPECT_EQ(decoded.response_.client_order_id_, 12u);
+	EXPECT_EQ(decoded.response_.market_order_id_, INVALID_ORDER_ID);
+	EXPECT_EQ(decoded.response_.price_, INVALID_PRICE);
+	EXPECT_EQ(decoded.response_.leaves_qty_, INVALID_QUANTITY);
+}
+
+TEST(CodecTest, V2MarketUpdateRoundTrip) {
+	reference_price_table reference_prices{};
+	reference_prices[1] = 500;
+
+	const client_market_update update{ 0x100000005ull, { market_update_type::ADD, 8, 1, side_t::BUY, 480, 25, 3 } };
+	std::array<char, V2_MAX_FRAME_SIZE> buffer{};
+
+	ASSERT_EQ(encode_v2_market_update(update, reference_prices, buffer.data()), v2_market_update_codec::size);
+	const auto decoded = decode_v2_market_update(buffer.data(), 0x100000004ull, reference_prices);
+
+	EXPECT_EQ(decoded.sequence_number_, update.sequence_number_);
+	EXPECT_EQ(decoded.update_.type_, update.update_.type_);
+	EXPECT_EQ(decoded.update_.order_id_, update.update_.order_id_);
+	EXPECT_EQ(decoded.update_.price_, update.update_.price_);
+	EXPECT_EQ(decoded.update_.qty_, update.update_.qty_);
+	EXPECT_EQ(decoded.update_.priority_, update.update_.priority_);
+}
+
+TEST(CodecTest, ExtendSequenceNumberAcrossWrap) {
+	EXPECT_EQ(extend_sequence_number(5, 5), 5u);
+	EXPECT_EQ(extend_sequence_number(0, 0xFFFFFFFFull), 0x100000000ull);
+	EXPECT_EQ(extend_sequence_number(0xFFFFFFFF, 0x100000000ull), 0xFFFFFFFFull);
+}
@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+
+#include <array>
+
+#include "order_server/fifo_sequencer.hpp"
+
+using namespace kse::models;
+using namespace kse::server;
+
+
+class FifoSequencerTest : public ::testing::Test {
+protected:
+	kse::utils::logger logger{ "fifo_sequencer_test.log" };
+	client_request_queue requests{ MAX_PENDING_REQUESTS };
+	fifo_sequencer sequencer{ &requests, &logger };
+
+	static auto make_request(client_id_t client_id, order_id_t order_id) -> client_request_internal {
+		return { client_request_type::NEW, client_id, 0, order_id, side_t::BUY, 100, 10 };
+	}
+
+	auto pop() -> client_request_internal {
+		auto request = *requests.get_next_read_element();
+		requests.next_read_index();
+		return request;
+	}
+};
+
+TEST_F(FifoSequencerTest, OrdersByReceiveTimeAcrossClients) {
+	sequencer.add_request(3'000, make_request(0, 1));
+	sequencer.add_request(1'001, make_request(1, 1));
+	sequencer.add_request(1'000, make_request(2, 1));
+
+	sequencer.sequence_and_publish();
+
+	ASSERT_EQ(requests.size(), 3);
+	EXPECT_EQ(pop().client_id_, 2);
+	EXPECT_EQ(pop().client_id_, 1);
+	EXPECT_EQ(pop().client_id_, 0);
+	EXPECT_TRUE(sequencer.is_empty());
+}
+
+TEST_F(FifoSequencerTest, EqualTimestampsKeepArrivalOrder) {
+	for (order_id_t order_id = 0; order_id < 64; ++order_id) {
+		sequencer.add_request(1'000, make_request(order_id % 2, order_id));
+	}
+	sequencer.add_request(999, make_request(3, 64));
+
+	sequencer.sequence_and_publish();
+
+	EXPECT_EQ(pop().order_id_, 64);
+	for (order_id_t order_id = 0; order_id < 64; ++order_id) {
+		EXPECT_EQ(pop().order_id_, order_id);
+	}
+}
+
+TEST_F(FifoSequencerTest, MergesInterleavedStreams) {
+	for (order_id_t order_id = 0; order_id < 300; ++order_id) {
+		const auto client_id = static_cast<client_id_t>(order_id % 3);
+		sequencer.add_request(static_cast<kse::utils::nananoseconds_t>(client_id * 100'000 + order_id), make_request(client_id, order_id));
+	}
+
+	sequencer.sequence_and_publish();
+
+	ASSERT_EQ(requests.size(), 300);
+	for (client_id_t client_id = 0; client_id < 3; ++client_id) {
+		for (order_id_t order_id = client_id; order_id < 300; order_id += 3) {
+			const auto request = pop();
+			EXPECT_EQ(request.client_id_, client_id);
+			EXPECT_EQ(request.order_id_, order_id);
+		}
+	}
+}
+
+TEST_F(FifoSequencerTest, HoldsBatchUntilWindowOrSizeLimit) {
+	fifo_sequencer windowed{ &requests, &logger, { 1'000, 3 } };
+
+	windowed.add_request(10'000, make_request(0, 1));
+	EXPECT_FALSE(windowed.is_ready(10'500));
+	EXPECT_TRUE(windowed.is_ready(11'000));
+
+	windowed.add_request(10'100, make_request(1, 2));
+	windowed.add_request(10'200, make_request(2, 3));
+	EXPECT_TRUE(windowed.is_ready(10'200));
+}
+
+TEST_F(FifoSequencerTest, KeepsOverflowPendingWhenQueueIsFull) {
+	client_request_queue small_queue{ 4 };
+	fifo_sequencer bounded{ &small_queue, &logger };
+
+	for (order_id_t order_id = 0; order_id < 2 * MAX_PENDING_REQUESTS; ++order_id) {
+		bounded.add_request(static_cast<kse::utils::nananoseconds_t>(order_id), make_request(order_id % MAX_NUM_CLIENTS, order_id));
+	}
+
+	order_id_t expected = 0;
+	while (!bounded.is_empty()) {
+		bounded.sequence_and_publish();
+		EXPECT_LE(small_queue.size(), small_queue.capacity());
+		while (small_queue.size()) {
+			EXPECT_EQ(small_queue.get_next_read_element()->order_id_, expected++);
+			small_queue.next_read_index();
+		}
+	}
+	EXPECT_EQ(expected, 2 * MAX_PENDING_REQUESTS);
+}
+
+TEST_F(FifoSequencerTest, PublishesBatchesWhole) {
+	client_request_queue small_queue{ 4 };
+	fifo_sequencer bounded{ &small_queue, &logger };
+
+	const client_request_internal header{ client_request_type::BATCH_NEW, 1, INVALID_INSTRUMENT_ID, 7, side_t::INVALID, INVALID_PRICE, 3 };
+	const std::array<client_request_internal, 3> entries{ {
+		{ client_request_type::BATCH_ENTRY, 1, 0, 1, side_t::BUY, 100, 10 },
+		{ client_request_type::BATCH_ENTRY, 1, 0, 2, side_t::BUY, 99, 10 },
+		{ client_request_type::BATCH_ENTRY, 1, 0, 3, side_t::BUY, 98, 10 } } };
+
+	bounded.add_request(1'000, make_request(0, 1));
+	bounded.add_batch(1'000, header, entries.data());
+	bounded.add_request(1'000, make_request(2, 1));
+
+	// Only three slots are left behind the first request, so the batch waits instead of being split.
+	bounded.sequence_and_publish();
+	ASSERT_EQ(small_queue.size(), 1);
+	EXPECT_EQ(small_queue.get_next_read_element()->client_id_, 0);
+	small_queue.next_read_index();
+
+	bounded.sequence_and_publish();
+	ASSERT_EQ(small_queue.size(), 4);
+	EXPECT_EQ(small_queue.get_next_read_element()->type_, client_request_type::BATCH_NEW);
+	small_queue.next_read_index();
+	for (const auto& entry : entries) {
+		EXPECT_EQ(small_queue.get_next_read_element()->order_id_, entry.order_id_);
+		small_queue.next_read_index();
+	}
+
+	bounded.sequence_and_publish();
+	ASSERT_EQ(small_queue.size(), 1);
+	EXPECT_EQ(small_queue.get_next_read_element()->client_id_, 2);
+	EXPECT_TRUE(bounded.is_empty());
+}
+
+TEST_F(FifoSequencerTest, ExchangeRequestsMergeByReceiveTime) {
+	sequencer.add_request(2'000, make_request(0, 1));
+	sequencer.add_request(1'000, { client_request_type::START_AUCTION, INVALID_CLIENT_ID, 0, INVALID_ORDER_ID, side_t::INVALID, INVALID_PRICE, INVALID_QUANTITY });
+	sequencer.add_request(3'000, { client_request_type::UNCROSS, INVALID_CLIENT_ID, 0, INVALID_ORDER_ID, side_t::INVALID, INVALID_PRICE, INVALID_QUANTITY });
+
+	sequencer.sequence_and_publish();
+
+	ASSERT_EQ(requests.size(), 3);
+	EXPECT_EQ(pop().type_, client_request_type::START_AUCTION);
+	EXPECT_EQ(pop().client_id_, 0);
+	EXPECT_EQ(pop().type_, client_request_type::UNCROSS);
+	EXPECT_TRUE(sequencer.is_empty());
+}
@@ -0,0 +1,326 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "engine/matching_engine.hpp"
+#include "engine/replication.hpp"
+#include "engine/request_journal.hpp"
+
+using namespace kse::engine;
+using namespace kse::models;
+
+
+namespace {
+	auto make_request(client_request_type type, client_id_t client_id, instrument_id_t instrument_id, order_id_t order_id, side_t side, price_t price,
+		quantity_t qty) -> client_request_internal {
+		client_request_internal request;
+		request.type_ = type;
+		request.client_id_ = client_id;
+		request.instrument_id_ = instrument_id;
+		request.order_id_ = order_id;
+		request.side_ = side;
+		request.price_ = price;
+		request.qty_ = qty;
+		return request;
+	}
+}
+
+TEST(MatchingEngineTest, ReplayRebuildsTheSameState) {
+	const auto directory = (std::filesystem::temp_directory_path() / "kse_matching_engine_test_replay").string();
+	std::filesystem::remove_all(directory);
+
+	client_request_queue requests{ MAX_CLIENT_UPDATES };
+	client_response_queue responses{ MAX_CLIENT_UPDATES };
+	market_update_queue updates{ MAX_MARKET_UPDATES };
+
+	uint64_t live_hash = 0;
+	uint64_t num_records = 0;
+	{
+		auto journal = request_journal::open({ directory });
+		ASSERT_NE(journal, nullptr);
+		matching_engine live{ &requests, &responses, &updates, {}, journal.get() };
+
+		// Journal first, then apply, the way run() does.
+		const auto apply = [&](const client_request_internal& request) {
+			journal->append(request, 0);
+			live.process_client_request(request);
+		};
+
+		apply(make_request(client_request_type::NEW, 1, 0, 1, side_t::BUY, 100, 10));
+		apply(make_request(client_request_type::NEW, 1, 0, 2, side_t::BUY, 99, 20));
+		apply(make_request(client_request_type::NEW, 2, 0, 1, side_t::SELL, 100, 4));
+		apply(make_request(client_request_type::MODIFY, 1, 0, 2, side_t::BUY, 98, 15));
+		apply(make_request(client_request_type::NEW, 2, 1, 2, side_t::SELL, 250, 30));
+		apply(make_request(client_request_type::CANCEL, 1, 0, 1, side_t::BUY, 100, 0));
+
+		auto gtt = make_request(client_request_type::NEW, 3, 1, 1, side_t::BUY, 240, 5);
+		gtt.time_in_force_ = time_in_force_t::GTT;
+		gtt.expire_time_ = static_cast<uint64_t>(kse::utils::get_current_timestamp()) + 3600 * static_cast<uint64_t>(kse::utils::NANOS_PER_SECS);
+		apply(gtt);
+		apply(make_request(client_request_type::EXPIRE, 3, 1, 1, side_t::INVALID, INVALID_PRICE, 0));
+
+		const auto header = make_request(client_request_type::BATCH_NEW, 2, INVALID_INSTRUMENT_ID, 7, side_t::INVALID, INVALID_PRICE, 2);
+		std::vector<client_request_internal> entries{ make_request(client_request_type::BATCH_ENTRY, 2, 0, 3, side_t::SELL, 98, 5),
+			make_request(client_request_type::BATCH_ENTRY, 2, 1, 4, side_t::BUY, 245, 8) };
+		journal->append(header, 0);
+		size_t next = 0;
+		live.process_batch(header, [&](client_request_internal& entry) {
+			entry = entries[next++];
+			journal->append(entry, 0);
+			return true;
+		});
+
+		live_hash = live.state_hash();
+		num_records = journal->next_sequence_number() - 1;
+	}
+
+	while (responses.size()) {
+		responses.next_read_index();
+	}
+	while (updates.size()) {
+		updates.next_read_index();
+	}
+
+	matching_engine replayed{ &requests, &responses, &updates };
+	EXPECT_NE(replayed.state_hash(), live_hash);
+
+	journal_reader reader{ directory };
+	const auto result = replayed.replay(reader);
+	EXPECT_EQ(result.requests_, num_records);
+	EXPECT_EQ(result.last_sequence_number_, num_records);
+	EXPECT_EQ(result.state_hash_, live_hash);
+	EXPECT_EQ(replayed.state_hash(), live_hash);
+
+	// Outputs were suppressed, and are sent again once the replay is over.
+	EXPECT_EQ(responses.size(), 0);
+	EXPECT_EQ(updates.size(), 0);
+	replayed.process_client_request(make_request(client_request_type::CANCEL, 1, 0, 2, side_t::BUY, 98, 0));
+	EXPECT_EQ(responses.size(), 1);
+}
+
+TEST(MatchingEngineTest, BatchMarksEachEntryAndCountsCanceledEntriesAsRejected) {
+	client_request_queue requests{ MAX_CLIENT_UPDATES };
+	client_response_queue responses{ MAX_CLIENT_UPDATES };
+	market_update_queue updates{ MAX_MARKET_UPDATES };
+	matching_engine engine{ &requests, &responses, &updates };
+
+	engine.process_client_request(make_request(client_request_type::NEW, 1, 0, 1, side_t::SELL, 100, 5));
+
+	// The first entry cancels the client's resting sell through self-trade prevention and rests; the second is an IOC with nothing to match.
+	auto stp = make_request(client_request_type::BATCH_ENTRY, 1, 0, 2, side_t::BUY, 100, 5);
+	stp.stp_mode_ = stp_mode_t::CANCEL_OLDEST;
+	auto ioc = make_request(client_request_type::BATCH_ENTRY, 1, 0, 3, side_t::BUY, 90, 4);
+	ioc.time_in_force_ = time_in_force_t::IOC;
+	const std::vector<client_request_internal> entries{ stp, ioc };
+	const auto header = make_request(client_request_type::BATCH_NEW, 1, INVALID_INSTRUMENT_ID, 7, side_t::INVALID, INVALID_PRICE, 2);
+	while (responses.size()) {
+		responses.next_read_index();
+	}
+	size_t next = 0;
+	engine.process_batch(header, [&](client_request_internal& entry) {
+		entry = entries[next++];
+		return true;
+	});
+
+	std::vector<std::pair<client_response_type, order_id_t>> sent;
+	client_response_internal ack;
+	while (responses.size()) {
+		ack = *responses.get_next_read_element();
+		sent.emplace_back(ack.type_, ack.client_order_id_);
+		responses.next_read_index();
+	}
+	const std::vector<std::pair<client_response_type, order_id_t>> expected{
+		{ client_response_type::BATCH_ENTRY, 2 }, { client_response_type::ACCEPTED, 2 }, { client_response_type::CANCELED, 1 },
+		{ client_response_type::BATCH_ENTRY, 3 }, { client_response_type::ACCEPTED, 3 }, { client_response_type::CANCELED, 3 },
+		{ client_response_type::BATCH_ACK, 7 } };
+	EXPECT_EQ(sent, expected);
+
+	EXPECT_EQ(ack.exec_qty_, 1);
+	EXPECT_EQ(ack.leaves_qty_, 1);
+}
+
+TEST(MatchingEngineTest, CheckpointRestoresBooksAndReplaysTheRest) {
+	const auto directory = (std::filesystem::temp_directory_path() / "kse_matching_engine_test_checkpoint").string();
+	std::filesystem::remove_all(directory);
+	const auto checkpoint_path = (std::filesystem::path{ directory } / CHECKPOINT_FILE_NAME).string();
+
+	const auto drain_canceled = [](client_response_queue& responses) {
+		std::vector<order_id_t> canceled;
+		while (const auto* response = responses.get_next_read_element()) {
+			if (response->type_ == client_response_type::CANCELED) {
+				canceled.push_back(response->client_order_id_);
+			}
+			responses.next_read_index();
+		}
+		return canceled;
+	};
+
+	client_request_queue requests{ MAX_CLIENT_UPDATES };
+	client_response_queue live_responses{ MAX_CLIENT_UPDATES };
+	market_update_queue live_updates{ MAX_MARKET_UPDATES };
+
+	auto journal = request_journal::open({ directory });
+	ASSERT_NE(journal, nullptr);
+	matching_engine live{ &requests, &live_responses, &live_updates, {}, journal.get() };
+	const auto apply = [&](const client_request_internal& request) {
+		journal->append(request, 0);
+		live.process_client_request(request);
+	};
+
+	// Before the checkpoint: two levels a side, an iceberg, a stop and an order that expires.
+	apply(make_request(client_request_type::NEW, 1, 0, 1, side_t::BUY, 100, 10));
+	apply(make_request(client_request_type::NEW, 2, 0, 1, side_t::BUY, 100, 20));
+	apply(make_request(client_request_type::NEW, 1, 0, 2, side_t::BUY, 99, 5));
+	auto iceberg = make_request(client_request_type::NEW, 2, 0, 2, side_t::SELL, 102, 50);
+	iceberg.display_qty_ = 10;
+	apply(iceberg);
+	apply(make_request(client_request_type::NEW, 1, 0, 3, side_t::SELL, 103, 7));
+	auto stop = make_request(client_request_type::NEW, 3, 0, 1, side_t::BUY, 104, 4);
+	stop.order_type_ = order_type_t::STOP_LIMIT;
+	stop.stop_price_ = 102;
+	apply(stop);
+	auto gtt = make_request(client_request_type::NEW, 1, 2, 4, side_t::SELL, 300, 3);
+	gtt.time_in_force_ = time_in_force_t::GTT;
+	gtt.expire_time_ = static_cast<uint64_t>(kse::utils::get_current_timestamp()) + 3600 * static_cast<uint64_t>(kse::utils::NANOS_PER_SECS);
+	apply(gtt);
+	apply(make_request(client_request_type::MODIFY, 1, 0, 1, side_t::BUY, 100, 12));
+
+	const auto checkpoint_sequence_number = journal->next_sequence_number() - 1;
+	ASSERT_TRUE(live.write_checkpoint(checkpoint_path, checkpoint_sequence_number));
+
+	// After it: a trade through the iceberg that triggers the stop, and more orders.
+	apply(make_request(client_request_type::NEW, 3, 0, 2, side_t::BUY, 102, 15));
+	apply(make_request(client_request_type::NEW, 2, 0, 3, side_t::BUY, 98, 6));
+	apply(make_request(client_request_type::CANCEL, 1, 0, 2, side_t::BUY, 99, 0));
+	const auto live_hash = live.state_hash();
+	const auto num_records = journal->next_sequence_number() - 1;
+	journal.reset();
+
+	client_response_queue restored_responses{ MAX_CLIENT_UPDATES };
+	market_update_queue restored_updates{ MAX_MARKET_UPDATES };
+	matching_engine restored{ &requests, &restored_responses, &restored_updates };
+
+	EXPECT_EQ(restored.restore_checkpoint(checkpoint_path), checkpoint_sequence_number);
+	journal_reader reader{ directory, checkpoint_sequence_number + 1 };
+	const auto result = restored.replay(reader);
+	EXPECT_EQ(result.requests_, num_records - checkpoint_sequence_number);
+	EXPECT_EQ(result.last_sequence_number_, num_records);
+	EXPECT_EQ(result.state_hash_, live_hash);
+
+	// The client order lists come back in their original order, so a mass cancel reports the orders the same way.
+	drain_canceled(live_responses);
+	const auto mass_cancel = make_request(client_request_type::MASS_CANCEL, 1, INVALID_INSTRUMENT_ID, 9, side_t::INVALID, INVALID_PRICE, 0);
+	live.process_client_request(mass_cancel);
+	restored.process_client_request(mass_cancel);
+	const auto live_canceled = drain_canceled(live_responses);
+	EXPECT_EQ(live_canceled.size(), 3);
+	EXPECT_EQ(drain_canceled(restored_responses), live_canceled);
+	EXPECT_EQ(restored.state_hash(), live.state_hash());
+}
+
+TEST(MatchingEngineTest, CorruptCheckpointIsIgnored) {
+	const auto directory = std::filesystem::temp_directory_path() / "kse_matching_engine_test_corrupt";
+	std::filesystem::remove_all(directory);
+	std::filesystem::create_directories(directory);
+	const auto checkpoint_path = (directory / CHECKPOINT_FILE_NAME).string();
+
+	client_request_queue requests{ MAX_CLIENT_UPDATES };
+	client_response_queue responses{ MAX_CLIENT_UPDATES };
+	market_update_queue updates{ MAX_MARKET_UPDATES };
+	matching_engine engine{ &requests, &responses, &updates };
+
+	EXPECT_EQ(engine.restore_checkpoint(checkpoint_path), 0);
+
+	engine.process_client_request(make_request(client_request_type::NEW, 1, 0, 1, side_t::BUY, 100, 10));
+	ASSERT_TRUE(engine.write_checkpoint(checkpoint_path, 1));
+	{
+		std::fstream file{ checkpoint_path, std::ios::in | std::ios::out | std::ios::binary };
+		file.seekp(-1, std::ios::end);
+		file.put('\x55');
+	}
+
+	matching_engine restored{ &requests, &responses, &updates };
+	EXPECT_EQ(restored.restore_checkpoint(checkpoint_path), 0);
+	EXPECT_NE(restored.state_hash(), engine.state_hash());
+}
+
+TEST(MatchingEngineTest, StandbyFollowsThePrimaryAndTakesOver) {
+	const auto directory = (std::filesystem::temp_directory_path() / "kse_matching_engine_test_standby").string();
+	std::filesystem::remove_all(directory);
+	constexpr std::string_view segment_name = "kse_matching_engine_test_standby";
+
+	EXPECT_EQ(standby_replica::connect(segment_name, directory, 0), nullptr);
+
+	client_request_queue requests{ MAX_CLIENT_UPDATES };
+	client_response_queue primary_responses{ MAX_CLIENT_UPDATES };
+	market_update_queue primary_updates{ MAX_MARKET_UPDATES };
+
+	auto journal = request_journal::open({ directory });
+	ASSERT_NE(journal, nullptr);
+	matching_engine primary{ &requests, &primary_responses, &primary_updates, {}, journal.get() };
+	const auto apply = [&](const client_request_internal& request) {
+		journal->append(request, 0);
+		primary.process_client_request(request);
+	};
+
+	// Appended before replication starts, so the standby has to read them from the journal files.
+	apply(make_request(client_request_type::NEW, 1, 0, 1, side_t::BUY, 100, 10));
+	apply(make_request(client_request_type::NEW, 2, 0, 1, side_t::SELL, 101, 5));
+
+	auto publisher = replication_publisher::create(segment_name);
+	ASSERT_NE(publisher, nullptr);
+	journal->set_replication(publisher.get());
+	auto replica = standby_replica::connect(segment_name, directory, 0);
+	ASSERT_NE(replica, nullptr);
+
+	apply(make_request(client_request_type::NEW, 3, 0, 1, side_t::BUY, 101, 3));
+	apply(make_request(client_request_type::MODIFY, 1, 0, 1, side_t::BUY, 100, 8));
+	const auto header = make_request(client_request_type::BATCH_NEW, 2, INVALID_INSTRUMENT_ID, 7, side_t::INVALID, INVALID_PRICE, 2);
+	std::vector<client_request_internal> entries{ make_request(client_request_type::BATCH_ENTRY, 2, 0, 2, side_t::SELL, 102, 5),
+		make_request(client_request_type::BATCH_ENTRY, 2, 1, 3, side_t::BUY, 245, 8) };
+	journal->append(header, 0);
+	size_t next = 0;
+	primary.process_batch(header, [&](client_request_internal& entry) {
+		entry = entries[next++];
+		journal->append(entry, 0);
+		return true;
+	});
+	const auto num_records = journal->next_sequence_number() - 1;
+
+	// The primary shuts down: the heartbeat stops and its pid is cleared.
+	primary.set_journal(nullptr);
+	journal.reset();
+	publisher.reset();
+
+	client_response_queue standby_responses{ MAX_CLIENT_UPDATES };
+	market_update_queue standby_updates{ MAX_MARKET_UPDATES };
+	matching_engine standby{ &requests, &standby_responses, &standby_updates };
+	EXPECT_EQ(standby.follow(*replica, 50 * kse::utils::NANOS_PER_MILLIS), num_records);
+	EXPECT_EQ(standby.state_hash(), primary.state_hash());
+	EXPECT_EQ(replica->lag(), 0);
+	EXPECT_EQ(standby_responses.size(), 0);
+	EXPECT_EQ(standby_updates.size(), 0);
+}
+
+TEST(MatchingEngineTest, StalledPrimaryIsNotTakenOver) {
+	constexpr std::string_view segment_name = "kse_matching_engine_test_stalled";
+	auto segment = kse::utils::shared_memory_segment::create(segment_name, sizeof(replication_layout));
+	ASSERT_NE(segment, nullptr);
+	auto* layout = new (segment->data()) replication_layout{};
+	layout->primary_pid_.store(kse::utils::get_process_id());
+
+	// The heartbeat is long stale, but the primary's process still runs.
+	auto replica = standby_replica::connect(segment_name, ".", 0);
+	ASSERT_NE(replica, nullptr);
+	EXPECT_TRUE(replica->primary_alive(50 * kse::utils::NANOS_PER_MILLIS));
+
+	layout->primary_pid_.store(0);
+	EXPECT_FALSE(replica->primary_alive(50 * kse::utils::NANOS_PER_MILLIS));
+
+	layout->primary_heartbeat_.store(kse::utils::get_monotonic_timestamp());
+	EXPECT_TRUE(replica->primary_alive(50 * kse::utils::NANOS_PER_MILLIS));
+}
@@ -1,5 +1,11 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "engine/checkpoint.hpp"
 #include "engine/order_book.hpp"
 
 #include "models/client_request.hpp"
@@ -362,3 +368,553 @@ TEST_F(OrderBookTest, CancelNonExistentOrder) {
 	EXPECT_EQ(response->type_, client_response_type::CANCEL_REJECTED);
 	EXPECT_EQ(response->client_id_, client_id);
 }
+
+TEST_F(OrderBookTest, QuoteModifiesLiveOrderOrAddsIt) {
+	client_id_t client_id = 1;
+
+	order_book->quote(client_id, 1, side_t::BUY, 100, 10);
+	ASSERT_EQ(client_responses.size(), 1);
+	EXPECT_EQ(client_responses.get_next_read_element()->type_, client_response_type::ACCEPTED);
+	client_responses.next_read_index();
+
+	order_book->quote(client_id, 1, side_t::BUY, 100, 5);
+	ASSERT_EQ(client_responses.size(), 1);
+	EXPECT_EQ(client_responses.get_next_read_element()->type_, client_response_type::MODIFIED);
+	client_responses.next_read_index();
+
+	// The same id on the other side replaces the order.
+	order_book->quote(client_id, 1, side_t::SELL, 105, 5);
+	ASSERT_EQ(client_responses.size(), 2);
+	EXPECT_EQ(client_responses.get_next_read_element()->type_, client_response_type::CANCELED);
+	client_responses.next_read_index();
+	auto response = client_responses.get_next_read_element();
+	EXPECT_EQ(response->type_, client_response_type::ACCEPTED);
+	EXPECT_EQ(response->side_, side_t::SELL);
+	EXPECT_EQ(response->price_, 105);
+}
+
+TEST_F(OrderBookTest, MassCancelRemovesOnlyTheClientsOrders) {
+	order_book->add(1, 1, side_t::BUY, 100, 10);
+	order_book->add(2, 1, side_t::BUY, 100, 10);
+	order_book->add(1, 2, side_t::BUY, 99, 10);
+	order_book->add(1, 3, side_t::SELL, 105, 10);
+	order_book->add(1, 4, side_t::SELL, 106, 10);
+	order_book->cancel(1, 2);
+	while (client_responses.size()) client_responses.next_read_index();
+	while (market_updates.size()) market_updates.next_read_index();
+
+	EXPECT_EQ(order_book->mass_cancel(1, side_t::SELL), 2);
+	ASSERT_EQ(client_responses.size(), 2);
+	ASSERT_EQ(market_updates.size(), 2);
+	while (client_responses.size()) {
+		auto response = client_responses.get_next_read_element();
+		EXPECT_EQ(response->type_, client_response_type::CANCELED);
+		EXPECT_EQ(response->side_, side_t::SELL);
+		client_responses.next_read_index();
+	}
+	while (market_updates.size()) {
+		EXPECT_EQ(market_updates.get_next_read_element()->type_, market_update_type::CANCEL);
+		market_updates.next_read_index();
+	}
+
+	EXPECT_EQ(order_book->mass_cancel(1, side_t::INVALID), 1);
+	ASSERT_EQ(client_responses.size(), 1);
+	EXPECT_EQ(client_responses.get_next_read_element()->client_order_id_, 1);
+	client_responses.next_read_index();
+	EXPECT_EQ(order_book->mass_cancel(1, side_t::INVALID), 0);
+
+	// The other client's order is still resting and still cancelable.
+	order_book->cancel(2, 1);
+	ASSERT_EQ(client_responses.size(), 1);
+	EXPECT_EQ(client_responses.get_next_read_element()->type_, client_response_type::CANCELED);
+}
+
+TEST_F(OrderBookTest, ImmediateOrdersNeverRest) {
+	order_book->add(1, 1, side_t::SELL, 100, 10);
+	order_book->add(1, 2, side_t::SELL, 101, 10);
+	while (client_responses.size()) client_responses.next_read_index();
+	while (market_updates.size()) market_updates.next_read_index();
+
+	// IOC: fills the first level only, the rest is canceled without an ADD.
+	order_book->add(2, 1, side_t::BUY, 100, 15, order_type_t::LIMIT, time_in_force_t::IOC);
+	std::vector<client_response_type> types;
+	for (; client_responses.size(); client_responses.next_read_index()) {
+		types.push_back(client_responses.get_next_read_element()->type_);
+	}
+	ASSERT_EQ(types, (std::vector{ client_response_type::ACCEPTED, client_response_type::FILLED, client_response_type::FILLED, client_response_type::CANCELED }));
+	for (; market_updates.size(); market_updates.next_read_index()) {
+		EXPECT_NE(market_updates.get_next_read_element()->type_, market_update_type::ADD);
+	}
+
+	// FOK: 11 are wanted but only 10 rest up to 102, so nothing trades and the book is untouched.
+	order_book->add(2, 2, side_t::BUY, 102, 11, order_type_t::LIMIT, time_in_force_t::FOK);
+	ASSERT_EQ(client_responses.size(), 2);
+	client_responses.next_read_index();
+	auto response = client_responses.get_next_read_element();
+	EXPECT_EQ(response->type_, client_response_type::CANCELED);
+	EXPECT_EQ(response->leaves_qty_, 11);
+	client_responses.next_read_index();
+	EXPECT_EQ(market_updates.size(), 0);
+
+	// Market: takes the remaining level whatever its price.
+	order_book->add(2, 3, side_t::BUY, INVALID_PRICE, 10, order_type_t::MARKET, time_in_force_t::IOC);
+	ASSERT_EQ(client_responses.size(), 3);
+	client_responses.next_read_index();
+	response = client_responses.get_next_read_element();
+	EXPECT_EQ(response->type_, client_response_type::FILLED);
+	EXPECT_EQ(response->price_, 101);
+	EXPECT_EQ(response->leaves_qty_, 0);
+	while (client_responses.size()) client_responses.next_read_index();
+
+	order_book->cancel(2, 1);
+	EXPECT_EQ(client_responses.get_next_read_element()->type_, client_response_type::CANCEL_REJECTED);
+}
+
+TEST_F(OrderBookTest, StopsTriggerOnTradesInOrder) {
+	order_book->add(1, 1, side_t::SELL, 100, 5);
+	order_book->add(1, 2, side_t::SELL, 101, 5);
+	order_book->add(1, 3, side_t::SELL, 102, 5);
+
+	// Parked stops are acknowledged but invisible to the market.
+	order_book->add(2, 1, side_t::BUY, INVALID_PRICE, 5, order_type_t::STOP, time_in_force_t::GTC, 101);
+	order_book->add(3, 1, side_t::BUY, 105, 5, order_type_t::STOP_LIMIT, time_in_force_t::GTC, 100);
+	order_book->add(4, 1, side_t::BUY, INVALID_PRICE, 5, order_type_t::STOP, time_in_force_t::GTC, 101);
+	order_book->add(2, 2, side_t::SELL, INVALID_PRICE, 5, order_type_t::STOP, time_in_force_t::GTC, 90);
+	while (client_responses.size()) client_responses.next_read_index();
+	while (market_updates.size()) market_updates.next_read_index();
+
+	// The trade at 100 triggers client 3's stop limit, which lifts 101 and in turn triggers clients 2 and 4, in arrival order.
+	order_book->add(5, 1, side_t::BUY, 100, 5);
+	std::vector<std::pair<client_response_type, client_id_t>> responses;
+	for (; client_responses.size(); client_responses.next_read_index()) {
+		const auto* response = client_responses.get_next_read_element();
+		if (response->type_ != client_response_type::FILLED || response->side_ == side_t::BUY) {
+			responses.emplace_back(response->type_, response->client_id_);
+		}
+	}
+	EXPECT_EQ(responses, (std::vector<std::pair<client_response_type, client_id_t>>{
+		{ client_response_type::ACCEPTED, 5 }, { client_response_type::FILLED, 5 },
+		{ client_response_type::TRIGGERED, 3 }, { client_response_type::FILLED, 3 },
+		{ client_response_type::TRIGGERED, 2 }, { client_response_type::FILLED, 2 },
+		{ client_response_type::TRIGGERED, 4 }, { client_response_type::CANCELED, 4 } }));
+	while (market_updates.size()) market_updates.next_read_index();
+
+	// The sell stop is still parked: cancels find it, and a mass cancel has nothing left.
+	order_book->cancel(2, 2);
+	ASSERT_EQ(client_responses.size(), 1);
+	EXPECT_EQ(client_responses.get_next_read_element()->type_, client_response_type::CANCELED);
+	client_responses.next_read_index();
+	EXPECT_EQ(market_updates.size(), 0);
+	EXPECT_EQ(order_book->mass_cancel(2, side_t::INVALID), 0);
+}
+
+TEST_F(OrderBookTest, FillOrKillNeverCountsSelfTrades) {
+	const auto drain = [this] {
+		std::vector<std::pair<client_response_type, client_id_t>> responses;
+		for (; client_responses.size(); client_responses.next_read_index()) {
+			const auto* response = client_responses.get_next_read_element();
+			responses.emplace_back(response->type_, response->client_id_);
+		}
+		size_t updates = 0;
+		for (; market_updates.size(); market_updates.next_read_index()) {
+			++updates;
+		}
+		return std::make_pair(responses, updates);
+	};
+	using responses_t = std::vector<std::pair<client_response_type, client_id_t>>;
+	const auto fok = [this](order_id_t order_id, price_t price, quantity_t qty, stp_mode_t stp_mode) {
+		order_book->add(2, order_id, side_t::BUY, price, qty, order_type_t::LIMIT, time_in_force_t::FOK, INVALID_PRICE, INVALID_QUANTITY, stp_mode);
+	};
+
+	order_book->add(1, 1, side_t::SELL, 100, 10);
+	order_book->add(2, 1, side_t::SELL, 100, 10);
+	drain();
+
+	// 20 rest at 100 but only 10 belong to someone else: the order is killed and the client's own ask stays.
+	fok(2, 100, 20, stp_mode_t::CANCEL_OLDEST);
+	EXPECT_EQ(drain(), std::make_pair(responses_t{ { client_response_type::ACCEPTED, 2 }, { client_response_type::CANCELED, 2 } }, size_t{ 0 }));
+
+	// With another 10 from someone else at 101 it fills, and cancel oldest takes the client's ask out of the way.
+	order_book->add(3, 1, side_t::SELL, 101, 10);
+	drain();
+	fok(3, 101, 20, stp_mode_t::CANCEL_OLDEST);
+	auto [responses, updates] = drain();
+	EXPECT_EQ(std::ranges::count(responses, std::make_pair(client_response_type::FILLED, client_id_t{ 2 })), 2);
+	EXPECT_EQ(std::ranges::count(responses, std::make_pair(client_response_type::CANCELED, client_id_t{ 2 })), 1);
+	EXPECT_EQ(responses.back(), std::make_pair(client_response_type::FILLED, client_id_t{ 3 }));
+
+	// Cancel newest and decrement stop at the client's own order, so only the 10 in front of it count.
+	order_book->add(1, 2, side_t::SELL, 100, 10);
+	order_book->add(2, 4, side_t::SELL, 100, 10);
+	order_book->add(3, 2, side_t::SELL, 100, 10);
+	drain();
+	for (const auto stp_mode : { stp_mode_t::CANCEL_NEWEST, stp_mode_t::CANCEL_BOTH, stp_mode_t::DECREMENT }) {
+		fok(5, 100, 20, stp_mode);
+		EXPECT_EQ(drain(), std::make_pair(responses_t{ { client_response_type::ACCEPTED, 2 }, { client_response_type::CANCELED, 2 } }, size_t{ 0 }));
+	}
+	fok(5, 100, 10, stp_mode_t::CANCEL_NEWEST);
+	EXPECT_EQ(drain().first, (responses_t{ { client_response_type::ACCEPTED, 2 }, { client_response_type::FILLED, 2 }, { client_response_type::FILLED, 1 } }));
+}
+
+TEST_F(OrderBookTest, IcebergsShowOnlyTheirPeak) {
+	order_book->add(1, 1, side_t::SELL, 100, 25, order_type_t::LIMIT, time_in_force_t::GTC, INVALID_PRICE, 10);
+	order_book->add(2, 1, side_t::SELL, 100, 5);
+	ASSERT_EQ(market_updates.size(), 2);
+	auto* update = market_updates.get_next_read_element();
+	EXPECT_EQ(update->type_, market_update_type::ADD);
+	EXPECT_EQ(update->qty_, 10);
+	const auto iceberg_id = update->order_id_;
+	const auto iceberg_priority = update->priority_;
+	market_updates.next_read_index();
+	const auto other_priority = market_updates.get_next_read_element()->priority_;
+	EXPECT_GT(other_priority, iceberg_priority);
+	market_updates.next_read_index();
+	while (client_responses.size()) client_responses.next_read_index();
+
+	// Taking the peak replenishes it from the reserve behind the other order; the owner sees the whole quantity left.
+	order_book->add(3, 1, side_t::BUY, 100, 10);
+	std::vector<market_update> updates;
+	for (; market_updates.size(); market_updates.next_read_index()) {
+		updates.push_back(*market_updates.get_next_read_element());
+	}
+	ASSERT_EQ(updates.size(), 3);
+	EXPECT_EQ(updates[0].type_, market_update_type::TRADE);
+	EXPECT_EQ(updates[1].type_, market_update_type::CANCEL);
+	EXPECT_EQ(updates[2].type_, market_update_type::ADD);
+	EXPECT_EQ(updates[2].order_id_, iceberg_id);
+	EXPECT_EQ(updates[2].qty_, 10);
+	EXPECT_GT(updates[2].priority_, other_priority);
+	client_responses.next_read_index();
+	client_responses.next_read_index();
+	EXPECT_EQ(client_responses.get_next_read_element()->client_id_, 1);
+	EXPECT_EQ(client_responses.get_next_read_element()->leaves_qty_, 15);
+	while (client_responses.size()) client_responses.next_read_index();
+
+	// The next buyer meets the other order first, then the iceberg's new peak; the last peak holds what the reserve had left.
+	order_book->add(3, 2, side_t::BUY, 100, 20);
+	std::vector<client_id_t> sellers;
+	for (; client_responses.size(); client_responses.next_read_index()) {
+		const auto* response = client_responses.get_next_read_element();
+		if (response->type_ == client_response_type::FILLED && response->side_ == side_t::SELL) {
+			sellers.push_back(response->client_id_);
+		}
+	}
+	EXPECT_EQ(sellers, (std::vector<client_id_t>{ 2, 1, 1 }));
+	updates.clear();
+	for (; market_updates.size(); market_updates.next_read_index()) {
+		updates.push_back(*market_updates.get_next_read_element());
+	}
+	const auto last_peak = std::ranges::find(updates, market_update_type::ADD, &market_update::type_);
+	ASSERT_NE(last_peak, updates.end());
+	EXPECT_EQ(last_peak->qty_, 5);
+	EXPECT_EQ(updates.back().type_, market_update_type::CANCEL);
+	EXPECT_EQ(updates.back().order_id_, iceberg_id);
+}
+
+TEST_F(OrderBookTest, SelfTradePreventionModes) {
+	const auto drain = [this] {
+		std::vector<std::pair<client_response_type, order_id_t>> responses;
+		for (; client_responses.size(); client_responses.next_read_index()) {
+			const auto* response = client_responses.get_next_read_element();
+			responses.emplace_back(response->type_, response->client_order_id_);
+		}
+		while (market_updates.size()) market_updates.next_read_index();
+		return responses;
+	};
+	using responses_t = std::vector<std::pair<client_response_type, order_id_t>>;
+
+	// Without a mode the client trades with itself.
+	order_book->add(1, 1, side_t::SELL, 100, 10);
+	order_book->add(1, 2, side_t::BUY, 100, 4);
+	EXPECT_EQ(drain(), (responses_t{ { client_response_type::ACCEPTED, 1 }, { client_response_type::ACCEPTED, 2 }, { client_response_type::FILLED, 2 }, { client_response_type::FILLED, 1 } }));
+
+	// Cancel newest: the incoming order goes, the resting one stays.
+	order_book->add(1, 3, side_t::BUY, 100, 4, order_type_t::LIMIT, time_in_force_t::GTC, INVALID_PRICE, INVALID_QUANTITY, stp_mode_t::CANCEL_NEWEST);
+	EXPECT_EQ(drain(), (responses_t{ { client_response_type::ACCEPTED, 3 }, { client_response_type::CANCELED, 3 } }));
+
+	// Decrement: 6 rest, 4 come in; the resting order keeps 2 and nothing trades.
+	order_book->add(1, 4, side_t::BUY, 100, 4, order_type_t::LIMIT, time_in_force_t::GTC, INVALID_PRICE, INVALID_QUANTITY, stp_mode_t::DECREMENT);
+	EXPECT_EQ(drain(), (responses_t{ { client_response_type::ACCEPTED, 4 }, { client_response_type::DECREMENTED, 1 }, { client_response_type::CANCELED, 4 } }));
+
+	// Another client's order behind it is reached once cancel oldest takes the client's own order out of the way.
+	order_book->add(2, 1, side_t::SELL, 100, 5);
+	order_book->add(1, 5, side_t::BUY, 100, 5, order_type_t::LIMIT, time_in_force_t::GTC, INVALID_PRICE, INVALID_QUANTITY, stp_mode_t::CANCEL_OLDEST);
+	EXPECT_EQ(drain(), (responses_t{ { client_response_type::ACCEPTED, 1 }, { client_response_type::ACCEPTED, 5 }, { client_response_type::CANCELED, 1 },
+		{ client_response_type::FILLED, 5 }, { client_response_type::FILLED, 1 } }));
+
+	// Cancel both.
+	order_book->add(1, 6, side_t::SELL, 101, 5);
+	order_book->add(1, 7, side_t::BUY, 101, 5, order_type_t::LIMIT, time_in_force_t::GTC, INVALID_PRICE, INVALID_QUANTITY, stp_mode_t::CANCEL_BOTH);
+	EXPECT_EQ(drain(), (responses_t{ { client_response_type::ACCEPTED, 6 }, { client_response_type::ACCEPTED, 7 }, { client_response_type::CANCELED, 6 }, { client_response_type::CANCELED, 7 } }));
+
+	order_book->cancel(1, 1);
+	EXPECT_EQ(drain(), (responses_t{ { client_response_type::CANCEL_REJECTED, 1 } }));
+}
+
+TEST_F(OrderBookTest, CallAuctionUncrossesAtEquilibrium) {
+	const auto drain = [this] {
+		std::vector<std::pair<client_response_type, price_t>> responses;
+		for (; client_responses.size(); client_responses.next_read_index()) {
+			const auto* response = client_responses.get_next_read_element();
+			responses.emplace_back(response->type_, response->price_);
+		}
+		std::vector<market_update> updates;
+		for (; market_updates.size(); market_updates.next_read_index()) {
+			updates.push_back(*market_updates.get_next_read_element());
+		}
+		return std::make_pair(responses, updates);
+	};
+	using responses_t = std::vector<std::pair<client_response_type, price_t>>;
+
+	order_book->start_auction();
+	ASSERT_TRUE(order_book->in_auction());
+
+	// The book crosses but nothing trades during the call.
+	order_book->add(1, 1, side_t::SELL, 100, 10);
+	order_book->add(1, 2, side_t::SELL, 101, 10);
+	order_book->add(2, 1, side_t::BUY, 102, 15);
+	order_book->add(3, 1, side_t::BUY, 100, 5);
+	auto [responses, updates] = drain();
+	EXPECT_EQ(std::ranges::count(responses, client_response_type::ACCEPTED, &std::pair<client_response_type, price_t>::first), 4);
+	EXPECT_EQ(std::ranges::count(updates, market_update_type::ADD, &market_update::type_), 4);
+
+	// Immediate orders cannot rest, so they are canceled.
+	order_book->add(4, 1, side_t::BUY, 102, 5, order_type_t::LIMIT, time_in_force_t::IOC);
+	EXPECT_EQ(drain().first, (responses_t{ { client_response_type::ACCEPTED, 102 }, { client_response_type::CANCELED, 102 } }));
+
+	// 101 and 102 both execute 15 with 5 left on the sell side; 101 comes first.
+	const auto equilibrium = order_book->find_uncross();
+	EXPECT_EQ(equilibrium, (uncross_result{ 101, 15, side_t::SELL, 5 }));
+
+	order_book->publish_indicative();
+	std::tie(responses, updates) = drain();
+	ASSERT_EQ(updates.size(), 1);
+	EXPECT_EQ(updates[0].type_, market_update_type::INDICATIVE);
+	EXPECT_EQ(updates[0].price_, 101);
+	EXPECT_EQ(updates[0].qty_, 15);
+	EXPECT_EQ(updates[0].side_, side_t::SELL);
+	EXPECT_EQ(updates[0].priority_, 5);
+
+	// Unchanged equilibrium, no update.
+	order_book->publish_indicative();
+	EXPECT_TRUE(drain().second.empty());
+
+	order_book->uncross();
+	EXPECT_FALSE(order_book->in_auction());
+	std::tie(responses, updates) = drain();
+	EXPECT_EQ(responses, (responses_t{ { client_response_type::FILLED, 101 }, { client_response_type::FILLED, 101 },
+		{ client_response_type::FILLED, 101 }, { client_response_type::FILLED, 101 } }));
+	const auto trades = std::ranges::count(updates, market_update_type::TRADE, &market_update::type_);
+	EXPECT_EQ(trades, 2);
+	for (const auto& update : updates) {
+		if (update.type_ == market_update_type::TRADE) {
+			EXPECT_EQ(update.price_, 101);
+			EXPECT_EQ(update.side_, side_t::INVALID);
+		}
+	}
+	EXPECT_EQ(order_book->find_uncross().price_, INVALID_PRICE);
+
+	// Continuous trading resumes: 5 left at 101 on the sell side.
+	order_book->add(4, 2, side_t::BUY, 101, 5);
+	EXPECT_EQ(drain().first, (responses_t{ { client_response_type::ACCEPTED, 101 }, { client_response_type::FILLED, 101 }, { client_response_type::FILLED, 101 } }));
+}
+
+TEST_F(OrderBookTest, AllocationPolicies) {
+	using fills_t = std::vector<std::pair<client_id_t, quantity_t>>;
+	const auto resting_fills = [this](const matching_params& matching, quantity_t qty) {
+		order_book = std::make_unique<kse::engine::order_book>(1, &loggerq, &message_handlers, matching);
+		order_book->add(1, 1, side_t::SELL, 100, 10);
+		order_book->add(2, 1, side_t::SELL, 100, 30);
+		order_book->add(3, 1, side_t::SELL, 100, 60);
+		order_book->add(4, 1, side_t::BUY, 100, qty);
+
+		fills_t fills;
+		for (; client_responses.size(); client_responses.next_read_index()) {
+			const auto* response = client_responses.get_next_read_element();
+			if (response->type_ == client_response_type::FILLED && response->client_id_ != 4) {
+				fills.emplace_back(response->client_id_, response->exec_qty_);
+			}
+		}
+		while (market_updates.size()) market_updates.next_read_index();
+		return fills;
+	};
+
+	EXPECT_EQ(resting_fills({}, 50), (fills_t{ { 1, 10 }, { 2, 30 }, { 3, 10 } }));
+
+	// 50 splits 10:30:60 exactly; 7 floors to 0, 2 and 4 and the leftover lot goes to the oldest order.
+	EXPECT_EQ(resting_fills({ matching_policy_t::PRO_RATA }, 50), (fills_t{ { 1, 5 }, { 2, 15 }, { 3, 30 } }));
+	EXPECT_EQ(resting_fills({ matching_policy_t::PRO_RATA }, 7), (fills_t{ { 1, 1 }, { 2, 2 }, { 3, 4 } }));
+
+	// The top order fills first, then 40 splits 30:60.
+	EXPECT_EQ(resting_fills({ matching_policy_t::PRO_RATA_TOP_ORDER }, 50), (fills_t{ { 1, 10 }, { 2, 14 }, { 3, 26 } }));
+
+	// The lead market maker takes 40% of 50, the rest goes in time order.
+	EXPECT_EQ(resting_fills({ matching_policy_t::LMM, 3, 40 }, 50), (fills_t{ { 1, 10 }, { 2, 20 }, { 3, 20 } }));
+
+	// A share over 100% is capped at the incoming quantity.
+	EXPECT_EQ(resting_fills({ matching_policy_t::LMM, 3, 250 }, 50), (fills_t{ { 3, 50 } }));
+
+	// More than the level holds sweeps it and moves on.
+	order_book = std::make_unique<kse::engine::order_book>(1, &loggerq, &message_handlers, matching_params{ matching_policy_t::PRO_RATA });
+	order_book->add(1, 1, side_t::SELL, 100, 10);
+	order_book->add(2, 1, side_t::SELL, 101, 10);
+	order_book->add(3, 1, side_t::BUY, 101, 15);
+	quantity_t buyer_leaves = 0;
+	for (; client_responses.size(); client_responses.next_read_index()) {
+		const auto* response = client_responses.get_next_read_element();
+		if (response->client_id_ == 3) {
+			buyer_leaves = response->leaves_qty_;
+		}
+	}
+	EXPECT_EQ(buyer_leaves, 0);
+}
+
+TEST_F(OrderBookTest, IcebergsReplenishedAnywhereInALevelGoToItsBack) {
+	// Resting orders in book order, read back through a checkpoint: (client id, priority).
+	using level_t = std::vector<std::pair<client_id_t, priority_t>>;
+	const auto resting_orders = [this] {
+		std::vector<char> checkpoint(order_book->checkpoint_size());
+		order_book->write_checkpoint(checkpoint.data());
+		book_checkpoint_header header;
+		std::memcpy(&header, checkpoint.data(), sizeof(header));
+		level_t orders;
+		for (uint32_t i = 0; i < header.num_orders_; ++i) {
+			checkpoint_order order;
+			std::memcpy(&order, checkpoint.data() + sizeof(header) + i * sizeof(order), sizeof(order));
+			orders.emplace_back(order.client_id_, order.priority_);
+		}
+		return orders;
+	};
+	const auto drain = [this] {
+		while (client_responses.size()) client_responses.next_read_index();
+		while (market_updates.size()) market_updates.next_read_index();
+	};
+
+	// A, then the iceberg B with a peak of 5, then C, all selling at 100.
+	const auto rest = [this](const matching_params& matching) {
+		order_book = std::make_unique<kse::engine::order_book>(1, &loggerq, &message_handlers, matching);
+		order_book->add(1, 1, side_t::SELL, 100, 10);
+		order_book->add(2, 1, side_t::SELL, 100, 25, order_type_t::LIMIT, time_in_force_t::GTC, INVALID_PRICE, 5);
+		order_book->add(3, 1, side_t::SELL, 100, 10);
+	};
+
+	// The lead market maker's peak is taken in the middle of the level: it goes behind C, and A keeps its place.
+	rest({ matching_policy_t::LMM, 2, 50 });
+	order_book->add(4, 1, side_t::BUY, 100, 10);
+	EXPECT_EQ(resting_orders(), (level_t{ { 1, 1 }, { 3, 3 }, { 2, 4 } }));
+	drain();
+
+	// Decrement reaches the client's own order in the middle of the level too.
+	for (const auto policy : { matching_policy_t::PRO_RATA, matching_policy_t::PRO_RATA_TOP_ORDER, matching_policy_t::LMM }) {
+		rest({ policy, 3, 50 });
+		order_book->add(2, 2, side_t::BUY, 100, 5, order_type_t::LIMIT, time_in_force_t::GTC, INVALID_PRICE, INVALID_QUANTITY, stp_mode_t::DECREMENT);
+		EXPECT_EQ(resting_orders(), (level_t{ { 1, 1 }, { 3, 3 }, { 2, 4 } }));
+		drain();
+	}
+
+	// Pro-rata policies only empty a peak together with everything before it; the level stays in priority order either way.
+	for (const auto policy : { matching_policy_t::PRO_RATA, matching_policy_t::PRO_RATA_TOP_ORDER }) {
+		rest({ policy });
+		order_book->add(4, 1, side_t::BUY, 100, 24);
+		const auto orders = resting_orders();
+		EXPECT_TRUE(std::ranges::is_sorted(orders, {}, &std::pair<client_id_t, priority_t>::second));
+		EXPECT_EQ(orders.back().first, 2);
+		drain();
+	}
+}
+
+TEST_F(OrderBookTest, ExpiredOrdersAreCanceled) {
+	expiry_wheel expiries{ 0 };
+	order_book = std::make_unique<kse::engine::order_book>(1, &loggerq, &message_handlers, matching_params{}, &expiries);
+	const auto expire_at = [](uint64_t tick) { return tick * EXPIRY_TICK; };
+
+	order_book->add(1, 1, side_t::BUY, 100, 10, order_type_t::LIMIT, time_in_force_t::GTT, INVALID_PRICE, INVALID_QUANTITY, stp_mode_t::NONE, expire_at(5));
+	order_book->add(1, 2, side_t::BUY, 99, 10, order_type_t::LIMIT, time_in_force_t::GTT, INVALID_PRICE, INVALID_QUANTITY, stp_mode_t::NONE, expire_at(5));
+	order_book->add(1, 3, side_t::BUY, 98, 10, order_type_t::LIMIT, time_in_force_t::GTT, INVALID_PRICE, INVALID_QUANTITY, stp_mode_t::NONE, expire_at(5));
+	order_book->add(1, 4, side_t::BUY, 97, 10);
+	EXPECT_EQ(expiries.size(), 3);
+
+	// A filled order leaves the wheel; a replaced one keeps its expiry.
+	order_book->add(2, 1, side_t::SELL, 100, 10);
+	order_book->modify(1, 2, 96, 10);
+	EXPECT_EQ(expiries.size(), 2);
+	while (client_responses.size()) client_responses.next_read_index();
+	while (market_updates.size()) market_updates.next_read_index();
+
+	const auto expire = [&](uint64_t now_tick) {
+		return expiries.poll(now_tick, 64, [this](order* expired) { order_book->expire(expired); });
+	};
+	EXPECT_EQ(expire(4), 0);
+	EXPECT_EQ(expire(5), 2);
+
+	std::vector<order_id_t> canceled;
+	for (; client_responses.size(); client_responses.next_read_index()) {
+		const auto* response = client_responses.get_next_read_element();
+		EXPECT_EQ(response->type_, client_response_type::CANCELED);
+		canceled.push_back(response->client_order_id_);
+	}
+	EXPECT_EQ(canceled, (std::vector<order_id_t>{ 3, 2 }));
+	size_t cancels = 0;
+	for (; market_updates.size(); market_updates.next_read_index()) {
+		cancels += market_updates.get_next_read_element()->type_ == market_update_type::CANCEL;
+	}
+	EXPECT_EQ(cancels, 2);
+
+	// The order without an expiry is still there.
+	order_book->cancel(1, 4);
+	EXPECT_EQ(order_book->get_client_response().type_, client_response_type::CANCELED);
+}
+
+TEST_F(OrderBookTest, PriceBandBreachTripsCircuitBreaker) {
+	// Static band 10% around 100, dynamic band 2% around the last trade.
+	matching_params matching{};
+	matching.reference_price_ = 100;
+	matching.static_band_bps_ = 1000;
+	matching.dynamic_band_bps_ = 200;
+	order_book = std::make_unique<kse::engine::order_book>(1, &loggerq, &message_handlers, matching);
+
+	const auto drain = [this] {
+		std::vector<market_update> updates;
+		for (; market_updates.size(); market_updates.next_read_index()) {
+			updates.push_back(*market_updates.get_next_read_element());
+		}
+		while (client_responses.size()) client_responses.next_read_index();
+		return updates;
+	};
+
+	order_book->add(1, 1, side_t::SELL, 100, 10);
+	order_book->add(1, 2, side_t::SELL, 101, 10);
+	order_book->add(1, 3, side_t::SELL, 105, 10);
+	order_book->add(2, 1, side_t::BUY, 100, 5);
+	drain();
+
+	// After a trade at 100 the dynamic band stops buys at 102: the sweep takes 100 and 101, and the 105 ask would breach.
+	order_book->add(2, 2, side_t::BUY, 110, 30);
+	const auto updates = drain();
+	const auto trades = std::ranges::count(updates, market_update_type::TRADE, &market_update::type_);
+	EXPECT_EQ(trades, 2);
+	const auto status = std::ranges::find(updates, market_update_type::TRADING_STATUS, &market_update::type_);
+	ASSERT_NE(status, updates.end());
+	EXPECT_EQ(status->price_, 105);
+	EXPECT_EQ(status->qty_, static_cast<quantity_t>(trading_phase_t::AUCTION));
+	EXPECT_TRUE(order_book->in_auction());
+
+	// The remainder rests in the call, crossing the 105 ask; the uncross resolves it and resumes continuous trading.
+	EXPECT_EQ(order_book->find_uncross(), (uncross_result{ 105, 10, side_t::BUY, 5 }));
+	order_book->uncross();
+	const auto uncross_updates = drain();
+	EXPECT_EQ(uncross_updates.back().type_, market_update_type::TRADING_STATUS);
+	EXPECT_EQ(uncross_updates.back().qty_, static_cast<quantity_t>(trading_phase_t::CONTINUOUS));
+
+	// Market orders are bounded too. Configured to halt, the book stops without trading and the market order is canceled.
+	matching.breach_phase_ = trading_phase_t::HALTED;
+	order_book = std::make_unique<kse::engine::order_book>(1, &loggerq, &message_handlers, matching);
+	order_book->add(3, 1, side_t::SELL, 120, 10);
+	order_book->add(4, 1, side_t::BUY, 0, 10, order_type_t::MARKET);
+	EXPECT_EQ(order_book->get_client_response().type_, client_response_type::CANCELED);
+	const auto halt_updates = drain();
+	EXPECT_EQ(std::ranges::count(halt_updates, market_update_type::TRADE, &market_update::type_), 0);
+	EXPECT_EQ(halt_updates.back().type_, market_update_type::TRADING_STATUS);
+	EXPECT_EQ(halt_updates.back().qty_, static_cast<quantity_t>(trading_phase_t::HALTED));
+	EXPECT_FALSE(order_book->in_auction());
+}
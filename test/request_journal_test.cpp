@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "engine/request_journal.hpp"
+
+using namespace kse::engine;
+using namespace kse::models;
+
+
+namespace {
+	constexpr size_t RECORDS_PER_SEGMENT = 10;
+
+	/// A fresh journal directory with small segments, so a few dozen records roll over several of them.
+	auto make_config(const std::string& name, journal_sync_policy sync_policy = journal_sync_policy::NONE) -> journal_config {
+		const auto directory = std::filesystem::temp_directory_path() / ("kse_request_journal_test_" + name);
+		std::filesystem::remove_all(directory);
+		return { directory.string(), JOURNAL_HEADER_SIZE + RECORDS_PER_SEGMENT * sizeof(journal_record), sync_policy, 100 * kse::utils::NANOS_PER_MICROS };
+	}
+
+	auto make_request(order_id_t order_id) -> client_request_internal {
+		client_request_internal request;
+		request.type_ = client_request_type::NEW;
+		request.client_id_ = 1;
+		request.instrument_id_ = 0;
+		request.order_id_ = order_id;
+		request.side_ = side_t::BUY;
+		request.price_ = 100;
+		request.qty_ = 10;
+		return request;
+	}
+
+	auto read_order_ids(const std::string& directory) -> std::vector<order_id_t> {
+		std::vector<order_id_t> order_ids;
+		journal_reader reader{ directory };
+		uint64_t expected_sequence_number = 1;
+		while (const auto* record = reader.next()) {
+			EXPECT_EQ(record->sequence_number_, expected_sequence_number++);
+			order_ids.push_back(record->request_.order_id_);
+		}
+		return order_ids;
+	}
+}
+
+TEST(RequestJournalTest, RecordsRollOverSegmentsInOrder) {
+	const auto config = make_config("roll");
+	{
+		auto journal = request_journal::open(config);
+		ASSERT_NE(journal, nullptr);
+		for (order_id_t order_id = 1; order_id <= 35; ++order_id) {
+			EXPECT_EQ(journal->append(make_request(order_id), 1000 + order_id), order_id);
+		}
+		EXPECT_EQ(journal->next_sequence_number(), 36);
+	}
+
+	const auto order_ids = read_order_ids(config.directory_);
+	ASSERT_EQ(order_ids.size(), 35);
+	for (size_t i = 0; i < order_ids.size(); ++i) {
+		EXPECT_EQ(order_ids[i], i + 1);
+	}
+
+	// Four segments were written to; the spare prepared after the last one is removed on close.
+	EXPECT_EQ(std::distance(std::filesystem::directory_iterator{ config.directory_ }, std::filesystem::directory_iterator{}), 4);
+}
+
+TEST(RequestJournalTest, ReopeningContinuesAfterTheLastRecord) {
+	const auto config = make_config("reopen");
+	{
+		auto journal = request_journal::open(config);
+		for (order_id_t order_id = 1; order_id <= 12; ++order_id) {
+			journal->append(make_request(order_id), 0);
+		}
+	}
+	{
+		auto journal = request_journal::open(config);
+		ASSERT_NE(journal, nullptr);
+		EXPECT_EQ(journal->next_sequence_number(), 13);
+		for (order_id_t order_id = 13; order_id <= 15; ++order_id) {
+			EXPECT_EQ(journal->append(make_request(order_id), 0), order_id);
+		}
+	}
+
+	EXPECT_EQ(read_order_ids(config.directory_), (std::vector<order_id_t>{ 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 }));
+}
+
+TEST(RequestJournalTest, TornRecordEndsTheJournal) {
+	const auto config = make_config("torn");
+	{
+		auto journal = request_journal::open(config);
+		for (order_id_t order_id = 1; order_id <= 5; ++order_id) {
+			journal->append(make_request(order_id), 0);
+		}
+	}
+
+	// Corrupt the price of the fourth record, as a write cut short by a crash would.
+	{
+		std::fstream segment{ std::filesystem::path{ config.directory_ } / "kse_journal_0.seg", std::ios::in | std::ios::out | std::ios::binary };
+		segment.seekp(static_cast<std::streamoff>(JOURNAL_HEADER_SIZE + 3 * sizeof(journal_record) + offsetof(journal_record, request_) + offsetof(client_request_internal, price_)));
+		segment.put('\x7F');
+	}
+
+	EXPECT_EQ(read_order_ids(config.directory_), (std::vector<order_id_t>{ 1, 2, 3 }));
+
+	auto journal = request_journal::open(config);
+	ASSERT_NE(journal, nullptr);
+	EXPECT_EQ(journal->next_sequence_number(), 4);
+}
+
+TEST(RequestJournalTest, BatchedSyncMakesCommittedRecordsDurable) {
+	const auto config = make_config("sync", journal_sync_policy::BATCHED);
+	auto journal = request_journal::open(config);
+	ASSERT_NE(journal, nullptr);
+
+	for (order_id_t order_id = 1; order_id <= 25; ++order_id) {
+		journal->append(make_request(order_id), 0);
+	}
+	EXPECT_EQ(journal->committed_sequence_number(), 20); //committed at each roll
+	journal->commit();
+	EXPECT_EQ(journal->committed_sequence_number(), 25);
+
+	using namespace std::literals::chrono_literals;
+	for (int i = 0; i < 1000 && journal->durable_sequence_number() < 25; ++i) {
+		std::this_thread::sleep_for(1ms);
+	}
+	EXPECT_EQ(journal->durable_sequence_number(), 25);
+}
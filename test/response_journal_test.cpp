@@ -0,0 +1,43 @@
+#include <gtest/gtest.h>
+
+#include "order_server/response_journal.hpp"
+
+using namespace kse::models;
+using namespace kse::server;
+
+
+namespace {
+	auto make_response(order_id_t client_order_id) -> client_response_internal {
+		return { client_response_type::ACCEPTED, 1, 0, client_order_id, client_order_id, side_t::BUY, 100, 0, 10 };
+	}
+}
+
+TEST(ResponseJournalTest, ReturnsRecordedResponses) {
+	response_journal journal{ 8 };
+
+	EXPECT_FALSE(journal.contains(1));
+
+	for (uint64_t sequence_number = 1; sequence_number <= 5; ++sequence_number) {
+		journal.record(sequence_number, make_response(sequence_number * 10));
+	}
+
+	EXPECT_EQ(journal.first_sequence_number(), 1);
+	EXPECT_EQ(journal.next_sequence_number(), 6);
+	EXPECT_TRUE(journal.contains(5));
+	EXPECT_FALSE(journal.contains(6));
+	EXPECT_EQ(journal.at(3).client_order_id_, 30);
+}
+
+TEST(ResponseJournalTest, KeepsOnlyTheMostRecentResponses) {
+	response_journal journal{ 8 };
+
+	for (uint64_t sequence_number = 1; sequence_number <= 20; ++sequence_number) {
+		journal.record(sequence_number, make_response(sequence_number));
+	}
+
+	EXPECT_EQ(journal.first_sequence_number(), 13);
+	EXPECT_FALSE(journal.contains(12));
+	for (uint64_t sequence_number = 13; sequence_number <= 20; ++sequence_number) {
+		EXPECT_EQ(journal.at(sequence_number).client_order_id_, sequence_number);
+	}
+}
@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+
+#include <array>
+#include <limits>
+
+#include "order_server/risk_gate.hpp"
+
+using namespace kse::models;
+using namespace kse::server;
+
+
+namespace {
+	auto new_order(order_id_t order_id, price_t price, quantity_t qty) -> client_request_internal {
+		return { client_request_type::NEW, 1, 0, order_id, side_t::BUY, price, qty };
+	}
+}
+
+TEST(RiskGateTest, RejectsMalformedRequests) {
+	risk_gate gate;
+	client_risk_state state;
+
+	EXPECT_EQ(gate.check(state, { client_request_type::NEW, 1, MAX_NUM_INSTRUMENTS, 1, side_t::BUY, 100, 10 }), risk_reject_reason::MALFORMED);
+	EXPECT_EQ(gate.check(state, new_order(MAX_NUM_ORDERS, 100, 10)), risk_reject_reason::MALFORMED);
+	EXPECT_EQ(gate.check(state, { client_request_type::NEW, 1, 0, 1, side_t::INVALID, 100, 10 }), risk_reject_reason::MALFORMED);
+	EXPECT_EQ(gate.check(state, new_order(1, 100, 0)), risk_reject_reason::MALFORMED);
+	EXPECT_EQ(gate.check(state, new_order(1, INVALID_PRICE, 10)), risk_reject_reason::MALFORMED);
+	EXPECT_EQ(gate.check(state, { client_request_type::LOGON, 1, 0, 1, side_t::BUY, 100, 10 }), risk_reject_reason::MALFORMED);
+	EXPECT_EQ(gate.check(state, { client_request_type::NEW, 1, 0, 1, side_t::BUY, INVALID_PRICE, 10, order_type_t::STOP }), risk_reject_reason::MALFORMED);
+	EXPECT_EQ(gate.check(state, { client_request_type::NEW, 1, 0, 1, side_t::BUY, INVALID_PRICE, 10, order_type_t::STOP_LIMIT, time_in_force_t::GTC, 105 }), risk_reject_reason::MALFORMED);
+	EXPECT_EQ(gate.check(state, { client_request_type::NEW, 1, 0, 1, side_t::BUY, 100, 10, order_type_t::LIMIT, time_in_force_t::GTT }), risk_reject_reason::MALFORMED);
+	EXPECT_EQ(gate.check(state, { client_request_type::MASS_CANCEL, 1, MAX_NUM_INSTRUMENTS, INVALID_ORDER_ID, side_t::INVALID }), risk_reject_reason::MALFORMED);
+	EXPECT_EQ(gate.check(state, { client_request_type::MASS_CANCEL, 1, INVALID_INSTRUMENT_ID, INVALID_ORDER_ID, side_t::INVALID }), risk_reject_reason::NONE);
+	EXPECT_EQ(state.open_orders_[0], 0);
+}
+
+TEST(RiskGateTest, AppliesInstrumentLimits) {
+	risk_config config;
+	config.instrument_limits_[0] = { 100, 5000, 10, 1 };
+	reference_price_table reference_prices{};
+	reference_prices[0] = 50;
+	risk_gate gate{ config, reference_prices };
+	client_risk_state state;
+
+	EXPECT_EQ(gate.check(state, new_order(1, 50, 101)), risk_reject_reason::MAX_ORDER_QTY);
+	EXPECT_EQ(gate.check(state, new_order(1, 51, 100)), risk_reject_reason::MAX_NOTIONAL);
+	EXPECT_EQ(gate.check(state, new_order(1, 39, 10)), risk_reject_reason::PRICE_BAND);
+	EXPECT_EQ(gate.check(state, new_order(1, 45, 10)), risk_reject_reason::NONE);
+	EXPECT_EQ(gate.check(state, new_order(2, 45, 10)), risk_reject_reason::MAX_OPEN_ORDERS);
+
+	// The band follows the last trade.
+	gate.on_response(state, { client_response_type::FILLED, 1, 0, 1, 1, side_t::BUY, 58, 10, 0 });
+	EXPECT_EQ(gate.last_trade_price(0), 58);
+	EXPECT_EQ(state.open_orders_[0], 0);
+	EXPECT_EQ(gate.check(state, new_order(2, 45, 10)), risk_reject_reason::PRICE_BAND);
+	EXPECT_EQ(gate.check(state, new_order(2, 60, 10)), risk_reject_reason::NONE);
+}
+
+TEST(RiskGateTest, RejectsPricesWithNoV2Encoding) {
+	reference_price_table reference_prices{};
+	reference_prices[0] = 3'000'000'000;
+	risk_gate gate{ {}, reference_prices };
+	client_risk_state state;
+
+	constexpr price_t max_offset = std::numeric_limits<int32_t>::max() - 1;
+	constexpr price_t min_offset = std::numeric_limits<int32_t>::min();
+	EXPECT_EQ(gate.check(state, new_order(1, 3'000'000'000 + max_offset + 1, 10)), risk_reject_reason::PRICE_RANGE);
+	EXPECT_EQ(gate.check(state, new_order(1, 3'000'000'000 + min_offset - 1, 10)), risk_reject_reason::PRICE_RANGE);
+	EXPECT_EQ(gate.check(state, { client_request_type::NEW, 1, 0, 1, side_t::BUY, INVALID_PRICE, 10, order_type_t::STOP, time_in_force_t::GTC,
+		3'000'000'000 + max_offset + 1 }), risk_reject_reason::PRICE_RANGE);
+	EXPECT_EQ(gate.check(state, { client_request_type::MODIFY, 1, 0, 1, side_t::BUY, 3'000'000'000 + min_offset - 1, 10 }), risk_reject_reason::PRICE_RANGE);
+	EXPECT_EQ(state.open_orders_[0], 0);
+
+	EXPECT_EQ(gate.check(state, new_order(1, 3'000'000'000 + max_offset, 10)), risk_reject_reason::NONE);
+	EXPECT_EQ(gate.check(state, new_order(2, 3'000'000'000 + min_offset, 10)), risk_reject_reason::NONE);
+}
+
+TEST(RiskGateTest, TracksOpenOrdersAcrossModifies) {
+	risk_gate gate;
+	client_risk_state state;
+
+	ASSERT_EQ(gate.check(state, new_order(1, 100, 10)), risk_reject_reason::NONE);
+	EXPECT_EQ(state.open_orders_[0], 1);
+
+	// In-place modify: the MODIFIED response takes back the count of the modify.
+	ASSERT_EQ(gate.check(state, { client_request_type::MODIFY, 1, 0, 1, side_t::BUY, 100, 5 }), risk_reject_reason::NONE);
+	gate.on_response(state, { client_response_type::MODIFIED, 1, 0, 1, 1, side_t::BUY, 100, 0, 5 });
+	EXPECT_EQ(state.open_orders_[0], 1);
+
+	// Cancel/replace: the old order is canceled and the new one stays open.
+	ASSERT_EQ(gate.check(state, { client_request_type::MODIFY, 1, 0, 1, side_t::BUY, 101, 5 }), risk_reject_reason::NONE);
+	gate.on_response(state, { client_response_type::CANCELED, 1, 0, 1, 1, side_t::BUY, 100, INVALID_QUANTITY, 5 });
+	gate.on_response(state, { client_response_type::ACCEPTED, 1, 0, 1, 2, side_t::BUY, 101, 0, 5 });
+	EXPECT_EQ(state.open_orders_[0], 1);
+
+	ASSERT_EQ(gate.check(state, { client_request_type::CANCEL, 1, 0, 1, side_t::BUY, INVALID_PRICE, INVALID_QUANTITY }), risk_reject_reason::NONE);
+	gate.on_response(state, { client_response_type::CANCELED, 1, 0, 1, 2, side_t::BUY, 101, INVALID_QUANTITY, 5 });
+	EXPECT_EQ(state.open_orders_[0], 0);
+}
+
+TEST(RiskGateTest, ChecksBatchesAllOrNothing) {
+	risk_config config;
+	config.instrument_limits_[0].max_order_qty_ = 100;
+	risk_gate gate{ config };
+	client_risk_state state;
+
+	const client_request_internal header{ client_request_type::MASS_QUOTE, 1, INVALID_INSTRUMENT_ID, 9, side_t::INVALID, INVALID_PRICE, 3 };
+	std::array<client_request_internal, 3> entries{ {
+		{ client_request_type::BATCH_ENTRY, 1, 0, 1, side_t::BUY, 100, 10 },
+		{ client_request_type::BATCH_ENTRY, 1, 0, 2, side_t::SELL, 101, 10 },
+		{ client_request_type::BATCH_ENTRY, 1, 0, 3, side_t::SELL, 102, 500 } } };
+
+	// The last entry fails, so the counts of the first two are taken back.
+	EXPECT_EQ(gate.check_batch(state, header, entries.data()), risk_reject_reason::MAX_ORDER_QTY);
+	EXPECT_EQ(state.open_orders_[0], 0);
+
+	// A zero quantity pulls a quote and does not count as an open order.
+	entries[2].qty_ = 0;
+	EXPECT_EQ(gate.check_batch(state, header, entries.data()), risk_reject_reason::NONE);
+	EXPECT_EQ(state.open_orders_[0], 2);
+
+	entries[1].type_ = client_request_type::NEW;
+	EXPECT_EQ(gate.check_batch(state, header, entries.data()), risk_reject_reason::MALFORMED);
+	EXPECT_EQ(state.open_orders_[0], 2);
+
+	const client_request_internal empty{ client_request_type::BATCH_CANCEL, 1, INVALID_INSTRUMENT_ID, 9, side_t::INVALID, INVALID_PRICE, 0 };
+	EXPECT_EQ(gate.check_batch(state, empty, entries.data()), risk_reject_reason::MALFORMED);
+}
@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+
+#include "order_server/session_table.hpp"
+
+using namespace kse::models;
+using namespace kse::server;
+
+
+TEST(SessionTableTest, AssignsIdsUpToCapacity) {
+	session_table sessions{ { .max_sessions_ = 2 } };
+
+	auto* first = sessions.logon(INVALID_CLIENT_ID);
+	auto* second = sessions.logon(INVALID_CLIENT_ID);
+
+	ASSERT_NE(first, nullptr);
+	ASSERT_NE(second, nullptr);
+	EXPECT_EQ(first->client_id_, 0);
+	EXPECT_EQ(second->client_id_, 1);
+	EXPECT_EQ(sessions.get(1), second);
+	EXPECT_EQ(sessions.get(2), nullptr);
+
+	EXPECT_EQ(sessions.logon(INVALID_CLIENT_ID), nullptr);
+	EXPECT_EQ(sessions.size(), 2);
+}
+
+TEST(SessionTableTest, ResumesDisconnectedSessionWithItsSequenceNumbers) {
+	session_table sessions{ { .max_sessions_ = 2 } };
+
+	auto* session = sessions.logon(INVALID_CLIENT_ID);
+	ASSERT_NE(session, nullptr);
+	session->connection_ = reinterpret_cast<tcp_connection_t*>(session);
+	session->next_incoming_seq_num_ = 42;
+	session->next_outgoing_seq_num_ = 17;
+
+	EXPECT_EQ(sessions.logon(session->client_id_), nullptr);
+
+	session->connection_ = nullptr;
+	auto* resumed = sessions.logon(session->client_id_);
+
+	EXPECT_EQ(resumed, session);
+	EXPECT_EQ(resumed->next_incoming_seq_num_, 42);
+	EXPECT_EQ(resumed->next_outgoing_seq_num_, 17);
+}
+
+TEST(SessionTableTest, RejectsUnknownClientId) {
+	session_table sessions{ { .max_sessions_ = 4 } };
+
+	EXPECT_EQ(sessions.logon(3), nullptr);
+	EXPECT_EQ(sessions.logon(1'000'000), nullptr);
+	EXPECT_EQ(sessions.size(), 0);
+}
+
+TEST(SessionTableTest, SizesSessionBuffersFromConfig) {
+	session_table sessions{ { .max_sessions_ = 1, .max_buffered_responses_ = 3, .response_journal_size_ = 2 } };
+
+	auto* session = sessions.logon(INVALID_CLIENT_ID);
+	ASSERT_NE(session, nullptr);
+	EXPECT_EQ(session->outbound_data_.size(), 3 * sizeof(client_response_external));
+
+	reference_price_table reference_prices{};
+	std::vector<size_t> slots;
+	for (uint64_t sequence_number = 1; sequence_number <= 4; ++sequence_number) {
+		client_response_internal response{};
+		session->journal_.record(sequence_number, response);
+		slots.push_back(session->append_to_outbound_buffer(response, sequence_number, reference_prices));
+	}
+
+	EXPECT_EQ(slots, (std::vector<size_t>{ 0, 1, 2, 0 }));
+	EXPECT_EQ(session->journal_.first_sequence_number(), 3);
+}
+
+TEST(SessionTableTest, SwitchesProtocolBetweenResponses) {
+	session_table sessions{ { .max_sessions_ = 1 } };
+
+	auto* session = sessions.logon(INVALID_CLIENT_ID);
+	ASSERT_NE(session, nullptr);
+
+	reference_price_table reference_prices{};
+	client_response_internal before{};
+	session->append_to_outbound_buffer(before, 1, reference_prices);
+	session->switch_protocol(protocol_version::V2, reference_prices);
+	client_response_internal after{};
+	session->append_to_outbound_buffer(after, 2, reference_prices);
+
+	std::vector<outbound_message_t> queued;
+	while (session->write_queue_.size()) {
+		queued.push_back(*session->write_queue_.get_next_read_element());
+		session->write_queue_.next_read_index();
+	}
+
+	ASSERT_EQ(queued.size(), MAX_NUM_INSTRUMENTS + 3);
+	EXPECT_FALSE(is_v2_frame_start(*session->get_response_buffer(queued.front().index_)));
+	for (size_t i = 1; i <= MAX_NUM_INSTRUMENTS; ++i) {
+		EXPECT_EQ(peek_v2_header(session->get_response_buffer(queued[i].index_)).type_, v2_message_type::REFERENCE_PRICE);
+	}
+
+	const auto* ack = session->get_response_buffer(queued[MAX_NUM_INSTRUMENTS + 1].index_);
+	EXPECT_EQ(peek_v2_header(ack).type_, v2_message_type::HELLO_ACK);
+	EXPECT_EQ(v2_hello_ack_codec::decode(ack).version_, protocol_version::V2);
+	EXPECT_EQ(peek_v2_header(session->get_response_buffer(queued.back().index_)).type_, v2_message_type::RESPONSE);
+}
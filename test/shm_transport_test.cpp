@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+
+#include "order_server/shm_transport.hpp"
+
+#include <string>
+
+using namespace kse::models;
+using namespace kse::server;
+
+
+namespace {
+	auto test_segment_name() -> std::string {
+		return "kse_shm_transport_test_" + std::to_string(kse::utils::get_process_id());
+	}
+}
+
+TEST(ShmTransportTest, RingReportsFullAndPreservesOrder) {
+	auto ring = std::make_unique<kse::utils::shm_spsc_ring<uint64_t, 4>>();
+
+	for (uint64_t i = 0; i < 4; ++i) {
+		auto* slot = ring->get_next_write_element();
+		ASSERT_NE(slot, nullptr);
+		*slot = i;
+		ring->next_write_index();
+	}
+	EXPECT_EQ(ring->get_next_write_element(), nullptr);
+	EXPECT_EQ(ring->size(), 4);
+
+	for (uint64_t i = 0; i < 4; ++i) {
+		auto* slot = ring->get_next_read_element();
+		ASSERT_NE(slot, nullptr);
+		EXPECT_EQ(*slot, i);
+		ring->next_read_index();
+	}
+	EXPECT_EQ(ring->get_next_read_element(), nullptr);
+	EXPECT_NE(ring->get_next_write_element(), nullptr);
+}
+
+TEST(ShmTransportTest, ClientAndServerShareChannels) {
+	const auto name = test_segment_name();
+	EXPECT_EQ(shm_client::connect(name), nullptr);
+
+	auto server = shm_order_entry::create(name);
+	ASSERT_NE(server, nullptr);
+
+	auto client = shm_client::connect(name);
+	ASSERT_NE(client, nullptr);
+	auto& channel = server->channel(0);
+	EXPECT_EQ(channel.state_, shm_channel_state::CLAIMED);
+	EXPECT_EQ(channel.owner_pid_, kse::utils::get_process_id());
+	EXPECT_EQ(server->channel(1).state_, shm_channel_state::FREE);
+
+	*client->requests().get_next_write_element() = { 1, { client_request_type::NEW, 3, 1, 7, side_t::SELL, 101, 25 } };
+	client->requests().next_write_index();
+
+	auto* request = channel.requests_.get_next_read_element();
+	ASSERT_NE(request, nullptr);
+	EXPECT_EQ(request->sequence_number_, 1);
+	EXPECT_EQ(request->request_.order_id_, 7);
+	EXPECT_EQ(request->request_.price_, 101);
+	channel.requests_.next_read_index();
+
+	*channel.responses_.get_next_write_element() = { 1, { client_response_type::ACCEPTED, 3, 1, 7, 1, side_t::SELL, 101, 0, 25 } };
+	channel.responses_.next_write_index();
+	auto* response = client->responses().get_next_read_element();
+	ASSERT_NE(response, nullptr);
+	EXPECT_EQ(response->response_.type_, client_response_type::ACCEPTED);
+	EXPECT_EQ(response->response_.leaves_qty_, 25);
+
+	client.reset();
+	EXPECT_EQ(channel.state_, shm_channel_state::DETACHING);
+
+	server->release(channel);
+	EXPECT_EQ(channel.state_, shm_channel_state::FREE);
+	EXPECT_EQ(channel.responses_.size(), 0);
+}
@@ -0,0 +1,54 @@
+#include <gtest/gtest.h>
+
+#include "order_server/throttle.hpp"
+
+using namespace kse::server;
+using kse::utils::NANOS_PER_SECS;
+using kse::utils::NANOS_PER_MILLIS;
+
+
+TEST(ThrottleTest, UnlimitedByDefault) {
+	token_bucket bucket;
+
+	for (int i = 0; i < 10000; ++i) {
+		ASSERT_TRUE(bucket.try_consume(0));
+	}
+}
+
+TEST(ThrottleTest, AllowsBurstThenRefillsAtRate) {
+	token_bucket bucket{ { 100, 5, throttle_policy::REJECT } };
+	const auto start = NANOS_PER_SECS;
+
+	for (int i = 0; i < 5; ++i) {
+		EXPECT_TRUE(bucket.try_consume(start));
+	}
+	EXPECT_FALSE(bucket.try_consume(start));
+
+	// One token every 10ms at 100 messages per second.
+	EXPECT_FALSE(bucket.has_token(start + 9 * NANOS_PER_MILLIS));
+	EXPECT_TRUE(bucket.try_consume(start + 10 * NANOS_PER_MILLIS));
+	EXPECT_FALSE(bucket.try_consume(start + 15 * NANOS_PER_MILLIS));
+	EXPECT_TRUE(bucket.try_consume(start + 20 * NANOS_PER_MILLIS));
+
+	// Long idle periods only refill up to the burst.
+	const auto later = start + 3600 * NANOS_PER_SECS;
+	for (int i = 0; i < 5; ++i) {
+		EXPECT_TRUE(bucket.try_consume(later));
+	}
+	EXPECT_FALSE(bucket.try_consume(later));
+}
+
+TEST(ThrottleTest, CountsAdmittedRejectedAndDeferred) {
+	session_throttle throttle;
+	throttle.bucket_.configure({ 1, 1, throttle_policy::REJECT });
+
+	EXPECT_EQ(throttle.admit(0, throttle_policy::REJECT), throttle_action::ADMIT);
+	EXPECT_EQ(throttle.admit(1, throttle_policy::REJECT), throttle_action::REJECT);
+	EXPECT_EQ(throttle.admit(2, throttle_policy::QUEUE), throttle_action::DEFER);
+	EXPECT_EQ(throttle.admit(NANOS_PER_SECS, throttle_policy::QUEUE), throttle_action::ADMIT);
+
+	const auto stats = throttle.stats();
+	EXPECT_EQ(stats.admitted_, 2);
+	EXPECT_EQ(stats.rejected_, 1);
+	EXPECT_EQ(stats.deferred_, 1);
+}
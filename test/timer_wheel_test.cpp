@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+
+#include <array>
+#include <vector>
+
+#include "utils/timer_wheel.hpp"
+
+using namespace kse::utils;
+
+
+namespace {
+	struct test_timer {
+		int id_ = 0;
+		test_timer* prev_timer_ = nullptr;
+		test_timer* next_timer_ = nullptr;
+		uint64_t timer_tick_ = 0;
+		uint32_t timer_slot_ = INVALID_TIMER_SLOT;
+	};
+
+	// Four slots per level and two levels: ticks 4 and up cascade, 16 and up start in the overflow list.
+	using small_wheel = timer_wheel<test_timer, 2, 2>;
+
+	auto poll_ids(small_wheel& wheel, uint64_t now_tick, size_t max_timers = 1000) -> std::vector<int> {
+		std::vector<int> ids;
+		wheel.poll(now_tick, max_timers, [&ids](test_timer* timer) { ids.push_back(timer->id_); });
+		return ids;
+	}
+}
+
+TEST(TimerWheelTest, FiresOnTheirTickAcrossLevels) {
+	small_wheel wheel{ 0 };
+	std::array<test_timer, 5> timers{ { { 1 }, { 2 }, { 3 }, { 4 }, { 5 } } };
+	wheel.schedule(&timers[0], 3);
+	wheel.schedule(&timers[1], 9);
+	wheel.schedule(&timers[2], 40);
+	wheel.schedule(&timers[3], 2);
+	wheel.schedule(&timers[4], 9);
+	EXPECT_EQ(wheel.size(), 5);
+
+	EXPECT_TRUE(poll_ids(wheel, 1).empty());
+	EXPECT_EQ(poll_ids(wheel, 3), (std::vector<int>{ 4, 1 }));
+	EXPECT_TRUE(poll_ids(wheel, 8).empty());
+	EXPECT_EQ(poll_ids(wheel, 9), (std::vector<int>{ 2, 5 }));
+	EXPECT_TRUE(poll_ids(wheel, 39).empty());
+	EXPECT_EQ(poll_ids(wheel, 100), (std::vector<int>{ 3 }));
+	EXPECT_EQ(wheel.size(), 0);
+}
+
+TEST(TimerWheelTest, CancelUnlinksInConstantTime) {
+	small_wheel wheel{ 0 };
+	std::array<test_timer, 3> timers{ { { 1 }, { 2 }, { 3 } } };
+	for (auto& timer : timers) {
+		wheel.schedule(&timer, 6);
+	}
+
+	wheel.cancel(&timers[1]);
+	EXPECT_EQ(timers[1].timer_slot_, INVALID_TIMER_SLOT);
+	wheel.cancel(&timers[1]);
+	EXPECT_EQ(wheel.size(), 2);
+
+	EXPECT_EQ(poll_ids(wheel, 10), (std::vector<int>{ 1, 3 }));
+}
+
+TEST(TimerWheelTest, PastTicksFireOnTheNextPoll) {
+	small_wheel wheel{ 100 };
+	test_timer timer{ 1 };
+	wheel.schedule(&timer, 50);
+	EXPECT_EQ(poll_ids(wheel, 100), (std::vector<int>{ 1 }));
+}
+
+TEST(TimerWheelTest, BoundsTheTimersFiredPerPoll) {
+	small_wheel wheel{ 0 };
+	std::vector<test_timer> timers(10);
+	for (int i = 0; i < 10; ++i) {
+		timers[i].id_ = i;
+		wheel.schedule(&timers[i], i < 8 ? 5 : 6);
+	}
+
+	EXPECT_EQ(poll_ids(wheel, 6, 3), (std::vector<int>{ 0, 1, 2 }));
+	EXPECT_EQ(wheel.current_tick(), 5);
+	EXPECT_EQ(poll_ids(wheel, 6, 3), (std::vector<int>{ 3, 4, 5 }));
+
+	// A timer canceled while due does not fire.
+	wheel.cancel(&timers[6]);
+	EXPECT_EQ(poll_ids(wheel, 6, 3), (std::vector<int>{ 7, 8, 9 }));
+	EXPECT_EQ(wheel.size(), 0);
+}
+
+TEST(TimerWheelTest, SkipsAheadWhenEmpty) {
+	small_wheel wheel{ 0 };
+	EXPECT_TRUE(poll_ids(wheel, 1'000'000).empty());
+	EXPECT_EQ(wheel.current_tick(), 1'000'000);
+
+	test_timer timer{ 1 };
+	wheel.schedule(&timer, 1'000'001);
+	EXPECT_EQ(poll_ids(wheel, 1'000'001), (std::vector<int>{ 1 }));
+}
+
+TEST(TimerWheelTest, JumpsOverIdleTicksWithTimersPending) {
+	small_wheel wheel{ 0 };
+	std::array<test_timer, 4> timers{ { { 1 }, { 2 }, { 3 }, { 4 } } };
+	wheel.schedule(&timers[0], 2);
+	wheel.schedule(&timers[1], 13);
+	wheel.schedule(&timers[2], 70);
+	wheel.schedule(&timers[3], 1'000'000);
+
+	EXPECT_TRUE(poll_ids(wheel, 1).empty());
+	EXPECT_EQ(poll_ids(wheel, 12), (std::vector<int>{ 1 }));
+	EXPECT_EQ(wheel.current_tick(), 12);
+	EXPECT_EQ(poll_ids(wheel, 69), (std::vector<int>{ 2 }));
+	EXPECT_EQ(wheel.current_tick(), 69);
+	EXPECT_EQ(poll_ids(wheel, 999'999), (std::vector<int>{ 3 }));
+	EXPECT_EQ(wheel.current_tick(), 999'999);
+	EXPECT_EQ(poll_ids(wheel, 2'000'000), (std::vector<int>{ 4 }));
+	EXPECT_EQ(wheel.size(), 0);
+
+	// A day of 1 ms ticks with one timer at its end is caught up in one poll.
+	timer_wheel<test_timer> day_wheel{ 0 };
+	test_timer close{ 5 };
+	day_wheel.schedule(&close, 86'400'000);
+	std::vector<int> ids;
+	day_wheel.poll(86'399'999, 1000, [&ids](test_timer* timer) { ids.push_back(timer->id_); });
+	EXPECT_TRUE(ids.empty());
+	day_wheel.poll(86'400'000, 1000, [&ids](test_timer* timer) { ids.push_back(timer->id_); });
+	EXPECT_EQ(ids, (std::vector<int>{ 5 }));
+}
@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bench/workload.hpp"
+
+using namespace kse::bench;
+using namespace kse::models;
+
+
+TEST(WorkloadTest, ParsesTheRequestLinesOfAnOldLog) {
+	std::istringstream log{
+		"K:\\dev-projects\\kse\\src\\engine\\matching_engine.hpp:66 run() 02:00:36.330093100\n"
+		"K:\\dev-projects\\kse\\src\\engine\\matching_engine.hpp:71 run() 02:01:00.928197500 Processing client_request_internal [type:NEW client:0 instrument:6 oid:1 side:SELL qty:28 price:198]\n"
+		"02:01:00.928243500 RDTSC Exchange_MEOrderBook_checkForMatch 10772\n"
+		"K:\\dev-projects\\kse\\src\\engine\\matching_engine.hpp:71 run() 02:01:09.921895500 Processing client_request_internal [type:CANCEL client:1 instrument:3 oid:2 side:INVALID qty:INVALID price:INVALID]\n"
+		"K:\\dev-projects\\kse\\src\\engine\\matching_engine.hpp:71 run() 02:01:10.921895500 Processing client_request_internal [type:BOGUS client:1]\n" };
+
+	size_t skipped = 0;
+	const auto requests = read_request_log(log, &skipped);
+	ASSERT_EQ(requests.size(), 2);
+	EXPECT_EQ(skipped, 1);
+
+	EXPECT_EQ(requests[0].type_, client_request_type::NEW);
+	EXPECT_EQ(requests[0].client_id_, 0);
+	EXPECT_EQ(requests[0].instrument_id_, 6);
+	EXPECT_EQ(requests[0].order_id_, 1);
+	EXPECT_EQ(requests[0].side_, side_t::SELL);
+	EXPECT_EQ(requests[0].qty_, 28);
+	EXPECT_EQ(requests[0].price_, 198);
+	EXPECT_EQ(requests[0].time_in_force_, time_in_force_t::GTC);
+
+	EXPECT_EQ(requests[1].type_, client_request_type::CANCEL);
+	EXPECT_EQ(requests[1].side_, side_t::INVALID);
+	EXPECT_EQ(requests[1].qty_, INVALID_QUANTITY);
+	EXPECT_EQ(requests[1].price_, INVALID_PRICE);
+}
+
+TEST(WorkloadTest, ParsesEveryFieldTheEngineLogs) {
+	client_request_internal request;
+	request.type_ = client_request_type::NEW;
+	request.client_id_ = 4;
+	request.instrument_id_ = 2;
+	request.order_id_ = 77;
+	request.side_ = side_t::BUY;
+	request.price_ = -5;
+	request.qty_ = 300;
+	request.order_type_ = order_type_t::STOP_LIMIT;
+	request.time_in_force_ = time_in_force_t::GTT;
+	request.stop_price_ = 12;
+	request.display_qty_ = 50;
+	request.stp_mode_ = stp_mode_t::CANCEL_BOTH;
+	request.expire_time_ = 1735693260928170700;
+
+	client_request_internal parsed;
+	ASSERT_TRUE(parse_request_line("run() 02:01:00.928197500 Processing " + request.to_string(), parsed));
+	EXPECT_EQ(std::memcmp(&parsed, &request, sizeof(request)), 0);
+}
+
+TEST(WorkloadTest, WorkloadFileRoundTripsAndRejectsCorruption) {
+	const auto path = (std::filesystem::temp_directory_path() / "kse_workload_test.wkld").string();
+
+	std::vector<client_request_internal> requests(3);
+	for (size_t i = 0; i < requests.size(); ++i) {
+		requests[i].type_ = client_request_type::NEW;
+		requests[i].order_id_ = i + 1;
+		requests[i].qty_ = 10;
+	}
+	ASSERT_TRUE(write_workload(path, requests));
+
+	const auto read = read_workload(path);
+	ASSERT_EQ(read.size(), requests.size());
+	EXPECT_EQ(std::memcmp(read.data(), requests.data(), requests.size() * sizeof(client_request_internal)), 0);
+
+	{
+		std::fstream file{ path, std::ios::in | std::ios::out | std::ios::binary };
+		file.seekp(-1, std::ios::end);
+		file.put('\x55');
+	}
+	EXPECT_TRUE(read_workload(path).empty());
+	EXPECT_TRUE(read_workload(path + ".missing").empty());
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace kse::utils {
+	template<size_t N> struct unsigned_of_size;
+	template<> struct unsigned_of_size<1> { using type = uint8_t; };
+	template<> struct unsigned_of_size<2> { using type = uint16_t; };
+	template<> struct unsigned_of_size<4> { using type = uint32_t; };
+	template<> struct unsigned_of_size<8> { using type = uint64_t; };
+
+	/// Reverses the byte order of an unsigned integer. Written with shifts so it stays constexpr; compilers lower it to a single bswap.
+	template<typename U>
+	constexpr auto byte_swap(U value) noexcept -> U {
+		static_assert(std::is_unsigned_v<U>, "byte_swap expects an unsigned integer");
+		if constexpr (sizeof(U) == 1) {
+			return value;
+		}
+		else {
+			U result = 0;
+			for (size_t i = 0; i < sizeof(U); ++i) {
+				result = static_cast<U>((result << 8) | ((value >> (i * 8)) & 0xFF));
+			}
+			return result;
+		}
+	}
+
+	/// Converts a trivially copyable scalar (integer or enum) between host order and the given wire order.
+	/// The choice is made at compile time against std::endian::native, so there is no runtime branch.
+	template<std::endian Order, typename T>
+	constexpr auto convert_endian(T value) noexcept -> T {
+		static_assert(std::is_trivially_copyable_v<T>, "only trivially copyable scalars can be put on the wire");
+		if constexpr (sizeof(T) == 1 || Order == std::endian::native) {
+			return value;
+		}
+		else {
+			using raw_t = typename unsigned_of_size<sizeof(T)>::type;
+			return std::bit_cast<T>(byte_swap(std::bit_cast<raw_t>(value)));
+		}
+	}
+
+	/**
+	 * Describes one wire field of a message as a chain of member pointers, e.g.
+	 * field<&client_request_external::request_, &client_request_internal::qty_>.
+	 * Values are read and written by copy so packed structs never bind references to unaligned members.
+	 */
+	template<auto... Members>
+	struct field {
+		static_assert(sizeof...(Members) > 0, "field needs at least one member pointer");
+
+		template<typename T>
+		static constexpr auto get(const T& message) noexcept {
+			return (message .* ... .* Members);
+		}
+
+		template<typename T, typename V>
+		static constexpr auto set(T& message, V value) noexcept -> void {
+			(message .* ... .* Members) = value;
+		}
+
+		template<typename T>
+		using value_type = std::remove_cvref_t<decltype(get(std::declval<const T&>()))>;
+	};
+
+	/**
+	 * Generates encode/decode for a message from its ordered field list.
+	 * Field offsets and the total wire size are computed at compile time and every field is
+	 * copied with a fixed-size memcpy, so the codec unrolls completely.
+	 *
+	 * @tparam T The message type.
+	 * @tparam Order Byte order of integers on the wire.
+	 * @tparam Fields The field descriptors, in wire order.
+	 */
+	template<typename T, std::endian Order, typename... Fields>
+	class message_codec {
+	public:
+		using message_type = T;
+
+		static constexpr size_t num_fields = sizeof...(Fields);
+		static constexpr size_t size = (sizeof(typename Fields::template value_type<T>) + ... + 0);
+
+		static auto encode(const T& message, char* buffer) noexcept -> void {
+			encode_fields(message, buffer, std::make_index_sequence<num_fields>{});
+		}
+
+		static auto decode(const char* buffer) noexcept -> T {
+			T message{};
+			decode_fields(message, buffer, std::make_index_sequence<num_fields>{});
+			return message;
+		}
+
+	private:
+		static constexpr std::array<size_t, num_fields> offsets_ = [] {
+			std::array<size_t, num_fields> offsets{};
+			constexpr std::array<size_t, num_fields> sizes{ sizeof(typename Fields::template value_type<T>)... };
+			size_t offset = 0;
+			for (size_t i = 0; i < num_fields; ++i) {
+				offsets[i] = offset;
+				offset += sizes[i];
+			}
+			return offsets;
+		}();
+
+		template<size_t I>
+		using field_at = std::tuple_element_t<I, std::tuple<Fields...>>;
+
+		template<size_t... I>
+		static auto encode_fields(const T& message, char* buffer, std::index_sequence<I...>) noexcept -> void {
+			(encode_field<field_at<I>>(message, buffer + offsets_[I]), ...);
+		}
+
+		template<size_t... I>
+		static auto decode_fields(T& message, const char* buffer, std::index_sequence<I...>) noexcept -> void {
+			(decode_field<field_at<I>>(message, buffer + offsets_[I]), ...);
+		}
+
+		template<typename F>
+		static auto encode_field(const T& message, char* buffer) noexcept -> void {
+			const auto value = convert_endian<Order>(F::get(message));
+			std::memcpy(buffer, &value, sizeof(value));
+		}
+
+		template<typename F>
+		static auto decode_field(T& message, const char* buffer) noexcept -> void {
+			typename F::template value_type<T> value;
+			std::memcpy(&value, buffer, sizeof(value));
+			F::set(message, convert_endian<Order>(value));
+		}
+	};
+}
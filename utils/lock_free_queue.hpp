@@ -44,6 +44,10 @@ namespace kse::utils {
 		auto size() const noexcept {
 			return num_elements_.load();
 		}
+
+		auto capacity() const noexcept {
+			return data_.size();
+		}
 	private:
 		std::vector<T> data_;
 		size_t next_write_index_ = 0;
@@ -77,6 +77,11 @@ namespace kse::utils {
 
 		logger& operator=(const logger&&) = delete;
 
+		/// Entries logged but not written to the file yet.
+		auto pending() const noexcept {
+			return log_queue_.size();
+		}
+
 		void flush_queue() noexcept {
 			while (running_) {
 				for (auto next = log_queue_.get_next_read_element(); log_queue_.size() && next; next = log_queue_.get_next_read_element()) {
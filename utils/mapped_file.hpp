@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#error "Unsupported platform"
+#endif
+
+namespace kse::utils {
+	/**
+	 * A file mapped into this process. Writes land in the page cache as soon as they are made, so they survive the
+	 * process; sync() forces a range to the disk.
+	 */
+	class mapped_file {
+	public:
+		/// Creates a zero-filled file of the given size with its blocks allocated up front, replacing any file with the same path. Returns nullptr on failure.
+		static auto create(std::string_view path, size_t size) -> std::unique_ptr<mapped_file> {
+			return map(path, size, true, true);
+		}
+
+		/// Maps an existing file whole. Returns nullptr if it does not exist or is empty.
+		static auto open(std::string_view path, bool writable) -> std::unique_ptr<mapped_file> {
+			return map(path, 0, false, writable);
+		}
+
+		mapped_file(const mapped_file&) = delete;
+		mapped_file& operator=(const mapped_file&) = delete;
+
+		~mapped_file() noexcept {
+#ifdef _WIN32
+			UnmapViewOfFile(data_);
+			CloseHandle(mapping_);
+			CloseHandle(file_);
+#else
+			munmap(data_, size_);
+#endif
+		}
+
+		auto data() const noexcept -> char* { return static_cast<char*>(data_); }
+		auto size() const noexcept -> size_t { return size_; }
+
+		/// Writes the pages covering [offset, offset + length) to the disk and waits for them. Returns false on failure.
+		auto sync(size_t offset, size_t length) const noexcept -> bool {
+			if (!length) {
+				return true;
+			}
+			const auto page_offset = offset & ~(page_size() - 1);
+#ifdef _WIN32
+			return FlushViewOfFile(data() + page_offset, offset + length - page_offset) && FlushFileBuffers(file_);
+#else
+			return msync(data() + page_offset, offset + length - page_offset, MS_SYNC) == 0;
+#endif
+		}
+
+	private:
+		mapped_file(void* data, size_t size) noexcept : data_{ data }, size_{ size } {
+		}
+
+		static auto page_size() noexcept -> size_t {
+#ifdef _WIN32
+			SYSTEM_INFO info;
+			GetSystemInfo(&info);
+			return static_cast<size_t>(info.dwAllocationGranularity);
+#else
+			return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+		}
+
+		static auto map(std::string_view path, size_t size, bool create, bool writable) -> std::unique_ptr<mapped_file> {
+			const std::string file_path{ path };
+#ifdef _WIN32
+			HANDLE file = CreateFileA(file_path.c_str(), GENERIC_READ | (writable ? GENERIC_WRITE : 0), FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+				create ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (file == INVALID_HANDLE_VALUE) {
+				return nullptr;
+			}
+
+			if (!create) {
+				LARGE_INTEGER file_size{};
+				GetFileSizeEx(file, &file_size);
+				size = static_cast<size_t>(file_size.QuadPart);
+			}
+			if (!size) {
+				CloseHandle(file);
+				return nullptr;
+			}
+
+			HANDLE mapping = CreateFileMappingA(file, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY,
+				static_cast<DWORD>(static_cast<uint64_t>(size) >> 32), static_cast<DWORD>(size), nullptr);
+			void* data = mapping ? MapViewOfFile(mapping, writable ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, size) : nullptr;
+			if (!data) {
+				if (mapping) {
+					CloseHandle(mapping);
+				}
+				CloseHandle(file);
+				return nullptr;
+			}
+
+			auto mapped = std::unique_ptr<mapped_file>(new mapped_file(data, size));
+			mapped->file_ = file;
+			mapped->mapping_ = mapping;
+			return mapped;
+#else
+			const int fd = ::open(file_path.c_str(), create ? (O_CREAT | O_TRUNC | O_RDWR) : (writable ? O_RDWR : O_RDONLY), 0644);
+			if (fd < 0) {
+				return nullptr;
+			}
+
+			if (create) {
+				// Allocating the blocks now keeps the first write to every page from paying for it.
+				if (posix_fallocate(fd, 0, static_cast<off_t>(size)) != 0) {
+					close(fd);
+					return nullptr;
+				}
+			}
+			else {
+				struct stat status{};
+				if (fstat(fd, &status) != 0) {
+					close(fd);
+					return nullptr;
+				}
+				size = static_cast<size_t>(status.st_size);
+			}
+			if (!size) {
+				close(fd);
+				return nullptr;
+			}
+
+			void* data = mmap(nullptr, size, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+			close(fd);
+			if (data == MAP_FAILED) {
+				return nullptr;
+			}
+
+			return std::unique_ptr<mapped_file>(new mapped_file(data, size));
+#endif
+		}
+
+		void* data_ = nullptr;
+		size_t size_ = 0;
+#ifdef _WIN32
+		HANDLE file_ = INVALID_HANDLE_VALUE;
+		HANDLE mapping_ = nullptr;
+#endif
+	};
+}
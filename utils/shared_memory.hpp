@@ -0,0 +1,200 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#else
+#error "Unsupported platform"
+#endif
+
+namespace kse::utils {
+	/**
+	 * A named shared memory segment mapped into this process.
+	 * The process that creates a segment owns its name and removes it when the segment is destroyed;
+	 * processes that open it only unmap their view.
+	 */
+	class shared_memory_segment {
+	public:
+		/// Creates a zero-filled segment, replacing a stale one left with the same name. Returns nullptr on failure.
+		static auto create(std::string_view name, size_t size) -> std::unique_ptr<shared_memory_segment> {
+			return map(name, size, true);
+		}
+
+		/// Opens an existing segment of at least the given size. Returns nullptr if it does not exist.
+		static auto open(std::string_view name, size_t size) -> std::unique_ptr<shared_memory_segment> {
+			return map(name, size, false);
+		}
+
+		shared_memory_segment(const shared_memory_segment&) = delete;
+		shared_memory_segment& operator=(const shared_memory_segment&) = delete;
+
+		~shared_memory_segment() noexcept {
+#ifdef _WIN32
+			UnmapViewOfFile(data_);
+			CloseHandle(handle_);
+#else
+			munmap(data_, size_);
+			if (owner_) {
+				shm_unlink(name_.c_str());
+			}
+#endif
+		}
+
+		auto data() const noexcept -> void* { return data_; }
+		auto size() const noexcept -> size_t { return size_; }
+
+	private:
+		shared_memory_segment(std::string name, void* data, size_t size, bool owner) noexcept
+			: name_{ std::move(name) }, data_{ data }, size_{ size }, owner_{ owner } {
+		}
+
+		static auto map(std::string_view name, size_t size, bool create) -> std::unique_ptr<shared_memory_segment> {
+#ifdef _WIN32
+			const std::string path{ name };
+			HANDLE handle = create ?
+				CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, static_cast<DWORD>(static_cast<uint64_t>(size) >> 32), static_cast<DWORD>(size), path.c_str()) :
+				OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, path.c_str());
+			if (!handle) {
+				return nullptr;
+			}
+
+			void* data = MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+			if (!data) {
+				CloseHandle(handle);
+				return nullptr;
+			}
+
+			auto segment = std::unique_ptr<shared_memory_segment>(new shared_memory_segment(path, data, size, create));
+			segment->handle_ = handle;
+			return segment;
+#else
+			// POSIX names are a single path component starting with a slash.
+			const auto path = name.starts_with('/') ? std::string{ name } : "/" + std::string{ name };
+
+			if (create) {
+				shm_unlink(path.c_str());
+			}
+
+			const int fd = shm_open(path.c_str(), create ? (O_CREAT | O_EXCL | O_RDWR) : O_RDWR, 0600);
+			if (fd < 0) {
+				return nullptr;
+			}
+
+			struct stat status{};
+			if ((create && ftruncate(fd, static_cast<off_t>(size)) != 0) || fstat(fd, &status) != 0 || static_cast<size_t>(status.st_size) < size) {
+				close(fd);
+				if (create) {
+					shm_unlink(path.c_str());
+				}
+				return nullptr;
+			}
+
+			void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			close(fd);
+			if (data == MAP_FAILED) {
+				if (create) {
+					shm_unlink(path.c_str());
+				}
+				return nullptr;
+			}
+
+			return std::unique_ptr<shared_memory_segment>(new shared_memory_segment(path, data, size, create));
+#endif
+		}
+
+		std::string name_;
+		void* data_ = nullptr;
+		size_t size_ = 0;
+		bool owner_ = false;
+#ifdef _WIN32
+		HANDLE handle_ = nullptr;
+#endif
+	};
+
+	/**
+	 * Single producer single consumer ring that lives entirely inside its own storage, so a producer and a consumer
+	 * in different processes can share it through a mapped segment. The indices grow monotonically and sit on their
+	 * own cache lines; unlike lock_free_queue, writers get nullptr when the ring is full instead of overwriting.
+	 *
+	 * @tparam T A trivially copyable element type, identical in both processes.
+	 * @tparam N The number of slots, a power of two.
+	 */
+	template<typename T, size_t N>
+	struct shm_spsc_ring {
+		static_assert(std::is_trivially_copyable_v<T>, "shared memory elements must be trivially copyable");
+		static_assert(N && (N & (N - 1)) == 0, "ring size must be a power of two");
+		static_assert(std::atomic<uint64_t>::is_always_lock_free, "ring indices must be lock free to be shared between processes");
+
+		alignas(64) std::atomic<uint64_t> write_index_ = 0;
+		alignas(64) std::atomic<uint64_t> read_index_ = 0;
+		alignas(64) std::array<T, N> slots_;
+
+		auto get_next_write_element() noexcept -> T* {
+			const auto write_index = write_index_.load(std::memory_order_relaxed);
+			return write_index - read_index_.load(std::memory_order_acquire) < N ? &slots_[write_index & (N - 1)] : nullptr;
+		}
+
+		auto next_write_index() noexcept -> void {
+			write_index_.store(write_index_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		}
+
+		auto get_next_read_element() noexcept -> T* {
+			const auto read_index = read_index_.load(std::memory_order_relaxed);
+			return read_index != write_index_.load(std::memory_order_acquire) ? &slots_[read_index & (N - 1)] : nullptr;
+		}
+
+		auto next_read_index() noexcept -> void {
+			read_index_.store(read_index_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		}
+
+		auto size() const noexcept -> size_t {
+			return static_cast<size_t>(write_index_.load(std::memory_order_acquire) - read_index_.load(std::memory_order_acquire));
+		}
+
+		static constexpr auto capacity() noexcept -> size_t { return N; }
+
+		/// Empties the ring. Only valid while neither side is using it.
+		auto reset() noexcept -> void {
+			read_index_.store(0, std::memory_order_relaxed);
+			write_index_.store(0, std::memory_order_release);
+		}
+	};
+
+	inline auto get_process_id() noexcept -> int64_t {
+#ifdef _WIN32
+		return static_cast<int64_t>(GetCurrentProcessId());
+#else
+		return static_cast<int64_t>(getpid());
+#endif
+	}
+
+	inline auto is_process_alive(int64_t pid) noexcept -> bool {
+#ifdef _WIN32
+		HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, static_cast<DWORD>(pid));
+		if (!process) {
+			return false;
+		}
+		DWORD exit_code = 0;
+		const auto alive = GetExitCodeProcess(process, &exit_code) && exit_code == STILL_ACTIVE;
+		CloseHandle(process);
+		return alive;
+#else
+		return kill(static_cast<pid_t>(pid), 0) == 0 || errno == EPERM;
+#endif
+	}
+}
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace kse::utils {
+	constexpr uint32_t INVALID_TIMER_SLOT = std::numeric_limits<uint32_t>::max();
+
+	/**
+	 * Hierarchical timer wheel over intrusive timers. T provides prev_timer_ and next_timer_ (T*), timer_tick_ (uint64_t)
+	 * and timer_slot_ (uint32_t, INVALID_TIMER_SLOT while not scheduled), the same way orders carry their price level links.
+	 *
+	 * Level L has 2^SLOT_BITS slots, each covering 2^(SLOT_BITS * L) ticks. A timer sits at the lowest level whose higher
+	 * digits match the current tick and is moved one level down each time its slot comes up, so scheduling and canceling
+	 * are O(1) and a timer is moved at most LEVELS - 1 times. Timers beyond the top level wait in an overflow list that is
+	 * revisited every time the top level wraps.
+	 *
+	 * @tparam T The timer type.
+	 * @tparam SLOT_BITS log2 of the slots per level.
+	 * @tparam LEVELS The number of levels.
+	 */
+	template<typename T, size_t SLOT_BITS = 8, size_t LEVELS = 4>
+	class timer_wheel {
+		static_assert(SLOT_BITS * LEVELS < 64, "the wheel must cover less than the tick range");
+
+	public:
+		static constexpr size_t SLOTS_PER_LEVEL = size_t{ 1 } << SLOT_BITS;
+
+		explicit timer_wheel(uint64_t now_tick) noexcept : current_tick_{ now_tick } {
+		}
+
+		timer_wheel(const timer_wheel&) = delete;
+		timer_wheel& operator=(const timer_wheel&) = delete;
+
+		/// Schedules a timer to fire at the given tick; a tick that has passed fires on the next poll.
+		auto schedule(T* timer, uint64_t tick) noexcept -> void {
+			timer->timer_tick_ = tick;
+			link(timer, slot_of(tick));
+			++size_;
+		}
+
+		auto cancel(T* timer) noexcept -> void {
+			if (timer->timer_slot_ == INVALID_TIMER_SLOT) {
+				return;
+			}
+			unlink(timer);
+			--size_;
+		}
+
+		/**
+		 * Advances the wheel up to now_tick and fires at most max_timers due timers, each unlinked before on_expire is called.
+		 * The wheel stays on the first tick it could not drain, so a wave of timers due together is spread over several polls.
+		 * Ticks with no timer are jumped over, so catching up after a long gap costs one step per occupied slot, not per tick.
+		 * Returns the number fired.
+		 */
+		template<typename F>
+		auto poll(uint64_t now_tick, size_t max_timers, F&& on_expire) noexcept -> size_t {
+			size_t fired = 0;
+			while (fired < max_timers) {
+				auto* timer = heads_[EXPIRED_SLOT] ? heads_[EXPIRED_SLOT] : heads_[digit(current_tick_, 0)];
+				if (timer) {
+					unlink(timer);
+					--size_;
+					on_expire(timer);
+					++fired;
+					continue;
+				}
+
+				if (current_tick_ >= now_tick) {
+					break;
+				}
+				if (!size_) {
+					current_tick_ = now_tick;
+					break;
+				}
+				skip_idle(now_tick);
+				if (current_tick_ < now_tick) {
+					step();
+				}
+			}
+			return fired;
+		}
+
+		auto size() const noexcept -> size_t { return size_; }
+		auto current_tick() const noexcept -> uint64_t { return current_tick_; }
+
+	private:
+		static constexpr uint32_t OVERFLOW_SLOT = static_cast<uint32_t>(SLOTS_PER_LEVEL * LEVELS);
+		static constexpr uint32_t EXPIRED_SLOT = OVERFLOW_SLOT + 1;
+		static constexpr uint64_t WHEEL_MASK = (uint64_t{ 1 } << (SLOT_BITS * LEVELS)) - 1;
+
+		static auto digit(uint64_t tick, size_t level) noexcept -> uint32_t {
+			return static_cast<uint32_t>((tick >> (SLOT_BITS * level)) & (SLOTS_PER_LEVEL - 1));
+		}
+
+		auto slot_of(uint64_t tick) const noexcept -> uint32_t {
+			if (tick <= current_tick_) {
+				return EXPIRED_SLOT;
+			}
+			for (size_t level = 0; level < LEVELS; ++level) {
+				if ((tick >> (SLOT_BITS * (level + 1))) == (current_tick_ >> (SLOT_BITS * (level + 1)))) {
+					return static_cast<uint32_t>(level * SLOTS_PER_LEVEL) + digit(tick, level);
+				}
+			}
+			return OVERFLOW_SLOT;
+		}
+
+		/**
+		 * Moves up to now_tick, but no further than the tick before the next occupied slot of the lowest level that has one,
+		 * or before the top level wraps when only the overflow list is left. The current level 0 slot must be empty.
+		 * Higher level slots only start on lower level wraps, so no slot that step() would bring down is passed.
+		 */
+		auto skip_idle(uint64_t now_tick) noexcept -> void {
+			auto target = current_tick_;
+			for (size_t level = 0; level < LEVELS; ++level) {
+				const auto shift = SLOT_BITS * level;
+				for (auto slot = digit(current_tick_, level) + 1; slot < SLOTS_PER_LEVEL; ++slot) {
+					if (heads_[level * SLOTS_PER_LEVEL + slot]) {
+						target = ((((current_tick_ >> (shift + SLOT_BITS)) << SLOT_BITS) | slot) << shift) - 1;
+						current_tick_ = std::min(target, now_tick);
+						return;
+					}
+				}
+				target = current_tick_ | ((uint64_t{ 1 } << (shift + SLOT_BITS)) - 1);
+			}
+			current_tick_ = std::min(target, now_tick);
+		}
+
+		/// Moves to the next tick, first bringing down the higher level slots that start on it, top level first.
+		auto step() noexcept -> void {
+			++current_tick_;
+			if ((current_tick_ & WHEEL_MASK) == 0) [[unlikely]] {
+				relink(OVERFLOW_SLOT);
+			}
+			for (size_t level = LEVELS - 1; level > 0; --level) {
+				if ((current_tick_ & ((uint64_t{ 1 } << (SLOT_BITS * level)) - 1)) == 0) {
+					relink(static_cast<uint32_t>(level * SLOTS_PER_LEVEL) + digit(current_tick_, level));
+				}
+			}
+		}
+
+		auto relink(uint32_t slot) noexcept -> void {
+			auto* timer = heads_[slot];
+			if (!timer) {
+				return;
+			}
+			heads_[slot] = nullptr;
+			timer->prev_timer_->next_timer_ = nullptr;
+			while (timer) {
+				auto* next = timer->next_timer_;
+				link(timer, slot_of(timer->timer_tick_));
+				timer = next;
+			}
+		}
+
+		auto link(T* timer, uint32_t slot) noexcept -> void {
+			auto*& head = heads_[slot];
+			if (!head) {
+				timer->prev_timer_ = timer->next_timer_ = timer;
+				head = timer;
+			}
+			else {
+				timer->next_timer_ = head;
+				timer->prev_timer_ = head->prev_timer_;
+				head->prev_timer_->next_timer_ = timer;
+				head->prev_timer_ = timer;
+			}
+			timer->timer_slot_ = slot;
+		}
+
+		auto unlink(T* timer) noexcept -> void {
+			auto*& head = heads_[timer->timer_slot_];
+			if (timer->next_timer_ == timer) {
+				head = nullptr;
+			}
+			else {
+				timer->prev_timer_->next_timer_ = timer->next_timer_;
+				timer->next_timer_->prev_timer_ = timer->prev_timer_;
+				if (head == timer) {
+					head = timer->next_timer_;
+				}
+			}
+			timer->prev_timer_ = timer->next_timer_ = nullptr;
+			timer->timer_slot_ = INVALID_TIMER_SLOT;
+		}
+
+		std::array<T*, SLOTS_PER_LEVEL * LEVELS + 2> heads_{}; //circular lists: every level's slots, then overflow and expired
+		uint64_t current_tick_ = 0; //every timer up to this tick is in the expired list or the current level 0 slot
+		size_t size_ = 0;
+	};
+}
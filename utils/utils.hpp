@@ -90,6 +90,12 @@ namespace kse::utils {
 		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
 	}
 
+	/// Nanoseconds from a monotonic clock with no fixed epoch, for ordering and measuring events within one process.
+	/// On Linux steady_clock is served from the vDSO off the invariant TSC, so a read costs tens of nanoseconds.
+	inline auto get_monotonic_timestamp() noexcept -> nananoseconds_t {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
 	inline auto& get_curren_time_str(std::string* time_str) {
 		const auto clock = std::chrono::system_clock::now();
 		const auto time = std::chrono::system_clock::to_time_t(clock);
@@ -165,6 +171,17 @@ namespace kse::utils {
 		return is_big_endian() ? value : swap_bytes_64(value);
 	}
 
+	constexpr uint64_t FNV1A_OFFSET_BASIS = 0xCBF29CE484222325;
+
+	/// 64-bit FNV-1a over raw bytes. Pass the previous result as `hash` to extend it over more data.
+	inline auto fnv1a(const void* data, size_t length, uint64_t hash = FNV1A_OFFSET_BASIS) noexcept -> uint64_t {
+		const auto* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < length; ++i) {
+			hash = (hash ^ bytes[i]) * 0x100000001B3;
+		}
+		return hash;
+	}
+
 #if defined(_MSC_VER)
 #include <intrin.h>
 	inline uint64_t rdtsc() noexcept {